@@ -0,0 +1,245 @@
+/*
+ * json_scan_bench.c — Timing of /get response parsing, json_scan vs cJSON
+ *
+ * Builds a fixed set of LRCLIB /get responses, from a short instrumental
+ * to a long synced-lyrics track, and extracts the members a track needs
+ * (syncedLyrics, plainLyrics, instrumental) with json_scan_object() and
+ * with a cJSON DOM.  Both must yield identical fields before anything
+ * is timed.  Each round copies the payload into a work buffer first,
+ * in both loops, since the scan decodes strings in place.
+ *
+ *   make bench                      (or: build/json_scan_bench [rounds])
+ */
+
+#include "json_scan.h"
+#include "cJSON.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_ROUNDS 2000
+
+/* Lyric lines, JSON-escaped: quotes, \u escapes, raw UTF-8, slashes */
+static const char *const phrases[] = {
+    "I've been waiting for a \\\"sign\\\" all night",
+    "Caf\\u00e9 lights are fading on the avenue",
+    "Na\xc3\xafve hearts and broken clocks",
+    "We run, we run / until the morning comes",
+    "\xd0\x9c\xd1\x8b \xd0\xb1\xd0\xb5\xd0\xb6\xd0\xb8\xd0\xbc \xd0\xb4\xd0"
+    "\xbe \xd1\x80\xd0\xb0\xd1\x81\xd1\x81\xd0\xb2\xd0\xb5\xd1\x82\xd0\xb0",
+    "Oh-oh, oh-oh\\t(echo)",
+    "Nothing's gonna stop us now \\u266a",
+    "Take me back to the start\\\\the end",
+};
+
+#define NUM_PHRASES ((int)(sizeof(phrases) / sizeof(phrases[0])))
+
+/* Lyric line counts of the payloads; 0 builds an instrumental */
+static const int payload_lines[] = { 0, 24, 60, 150, 400 };
+
+#define NUM_PAYLOADS \
+    ((int)(sizeof(payload_lines) / sizeof(payload_lines[0])))
+
+typedef struct {
+    char  *data;
+    size_t len, cap;
+} Buf;
+
+/* Members extracted from one payload */
+typedef struct {
+    const char *synced;
+    const char *plain;
+    int         instrumental;
+} Fields;
+
+/* ── Internal helpers ──────────────────────────────────────────────────── */
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void buf_printf(Buf *b, const char *fmt, ...)
+{
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+        va_end(ap);
+        if (n < 0) abort();
+        if ((size_t)n < b->cap - b->len) {
+            b->len += (size_t)n;
+            return;
+        }
+        b->cap = (b->cap + (size_t)n) * 2;
+        b->data = realloc(b->data, b->cap);
+        if (!b->data) abort();
+    }
+}
+
+/*
+ * A /get response with `lines` lines of lyrics, laid out as LRCLIB
+ * sends it: metadata first, plain lyrics, then the synced ones.
+ */
+static char *build_payload(int id, int lines, size_t *len)
+{
+    Buf b = { malloc(256), 0, 256 };
+    if (!b.data) abort();
+
+    buf_printf(&b, "{\"id\":%d,\"name\":\"Track %d\",\"trackName\":"
+               "\"Track %d\",\"artistName\":\"Bench Artist\",\"albumName\":"
+               "\"Bench Album (Deluxe)\",\"duration\":%d.0,"
+               "\"instrumental\":%s,", id, id, id, 120 + lines,
+               lines ? "false" : "true");
+    if (lines == 0) {
+        buf_printf(&b, "\"plainLyrics\":null,\"syncedLyrics\":null}");
+        *len = b.len;
+        return b.data;
+    }
+
+    buf_printf(&b, "\"plainLyrics\":\"");
+    for (int i = 0; i < lines; i++) {
+        buf_printf(&b, "%s%s", phrases[(i * 7 + id) % NUM_PHRASES],
+                   i + 1 < lines ? "\\n" : "");
+    }
+    buf_printf(&b, "\",\"syncedLyrics\":\"");
+    for (int i = 0; i < lines; i++) {
+        int cs = 1250 + i * 347;   /* centiseconds */
+        buf_printf(&b, "[%02d:%02d.%02d] %s%s", cs / 6000, cs / 100 % 60,
+                   cs % 100, phrases[(i * 7 + id) % NUM_PHRASES],
+                   i + 1 < lines ? "\\n" : "");
+    }
+    buf_printf(&b, "\"}");
+    *len = b.len;
+    return b.data;
+}
+
+static int scan_fields(char *work, Fields *out)
+{
+    JsonField f[3] = {
+        { .key = "syncedLyrics" },
+        { .key = "plainLyrics" },
+        { .key = "instrumental" },
+    };
+    if (json_scan_object(work, f, 3) != 0) return -1;
+
+    out->synced       = json_field_string(&f[0]);
+    out->plain        = json_field_string(&f[1]);
+    out->instrumental = f[2].kind == JSON_TRUE;
+    return 0;
+}
+
+static const char *dom_string(const cJSON *obj, const char *key)
+{
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(obj, key);
+    return cJSON_IsString(item) ? item->valuestring : NULL;
+}
+
+/* Caller frees the returned DOM, which owns the strings in `out` */
+static cJSON *dom_fields(const char *work, Fields *out)
+{
+    cJSON *obj = cJSON_Parse(work);
+    if (!cJSON_IsObject(obj)) {
+        cJSON_Delete(obj);
+        return NULL;
+    }
+
+    out->synced       = dom_string(obj, "syncedLyrics");
+    out->plain        = dom_string(obj, "plainLyrics");
+    out->instrumental =
+        cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(obj, "instrumental"));
+    return obj;
+}
+
+static int same_string(const char *a, const char *b)
+{
+    return (!a && !b) || (a && b && strcmp(a, b) == 0);
+}
+
+static unsigned long fields_check(const Fields *f)
+{
+    return (f->synced ? strlen(f->synced) : 0) +
+           (f->plain ? strlen(f->plain) : 0) + (unsigned long)f->instrumental;
+}
+
+/* ── Main ─────────────────────────────────────────────────────────────── */
+
+int main(int argc, char **argv)
+{
+    long rounds = argc > 1 ? strtol(argv[1], NULL, 10) : DEFAULT_ROUNDS;
+    if (rounds <= 0) {
+        fprintf(stderr, "usage: %s [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    char  *payloads[NUM_PAYLOADS];
+    size_t lens[NUM_PAYLOADS];
+    size_t total = 0, longest = 0;
+    for (int i = 0; i < NUM_PAYLOADS; i++) {
+        payloads[i] = build_payload(i + 1, payload_lines[i], &lens[i]);
+        total += lens[i];
+        if (lens[i] > longest) longest = lens[i];
+    }
+
+    char *work = malloc(longest + 1);
+    if (!work) abort();
+
+    /* Both parsers must agree on every payload */
+    for (int i = 0; i < NUM_PAYLOADS; i++) {
+        Fields a, b;
+        memcpy(work, payloads[i], lens[i] + 1);
+        cJSON *dom = dom_fields(payloads[i], &b);
+        if (scan_fields(work, &a) != 0 || !dom ||
+            !same_string(a.synced, b.synced) ||
+            !same_string(a.plain, b.plain) ||
+            a.instrumental != b.instrumental) {
+            fprintf(stderr, "error: json_scan and cJSON disagree on "
+                    "payload %d (%zu bytes)\n", i + 1, lens[i]);
+            return 1;
+        }
+        cJSON_Delete(dom);
+    }
+
+    printf("json_scan: %d payloads, %zu bytes (largest %zu), %ld rounds, "
+           "fields equal\n", NUM_PAYLOADS, total, longest, rounds);
+
+    double times[2];
+    unsigned long checks[2] = { 0, 0 };
+    for (int parser = 0; parser < 2; parser++) {
+        double start = now_sec();
+        for (long r = 0; r < rounds; r++) {
+            for (int i = 0; i < NUM_PAYLOADS; i++) {
+                Fields f;
+                memcpy(work, payloads[i], lens[i] + 1);
+                if (parser == 0) {
+                    if (scan_fields(work, &f) != 0) return 1;
+                    checks[0] += fields_check(&f);
+                } else {
+                    cJSON *dom = dom_fields(work, &f);
+                    if (!dom) return 1;
+                    checks[1] += fields_check(&f);
+                    cJSON_Delete(dom);
+                }
+            }
+        }
+        times[parser] = now_sec() - start;
+    }
+
+    static const char *const names[2] = { "json_scan", "cJSON" };
+    for (int parser = 0; parser < 2; parser++) {
+        double sec = times[parser];
+        printf("  %-20s %8.2f us/payload %8.1f MB/s   (check %lx)\n",
+               names[parser], sec * 1e6 / (double)(rounds * NUM_PAYLOADS),
+               (double)total * (double)rounds / sec / 1e6, checks[parser]);
+    }
+    printf("  json_scan speedup     %.2fx\n", times[1] / times[0]);
+
+    for (int i = 0; i < NUM_PAYLOADS; i++) free(payloads[i]);
+    free(work);
+    return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * normalize_bench.c — Timing of name normalization
+ *
+ * Runs normalize_buf() and normalize_stripped() over a fixed corpus of
+ * artist, title and album names, the mix a tagged library produces:
+ * plain ASCII, precomposed and decomposed accents, Greek and Cyrillic,
+ * stray whitespace and "feat." / "(Remastered)" suffixes.
+ *
+ *   make bench                      (or: build/normalize_bench [rounds])
+ */
+
+#include "normalize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_ROUNDS 20000
+
+static const char *const corpus[] = {
+    "Radiohead",
+    "Paranoid Android",
+    "OK Computer",
+    "The Beatles",
+    "Here Comes the Sun - Remastered 2009",
+    "Abbey Road (Remastered)",
+    "Daft Punk feat. Pharrell Williams",
+    "Get Lucky (Radio Edit) [feat. Pharrell Williams & Nile Rodgers]",
+    "  Random   Access  Memories  ",
+    "Sigur R\xc3\xb3s",                                  /* Sigur Rós */
+    "Sigur Ro\xcc\x81s",                                 /* decomposed ó */
+    "Hoppi\xcc\x81polla",
+    "Bj\xc3\xb6rk",
+    "J\xc3\xb3ga",
+    "Mot\xc3\xb6rhead",
+    "Ace of Spades (40th Anniversary Edition)",
+    "Bl\xc3\xa5 \xc3\x98yne",                            /* Blå Øyne */
+    "\xce\x9c\xce\xaf\xce\xba\xce\xb7\xcf\x82 \xce\x98\xce\xb5\xce\xbf"
+    "\xce\xb4\xcf\x89\xcf\x81\xce\xac\xce\xba\xce\xb7\xcf\x82",
+                                                         /* Μίκης Θεοδωράκης */
+    "\xd0\x9a\xd0\xb8\xd0\xbd\xd0\xbe",                  /* Кино */
+    "\xd0\x93\xd1\x80\xd1\x83\xd0\xbf\xd0\xbf\xd0\xb0 \xd0\xba\xd1\x80\xd0"
+    "\xbe\xd0\xb2\xd0\xb8",                              /* Группа крови */
+    "Caf\xc3\xa9 Tacvba",
+    "Ojal\xc3\xa1 que llueva caf\xc3\xa9",
+    "Beyonc\xc3\xa9 ft. JAY Z",
+    "Drunk in Love",
+    "Zero\xe2\x80\x8bWidth\xe2\x80\x8bSpace",            /* U+200B */
+    "No\xc2\xa0" "Break\xe3\x80\x80Spaces",              /* NBSP, U+3000 */
+    "MOTLEY CR\xc3\x9c" "E",
+    "Dr. Feelgood (2003 Remaster)",
+    "Wish You Were Here - 2011 Remastered Version",
+    "Shine On You Crazy Diamond, Pts. 1-5",
+};
+
+#define CORPUS_SIZE ((int)(sizeof(corpus) / sizeof(corpus[0])))
+
+/* ── Internal helpers ──────────────────────────────────────────────────── */
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double sec, long calls, size_t bytes,
+                   unsigned long check)
+{
+    printf("  %-20s %8.1f ns/name %8.1f MB/s   (check %lx)\n", name,
+           sec * 1e9 / (double)calls, (double)bytes / sec / 1e6, check);
+}
+
+/* ── Main ─────────────────────────────────────────────────────────────── */
+
+int main(int argc, char **argv)
+{
+    long rounds = argc > 1 ? strtol(argv[1], NULL, 10) : DEFAULT_ROUNDS;
+    if (rounds <= 0) {
+        fprintf(stderr, "usage: %s [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    size_t corpus_bytes = 0;
+    for (int i = 0; i < CORPUS_SIZE; i++) {
+        corpus_bytes += strlen(corpus[i]);
+    }
+    long calls = rounds * CORPUS_SIZE;
+
+    printf("normalize: %d names, %zu bytes, %ld rounds\n", CORPUS_SIZE,
+           corpus_bytes, rounds);
+
+    /* The check sums make the results observable, so no call is elided */
+    char out[256];
+    unsigned long check = 0;
+    double start = now_sec();
+    for (long r = 0; r < rounds; r++) {
+        for (int i = 0; i < CORPUS_SIZE; i++) {
+            size_t len = normalize_buf(corpus[i], out);
+            check += len + (unsigned char)out[0];
+        }
+    }
+    report("normalize_buf", now_sec() - start, calls,
+           corpus_bytes * (size_t)rounds, check);
+
+    check = 0;
+    start = now_sec();
+    for (long r = 0; r < rounds; r++) {
+        for (int i = 0; i < CORPUS_SIZE; i++) {
+            char *s = normalize_stripped(corpus[i]);
+            if (!s) {
+                fprintf(stderr, "error: out of memory\n");
+                return 1;
+            }
+            check += strlen(s) + (unsigned char)s[0];
+            free(s);
+        }
+    }
+    report("normalize_stripped", now_sec() - start, calls,
+           corpus_bytes * (size_t)rounds, check);
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * arena.h — Per-thread bump allocator for short-lived lookup data
+ *
+ * A lookup allocates an encoded URL, a response body, parser nodes and
+ * the lyrics strings, and all of it is dead once the track is written.
+ * Sync workers give their thread an arena and reset it after each
+ * track, so in the steady state a lookup makes no malloc() calls.
+ *
+ * Code on the lookup path allocates with arena_malloc() and
+ * arena_realloc(), which use the calling thread's arena when it has
+ * one and the heap otherwise, and gives memory back with
+ * arena_release(), which leaves arena memory alone.  Anything that can
+ * outlive the track or reach another thread must come from the heap.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* ── Types ─────────────────────────────────────────────────────────────── */
+
+typedef struct Arena Arena;
+
+/*
+ * Allocation counts across all threads, for confirming that lookups
+ * stay off the heap.  Arena counts are folded in on each reset.
+ */
+typedef struct {
+    long   arena_allocs;   /* served by an arena                        */
+    long   heap_allocs;    /* lookup-path allocations that hit malloc() */
+    long   blocks;         /* heap blocks the arenas themselves took    */
+    size_t peak_bytes;     /* most arena memory one track needed        */
+} ArenaStats;
+
+/* ── Public API ────────────────────────────────────────────────────────── */
+
+/*
+ * Create an empty arena.  Returns NULL on allocation failure.
+ */
+Arena *arena_new(void);
+
+/*
+ * Allocate `size` bytes (16-byte aligned) from `a`.  Returns NULL on
+ * allocation failure.
+ */
+void *arena_alloc(Arena *a, size_t size);
+
+/*
+ * Release everything allocated from `a` at once.  If the last cycle
+ * spilled into several blocks they are merged into one big enough for
+ * it, so the next cycle fits without growing.
+ */
+void arena_reset(Arena *a);
+
+/*
+ * Free the arena and every block it holds.  Safe to call with NULL.
+ */
+void arena_free(Arena *a);
+
+/*
+ * Make `a` the calling thread's arena (NULL for none).  The caller
+ * keeps ownership.
+ */
+void arena_set_thread(Arena *a);
+
+/*
+ * The calling thread's arena, or NULL.
+ */
+Arena *arena_thread(void);
+
+/*
+ * Allocate from the calling thread's arena, or the heap without one.
+ */
+void *arena_malloc(size_t size);
+
+/*
+ * Resize `p` (NULL, or `old_size` bytes from arena_malloc()).  The most
+ * recent arena allocation grows in place while its block has room.
+ */
+void *arena_realloc(void *p, size_t old_size, size_t size);
+
+/*
+ * Free `p` unless it lives in the calling thread's arena.  Safe to
+ * call with NULL.
+ */
+void arena_release(void *p);
+
+/*
+ * Allocation counts so far.
+ */
+ArenaStats arena_stats(void);
+
+#endif /* ARENA_H */
@@ -0,0 +1,81 @@
+/*
+ * cache.h — Persistent on-disk cache of LRCLIB responses
+ *
+ * Maps a lookup key to the /get response body, or to a "not found"
+ * marker for 404s.  The key is the normalized artist, title and album
+ * sent to LRCLIB plus the rounded duration, case folded and separated
+ * by 0x1f; a relaxed lookup (no album or duration, suffixes stripped)
+ * has a key of its own.  Tag spellings that LRCLIB would match alike
+ * therefore share one entry, found or not found.
+ *
+ * Each kind of entry has its own TTL; nothing else invalidates one.
+ * A later answer for the same key replaces it, and a change to the
+ * normalization yields new keys, so old entries just go unused until
+ * they expire or are evicted.  Entries are individual files replaced
+ * atomically, so any number of threads and processes may share one
+ * cache directory.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+
+/* ── Types ─────────────────────────────────────────────────────────────── */
+
+typedef enum {
+    CACHE_MISS = 0,    /* no usable entry: ask the server          */
+    CACHE_HIT,         /* cached response body                     */
+    CACHE_NEGATIVE     /* cached "not found"                       */
+} CacheResult;
+
+typedef struct LookupCache LookupCache;
+
+/*
+ * Counters for the run summary.
+ */
+typedef struct {
+    long hits;         /* CACHE_HIT and CACHE_NEGATIVE answers */
+    long misses;
+    long stored;
+} CacheStats;
+
+/* ── Public API ────────────────────────────────────────────────────────── */
+
+/*
+ * Open (creating if needed) the cache rooted at directory `dir`.
+ *
+ * Found entries expire after `ttl_secs`, not-found entries after
+ * `miss_ttl_secs`; 0 means never.  When `max_bytes` > 0 the least
+ * recently used entries are evicted on close to stay under it.
+ *
+ * Returns NULL on failure.  Close with cache_close().
+ */
+LookupCache *cache_open(const char *dir, long ttl_secs, long miss_ttl_secs,
+                        long long max_bytes);
+
+/*
+ * Look up `key`.  On CACHE_HIT, *body receives a NUL-terminated heap
+ * copy of the stored body (caller frees) and *len its length.
+ * Thread-safe.
+ */
+CacheResult cache_get(LookupCache *c, const char *key,
+                      char **body, size_t *len);
+
+/*
+ * Store `body` under `key`, or a not-found marker if `body` is NULL.
+ * Thread-safe.  Returns 0 on success, -1 on failure.
+ */
+int cache_put(LookupCache *c, const char *key, const char *body, size_t len);
+
+/*
+ * Read the counters.
+ */
+CacheStats cache_stats(LookupCache *c);
+
+/*
+ * Enforce the size cap and free the handle.  Safe to call with NULL.
+ */
+void cache_close(LookupCache *c);
+
+#endif /* CACHE_H */
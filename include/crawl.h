@@ -0,0 +1,57 @@
+/*
+ * crawl.h — Parallel recursive directory crawler
+ *
+ * Walks one or more library roots to any depth and reports every
+ * directory that directly contains audio files.  Directories are read
+ * relative to their parent's fd and spread across threads with work
+ * stealing, so the walk is bound by metadata I/O rather than by path
+ * building and stat() calls.
+ */
+
+#ifndef CRAWL_H
+#define CRAWL_H
+
+/* ── Types ─────────────────────────────────────────────────────────────── */
+
+/*
+ * A directory with at least one audio file, as seen by CrawlDirFn.
+ * All pointers are only valid for the duration of the callback.
+ */
+typedef struct {
+    const char  *path;       /* full path ("<root>/<rel>")                */
+    const char  *rel;        /* path relative to its root ("" = the root) */
+    const char  *name;       /* last path component                       */
+    char *const *files;      /* audio file names, relative to `path`      */
+    int          num_files;
+} CrawlDir;
+
+/*
+ * Called once per directory containing audio files.  May be called
+ * concurrently from several crawler threads.  Return 0 to continue the
+ * crawl, non-zero to stop it: directories not yet read are dropped.
+ */
+typedef int (*CrawlDirFn)(const CrawlDir *dir, void *user);
+
+/*
+ * Totals from a crawl.
+ */
+typedef struct {
+    long dirs;       /* directories read                                */
+    long files;      /* audio files found                               */
+    long albums;     /* directories with audio files                    */
+    long artists;    /* directories with at least one album as a child  */
+} CrawlStats;
+
+/* ── Public API ────────────────────────────────────────────────────────── */
+
+/*
+ * Crawl `num_roots` root directories with `num_threads` threads,
+ * invoking `fn` for every directory that contains audio files.
+ * Hidden entries (leading '.') are skipped.
+ *
+ * Returns 0 on success, -1 if no root could be opened.
+ */
+int crawl_tree(const char *const *roots, int num_roots, int num_threads,
+               CrawlDirFn fn, void *user, CrawlStats *stats);
+
+#endif /* CRAWL_H */
@@ -8,6 +8,8 @@
 #ifndef HTTP_CLIENT_H
 #define HTTP_CLIENT_H
 
+#include "ratelimit.h"
+
 #include <stddef.h>
 
 /* ── Types ─────────────────────────────────────────────────────────────── */
@@ -16,8 +18,42 @@ typedef struct {
     char  *body;        /* Response body (null-terminated)   */
     size_t size;        /* Body length in bytes              */
     long   status_code; /* HTTP status code (e.g. 200, 404)  */
+    int    lent;        /* body is the handle's receive buffer */
 } HttpResponse;
 
+/*
+ * Retry state of one request across http_get_attempt() calls.  Start
+ * zeroed; `retry_ms` > 0 after a call means "try again in that many ms".
+ */
+typedef struct {
+    int  attempts;      /* transient failures so far */
+    int  throttles;     /* 429/503 responses so far  */
+    long retry_ms;
+} HttpRetry;
+
+/*
+ * Retries scheduled so far across all requests.
+ */
+typedef struct {
+    long retries;
+    long wait_ms;       /* total delay those retries were scheduled with */
+} HttpRetryStats;
+
+/*
+ * Hedged requests sent so far.
+ */
+typedef struct {
+    long hedges;        /* duplicates sent                        */
+    long wins;          /* duplicates that answered first         */
+    long p95_ms;        /* current p95 latency, 0 until estimated */
+} HttpHedgeStats;
+
+/*
+ * Completion callback for http_get_async().  `resp` is NULL if the
+ * request failed after retries; the callee owns it otherwise.
+ */
+typedef void (*HttpDoneFn)(HttpResponse *resp, void *user);
+
 /* ── Public API ────────────────────────────────────────────────────────── */
 
 /*
@@ -27,15 +63,60 @@ typedef struct {
 int http_init(void);
 
 /*
- * Perform an HTTP GET request to `url`.
- * Returns a heap-allocated HttpResponse on success, NULL on failure.
- * Caller must free the response with http_response_free().
+ * Set the shared limiter's request rate (requests/second, 0 = no cap)
+ * and the ceiling of its adaptive concurrency window.
+ */
+void http_set_limits(double rate, int max_concurrency);
+
+/*
+ * Statistics of the shared limiter (throttles seen, current window).
+ */
+RateStats http_rate_stats(void);
+
+/*
+ * Perform an HTTP GET request to `url`.  Requests pass through the
+ * shared limiter; 429/503 responses are retried after Retry-After and
+ * transient errors with backoff.  Once retries run out, an HTTP error
+ * response is still returned so the caller can tell it from a 404.
+ * Returns an HttpResponse, or NULL on transport failure.  It lives in
+ * the calling thread's arena if it has one (see arena.h), else on the
+ * heap.  The body is lent from the thread's receive buffer and stays
+ * valid until the thread's next request; http_response_take_body()
+ * keeps it.  Caller must free the response with http_response_free().
  */
 HttpResponse *http_get(const char *url);
 
 /*
- * URL-encode a string using the thread-local CURL handle.
- * Caller must free() the result.
+ * Single attempt of http_get() that never sleeps.  If the request must
+ * be retried (throttled, transient error, limiter paused or its window
+ * full) it returns NULL with retry->retry_ms set, and the caller decides
+ * what to do in the meantime.  Otherwise retry->retry_ms is 0 and the result is final,
+ * exactly as http_get() would return it.
+ */
+HttpResponse *http_get_attempt(const char *url, HttpRetry *retry);
+
+/*
+ * Statistics on scheduled retries (all request paths).
+ */
+HttpRetryStats http_retry_stats(void);
+
+/*
+ * Enable hedging: a request still unanswered after the running p95
+ * latency gets one duplicate, and the first copy to answer is used.
+ * `budget` caps duplicates as a fraction of requests (0.05 = 5% extra),
+ * 0 disables.  Applies to blocking and async requests alike; call
+ * before the first request.
+ */
+void http_set_hedging(double budget);
+
+/*
+ * Statistics on hedged requests.
+ */
+HttpHedgeStats http_hedge_stats(void);
+
+/*
+ * URL-encode a string as curl_easy_escape() does, into memory from
+ * arena_malloc().  Caller must arena_release() the result.
  */
 char *http_url_encode(const char *str);
 
@@ -46,8 +127,51 @@ char *http_url_encode(const char *str);
 void http_thread_cleanup(void);
 
 /*
- * Free an HttpResponse previously returned by http_get().
- * Safe to call with NULL.
+ * Start the async engine: one event-loop thread driving a curl multi
+ * handle with at most `max_inflight` concurrent transfers, multiplexed
+ * over a few connections.  Call after http_init().
+ * Returns 0 on success, -1 on failure or if already running.
+ */
+int http_async_start(int max_inflight);
+
+/*
+ * Returns 1 if the async engine is running.
+ */
+int http_async_running(void);
+
+/*
+ * Queue a GET request on the async engine.  `done` is called exactly
+ * once, from the event-loop thread, so it must not block; it may queue
+ * further requests.  Retries follow the same rules as http_get().
+ * Returns 0 if queued, -1 on failure (`done` is not called).
+ */
+int http_get_async(const char *url, HttpDoneFn done, void *user);
+
+/*
+ * Wait for all queued async requests to complete, then stop the
+ * engine.  Safe to call when it is not running.
+ */
+void http_async_stop(void);
+
+/*
+ * Open up to `connections` connections to the host of `url` in
+ * parallel (HEAD requests) to fill the shared DNS and TLS session
+ * caches, so the first lookups on every thread skip the DNS query and
+ * resume a TLS session.  Returns the number opened.
+ */
+int http_warmup(const char *url, int connections);
+
+/*
+ * Take the body out of `resp` for the caller to keep: a lent body is
+ * copied with arena_malloc(), an owned one is handed over.  Release it
+ * with arena_release().  Returns NULL if there is no body or on
+ * allocation failure.
+ */
+char *http_response_take_body(HttpResponse *resp);
+
+/*
+ * Free an HttpResponse previously returned by http_get().  Responses
+ * in the calling thread's arena are left to it.  Safe to call with NULL.
  */
 void http_response_free(HttpResponse *resp);
 
@@ -0,0 +1,64 @@
+/*
+ * journal.h — Checkpoint journal of finished tracks for --resume
+ *
+ * A long run appends one line per finished track to the journal, in
+ * batches, as tracks complete.  If the run dies (killed, OOM, power
+ * cut on the container host), --resume loads the journal and the scan
+ * skips every file it lists without opening it.  A run that completes
+ * without errors removes its journal, so the next run starts afresh.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "state.h"
+
+/* ── Types ─────────────────────────────────────────────────────────────── */
+
+typedef struct Journal Journal;
+
+/* ── Public API ────────────────────────────────────────────────────────── */
+
+/*
+ * Open the journal at `path`.  With `resume`, the tracks an earlier
+ * run finished are loaded for journal_is_done() and new ones are
+ * appended; otherwise the journal is started empty.  So is an empty
+ * file, or one cut off inside the magic line; any other file that is
+ * not a journal is left alone.
+ *
+ * Returns NULL on failure.  Close with journal_close().
+ */
+Journal *journal_open(const char *path, int resume);
+
+/*
+ * Whether `filepath` was finished by the run being resumed.  Read-only
+ * after journal_open(), so safe from any thread.
+ */
+int journal_is_done(const Journal *j, const char *filepath);
+
+/*
+ * Number of finished tracks loaded on resume.
+ */
+long journal_count(const Journal *j);
+
+/*
+ * Buffer a finished track; large batches are written out right away.
+ * Calls must not overlap (the sync engine makes them from its reporter
+ * thread).
+ */
+void journal_add(Journal *j, const char *filepath, StateOutcome outcome);
+
+/*
+ * Append the buffered batch to the file.  Returns 0 on success, -1 on
+ * a write error (reported once on stderr).
+ */
+int journal_flush(Journal *j);
+
+/*
+ * Flush and close the journal.  With `finished` the run is complete
+ * and the file is removed; otherwise it is synced to disk for a later
+ * --resume.  Safe to call with NULL.
+ */
+void journal_close(Journal *j, int finished);
+
+#endif /* JOURNAL_H */
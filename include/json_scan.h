@@ -0,0 +1,58 @@
+/*
+ * json_scan.h — Single-pass extraction of fields from a JSON object
+ *
+ * For responses where only a few top-level members matter, a DOM is
+ * wasted work.  json_scan_object() validates the document and records
+ * where the wanted members are, without copying anything; string
+ * values are then decoded in place, inside the caller's buffer.
+ */
+
+#ifndef JSON_SCAN_H
+#define JSON_SCAN_H
+
+#include <stddef.h>
+
+/* ── Types ─────────────────────────────────────────────────────────────── */
+
+typedef enum {
+    JSON_ABSENT = 0,   /* member not present */
+    JSON_NULL,
+    JSON_FALSE,
+    JSON_TRUE,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_OTHER         /* object or array */
+} JsonKind;
+
+/*
+ * A member to look for.  Set `key` and zero the rest; the scan fills
+ * in the kind and, for strings and numbers, the raw text of the value
+ * (string contents still escaped, without the quotes).
+ */
+typedef struct {
+    const char *key;
+    JsonKind    kind;
+    char       *raw;
+    size_t      len;
+} JsonField;
+
+/* ── Public API ────────────────────────────────────────────────────────── */
+
+/*
+ * Scan the NUL-terminated JSON text `json`, which must hold a single
+ * object, and locate the top-level members named in `fields` (the
+ * first occurrence wins).  The whole document is validated; nested
+ * values are skipped.  Nothing is modified.
+ * Returns 0 on success, -1 if `json` is not a well-formed object.
+ */
+int json_scan_object(char *json, JsonField *fields, int count);
+
+/*
+ * Decode a JSON_STRING field in place: escapes are resolved (\uXXXX to
+ * UTF-8) inside the scanned buffer and the result NUL-terminated.
+ * Returns the string, or NULL if the field is not a string.  Call at
+ * most once per field.
+ */
+char *json_field_string(JsonField *f);
+
+#endif /* JSON_SCAN_H */
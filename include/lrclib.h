@@ -8,27 +8,139 @@
 #ifndef LRCLIB_H
 #define LRCLIB_H
 
+#include "cache.h"
+#include "http_client.h"
+#include "offline.h"
 
 /* ── Types ─────────────────────────────────────────────────────────────── */
 
+/*
+ * Both lyrics strings live either in `storage`, a response body owned
+ * by the track, or right after the struct in the same block.
+ */
 typedef struct {
-    char *synced_lyrics;
-    char *plain_lyrics;
+    char *synced_lyrics;    /* NULL if none */
+    char *plain_lyrics;     /* NULL if none */
     int   instrumental;
+    char *storage;
 } LrclibTrack;
 
+/*
+ * Outcome of a lookup.  LRCLIB_RETRY means the server was throttling
+ * or failing, so the track should be tried again later rather than be
+ * reported as missing.
+ */
+typedef enum {
+    LRCLIB_OK = 0,
+    LRCLIB_NOT_FOUND,
+    LRCLIB_RETRY,
+    LRCLIB_ERROR
+} LrclibStatus;
+
+/*
+ * Search results for one album, used to match its tracks locally.
+ */
+typedef struct LrclibAlbum LrclibAlbum;
+
+/*
+ * Completion callback for lrclib_get_async().  `track` is set only for
+ * LRCLIB_OK; the callee owns it.
+ */
+typedef void (*LrclibDoneFn)(LrclibStatus status, LrclibTrack *track,
+                             void *user);
+
 /* ── Public API ────────────────────────────────────────────────────────── */
 
 /*
  * Get the best matching track for the given metadata.
  * `album` and `duration` may be NULL / 0 to omit them.
  *
- * Returns a heap-allocated LrclibTrack on success, NULL if not found
- * or on error. Caller must free with lrclib_track_free().
+ * Returns an LrclibTrack on success, NULL if not found or on error.
+ * It lives in the calling thread's arena if it has one (see arena.h),
+ * so it is only valid until that arena is reset, else on the heap.
+ * Caller must free with lrclib_track_free() either way.
  */
 LrclibTrack *lrclib_get(const char *artist, const char *track,
                          const char *album, double duration);
 
+/*
+ * Like lrclib_get(), but reports why nothing was returned.  Sets *out
+ * (caller frees; allocated as by lrclib_get()) only when the result is
+ * LRCLIB_OK.
+ */
+LrclibStatus lrclib_lookup(const char *artist, const char *track,
+                           const char *album, double duration,
+                           LrclibTrack **out);
+
+/*
+ * One non-sleeping step of lrclib_lookup().  If the request has to be
+ * retried, returns LRCLIB_RETRY with retry->retry_ms > 0: call again
+ * with the same `retry` after that delay.  Any other result is final.
+ */
+LrclibStatus lrclib_lookup_attempt(const char *artist, const char *track,
+                                   const char *album, double duration,
+                                   HttpRetry *retry, LrclibTrack **out);
+
+/*
+ * Asynchronous lrclib_lookup() on the HTTP async engine (see
+ * http_async_start()).  `done` runs on the event-loop thread and must
+ * not block; on a cache hit it runs before this call returns.  The
+ * track it gets is always on the heap.  Returns 0 if the request was
+ * queued, -1 otherwise (`done` is not called).
+ */
+int lrclib_get_async(const char *artist, const char *track,
+                     const char *album, double duration,
+                     LrclibDoneFn done, void *user);
+
+/*
+ * Fetch LRCLIB's /search results for an album in one request, so its
+ * tracks can be matched without a /get each.  Returns NULL if the
+ * search failed (or in offline mode); callers then fall back to
+ * per-track lookups.  Free with lrclib_album_free().
+ */
+LrclibAlbum *lrclib_search_album(const char *artist, const char *album);
+
+/*
+ * Match a track against album search results by normalized artist,
+ * title and album, and duration within two seconds.  Returns LRCLIB_OK
+ * and sets *out (caller frees) only for a result that a per-track
+ * lookup could not improve on (synced lyrics or instrumental), allocated
+ * as by lrclib_get(); LRCLIB_NOT_FOUND means "do a per-track lookup".
+ * Thread-safe.
+ */
+LrclibStatus lrclib_album_match(const LrclibAlbum *results,
+                                const char *artist, const char *track,
+                                const char *album, double duration,
+                                LrclibTrack **out);
+
+void lrclib_album_free(LrclibAlbum *album);
+
+/*
+ * Number of lookups that piggybacked on an identical request already
+ * in flight instead of sending their own.
+ */
+long lrclib_shared_lookups(void);
+
+/*
+ * Answer every lookup from the offline `index` instead of the network
+ * (async lookups complete before lrclib_get_async() returns).  Pass
+ * NULL to go back online.  The caller keeps ownership.
+ */
+void lrclib_set_offline(OfflineIndex *index);
+
+/*
+ * Serve lookups from `cache` and store new results (found tracks and
+ * 404s) in it.  Pass NULL to go back to uncached lookups.  The caller
+ * keeps ownership and must not close the cache while lookups run.
+ */
+void lrclib_set_cache(LookupCache *cache);
+
+/*
+ * Open `connections` connections to LRCLIB ahead of the first lookup,
+ * priming the DNS and TLS session caches.  Returns the number opened.
+ */
+int lrclib_warmup(int connections);
+
 /* ── Memory management ─────────────────────────────────────────────────── */
 
 void lrclib_track_free(LrclibTrack *track);
@@ -16,6 +16,7 @@ typedef struct {
     char *album;
     int   track_number;
     int   duration;       /* Duration in seconds */
+    int   has_lyrics;     /* 1 if a LYRICS tag was present when scanned */
     char *filepath;
 } TrackMeta;
 
@@ -24,10 +25,41 @@ typedef struct {
     int         count;
 } TrackMetaList;
 
+/*
+ * Optional per-file filter for metadata_scan_dir_filtered().
+ * Return 1 to skip `filepath` without opening it.
+ */
+typedef int (*MetaFilterFn)(const char *filepath, void *user);
+
+/*
+ * Sink for metadata_scan_dir_each().  Receives ownership of each track
+ * as soon as it has been read.  Return 0 to continue scanning, non-zero
+ * to stop early.
+ */
+typedef int (*MetaSinkFn)(TrackMeta *meta, void *user);
+
 /* ── Public API ────────────────────────────────────────────────────────── */
 
 /*
- * Read metadata from a single audio file.
+ * Start `num_threads` parallel tag readers for directory scans (the
+ * scanning thread itself counts as one).  Values <= 1 keep scans
+ * serial.  Call once before scanning; returns 0 on success, -1 on failure.
+ */
+int metadata_scan_init(int num_threads);
+
+/*
+ * Stop the scan threads started by metadata_scan_init().
+ */
+void metadata_scan_cleanup(void);
+
+/*
+ * Check if a filename has a supported audio extension (case-insensitive).
+ */
+int metadata_is_audio_file(const char *filename);
+
+/*
+ * Read metadata from a single audio file.  Also records whether the
+ * file already carries embedded lyrics, so callers can skip lookups.
  * Returns a heap-allocated TrackMeta on success, NULL on failure.
  * Caller must free with metadata_free().
  */
@@ -40,6 +72,37 @@ TrackMeta *metadata_read(const char *filepath);
  */
 TrackMetaList *metadata_scan_dir(const char *dirpath);
 
+/*
+ * Like metadata_scan_dir(), but consults `filter` (if non-NULL) for each
+ * audio file before reading it.  `user` is passed through to the filter.
+ */
+TrackMetaList *metadata_scan_dir_filtered(const char *dirpath,
+                                          MetaFilterFn filter, void *user);
+
+/*
+ * Streaming scan: read each audio file in `dirpath` and hand it to
+ * `sink` in directory order as soon as it (and every file before it)
+ * has been read, without building a list first.  Reads are spread over
+ * the scan threads; `sink` is always called from the calling thread.
+ * `filter` may be NULL; `filter_user` / `sink_user` are passed through.
+ *
+ * Returns the number of tracks delivered, or -1 if the directory could
+ * not be opened.
+ */
+int metadata_scan_dir_each(const char *dirpath,
+                           MetaFilterFn filter, void *filter_user,
+                           MetaSinkFn sink, void *sink_user);
+
+/*
+ * Streaming scan over an already-listed directory: like
+ * metadata_scan_dir_each(), but reads the audio files `names[0..count)`
+ * inside `dirpath` instead of listing it again.  Returns the number of
+ * tracks delivered, or -1 on invalid arguments.
+ */
+int metadata_scan_files(const char *dirpath, char *const *names, int count,
+                        MetaFilterFn filter, void *filter_user,
+                        MetaSinkFn sink, void *sink_user);
+
 /*
  * Check and write lyrics in a single TagLib file open.
  * If force=0 and lyrics already exist, skips writing.
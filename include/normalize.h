@@ -0,0 +1,64 @@
+/*
+ * normalize.h — Canonical forms of artist, title and album names
+ *
+ * Tag strings and LRCLIB records spell the same name in different
+ * ways.  Comparing normalized forms lets local matching treat them as
+ * equal, and lets the cache and in-flight deduplication key lookups by
+ * what LRCLIB would match rather than by the exact bytes sent.
+ */
+
+#ifndef NORMALIZE_H
+#define NORMALIZE_H
+
+#include <stddef.h>
+
+/* ── Public API ────────────────────────────────────────────────────────── */
+
+/*
+ * Normalize `s` into `out`: combining marks composed (NFC), Unicode
+ * case folded, zero-width characters dropped, surrounding whitespace
+ * (including Unicode spaces) trimmed and inner runs collapsed to one
+ * space.  `out` needs strlen(s) + 1 bytes and may be `s` itself.
+ * Returns the length written.  No allocation; thread-safe.
+ */
+size_t normalize_buf(const char *s, char *out);
+
+/*
+ * normalize_buf() into a heap string (caller frees), or NULL on
+ * allocation failure.
+ */
+char *normalize_name(const char *s);
+
+/*
+ * Like normalize_buf() but without case folding: the form of a name
+ * to send to LRCLIB, which does its own case-insensitive matching.
+ */
+size_t normalize_query_buf(const char *s, char *out);
+
+/*
+ * Strip suffixes off the normalized string `s` of length `len` in
+ * place.  A suffix word in brackets takes the bracketed group with it
+ * and the text after the group stays; otherwise everything from the
+ * word, or from the " - " it follows, to the end goes.  The first word
+ * is never a suffix.  "artist feat. x", "song (remastered 2011)" and
+ * "hit (feat. x) remix" become "artist", "song" and "hit remix".
+ * Suffix words match regardless of ASCII case, so normalize_query_buf()
+ * output works too.  Returns the new length.  Thread-safe once the
+ * list is set.
+ */
+size_t normalize_strip(char *s, size_t len);
+
+/*
+ * normalize_name() followed by normalize_strip().
+ */
+char *normalize_stripped(const char *s);
+
+/*
+ * Replace the suffix words with a comma-separated list (a trailing '*'
+ * matches any word starting with it); NULL disables stripping.  The
+ * default is "feat.,feat,ft.,featuring,remaster*".  Call before any
+ * lookup starts.  Returns 0 on success, -1 on allocation failure.
+ */
+int normalize_set_suffixes(const char *list);
+
+#endif /* NORMALIZE_H */
@@ -0,0 +1,65 @@
+/*
+ * offline.h — Offline LRCLIB lookups against a local database dump
+ *
+ * An index is built once from a dump and then memory-mapped, so
+ * lookups need no network and cost a binary search.  Tracks are keyed
+ * by normalized artist + title; album and duration narrow the match
+ * the same way the /get endpoint does.
+ *
+ * Dump input is JSON Lines: one object per track using the API field
+ * names (trackName, artistName, albumName, duration, syncedLyrics,
+ * plainLyrics, instrumental) or the dump's column names (name,
+ * artist_name, album_name, synced_lyrics, plain_lyrics).
+ */
+
+#ifndef OFFLINE_H
+#define OFFLINE_H
+
+#include <stddef.h>
+
+/* ── Types ─────────────────────────────────────────────────────────────── */
+
+typedef struct OfflineIndex OfflineIndex;
+
+/*
+ * A matched track.  Strings point into the mapping and are
+ * NUL-terminated; they stay valid until offline_close().
+ */
+typedef struct {
+    const char *synced_lyrics;   /* NULL if none */
+    const char *plain_lyrics;    /* NULL if none */
+    int         instrumental;
+} OfflineMatch;
+
+/* ── Public API ────────────────────────────────────────────────────────── */
+
+/*
+ * Build an index at `index_path` from the JSON Lines dump at
+ * `dump_path` (or stdin if "-").  The index is written to a temporary
+ * file and renamed into place when complete.
+ * Returns the number of tracks indexed, or -1 on failure.
+ */
+long offline_build(const char *dump_path, const char *index_path);
+
+/*
+ * Map the index at `path`.  Returns NULL on failure.
+ */
+OfflineIndex *offline_open(const char *path);
+
+/*
+ * Find the best track for the given metadata.  `album` and `duration`
+ * may be NULL / 0 to match any album and length; otherwise the album
+ * must match and the duration be within two seconds.  Among matches,
+ * tracks with synced lyrics win over plain ones.
+ * Returns 1 and fills *out if found, 0 otherwise.  Thread-safe.
+ */
+int offline_find(const OfflineIndex *idx, const char *artist,
+                 const char *title, const char *album, double duration,
+                 OfflineMatch *out);
+
+/*
+ * Unmap the index.  Safe to call with NULL.
+ */
+void offline_close(OfflineIndex *idx);
+
+#endif /* OFFLINE_H */
@@ -0,0 +1,80 @@
+/*
+ * ratelimit.h — Shared request limiter for LRCLIB traffic
+ *
+ * Combines a token bucket (steady request rate), an AIMD concurrency
+ * window (additive increase on success, halved on 429/503) and a
+ * global pause that honors the server's Retry-After.  One limiter is
+ * shared by every HTTP handle in the process.
+ */
+
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+/* ── Types ─────────────────────────────────────────────────────────────── */
+
+typedef enum {
+    RATE_OK = 0,       /* request completed (any non-throttling status) */
+    RATE_THROTTLED,    /* 429 / 503: shrink the window and pause        */
+    RATE_FAILED        /* transport or 5xx error: no window change      */
+} RateSignal;
+
+typedef struct RateLimiter RateLimiter;
+
+/*
+ * Snapshot of limiter activity for summaries.
+ */
+typedef struct {
+    long   throttled;     /* RATE_THROTTLED signals received */
+    int    window;        /* current concurrency window      */
+    int    max_window;
+} RateStats;
+
+/* ── Public API ────────────────────────────────────────────────────────── */
+
+/*
+ * Create a limiter allowing `rate` requests per second (0 = no rate
+ * cap) and at most `max_window` concurrent requests.  The window
+ * starts small and grows while requests succeed.
+ * Returns NULL on failure.
+ */
+RateLimiter *ratelimit_new(double rate, int max_window);
+
+/*
+ * Change the rate cap and maximum window of a live limiter.
+ */
+void ratelimit_configure(RateLimiter *rl, double rate, int max_window);
+
+/*
+ * Take a slot without blocking.  Returns 0 if acquired, otherwise the
+ * number of milliseconds to wait before trying again, or -1 if the
+ * window is full (retry after a release).
+ */
+long ratelimit_try_acquire(RateLimiter *rl);
+
+/*
+ * Return a slot and feed back the outcome.  `retry_after` (seconds) is
+ * the server's Retry-After for RATE_THROTTLED, or 0 if absent.
+ */
+void ratelimit_release(RateLimiter *rl, RateSignal signal, long retry_after);
+
+/*
+ * Milliseconds left in the current Retry-After pause (0 if none).
+ */
+long ratelimit_pause_ms(RateLimiter *rl);
+
+/*
+ * Estimated milliseconds until a full window frees a slot: the average
+ * gap between releases, less the time since the last one (a whole gap
+ * once that is overdue).  Between 1ms and a second, so a caller polling
+ * with it neither spins nor oversleeps a release by much.
+ */
+long ratelimit_slot_wait_ms(RateLimiter *rl);
+
+/*
+ * Read the current statistics.
+ */
+RateStats ratelimit_stats(RateLimiter *rl);
+
+void ratelimit_free(RateLimiter *rl);
+
+#endif /* RATELIMIT_H */
@@ -0,0 +1,72 @@
+/*
+ * shard.h — Splitting one library run across several processes
+ *
+ * With --shard i/N each process syncs only the albums whose path
+ * (relative to the library root) hashes to shard i, so N processes on
+ * different hosts cover the library between them with no coordination:
+ * the hash is stable across runs, hosts and mount points.  Whole albums
+ * go to one shard, which keeps album searches and progress output
+ * together.
+ *
+ * Each shard writes its own logs and a JSON summary; the summaries are
+ * merged afterwards into one report.
+ */
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "sync.h"
+
+/* ── Types ─────────────────────────────────────────────────────────────── */
+
+/*
+ * One shard of a split run.  `count` 0 means the run is not split.
+ */
+typedef struct {
+    int index;   /* 1..count */
+    int count;
+} ShardSpec;
+
+/*
+ * What one shard did, as stored in its summary file.
+ */
+typedef struct {
+    ShardSpec  shard;
+    long       albums;    /* albums this shard synced */
+    double     seconds;   /* wall time of the run */
+    SyncResult result;
+} ShardSummary;
+
+/* ── Public API ────────────────────────────────────────────────────────── */
+
+/*
+ * Parse "i/N" (1 <= i <= N).  Returns 0 on success, -1 if malformed.
+ */
+int shard_parse(const char *spec, ShardSpec *out);
+
+/*
+ * Whether the album at `rel` (its path below the library root) belongs
+ * to shard `s`.  Always true for an unsplit run.
+ */
+int shard_owns(const ShardSpec *s, const char *rel);
+
+/*
+ * Per-shard variant of an output path: "missing.txt" becomes
+ * "missing.shard-2-of-4.txt".  Returns a heap string (a plain copy for
+ * an unsplit run), or NULL on allocation failure.
+ */
+char *shard_path(const char *path, const ShardSpec *s);
+
+/*
+ * Write `sum` as JSON to `path`, replacing it atomically.
+ * Returns 0 on success, -1 on failure.
+ */
+int shard_write_summary(const char *path, const ShardSummary *sum);
+
+/*
+ * Read a summary written by shard_write_summary().
+ * Returns 0 on success, -1 on failure.
+ */
+int shard_read_summary(const char *path, ShardSummary *out);
+
+#endif /* SHARD_H */
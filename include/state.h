@@ -0,0 +1,68 @@
+/*
+ * state.h — Persistent per-file state index for incremental syncs
+ *
+ * Remembers, for every processed file, its inode, size, mtime and the
+ * outcome of the last sync.  Library runs consult the index before
+ * opening a file so unchanged tracks are skipped without touching
+ * TagLib or the network.
+ */
+
+#ifndef STATE_H
+#define STATE_H
+
+/* ── Types ─────────────────────────────────────────────────────────────── */
+
+typedef enum {
+    STATE_NONE = 0,
+    STATE_SYNCED,        /* synced lyrics embedded (API or local .lrc) */
+    STATE_PLAIN,         /* only plain lyrics were available           */
+    STATE_MISSING,       /* LRCLIB had nothing for this track          */
+    STATE_INSTRUMENTAL,  /* LRCLIB marks the track as instrumental     */
+    STATE_TAGGED         /* file already carried lyrics                */
+} StateOutcome;
+
+typedef struct StateIndex StateIndex;
+
+/* ── Public API ────────────────────────────────────────────────────────── */
+
+/*
+ * Open (or create) the index file at `path`.
+ *
+ * Plain and missing outcomes older than `retry_secs` are treated as
+ * stale, so those tracks get looked up again (LRCLIB keeps growing).
+ * Pass 0 to never retry them.
+ *
+ * Returns NULL on failure.  Close with state_close().
+ */
+StateIndex *state_open(const char *path, long retry_secs);
+
+/*
+ * Check whether `filepath` is unchanged since its last recorded
+ * outcome (same inode, size and mtime) and does not need a retry.
+ * Returns 1 if the file can be skipped, with that outcome in *outcome
+ * unless it is NULL; 0 otherwise.  Thread-safe.
+ */
+int state_is_current(StateIndex *idx, const char *filepath,
+                     StateOutcome *outcome);
+
+/*
+ * Return the outcome recorded for `filepath` if the file is unchanged
+ * since (whether or not it is due for a retry), STATE_NONE otherwise.
+ * Safe to call with a NULL index.  Thread-safe.
+ */
+StateOutcome state_recorded(StateIndex *idx, const char *filepath);
+
+/*
+ * Record the outcome for `filepath`.  The file is stat()ed again so the
+ * entry reflects any lyrics that were just written.  Thread-safe.
+ * Returns 0 on success, -1 on failure.
+ */
+int state_record(StateIndex *idx, const char *filepath, StateOutcome outcome);
+
+/*
+ * Flush and close the index, compacting it if it holds many
+ * superseded records.  Safe to call with NULL.
+ */
+void state_close(StateIndex *idx);
+
+#endif /* STATE_H */
@@ -9,10 +9,33 @@
 #ifndef SYNC_H
 #define SYNC_H
 
+#include "journal.h"
 #include "metadata.h"
+#include "state.h"
+
+/* Most lookup or write threads a pool may have */
+#define SYNC_MAX_THREADS      256
+
+/* Auto-tuned lookup workers per usable CPU, for the default ceiling;
+   lookups mostly wait on the network */
+#define SYNC_THREADS_PER_CPU  64
 
 /* ── Types ─────────────────────────────────────────────────────────────── */
 
+/*
+ * Load on one pipeline stage (lookup or write) over a run.  A stage
+ * whose input queue stays deep while its threads are busy is the
+ * bottleneck; one stalled on a full downstream queue is waiting for it.
+ */
+typedef struct {
+    int    threads;     /* pool size                                     */
+    long   items;       /* tracks taken off the stage's input queue      */
+    int    max_queue;   /* deepest the input queue got                   */
+    double avg_queue;   /* input queue depth, averaged over the run      */
+    double busy;        /* share of thread time spent working, 0..1      */
+    double stalled;     /* share blocked on a full downstream queue      */
+} SyncStageStats;
+
 /*
  * Aggregated results from a sync run.
  */
@@ -22,24 +45,60 @@ typedef struct {
     int skipped;
     int not_found;
     int errors;
+    int lookups_saved;   /* tracks skipped before any LRCLIB request */
+    int unchanged;       /* files skipped via the state index at scan time */
+    int resumed;         /* files skipped as done by the run being resumed */
+    int interrupted;     /* tracks left unstarted by sync_request_stop() */
+    int spec_extra;      /* speculative relaxed lookups that were not needed */
+    long spec_saved_ms;  /* lookup latency saved by speculation */
+    int album_searches;  /* /search requests made for album batches */
+    int album_matches;   /* tracks answered from an album search */
+    SyncStageStats lookup_stage;  /* set in sync_engine_finish() totals only */
+    SyncStageStats write_stage;
+    int threads_end;     /* --threads auto: lookup workers at the end, */
+    int threads_peak;    /*   the most at once and the ceiling; 0 when */
+    int threads_max;     /*   not tuned (sync_engine_finish() only)    */
 } SyncResult;
 
 /*
  * Callback invoked after each track is processed.
  *
- *   idx    — 0-based track index
- *   total  — total number of tracks
+ *   idx    — 0-based track index within its album
+ *   total  — number of tracks in that album, or 0 while the album is
+ *            still being scanned and its size is not yet known
  *   title  — track title (may be NULL)
  *   status — status string (e.g. "✓ synced")
- *   user   — opaque pointer passed through from sync_tracks()
+ *   user   — opaque pointer passed to sync_tracks() or sync_engine_submit()
  *
- * The callback is called under a mutex, so it may safely write
- * to shared state or output streams without extra locking.
+ * Callbacks run on the engine's reporter thread, one at a time, so
+ * they may safely write to shared state or output streams without
+ * extra locking.  Workers never wait for them.
  */
 typedef void (*SyncProgressFn)(int idx, int total,
                                 const char *title, const char *status,
                                 void *user);
 
+/*
+ * Callback invoked once every track of an album submitted to a
+ * SyncEngine has been processed.
+ *
+ *   result — results for that album only
+ *   user   — the album's opaque pointer from sync_engine_submit()
+ *
+ * Called on the same reporter thread as SyncProgressFn.
+ */
+typedef void (*SyncAlbumDoneFn)(const SyncResult *result, void *user);
+
+/*
+ * Long-lived worker pool shared by all albums of a run.
+ */
+typedef struct SyncEngine SyncEngine;
+
+/*
+ * An album being streamed into a SyncEngine.
+ */
+typedef struct SyncAlbum SyncAlbum;
+
 /* ── Public API ────────────────────────────────────────────────────────── */
 
 /*
@@ -48,11 +107,46 @@ typedef void (*SyncProgressFn)(int idx, int total,
 typedef struct {
     int   force;         /* 1 = overwrite existing lyrics, 0 = skip */
     int   clean_lrc;     /* 1 = delete local .lrc file after embedding */
-    int   num_threads;   /* number of parallel workers */
+    int   num_threads;   /* number of parallel workers (auto: to start with) */
     char *out_plain;     /* file path for plain lyrics log */
     char *out_missing;   /* file path for missing lyrics log */
+    StateIndex *state;   /* per-file state index to update (may be NULL) */
+    Journal *journal;    /* finished tracks are appended here (may be NULL) */
+    int   max_inflight;  /* >0: async lookups (needs http_async_start()) */
+    int   speculative;   /* 1 = send exact and relaxed lookups together (async only) */
+    int   album_search;  /* 1 = one /search per album, /get only for the rest */
+    int   write_threads; /* tag writer threads (0 = same as num_threads) */
+    int   serialize_writes; /* 1 = at most one write per device at a time */
+    int   auto_threads;  /* 1 = resize the lookup pool from measured throughput,
+                            latency and errors (blocking lookups only) */
+    int   min_threads;   /* auto: smallest pool (0 = 1) */
+    int   max_threads;   /* auto: largest pool (0 = sync_thread_ceiling()) */
 } SyncConfig;
 
+/*
+ * CPUs this process may use: online CPUs, capped by a cgroup (v2 or
+ * v1) CPU quota rounded up.
+ */
+int sync_cpu_count(void);
+
+/*
+ * Default ceiling for an auto-tuned lookup pool: sync_cpu_count() times
+ * SYNC_THREADS_PER_CPU, at most SYNC_MAX_THREADS.
+ */
+int sync_thread_ceiling(void);
+
+/*
+ * Ask every engine to stop early: tracks not yet started are reported
+ * as interrupted, while lookups under way and queued writes finish
+ * normally.  Async-signal-safe, for SIGINT and SIGTERM handlers.
+ */
+void sync_request_stop(void);
+
+/*
+ * Whether sync_request_stop() has been called.
+ */
+int sync_stop_requested(void);
+
 /*
  * Sync lyrics for all tracks in `list`.
  *
@@ -66,4 +160,68 @@ typedef struct {
 SyncResult sync_tracks(const TrackMetaList *list, const SyncConfig *config,
                          SyncProgressFn progress, void *user);
 
+/*
+ * Start a worker pool of config->num_threads lookup threads and
+ * config->write_threads tag writers.  Albums submitted to it share one
+ * queue, so workers move on to the next album as soon as the current
+ * one runs out of unclaimed tracks.  Selected lyrics reach the writers
+ * through a bounded queue; lookups block while it is full.
+ *
+ *   progress   — per-track callback (may be NULL)
+ *   album_done — per-album completion callback (may be NULL)
+ *
+ * Returns NULL on failure.  Finish with sync_engine_finish().
+ */
+SyncEngine *sync_engine_new(const SyncConfig *config, SyncProgressFn progress,
+                            SyncAlbumDoneFn album_done);
+
+/*
+ * Queue every track of `list` as one album.  The engine takes ownership
+ * of `list` and frees it once the album is done.  `user` is forwarded
+ * to both callbacks for this album's tracks.
+ *
+ * Blocks while too many tracks are already waiting, which bounds memory
+ * when the directory walk outpaces the workers.
+ * Returns 0 on success, -1 on failure (the list is not consumed).
+ */
+int sync_engine_submit(SyncEngine *e, TrackMetaList *list, void *user);
+
+/*
+ * Streaming variant of sync_engine_submit(): open an album whose tracks
+ * are added one by one as the scan reads them, so workers can start on
+ * the first track while the rest of the directory is still being read.
+ * Every album must be closed with sync_album_end().
+ *
+ * Returns NULL on failure.
+ */
+SyncAlbum *sync_engine_begin_album(SyncEngine *e, void *user);
+
+/*
+ * Add a track to an open album.  The engine takes ownership of `meta`.
+ * Blocks while the engine queue is full (backpressure on the scan).
+ * Returns 0 on success, -1 on failure (`meta` is not consumed).
+ */
+int sync_album_add(SyncAlbum *album, TrackMeta *meta);
+
+/*
+ * Mark an album as complete.  The album-done callback fires once its
+ * last track has been processed (immediately if it has none).  The
+ * handle must not be used afterwards.
+ */
+void sync_album_end(SyncAlbum *album);
+
+/*
+ * Log a track the scan skipped as unchanged, which was last found with
+ * `outcome`, to the plain or missing lyrics log like a looked-up one.
+ * Thread-safe.
+ */
+void sync_engine_log_skipped(SyncEngine *e, const char *filepath,
+                             StateOutcome outcome);
+
+/*
+ * Wait for all queued albums, stop the workers and free the engine.
+ * Returns aggregated results over every submitted album.
+ */
+SyncResult sync_engine_finish(SyncEngine *e);
+
 #endif /* SYNC_H */
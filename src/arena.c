@@ -0,0 +1,227 @@
+/*
+ * arena.c — Per-thread bump allocator implementation
+ *
+ * An arena is a stack of heap blocks filled front to back.  Resetting
+ * rewinds it; a cycle that outgrew the first block leaves behind one
+ * merged block of the combined size, so a worker's arena settles after
+ * its largest track and never touches the heap again.
+ *
+ * Counters are kept per arena and folded into the process totals on
+ * reset, so the hot path does no atomic operations.
+ */
+
+#include "arena.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK (64 * 1024)   /* first block; later ones double */
+#define ARENA_ALIGN 16
+
+/* ── Internal types ───────────────────────────────────────────────────── */
+
+typedef struct Block {
+    struct Block  *next;          /* older blocks */
+    size_t         size;          /* bytes in `data` */
+    size_t         used;
+    unsigned char  data[];
+} Block;
+
+struct Arena {
+    Block *head;                  /* block being filled */
+    void  *last;                  /* latest allocation, may grow in place */
+    long   allocs;                /* this cycle */
+};
+
+static __thread Arena *tls_arena = NULL;
+
+static atomic_long total_arena_allocs;
+static atomic_long total_heap_allocs;
+static atomic_long total_blocks;
+static _Atomic size_t peak_bytes;
+
+/* ── Internal helpers ──────────────────────────────────────────────────── */
+
+static Block *block_new(size_t size)
+{
+    Block *b = malloc(sizeof(Block) + size);
+    if (!b) return NULL;
+
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+    atomic_fetch_add_explicit(&total_blocks, 1, memory_order_relaxed);
+    return b;
+}
+
+/*
+ * Carve `size` aligned bytes out of `b`, or return NULL if they do not
+ * fit.
+ */
+static void *block_take(Block *b, size_t size)
+{
+    uintptr_t start = ((uintptr_t)(b->data + b->used) + ARENA_ALIGN - 1) &
+                      ~(uintptr_t)(ARENA_ALIGN - 1);
+    size_t end = (size_t)(start - (uintptr_t)b->data) + size;
+    if (end > b->size) return NULL;
+
+    b->used = end;
+    return (void *)start;
+}
+
+static int arena_owns(const Arena *a, const void *p)
+{
+    const unsigned char *u = p;
+    for (const Block *b = a->head; b; b = b->next) {
+        if (u >= b->data && u < b->data + b->size) return 1;
+    }
+    return 0;
+}
+
+static void count_heap_alloc(void)
+{
+    atomic_fetch_add_explicit(&total_heap_allocs, 1, memory_order_relaxed);
+}
+
+/*
+ * Add this cycle's counts to the totals.  `used` is the memory the
+ * cycle took across all blocks.
+ */
+static void fold_stats(Arena *a, size_t used)
+{
+    atomic_fetch_add_explicit(&total_arena_allocs, a->allocs,
+                              memory_order_relaxed);
+    a->allocs = 0;
+
+    size_t peak = atomic_load_explicit(&peak_bytes, memory_order_relaxed);
+    while (used > peak &&
+           !atomic_compare_exchange_weak_explicit(&peak_bytes, &peak, used,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+static void free_blocks(Block *b)
+{
+    while (b) {
+        Block *next = b->next;
+        free(b);
+        b = next;
+    }
+}
+
+/* ── Public API ────────────────────────────────────────────────────────── */
+
+Arena *arena_new(void)
+{
+    return calloc(1, sizeof(Arena));
+}
+
+void *arena_alloc(Arena *a, size_t size)
+{
+    void *p = a->head ? block_take(a->head, size) : NULL;
+    if (!p) {
+        size_t want = size + ARENA_ALIGN;
+        size_t bsize = a->head ? a->head->size * 2 : ARENA_BLOCK;
+        if (bsize < want) bsize = want;
+
+        Block *b = block_new(bsize);
+        if (!b) return NULL;
+        b->next = a->head;
+        a->head = b;
+        p = block_take(b, size);
+    }
+
+    a->last = p;
+    a->allocs++;
+    return p;
+}
+
+void arena_reset(Arena *a)
+{
+    if (!a) return;
+
+    size_t used = 0, capacity = 0;
+    for (Block *b = a->head; b; b = b->next) {
+        used     += b->used;
+        capacity += b->size;
+    }
+    fold_stats(a, used);
+
+    if (a->head && a->head->next) {
+        /* Without room the next block is simply made on demand */
+        free_blocks(a->head);
+        a->head = block_new(capacity);
+    } else if (a->head) {
+        a->head->used = 0;
+    }
+    a->last = NULL;
+}
+
+void arena_free(Arena *a)
+{
+    if (!a) return;
+
+    arena_reset(a);
+    free_blocks(a->head);
+    free(a);
+}
+
+void arena_set_thread(Arena *a)
+{
+    tls_arena = a;
+}
+
+Arena *arena_thread(void)
+{
+    return tls_arena;
+}
+
+void *arena_malloc(size_t size)
+{
+    if (tls_arena) return arena_alloc(tls_arena, size);
+
+    count_heap_alloc();
+    return malloc(size);
+}
+
+void *arena_realloc(void *p, size_t old_size, size_t size)
+{
+    Arena *a = tls_arena;
+    if (!a || (p && !arena_owns(a, p))) {
+        count_heap_alloc();
+        return realloc(p, size);
+    }
+
+    /* The latest allocation sits at the end of the head block */
+    if (p && p == a->last) {
+        Block *b = a->head;
+        size_t end = (size_t)((unsigned char *)p - b->data) + size;
+        if (end <= b->size) {
+            b->used = end;
+            return p;
+        }
+    }
+
+    void *q = arena_alloc(a, size);
+    if (q && p) memcpy(q, p, old_size < size ? old_size : size);
+    return q;
+}
+
+void arena_release(void *p)
+{
+    if (!p || (tls_arena && arena_owns(tls_arena, p))) return;
+    free(p);
+}
+
+ArenaStats arena_stats(void)
+{
+    return (ArenaStats){
+        .arena_allocs = atomic_load(&total_arena_allocs),
+        .heap_allocs  = atomic_load(&total_heap_allocs),
+        .blocks       = atomic_load(&total_blocks),
+        .peak_bytes   = atomic_load(&peak_bytes)
+    };
+}
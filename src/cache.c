@@ -0,0 +1,420 @@
+/*
+ * cache.c — Persistent on-disk response cache implementation
+ *
+ * Layout: <dir>/<xx>/<hash>, where <hash> is the 64-bit FNV-1a of the
+ * key in hex and <xx> its first two digits, so no directory grows past
+ * a few thousand entries.  Each file holds a fixed header, the key and
+ * the body, covered by a CRC-32.  Writers build the file under a
+ * temporary name and rename() it into place, so readers in any thread
+ * or process see either the old entry or the new one, never a mix.
+ *
+ * The header carries the time the entry was stored (for TTLs); the
+ * file's mtime is bumped on every hit and drives LRU eviction.
+ */
+
+#include "cache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define CACHE_MAGIC        "S2MCACH1"
+#define CACHE_SHARDS       256
+#define CACHE_MAX_ENTRY    (8 * 1024 * 1024)
+#define CACHE_STALE_TMP    3600            /* seconds before a temp is junk */
+
+/* ── On-disk entry ────────────────────────────────────────────────────── */
+
+typedef struct {
+    char     magic[8];
+    uint32_t crc;        /* CRC-32 of the rest of the header, key and body */
+    uint8_t  negative;   /* 1 = "not found" marker, no body */
+    uint8_t  reserved[3];
+    uint32_t key_len;
+    uint32_t body_len;
+    int64_t  stamp;      /* seconds since epoch when stored */
+} CacheRecord;
+
+struct LookupCache {
+    char            *dir;
+    long             ttl_secs;
+    long             miss_ttl_secs;
+    long long        max_bytes;
+    unsigned long    tmp_seq;
+    CacheStats       stats;
+    pthread_mutex_t  mutex;
+};
+
+/* ── Internal helpers ─────────────────────────────────────────────────── */
+
+static uint64_t hash_key(const char *s, size_t len)
+{
+    uint64_t h = 1469598103934665603ULL;   /* FNV-1a */
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint32_t entry_crc(const CacheRecord *rec, const char *key,
+                          const char *body)
+{
+    size_t skip = sizeof(rec->magic) + sizeof(rec->crc);
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef *)rec + skip, (uInt)(sizeof(*rec) - skip));
+    crc = crc32(crc, (const Bytef *)key, rec->key_len);
+    if (rec->body_len > 0) {
+        crc = crc32(crc, (const Bytef *)body, rec->body_len);
+    }
+    return (uint32_t)crc;
+}
+
+/*
+ * Write the path of the entry for `key` into `buf`; `shard_len`
+ * receives the length of the "<dir>/<xx>" prefix.
+ */
+static void entry_path(const LookupCache *c, const char *key,
+                       char *buf, size_t size, size_t *shard_len)
+{
+    uint64_t h = hash_key(key, strlen(key));
+    int n = snprintf(buf, size, "%s/%02x/%016" PRIx64,
+                     c->dir, (unsigned)(h >> 56), h);
+    if (shard_len) *shard_len = (size_t)n - 17;
+}
+
+static int mkdir_p(const char *path)
+{
+    char *tmp = strdup(path);
+    if (!tmp) return -1;
+
+    for (char *p = tmp + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(tmp, 0755) != 0 && errno != EEXIST) {
+            free(tmp);
+            return -1;
+        }
+        *p = '/';
+    }
+    int rc = (mkdir(tmp, 0755) == 0 || errno == EEXIST) ? 0 : -1;
+    free(tmp);
+    return rc;
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p   += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void *buf, size_t len)
+{
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) return -1;
+        p   += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* ── Eviction ─────────────────────────────────────────────────────────── */
+
+typedef struct {
+    int64_t   mtime_ns;
+    long long size;
+    int       shard;
+    char      name[24];
+} EvictEntry;
+
+static int by_mtime(const void *a, const void *b)
+{
+    const EvictEntry *x = a, *y = b;
+    return (x->mtime_ns > y->mtime_ns) - (x->mtime_ns < y->mtime_ns);
+}
+
+/*
+ * Delete least recently used entries until the cache fits in
+ * max_bytes (with some headroom so the next run does not evict again).
+ */
+static void evict(LookupCache *c)
+{
+    EvictEntry *entries = NULL;
+    size_t count = 0, cap = 0;
+    long long total = 0;
+
+    size_t dir_len = strlen(c->dir);
+    char *shard_path = malloc(dir_len + 4);
+    if (!shard_path) return;
+
+    for (int s = 0; s < CACHE_SHARDS; s++) {
+        snprintf(shard_path, dir_len + 4, "%s/%02x", c->dir, s);
+        DIR *d = opendir(shard_path);
+        if (!d) continue;
+
+        struct dirent *de;
+        while ((de = readdir(d)) != NULL) {
+            if (strcmp(de->d_name, ".") == 0 ||
+                strcmp(de->d_name, "..") == 0) {
+                continue;
+            }
+
+            struct stat st;
+            if (fstatat(dirfd(d), de->d_name, &st, 0) != 0) continue;
+
+            if (de->d_name[0] == '.') {
+                /* A temporary: in use by a live writer, or left by a crash */
+                if (time(NULL) - st.st_mtim.tv_sec > CACHE_STALE_TMP) {
+                    unlinkat(dirfd(d), de->d_name, 0);
+                }
+                continue;
+            }
+            if (strlen(de->d_name) != 16) continue;
+
+            if (count == cap) {
+                size_t new_cap = cap ? cap * 2 : 1024;
+                EvictEntry *grown = realloc(entries,
+                                            new_cap * sizeof(EvictEntry));
+                if (!grown) break;
+                entries = grown;
+                cap = new_cap;
+            }
+
+            EvictEntry *e = &entries[count++];
+            e->mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL +
+                          st.st_mtim.tv_nsec;
+            e->size  = (long long)st.st_size;
+            e->shard = s;
+            memcpy(e->name, de->d_name, 17);
+            total += e->size;
+        }
+        closedir(d);
+    }
+
+    if (total > c->max_bytes) {
+        qsort(entries, count, sizeof(EvictEntry), by_mtime);
+
+        long long target = c->max_bytes / 10 * 9;
+        size_t path_size = dir_len + 4 + 1 + 17;
+        char *path = malloc(path_size);
+        for (size_t i = 0; path && i < count && total > target; i++) {
+            snprintf(path, path_size, "%s/%02x/%s",
+                     c->dir, entries[i].shard, entries[i].name);
+            if (unlink(path) == 0) total -= entries[i].size;
+        }
+        free(path);
+    }
+
+    free(entries);
+    free(shard_path);
+}
+
+/* ── Public API ───────────────────────────────────────────────────────── */
+
+LookupCache *cache_open(const char *dir, long ttl_secs, long miss_ttl_secs,
+                        long long max_bytes)
+{
+    if (!dir || !dir[0]) return NULL;
+
+    if (mkdir_p(dir) != 0) {
+        fprintf(stderr, "error: could not create cache directory '%s'\n", dir);
+        return NULL;
+    }
+
+    LookupCache *c = calloc(1, sizeof(LookupCache));
+    if (!c) return NULL;
+
+    c->dir = strdup(dir);
+    if (!c->dir) {
+        free(c);
+        return NULL;
+    }
+
+    /* Tolerate a trailing slash: entry paths append "/<xx>/..." */
+    size_t len = strlen(c->dir);
+    while (len > 1 && c->dir[len - 1] == '/') c->dir[--len] = '\0';
+
+    c->ttl_secs      = ttl_secs;
+    c->miss_ttl_secs = miss_ttl_secs;
+    c->max_bytes     = max_bytes;
+    pthread_mutex_init(&c->mutex, NULL);
+    return c;
+}
+
+CacheResult cache_get(LookupCache *c, const char *key,
+                      char **body, size_t *len)
+{
+    *body = NULL;
+    *len  = 0;
+    if (!c || !key) return CACHE_MISS;
+
+    size_t path_size = strlen(c->dir) + 4 + 1 + 17;
+    char path[path_size];
+    entry_path(c, key, path, path_size, NULL);
+
+    CacheResult result = CACHE_MISS;
+    char *buf = NULL;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) goto done;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CacheRecord) ||
+        st.st_size > CACHE_MAX_ENTRY) {
+        goto done;
+    }
+
+    size_t size = (size_t)st.st_size;
+    buf = malloc(size + 1);
+    if (!buf || read_all(fd, buf, size) != 0) goto done;
+
+    CacheRecord rec;
+    memcpy(&rec, buf, sizeof(rec));
+    size_t key_len = strlen(key);
+    const char *stored_key  = buf + sizeof(rec);
+    const char *stored_body = stored_key + rec.key_len;
+
+    if (memcmp(rec.magic, CACHE_MAGIC, 8) != 0 ||
+        rec.key_len != key_len ||
+        sizeof(rec) + (size_t)rec.key_len + rec.body_len != size ||
+        memcmp(stored_key, key, key_len) != 0 ||
+        entry_crc(&rec, stored_key, stored_body) != rec.crc) {
+        goto done;
+    }
+
+    long ttl = rec.negative ? c->miss_ttl_secs : c->ttl_secs;
+    if (ttl > 0 && (int64_t)time(NULL) - rec.stamp >= ttl) goto done;
+
+    /* Mark as recently used for eviction */
+    futimens(fd, NULL);
+
+    if (rec.negative) {
+        result = CACHE_NEGATIVE;
+    } else {
+        memmove(buf, stored_body, rec.body_len);
+        buf[rec.body_len] = '\0';
+        *body = buf;
+        *len  = rec.body_len;
+        buf = NULL;
+        result = CACHE_HIT;
+    }
+
+done:
+    if (fd >= 0) close(fd);
+    free(buf);
+
+    pthread_mutex_lock(&c->mutex);
+    if (result == CACHE_MISS) c->stats.misses++; else c->stats.hits++;
+    pthread_mutex_unlock(&c->mutex);
+    return result;
+}
+
+int cache_put(LookupCache *c, const char *key, const char *body, size_t len)
+{
+    if (!c || !key) return -1;
+
+    size_t key_len = strlen(key);
+    if (key_len > UINT32_MAX ||
+        sizeof(CacheRecord) + key_len + len > CACHE_MAX_ENTRY) {
+        return -1;
+    }
+
+    CacheRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    memcpy(rec.magic, CACHE_MAGIC, 8);
+    rec.negative = body ? 0 : 1;
+    rec.key_len  = (uint32_t)key_len;
+    rec.body_len = body ? (uint32_t)len : 0;
+    rec.stamp    = (int64_t)time(NULL);
+    rec.crc      = entry_crc(&rec, key, body);
+
+    size_t path_size = strlen(c->dir) + 4 + 1 + 17;
+    char path[path_size];
+    size_t shard_len;
+    entry_path(c, key, path, path_size, &shard_len);
+
+    pthread_mutex_lock(&c->mutex);
+    unsigned long seq = c->tmp_seq++;
+    pthread_mutex_unlock(&c->mutex);
+
+    /* Temporary name unique across threads and processes */
+    size_t tmp_size = path_size + 48;
+    char tmp[tmp_size];
+    snprintf(tmp, tmp_size, "%.*s/.%s.%ld.%lu", (int)shard_len, path,
+             path + shard_len + 1, (long)getpid(), seq);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0 && errno == ENOENT) {
+        /* First entry in this shard */
+        path[shard_len] = '\0';
+        mkdir(path, 0755);
+        path[shard_len] = '/';
+        fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    }
+    if (fd < 0) return -1;
+
+    int ok = write_all(fd, &rec, sizeof(rec)) == 0 &&
+             write_all(fd, key, key_len) == 0 &&
+             (rec.body_len == 0 || write_all(fd, body, len) == 0);
+    ok = (close(fd) == 0) && ok;
+
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+
+    pthread_mutex_lock(&c->mutex);
+    c->stats.stored++;
+    pthread_mutex_unlock(&c->mutex);
+    return 0;
+}
+
+CacheStats cache_stats(LookupCache *c)
+{
+    CacheStats stats = {0};
+    if (!c) return stats;
+
+    pthread_mutex_lock(&c->mutex);
+    stats = c->stats;
+    pthread_mutex_unlock(&c->mutex);
+    return stats;
+}
+
+void cache_close(LookupCache *c)
+{
+    if (!c) return;
+
+    /* Only a run that added entries can have pushed the cache over */
+    if (c->max_bytes > 0 && c->stats.stored > 0) {
+        evict(c);
+    }
+
+    pthread_mutex_destroy(&c->mutex);
+    free(c->dir);
+    free(c);
+}
@@ -0,0 +1,489 @@
+/*
+ * crawl.c — Parallel recursive directory crawler implementation
+ *
+ * Every directory is a node that holds an open fd and a reference on
+ * its parent.  Subdirectories are opened with openat() on the parent's
+ * fd and listed with getdents64 (readdir elsewhere); fstatat() is only
+ * needed when the kernel reports DT_UNKNOWN or a symlink.
+ *
+ * Each thread owns a deque of pending nodes: it pushes and pops at the
+ * bottom (depth-first, so few fds stay open) and idle threads steal
+ * from the top, where the larger subtrees near the roots sit.
+ */
+
+#define _GNU_SOURCE   /* DT_* constants, syscall() */
+
+#include "crawl.h"
+#include "metadata.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#define CRAWL_MAX_DEPTH   64      /* guards against symlink loops */
+#define CRAWL_DENTS_SIZE  65536
+
+/* ── Types ────────────────────────────────────────────────────────────── */
+
+typedef struct CrawlNode {
+    struct CrawlNode *parent;
+    char             *path;
+    size_t            rel_off;      /* start of the root-relative part */
+    size_t            name_off;     /* start of the last component     */
+    int               fd;
+    int               depth;
+    atomic_int        refs;         /* self + unfinished children      */
+    atomic_int        has_album_child;
+} CrawlNode;
+
+typedef struct {
+    CrawlNode      **items;
+    int              head;          /* steal end   */
+    int              tail;          /* owner end   */
+    int              cap;
+    pthread_mutex_t  lock;
+} Deque;
+
+typedef struct {
+    Deque           *deques;
+    int              num_threads;
+    CrawlDirFn       fn;
+    void            *user;
+
+    atomic_long      pending;       /* nodes queued or being processed */
+    atomic_long      queued;        /* nodes sitting in a deque        */
+    atomic_int       stopped;       /* a callback asked to stop        */
+    atomic_int       sleepers;
+    pthread_mutex_t  idle_lock;
+    pthread_cond_t   idle_cond;
+
+    atomic_long      dirs;
+    atomic_long      files;
+    atomic_long      albums;
+    atomic_long      artists;
+} Crawler;
+
+typedef struct {
+    Crawler *crawler;
+    int      self;
+} CrawlWorker;
+
+/* ── Work-stealing deque ──────────────────────────────────────────────── */
+
+static int deque_push(Deque *d, CrawlNode *node)
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->tail == d->cap) {
+        if (d->head > 0) {
+            memmove(d->items, d->items + d->head,
+                    (size_t)(d->tail - d->head) * sizeof(CrawlNode *));
+            d->tail -= d->head;
+            d->head  = 0;
+        } else {
+            int cap = d->cap ? d->cap * 2 : 64;
+            CrawlNode **items = realloc(d->items, (size_t)cap * sizeof(CrawlNode *));
+            if (!items) {
+                pthread_mutex_unlock(&d->lock);
+                return -1;
+            }
+            d->items = items;
+            d->cap   = cap;
+        }
+    }
+    d->items[d->tail++] = node;
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+static CrawlNode *deque_pop(Deque *d)
+{
+    CrawlNode *node = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head) {
+        node = d->items[--d->tail];
+        if (d->tail == d->head) d->head = d->tail = 0;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return node;
+}
+
+static CrawlNode *deque_steal(Deque *d)
+{
+    CrawlNode *node = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head) {
+        node = d->items[d->head++];
+        if (d->tail == d->head) d->head = d->tail = 0;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return node;
+}
+
+/* ── Nodes ────────────────────────────────────────────────────────────── */
+
+static CrawlNode *node_new(CrawlNode *parent, const char *name, size_t name_len)
+{
+    CrawlNode *node = calloc(1, sizeof(CrawlNode));
+    if (!node) return NULL;
+
+    size_t plen = strlen(parent->path);
+    node->path = malloc(plen + name_len + 2);
+    if (!node->path) {
+        free(node);
+        return NULL;
+    }
+    memcpy(node->path, parent->path, plen);
+    node->path[plen] = '/';
+    memcpy(node->path + plen + 1, name, name_len + 1);
+
+    node->parent   = parent;
+    node->rel_off  = parent->rel_off ? parent->rel_off : plen + 1;
+    node->name_off = plen + 1;
+    node->fd       = -1;
+    node->depth    = parent->depth + 1;
+    atomic_init(&node->refs, 1);
+    atomic_init(&node->has_album_child, 0);
+
+    atomic_fetch_add(&parent->refs, 1);
+    return node;
+}
+
+/*
+ * Drop one reference; the last one closes the fd, accounts the node as
+ * an artist if any child was an album, and releases the parent.
+ */
+static void node_release(Crawler *c, CrawlNode *node)
+{
+    while (node && atomic_fetch_sub(&node->refs, 1) == 1) {
+        CrawlNode *parent = node->parent;
+        if (atomic_load(&node->has_album_child)) {
+            atomic_fetch_add(&c->artists, 1);
+        }
+        if (node->fd >= 0) close(node->fd);
+        free(node->path);
+        free(node);
+        node = parent;
+    }
+}
+
+/* ── Directory listing ────────────────────────────────────────────────── */
+
+typedef struct {
+    Crawler    *crawler;
+    int         self;
+    CrawlNode  *node;
+    char      **files;
+    int         num_files;
+    int         cap_files;
+} ListCtx;
+
+static void queue_node(Crawler *c, int self, CrawlNode *node)
+{
+    atomic_fetch_add(&c->pending, 1);
+    if (deque_push(&c->deques[self], node) != 0) {
+        atomic_fetch_sub(&c->pending, 1);
+        node_release(c, node);
+        return;
+    }
+    atomic_fetch_add(&c->queued, 1);
+
+    if (atomic_load(&c->sleepers) > 0) {
+        pthread_mutex_lock(&c->idle_lock);
+        pthread_cond_signal(&c->idle_cond);
+        pthread_mutex_unlock(&c->idle_lock);
+    }
+}
+
+static void visit_entry(ListCtx *ctx, const char *name, unsigned char type)
+{
+    if (name[0] == '.') return;   /* hidden entries, "." and ".." */
+
+    int is_dir = (type == DT_DIR);
+    int is_reg = (type == DT_REG);
+
+    if (type == DT_UNKNOWN || type == DT_LNK) {
+        struct stat st;
+        if (fstatat(ctx->node->fd, name, &st, 0) != 0) return;
+        is_dir = S_ISDIR(st.st_mode);
+        is_reg = S_ISREG(st.st_mode);
+    }
+
+    if (is_dir) {
+        if (ctx->node->depth >= CRAWL_MAX_DEPTH) return;
+        CrawlNode *child = node_new(ctx->node, name, strlen(name));
+        if (child) queue_node(ctx->crawler, ctx->self, child);
+        return;
+    }
+
+    if (!is_reg || !metadata_is_audio_file(name)) return;
+
+    if (ctx->num_files >= ctx->cap_files) {
+        int cap = ctx->cap_files ? ctx->cap_files * 2 : 32;
+        char **files = realloc(ctx->files, (size_t)cap * sizeof(char *));
+        if (!files) return;
+        ctx->files     = files;
+        ctx->cap_files = cap;
+    }
+    char *copy = strdup(name);
+    if (copy) ctx->files[ctx->num_files++] = copy;
+}
+
+#ifdef __linux__
+
+struct linux_dirent64 {
+    unsigned long long d_ino;
+    long long          d_off;
+    unsigned short     d_reclen;
+    unsigned char      d_type;
+    char               d_name[];
+};
+
+static void list_dir(ListCtx *ctx, char *buf)
+{
+    for (;;) {
+        long n = syscall(SYS_getdents64, ctx->node->fd, buf, CRAWL_DENTS_SIZE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        for (long off = 0; off < n;) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + off);
+            visit_entry(ctx, d->d_name, d->d_type);
+            off += d->d_reclen;
+        }
+    }
+}
+
+#else
+
+static void list_dir(ListCtx *ctx, char *buf)
+{
+    (void)buf;
+    int fd = dup(ctx->node->fd);
+    DIR *dir = fd >= 0 ? fdopendir(fd) : NULL;
+    if (!dir) {
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        visit_entry(ctx, entry->d_name, entry->d_type);
+    }
+    closedir(dir);
+}
+
+#endif
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/*
+ * Open and list one directory, queue its subdirectories, and report it
+ * if it holds audio files.
+ */
+static void process_node(Crawler *c, int self, CrawlNode *node, char *buf)
+{
+    if (atomic_load(&c->stopped)) return;
+
+    if (node->fd < 0) {
+        node->fd = openat(node->parent->fd, node->path + node->name_off,
+                          O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    if (node->fd < 0) {
+        fprintf(stderr, "warning: could not open '%s'\n", node->path);
+        return;
+    }
+
+    atomic_fetch_add(&c->dirs, 1);
+
+    ListCtx ctx = { .crawler = c, .self = self, .node = node };
+    list_dir(&ctx, buf);
+
+    if (ctx.num_files > 0) {
+        atomic_fetch_add(&c->albums, 1);
+        atomic_fetch_add(&c->files, ctx.num_files);
+        if (node->parent) atomic_store(&node->parent->has_album_child, 1);
+
+        /* Keep names in a stable order for the scan and the output */
+        qsort(ctx.files, (size_t)ctx.num_files, sizeof(char *), compare_names);
+
+        CrawlDir dir = {
+            .path      = node->path,
+            .rel       = node->rel_off ? node->path + node->rel_off : "",
+            .name      = node->path + node->name_off,
+            .files     = ctx.files,
+            .num_files = ctx.num_files
+        };
+        if (c->fn(&dir, c->user) != 0) atomic_store(&c->stopped, 1);
+    }
+
+    for (int i = 0; i < ctx.num_files; i++) free(ctx.files[i]);
+    free(ctx.files);
+}
+
+/* ── Worker threads ───────────────────────────────────────────────────── */
+
+static CrawlNode *find_work(Crawler *c, int self)
+{
+    CrawlNode *node = deque_pop(&c->deques[self]);
+    for (int i = 1; !node && i < c->num_threads; i++) {
+        node = deque_steal(&c->deques[(self + i) % c->num_threads]);
+    }
+    if (node) atomic_fetch_sub(&c->queued, 1);
+    return node;
+}
+
+static void *crawl_worker(void *arg)
+{
+    CrawlWorker *w = arg;
+    Crawler *c = w->crawler;
+
+    char *buf = malloc(CRAWL_DENTS_SIZE);
+    if (!buf) return NULL;
+
+    for (;;) {
+        CrawlNode *node = find_work(c, w->self);
+        if (node) {
+            process_node(c, w->self, node, buf);
+            node_release(c, node);
+
+            if (atomic_fetch_sub(&c->pending, 1) == 1) {
+                /* Last node done: wake everyone so they can exit */
+                pthread_mutex_lock(&c->idle_lock);
+                pthread_cond_broadcast(&c->idle_cond);
+                pthread_mutex_unlock(&c->idle_lock);
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&c->idle_lock);
+        atomic_fetch_add(&c->sleepers, 1);
+        while (atomic_load(&c->queued) == 0 && atomic_load(&c->pending) > 0) {
+            pthread_cond_wait(&c->idle_cond, &c->idle_lock);
+        }
+        atomic_fetch_sub(&c->sleepers, 1);
+        int finished = (atomic_load(&c->pending) == 0);
+        pthread_mutex_unlock(&c->idle_lock);
+
+        if (finished) break;
+    }
+
+    free(buf);
+    return NULL;
+}
+
+/* ── Public API ───────────────────────────────────────────────────────── */
+
+int crawl_tree(const char *const *roots, int num_roots, int num_threads,
+               CrawlDirFn fn, void *user, CrawlStats *stats)
+{
+    if (!roots || num_roots <= 0 || !fn) return -1;
+    if (num_threads < 1) num_threads = 1;
+
+    Crawler c = { .num_threads = num_threads, .fn = fn, .user = user };
+    atomic_init(&c.pending, 0);
+    atomic_init(&c.queued, 0);
+    atomic_init(&c.stopped, 0);
+    atomic_init(&c.sleepers, 0);
+    atomic_init(&c.dirs, 0);
+    atomic_init(&c.files, 0);
+    atomic_init(&c.albums, 0);
+    atomic_init(&c.artists, 0);
+    pthread_mutex_init(&c.idle_lock, NULL);
+    pthread_cond_init(&c.idle_cond, NULL);
+
+    c.deques = calloc((size_t)num_threads, sizeof(Deque));
+    CrawlWorker *workers = calloc((size_t)num_threads, sizeof(CrawlWorker));
+    pthread_t *threads = calloc((size_t)num_threads, sizeof(pthread_t));
+    if (!c.deques || !workers || !threads) {
+        free(c.deques);
+        free(workers);
+        free(threads);
+        return -1;
+    }
+    for (int i = 0; i < num_threads; i++) {
+        pthread_mutex_init(&c.deques[i].lock, NULL);
+        workers[i].crawler = &c;
+        workers[i].self    = i;
+    }
+
+    /* Roots are opened up front and spread round-robin over the deques */
+    int opened = 0;
+    for (int i = 0; i < num_roots; i++) {
+        int fd = open(roots[i], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            fprintf(stderr, "error: could not open '%s'\n", roots[i]);
+            continue;
+        }
+
+        CrawlNode *root = calloc(1, sizeof(CrawlNode));
+        char *path = strdup(roots[i]);
+        if (!root || !path) {
+            free(root);
+            free(path);
+            close(fd);
+            continue;
+        }
+
+        /* Strip trailing slashes so child paths join cleanly */
+        size_t len = strlen(path);
+        while (len > 1 && path[len - 1] == '/') path[--len] = '\0';
+        const char *slash = strrchr(path, '/');
+
+        root->path     = path;
+        root->name_off = (slash && slash[1]) ? (size_t)(slash + 1 - path) : 0;
+        root->fd       = fd;
+        atomic_init(&root->refs, 1);
+        atomic_init(&root->has_album_child, 0);
+
+        queue_node(&c, opened % num_threads, root);
+        opened++;
+    }
+
+    if (opened > 0) {
+        int started = 1;
+        for (int i = 1; i < num_threads; i++) {
+            if (pthread_create(&threads[i], NULL, crawl_worker, &workers[i]) != 0) {
+                break;
+            }
+            started++;
+        }
+        /* Deques of threads that failed to start are still stolen from */
+        crawl_worker(&workers[0]);
+        for (int i = 1; i < started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    if (stats) {
+        stats->dirs    = atomic_load(&c.dirs);
+        stats->files   = atomic_load(&c.files);
+        stats->albums  = atomic_load(&c.albums);
+        stats->artists = atomic_load(&c.artists);
+    }
+
+    for (int i = 0; i < num_threads; i++) {
+        free(c.deques[i].items);
+        pthread_mutex_destroy(&c.deques[i].lock);
+    }
+    free(c.deques);
+    free(workers);
+    free(threads);
+    pthread_cond_destroy(&c.idle_cond);
+    pthread_mutex_destroy(&c.idle_lock);
+
+    return opened > 0 ? 0 : -1;
+}
@@ -4,9 +4,30 @@
  * Uses thread-local CURL handles for connection pooling and reuse.
  * Each thread gets its own handle on first use, avoiding repeated
  * init/cleanup overhead and enabling TCP/TLS connection reuse.
+ *
+ * All handles share one DNS cache and TLS session cache.  Connections
+ * are pooled per handle (the async engine's by its multi handle): a
+ * shared connection cache must not be used by several threads at once.
+ *
+ * The optional async engine runs a curl multi handle on one event-loop
+ * thread, so many requests can be in flight (multiplexed over HTTP/2
+ * where available) without a thread per request.
+ *
+ * Optional hedging sends one duplicate of a request that has not
+ * answered within the running p95 latency and keeps whichever copy
+ * answers first without an error, within a budget of extra requests.
+ *
+ * Bodies are received into buffers sized from the announced
+ * Content-Length that grow geometrically past it.  A thread's blocking
+ * handles keep theirs across requests and lend the finished body to
+ * the response until the next request; a caller that keeps it gets a
+ * copy in the thread's arena (see arena.h).  Async transfers hand
+ * their buffer over with the response.
  */
 
 #include "http_client.h"
+#include "arena.h"
+#include "ratelimit.h"
 
 #include <curl/curl.h>
 #include <stdio.h>
@@ -18,9 +39,75 @@
 
 #define USER_AGENT "synclyr2metadata (https://github.com/newtonsart/synclyr2metadata)"
 
-/* ── Thread-local CURL handle ─────────────────────────────────────────── */
+#define MAX_RETRIES       3
+#define BASE_DELAY_SEC    1   /* 1s, 2s, 4s */
+#define ASYNC_MAX_CONNS   4   /* connections per host for the async engine */
+#define MAX_POOLED_CONNS  32  /* idle connections a handle keeps */
+#define MAX_THROTTLES     8   /* 429/503 responses tolerated per request */
+#define DEFAULT_WINDOW    16  /* concurrency cap until http_set_limits() */
 
-static __thread CURL *tls_curl = NULL;
+#define LATENCY_SAMPLES   256  /* recent latencies behind the p95 estimate */
+#define HEDGE_MIN_SAMPLES 20   /* below this the initial delay is used */
+#define HEDGE_INITIAL_MS  2000
+#define HEDGE_MIN_MS      50   /* never hedge sooner than this */
+
+#define RECV_MIN_SIZE     (16 * 1024)   /* without a Content-Length */
+#define RECV_KEEP_MAX     (256 * 1024)  /* larger buffers are not kept */
+
+/* ── Shared state ─────────────────────────────────────────────────────── */
+
+/*
+ * Process-wide share: every handle (thread-local, async and warm-up)
+ * uses the same DNS cache and TLS session cache, so a new connection
+ * on any thread resumes a session instead of a full handshake, even
+ * after the thread that made it is gone.  Connections are not shared:
+ * libcurl's connection cache is not safe for concurrent use.
+ */
+static CURLSH          *http_share = NULL;
+static pthread_mutex_t  share_locks[CURL_LOCK_DATA_LAST];
+
+/* Shared by every request: token bucket, AIMD window, Retry-After */
+static RateLimiter *http_limiter = NULL;
+
+/* Retries scheduled so far, by any request path */
+static HttpRetryStats  retry_stats;
+static pthread_mutex_t retry_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* CA locations, detected once in http_init() */
+static const char *http_ca_file = NULL;
+static const char *http_ca_path = NULL;
+
+/*
+ * Hedging: ring of recent latencies, the p95 derived from it, and the
+ * extra-request budget.  `budget` is set before any request starts.
+ */
+static struct {
+    pthread_mutex_t lock;
+    double          budget;          /* hedges per request, 0 = off */
+    long            samples[LATENCY_SAMPLES];
+    int             count;
+    int             next;
+    long            p95_ms;
+    long            requests;
+    long            hedges;
+    long            wins;
+} hedging = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/*
+ * Where a transfer's body is received.
+ */
+typedef struct {
+    CURL   *curl;       /* transfer, for its Content-Length */
+    char   *data;
+    size_t  len;
+    size_t  cap;
+} Receiver;
+
+static __thread CURL  *tls_curl  = NULL;
+static __thread CURL  *tls_hedge = NULL;   /* duplicate of a hedged request */
+static __thread CURLM *tls_multi = NULL;   /* runs a hedged pair */
+static __thread Receiver tls_recv;         /* bodies for tls_curl */
+static __thread Receiver tls_hedge_recv;   /* bodies for tls_hedge */
 
 static const char *first_readable_file(const char *const *paths, size_t count)
 {
@@ -131,15 +218,33 @@ static void print_ca_hint(CURLcode code, const char *ca_file,
             "hint: set CURL_CA_BUNDLE or SSL_CERT_FILE if your cert store is in a custom path.\n");
 }
 
+static void share_lock(CURL *handle, curl_lock_data data,
+                       curl_lock_access access, void *userptr)
+{
+    (void)handle;
+    (void)access;
+    (void)userptr;
+    pthread_mutex_lock(&share_locks[data]);
+}
+
+static void share_unlock(CURL *handle, curl_lock_data data, void *userptr)
+{
+    (void)handle;
+    (void)userptr;
+    pthread_mutex_unlock(&share_locks[data]);
+}
+
+static CURL *new_handle(void);
+
 /*
  * Get or create the thread-local CURL handle.
- * The handle is reused across all requests within the same thread,
- * enabling HTTP keep-alive and TLS session reuse.
+ * The handle is reused across all requests within the same thread;
+ * only the URL and response buffer change between requests.
  */
 static CURL *get_curl_handle(void)
 {
     if (!tls_curl) {
-        tls_curl = curl_easy_init();
+        tls_curl = new_handle();
     }
     return tls_curl;
 }
@@ -150,38 +255,175 @@ void http_thread_cleanup(void)
         curl_easy_cleanup(tls_curl);
         tls_curl = NULL;
     }
+    if (tls_hedge) {
+        curl_easy_cleanup(tls_hedge);
+        tls_hedge = NULL;
+    }
+    if (tls_multi) {
+        curl_multi_cleanup(tls_multi);
+        tls_multi = NULL;
+    }
+    free(tls_recv.data);
+    free(tls_hedge_recv.data);
+    memset(&tls_recv, 0, sizeof(tls_recv));
+    memset(&tls_hedge_recv, 0, sizeof(tls_hedge_recv));
 }
 
 /* ── Internal helpers ─────────────────────────────────────────────────── */
 
 /*
- * libcurl write callback. Appends received data to the response buffer.
+ * Make room for `need` bytes in `r`.  The first chunk of a body also
+ * reserves its Content-Length (the compressed size when the body is
+ * encoded, so only a lower bound); a new buffer gets exactly that, and
+ * RECV_MIN_SIZE only when no length is announced.  Beyond that
+ * capacity doubles.  Returns 0 on success, -1 on allocation failure.
+ */
+static int recv_reserve(Receiver *r, size_t need)
+{
+    int announced = 0;
+    if (r->len == 0) {
+        curl_off_t length = -1;
+        curl_easy_getinfo(r->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,
+                          &length);
+        if (length > 0 && (size_t)length + 1 >= need) {
+            need = (size_t)length + 1;
+            announced = 1;
+        }
+    }
+    if (need <= r->cap) {
+        return 0;
+    }
+
+    size_t cap = r->cap ? r->cap * 2 : announced ? need : RECV_MIN_SIZE;
+    if (cap < need) cap = need;
+    char *data = realloc(r->data, cap);
+    if (!data) {
+        return -1;
+    }
+    r->data = data;
+    r->cap  = cap;
+    return 0;
+}
+
+/*
+ * libcurl write callback. Appends received data to the receive buffer.
  */
 static size_t write_callback(char *data, size_t size, size_t nmemb,
                               void *userdata)
 {
     size_t real_size = size * nmemb;
-    HttpResponse *resp = (HttpResponse *)userdata;
+    Receiver *r = (Receiver *)userdata;
 
-    char *new_body = realloc(resp->body, resp->size + real_size + 1);
-    if (!new_body) {
+    if (recv_reserve(r, r->len + real_size + 1) != 0) {
         return 0; /* Signal error to libcurl */
     }
 
-    resp->body = new_body;
-    memcpy(resp->body + resp->size, data, real_size);
-    resp->size += real_size;
-    resp->body[resp->size] = '\0';
+    memcpy(r->data + r->len, data, real_size);
+    r->len += real_size;
+    r->data[r->len] = '\0';
 
     return real_size;
 }
 
+/*
+ * Point the transfer on `curl` at `r`, which starts out empty.  Ends
+ * the loan of the previous body; a buffer that grew unusually large
+ * for it is dropped rather than kept.
+ */
+static void recv_start(Receiver *r, CURL *curl)
+{
+    if (r->cap > RECV_KEEP_MAX) {
+        free(r->data);
+        r->data = NULL;
+        r->cap  = 0;
+    }
+    r->curl = curl;
+    r->len  = 0;
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, r);
+}
+
+/*
+ * Lend the body received into `r` to `resp` until the receiver's next
+ * transfer, which reuses the buffer.
+ */
+static void recv_lend(Receiver *r, HttpResponse *resp)
+{
+    if (r->len == 0) {
+        return;
+    }
+    resp->body = r->data;
+    resp->size = r->len;
+    resp->lent = 1;
+}
+
+/*
+ * Give the body received into `r` to `resp` for good.  The receiver
+ * starts its next transfer without a buffer.
+ */
+static void recv_hand_out(Receiver *r, HttpResponse *resp)
+{
+    if (r->len == 0) {
+        return;
+    }
+    resp->body = r->data;
+    resp->size = r->len;
+    memset(r, 0, sizeof(*r));
+}
+
+/*
+ * Create a handle with the options common to every request.  Only the
+ * URL and write target are set per request, so handles are never reset.
+ */
+static CURL *new_handle(void)
+{
+    CURL *curl = curl_easy_init();
+    if (!curl) {
+        return NULL;
+    }
+
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, USER_AGENT);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 15L);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(curl, CURLOPT_MAXCONNECTS, (long)MAX_POOLED_CONNS);
+    if (http_ca_file) {
+        curl_easy_setopt(curl, CURLOPT_CAINFO, http_ca_file);
+    }
+    if (http_ca_path) {
+        curl_easy_setopt(curl, CURLOPT_CAPATH, http_ca_path);
+    }
+    if (http_share) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, http_share);
+    }
+    return curl;
+}
+
 /* ── Public API ───────────────────────────────────────────────────────── */
 
 int http_init(void)
 {
     CURLcode res = curl_global_init(CURL_GLOBAL_DEFAULT);
-    return (res == CURLE_OK) ? 0 : -1;
+    if (res != CURLE_OK) {
+        return -1;
+    }
+
+    http_ca_file = detect_ca_file();
+    http_ca_path = detect_ca_path();
+    http_limiter = ratelimit_new(0.0, DEFAULT_WINDOW);
+
+    /* Without a share each handle just keeps its own caches */
+    http_share = curl_share_init();
+    if (http_share) {
+        for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+            pthread_mutex_init(&share_locks[i], NULL);
+        }
+        curl_share_setopt(http_share, CURLSHOPT_LOCKFUNC, share_lock);
+        curl_share_setopt(http_share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+        curl_share_setopt(http_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(http_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
+    return 0;
 }
 
 /*
@@ -202,97 +444,1032 @@ static int is_retryable(CURLcode code)
     }
 }
 
+/*
+ * Classify a finished request for the limiter: 429 and 503 mean the
+ * server wants us to slow down, other 5xx and transport errors are
+ * plain failures.
+ */
+static RateSignal classify(CURLcode res, long status)
+{
+    if (res != CURLE_OK) return RATE_FAILED;
+    if (status == 429 || status == 503) return RATE_THROTTLED;
+    if (status >= 500) return RATE_FAILED;
+    return RATE_OK;
+}
+
+/*
+ * Limiter signal of a finished transfer on `curl`.
+ */
+static RateSignal classify_done(CURL *curl, CURLcode res)
+{
+    long status = 0;
+    if (res == CURLE_OK) {
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    }
+    return classify(res, status);
+}
+
+/*
+ * Retry-After of the last response on `curl` in seconds, 0 if absent.
+ */
+static long retry_after_of(CURL *curl)
+{
+    curl_off_t secs = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_RETRY_AFTER, &secs) != CURLE_OK) {
+        return 0;
+    }
+    return (long)secs;
+}
+
+void http_set_limits(double rate, int max_concurrency)
+{
+    ratelimit_configure(http_limiter, rate, max_concurrency);
+}
+
+RateStats http_rate_stats(void)
+{
+    return ratelimit_stats(http_limiter);
+}
+
+/*
+ * Allocate a zeroed response, in the calling thread's arena if any.
+ */
+static HttpResponse *response_new(void)
+{
+    HttpResponse *resp = arena_malloc(sizeof(HttpResponse));
+    if (resp) memset(resp, 0, sizeof(*resp));
+    return resp;
+}
+
 char *http_url_encode(const char *str)
 {
+    static const char hex[] = "0123456789ABCDEF";
     if (!str) return NULL;
 
-    CURL *curl = get_curl_handle();
-    if (!curl) return NULL;
+    /* Same output as curl_easy_escape(): all but RFC 3986 unreserved */
+    char *out = arena_malloc(strlen(str) * 3 + 1);
+    if (!out) return NULL;
 
-    char *encoded = curl_easy_escape(curl, str, 0);
-    char *result  = encoded ? strdup(encoded) : NULL;
+    char *o = out;
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        if ((*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z') ||
+            (*p >= '0' && *p <= '9') ||
+            *p == '-' || *p == '.' || *p == '_' || *p == '~') {
+            *o++ = (char)*p;
+        } else {
+            *o++ = '%';
+            *o++ = hex[*p >> 4];
+            *o++ = hex[*p & 0x0F];
+        }
+    }
+    *o = '\0';
+    return out;
+}
 
-    curl_free(encoded);
-    return result;
+/*
+ * Count a scheduled retry and its delay for http_retry_stats().
+ */
+static void note_retry(long delay_ms)
+{
+    pthread_mutex_lock(&retry_stats_lock);
+    retry_stats.retries++;
+    retry_stats.wait_ms += delay_ms;
+    pthread_mutex_unlock(&retry_stats_lock);
 }
 
-HttpResponse *http_get(const char *url)
+/* ── Hedging ──────────────────────────────────────────────────────────── */
+
+static int compare_long(const void *a, const void *b)
+{
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Record the latency of a successful transfer on `easy`.  The p95 is
+ * recomputed every 16 samples rather than on each one.
+ */
+static void note_latency(CURL *easy)
 {
+    if (hedging.budget <= 0.0) return;
+
+    curl_off_t us = 0;
+    if (curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME_T, &us) != CURLE_OK) {
+        return;
+    }
+
+    pthread_mutex_lock(&hedging.lock);
+    hedging.samples[hedging.next] = (long)(us / 1000);
+    hedging.next = (hedging.next + 1) % LATENCY_SAMPLES;
+    if (hedging.count < LATENCY_SAMPLES) hedging.count++;
+
+    if (hedging.count >= HEDGE_MIN_SAMPLES && hedging.next % 16 == 0) {
+        long sorted[LATENCY_SAMPLES];
+        memcpy(sorted, hedging.samples, (size_t)hedging.count * sizeof(long));
+        qsort(sorted, (size_t)hedging.count, sizeof(long), compare_long);
+        hedging.p95_ms = sorted[hedging.count * 95 / 100];
+    }
+    pthread_mutex_unlock(&hedging.lock);
+}
+
+/*
+ * Count a request sent, for the budget.
+ */
+static void note_request(void)
+{
+    if (hedging.budget <= 0.0) return;
+
+    pthread_mutex_lock(&hedging.lock);
+    hedging.requests++;
+    pthread_mutex_unlock(&hedging.lock);
+}
+
+/*
+ * Milliseconds a request may run before it is hedged, or -1 if
+ * hedging is off.
+ */
+static long hedge_delay_ms(void)
+{
+    if (hedging.budget <= 0.0) return -1;
+
+    pthread_mutex_lock(&hedging.lock);
+    long delay = hedging.p95_ms > 0 ? hedging.p95_ms : HEDGE_INITIAL_MS;
+    pthread_mutex_unlock(&hedging.lock);
+    return delay < HEDGE_MIN_MS ? HEDGE_MIN_MS : delay;
+}
+
+/*
+ * Take a hedge from the budget and a slot from the limiter.  The budget
+ * allows one hedge on top of its share, so short runs can hedge too.
+ * Returns 1 if the duplicate may be sent.
+ */
+static int hedge_take(void)
+{
+    pthread_mutex_lock(&hedging.lock);
+    int allowed = hedging.hedges <
+                  (long)(hedging.budget * (double)hedging.requests) + 1;
+    if (allowed) hedging.hedges++;
+    pthread_mutex_unlock(&hedging.lock);
+
+    if (allowed && ratelimit_try_acquire(http_limiter) != 0) {
+        pthread_mutex_lock(&hedging.lock);
+        hedging.hedges--;
+        pthread_mutex_unlock(&hedging.lock);
+        allowed = 0;
+    }
+    return allowed;
+}
+
+static void note_hedge_win(void)
+{
+    pthread_mutex_lock(&hedging.lock);
+    hedging.wins++;
+    pthread_mutex_unlock(&hedging.lock);
+}
+
+void http_set_hedging(double budget)
+{
+    hedging.budget = budget > 0.0 ? budget : 0.0;
+}
+
+HttpHedgeStats http_hedge_stats(void)
+{
+    pthread_mutex_lock(&hedging.lock);
+    HttpHedgeStats stats = {
+        .hedges = hedging.hedges,
+        .wins   = hedging.wins,
+        .p95_ms = hedging.p95_ms
+    };
+    pthread_mutex_unlock(&hedging.lock);
+    return stats;
+}
+
+/*
+ * Run the request on `curl` (status in *resp), sending one duplicate
+ * on tls_hedge if it has not answered after `delay` ms.  The first copy
+ * to complete without a transport error, 429 or 5xx wins.  If both
+ * fail, the original does, unless only the duplicate got an HTTP
+ * answer.  The winner's response is left in *resp, its handle in
+ * *winner, and the other copy is cancelled.  The caller collects the
+ * winner's body and releases its limiter slot; the loser's is
+ * released here.
+ */
+static CURLcode perform_hedged(CURL *curl, const char *url,
+                               HttpResponse **resp, long delay,
+                               CURL **winner)
+{
+    *winner = curl;
+    if (!tls_multi) tls_multi = curl_multi_init();
+    if (!tls_multi) return curl_easy_perform(curl);
+    curl_multi_add_handle(tls_multi, curl);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    CURL *hedge = NULL;
+    HttpResponse *hedge_resp = NULL;
+    CURLcode res = CURLE_OK, hedge_res = CURLE_OK;
+    int done = 0, hedge_done = 0;
+
+    for (;;) {
+        int running = 0;
+        curl_multi_perform(tls_multi, &running);
+
+        CURLMsg *msg;
+        int left = 0;
+        while ((msg = curl_multi_info_read(tls_multi, &left)) != NULL) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            if (msg->easy_handle == curl) {
+                done = 1;
+                res = msg->data.result;
+            } else {
+                hedge_done = 1;
+                hedge_res = msg->data.result;
+            }
+        }
+
+        /* A 429 or 5xx is no answer while the other copy still runs */
+        if (done && classify_done(curl, res) == RATE_OK) break;
+        if (hedge_done && classify_done(hedge, hedge_res) == RATE_OK) {
+            *winner = hedge;
+            break;
+        }
+        if (done && (!hedge || hedge_done)) {
+            /* Both failed: an HTTP error beats a transport failure */
+            if (hedge && res != CURLE_OK && hedge_res == CURLE_OK) {
+                *winner = hedge;
+            }
+            break;
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long elapsed = (long)(now.tv_sec - start.tv_sec) * 1000 +
+                       (now.tv_nsec - start.tv_nsec) / 1000000;
+        int timeout = 1000;
+
+        if (!hedge && !done) {
+            if (elapsed < delay) {
+                timeout = (int)(delay - elapsed);
+            } else if (hedge_take()) {
+                if (!tls_hedge) tls_hedge = new_handle();
+                hedge_resp = response_new();
+                if (!tls_hedge || !hedge_resp) {
+                    arena_release(hedge_resp);
+                    hedge_resp = NULL;
+                    ratelimit_release(http_limiter, RATE_FAILED, 0);
+                } else {
+                    hedge = tls_hedge;
+                    curl_easy_setopt(hedge, CURLOPT_URL, url);
+                    recv_start(&tls_hedge_recv, hedge);
+                    curl_multi_add_handle(tls_multi, hedge);
+                    continue;
+                }
+            }
+        }
+        curl_multi_poll(tls_multi, NULL, 0, timeout, NULL);
+    }
+
+    curl_multi_remove_handle(tls_multi, curl);
+    if (!hedge) {
+        return res;
+    }
+    curl_multi_remove_handle(tls_multi, hedge);
+
+    /* The loser's slot carries no signal unless it actually finished */
+    CURL *loser = *winner == hedge ? curl : hedge;
+    HttpResponse *loser_resp = *winner == hedge ? *resp : hedge_resp;
+    int loser_done = *winner == hedge ? done : hedge_done;
+    CURLcode loser_res = *winner == hedge ? res : hedge_res;
+    if (loser_done && loser_res == CURLE_OK) {
+        curl_easy_getinfo(loser, CURLINFO_RESPONSE_CODE,
+                          &loser_resp->status_code);
+    }
+    ratelimit_release(http_limiter,
+                      loser_done ? classify(loser_res, loser_resp->status_code)
+                                 : RATE_FAILED, 0);
+    http_response_free(loser_resp);
+
+    if (*winner == hedge) {
+        note_hedge_win();
+        *resp = hedge_resp;
+        return hedge_res;
+    }
+    return res;
+}
+
+HttpResponse *http_get_attempt(const char *url, HttpRetry *retry)
+{
+    retry->retry_ms = 0;
     if (!url) {
         return NULL;
     }
 
-    static const int MAX_RETRIES    = 3;
-    static const int BASE_DELAY_SEC = 1; /* 1s, 2s, 4s */
-
     CURL *curl = get_curl_handle();
     if (!curl) {
         return NULL;
     }
-    const char *ca_file = detect_ca_file();
-    const char *ca_path = detect_ca_path();
 
-    for (int attempt = 0; attempt <= MAX_RETRIES; attempt++) {
+    /*
+     * A paused or empty bucket, or a full window, is a wait, not a
+     * failed attempt; a full window retries when a slot should be free
+     */
+    long wait = ratelimit_try_acquire(http_limiter);
+    if (wait != 0) {
+        retry->retry_ms = wait > 0 ? wait
+                                   : ratelimit_slot_wait_ms(http_limiter);
+        return NULL;
+    }
+
+    HttpResponse *resp = response_new();
+    if (!resp) {
+        ratelimit_release(http_limiter, RATE_FAILED, 0);
+        return NULL;
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    recv_start(&tls_recv, curl);
+    note_request();
+
+    long delay = hedge_delay_ms();
+    CURLcode res = delay < 0 ? curl_easy_perform(curl)
+                             : perform_hedged(curl, url, &resp, delay, &curl);
+    if (res == CURLE_OK) {
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &resp->status_code);
+    }
+    Receiver *rx = curl == tls_hedge ? &tls_hedge_recv : &tls_recv;
+
+    RateSignal signal = classify(res, resp->status_code);
+    ratelimit_release(http_limiter, signal,
+                      signal == RATE_THROTTLED ? retry_after_of(curl) : 0);
+
+    if (signal == RATE_OK) {
+        note_latency(curl);
+        recv_lend(rx, resp);
+        return resp;
+    }
+
+    /* Throttled: retry once the limiter's Retry-After pause is over */
+    if (signal == RATE_THROTTLED && retry->throttles < MAX_THROTTLES) {
+        retry->throttles++;
+        retry->retry_ms = ratelimit_pause_ms(http_limiter);
+        if (retry->retry_ms <= 0) retry->retry_ms = 1;
+        fprintf(stderr, "warning: LRCLIB throttled (HTTP %ld), "
+                "retrying in %ldms (%d/%d)...\n", resp->status_code,
+                retry->retry_ms, retry->throttles, MAX_THROTTLES);
+        note_retry(retry->retry_ms);
+        http_response_free(resp);
+        return NULL;
+    }
+
+    int retryable = (res == CURLE_OK) ? signal == RATE_FAILED
+                                      : is_retryable(res);
+    if (retry->attempts < MAX_RETRIES && retryable) {
+        int delay = BASE_DELAY_SEC << retry->attempts; /* 1, 2, 4 seconds */
+        retry->attempts++;
+        retry->retry_ms = delay * 1000L;
+        fprintf(stderr, "warning: %s, retrying in %ds (%d/%d)...\n",
+                res == CURLE_OK ? "server error" : curl_easy_strerror(res),
+                delay, retry->attempts, MAX_RETRIES);
+        note_retry(retry->retry_ms);
+        http_response_free(resp);
+        return NULL;
+    }
+
+    /* Out of retries: an HTTP error is still handed to the caller */
+    if (res == CURLE_OK) {
+        recv_lend(rx, resp);
+        return resp;
+    }
+
+    http_response_free(resp);
+    fprintf(stderr, "error: HTTP request failed: %s\n",
+            curl_easy_strerror(res));
+    print_ca_hint(res, http_ca_file, http_ca_path);
+    return NULL;
+}
+
+HttpResponse *http_get(const char *url)
+{
+    HttpRetry retry = {0};
+    for (;;) {
+        HttpResponse *resp = http_get_attempt(url, &retry);
+        if (retry.retry_ms <= 0) {
+            return resp;
+        }
+        struct timespec ts = {
+            .tv_sec  = retry.retry_ms / 1000,
+            .tv_nsec = (retry.retry_ms % 1000) * 1000000L
+        };
+        nanosleep(&ts, NULL);
+    }
+}
+
+HttpRetryStats http_retry_stats(void)
+{
+    pthread_mutex_lock(&retry_stats_lock);
+    HttpRetryStats stats = retry_stats;
+    pthread_mutex_unlock(&retry_stats_lock);
+    return stats;
+}
+
+/* ── Async engine (curl multi) ────────────────────────────────────────── */
+
+/*
+ * One asynchronous request.  Requests wait in `queue` until a slot is
+ * free, then run on the multi handle; transient failures move to
+ * `delayed` until their backoff expires.
+ */
+typedef struct AsyncRequest {
+    char                *url;
+    HttpDoneFn           done;
+    void                *user;
+    HttpResponse        *resp;
+    CURL                *easy;
+    Receiver            *rx;         /* body of `easy`'s transfer */
+    CURL                *hedge;      /* duplicate transfer, if running */
+    HttpResponse        *hedge_resp;
+    Receiver            *hedge_rx;
+    Receiver             bufs[2];    /* what `rx` and `hedge_rx` point at */
+    int                  hedged;     /* this attempt was hedged */
+    int                  slot;       /* index in async_http.active */
+    int                  attempt;
+    int                  throttles;
+    struct timespec      started;    /* when this attempt was sent */
+    struct timespec      due;        /* earliest retry time */
+    struct AsyncRequest *next;
+} AsyncRequest;
+
+static struct {
+    CURLM           *multi;
+    pthread_t        thread;
+    int              running;
+    int              stopping;
+    int              max_inflight;
+    int              inflight;       /* loop thread only */
+    CURL           **idle;           /* reusable easy handles */
+    int              num_idle;
+    AsyncRequest   **active;         /* requests on the multi handle */
+    int              num_active;
+
+    pthread_mutex_t  mutex;
+    AsyncRequest    *queue_head;
+    AsyncRequest    *queue_tail;
+    AsyncRequest    *delayed;        /* sorted by due time */
+} async_http = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+static long ms_until(const struct timespec *t)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long ms = (long)(t->tv_sec - now.tv_sec) * 1000 +
+              (t->tv_nsec - now.tv_nsec) / 1000000;
+    return ms > 0 ? ms : 0;
+}
+
+static void async_request_free(AsyncRequest *req)
+{
+    http_response_free(req->resp);
+    http_response_free(req->hedge_resp);
+    free(req->bufs[0].data);
+    free(req->bufs[1].data);
+    free(req->url);
+    free(req);
+}
+
+/* Caller holds the async mutex. */
+static void async_enqueue(AsyncRequest *req)
+{
+    req->next = NULL;
+    if (async_http.queue_tail) async_http.queue_tail->next = req;
+    else async_http.queue_head = req;
+    async_http.queue_tail = req;
+}
+
+/*
+ * Send a duplicate of each request that has run past the hedge delay,
+ * while slots and budget allow.  Queued requests come first, so only
+ * spare slots are used.  Returns ms until the next request is due for
+ * a hedge, or -1 if none is.  Caller holds the async mutex.
+ */
+static long async_hedge(void)
+{
+    long delay = hedge_delay_ms();
+    if (delay < 0) return -1;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long next = -1;
+    for (int i = 0; i < async_http.num_active; i++) {
+        AsyncRequest *req = async_http.active[i];
+        if (req->hedged) continue;
+
+        long elapsed = (long)(now.tv_sec - req->started.tv_sec) * 1000 +
+                       (now.tv_nsec - req->started.tv_nsec) / 1000000;
+        if (elapsed < delay) {
+            if (next < 0 || delay - elapsed < next) next = delay - elapsed;
+            continue;
+        }
+        if (async_http.inflight >= async_http.max_inflight ||
+            async_http.queue_head || !hedge_take()) {
+            break;
+        }
+
+        CURL *easy = async_http.num_idle > 0
+            ? async_http.idle[--async_http.num_idle]
+            : new_handle();
         HttpResponse *resp = calloc(1, sizeof(HttpResponse));
-        if (!resp) {
-            return NULL;
+        if (!easy || !resp) {
+            if (easy) async_http.idle[async_http.num_idle++] = easy;
+            free(resp);
+            ratelimit_release(http_limiter, RATE_FAILED, 0);
+            break;
+        }
+
+        curl_easy_setopt(easy, CURLOPT_URL, req->url);
+        recv_start(req->hedge_rx, easy);
+        curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+        curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+        curl_easy_setopt(easy, CURLOPT_PRIVATE, req);
+
+        req->hedge      = easy;
+        req->hedge_resp = resp;
+        req->hedged     = 1;
+        curl_multi_add_handle(async_http.multi, easy);
+        async_http.inflight++;
+    }
+    return next;
+}
+
+/*
+ * Remove `easy` from the multi handle and return it to the idle list.
+ */
+static void async_recycle(CURL *easy)
+{
+    curl_multi_remove_handle(async_http.multi, easy);
+    async_http.inflight--;
+
+    pthread_mutex_lock(&async_http.mutex);
+    async_http.idle[async_http.num_idle++] = easy;
+    pthread_mutex_unlock(&async_http.mutex);
+}
+
+/*
+ * Make the hedge's body the request's own, after the hedge took over.
+ * Only the pointers move: a transfer still running keeps writing into
+ * the receiver its CURLOPT_WRITEDATA was set to.
+ */
+static void async_swap_receivers(AsyncRequest *req)
+{
+    Receiver *rx  = req->rx;
+    req->rx       = req->hedge_rx;
+    req->hedge_rx = rx;
+}
+
+/*
+ * One copy of a hedged request finished.  A failure (transport error,
+ * 429 or 5xx) while the other copy still runs is dropped and 0
+ * returned; otherwise the other copy is cancelled, the finished one
+ * becomes the request's only transfer and 1 is returned.
+ */
+static int async_settle_hedge(AsyncRequest *req, CURL *easy, CURLcode res)
+{
+    int is_hedge = easy == req->hedge;
+    CURL *other = is_hedge ? req->easy : req->hedge;
+
+    RateSignal signal = classify_done(easy, res);
+    if (signal != RATE_OK) {
+        long retry_after = signal == RATE_THROTTLED ? retry_after_of(easy) : 0;
+        async_recycle(easy);
+        ratelimit_release(http_limiter, signal, retry_after);
+        if (is_hedge) {
+            http_response_free(req->hedge_resp);
+        } else {
+            http_response_free(req->resp);
+            req->easy = other;
+            req->resp = req->hedge_resp;
+            async_swap_receivers(req);
         }
+        req->hedge      = NULL;
+        req->hedge_resp = NULL;
+        return 0;
+    }
+
+    async_recycle(other);
+    ratelimit_release(http_limiter, RATE_FAILED, 0);
+    if (is_hedge) {
+        http_response_free(req->resp);
+        req->easy = easy;
+        req->resp = req->hedge_resp;
+        async_swap_receivers(req);
+        note_hedge_win();
+    } else {
+        http_response_free(req->hedge_resp);
+    }
+    req->hedge      = NULL;
+    req->hedge_resp = NULL;
+    return 1;
+}
+
+/*
+ * Move due retries back to the queue and start queued requests while
+ * slots are free.  Returns the poll timeout in ms.  Caller holds the
+ * async mutex.
+ */
+static int async_dispatch(void)
+{
+    while (async_http.delayed && ms_until(&async_http.delayed->due) == 0) {
+        AsyncRequest *req = async_http.delayed;
+        async_http.delayed = req->next;
+        async_enqueue(req);
+    }
 
-        /* Configure the request (reset state from previous use) */
-        curl_easy_reset(curl);
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, USER_AGENT);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, resp);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 15L);
-        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
-        if (ca_file) {
-            curl_easy_setopt(curl, CURLOPT_CAINFO, ca_file);
+    long timeout = 1000;
+    while (async_http.queue_head &&
+           async_http.inflight < async_http.max_inflight) {
+        AsyncRequest *req = async_http.queue_head;
+
+        /* Window full (-1) waits for a completion; otherwise a timer */
+        long wait = ratelimit_try_acquire(http_limiter);
+        if (wait != 0) {
+            if (wait > 0 && wait < timeout) timeout = wait;
+            break;
         }
-        if (ca_path) {
-            curl_easy_setopt(curl, CURLOPT_CAPATH, ca_path);
+
+        CURL *easy = async_http.num_idle > 0
+            ? async_http.idle[--async_http.num_idle]
+            : new_handle();
+        HttpResponse *resp = calloc(1, sizeof(HttpResponse));
+        if (!easy || !resp) {
+            if (easy) async_http.idle[async_http.num_idle++] = easy;
+            free(resp);
+            ratelimit_release(http_limiter, RATE_FAILED, 0);
+            break;
         }
 
-        CURLcode res = curl_easy_perform(curl);
+        async_http.queue_head = req->next;
+        if (!async_http.queue_head) async_http.queue_tail = NULL;
 
-        if (res == CURLE_OK) {
-            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE,
-                              &resp->status_code);
-            return resp;
+        curl_easy_setopt(easy, CURLOPT_URL, req->url);
+        recv_start(req->rx, easy);
+        /* Prefer waiting for an HTTP/2 connection over opening another */
+        curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+        curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+        curl_easy_setopt(easy, CURLOPT_PRIVATE, req);
+
+        req->easy   = easy;
+        req->resp   = resp;
+        req->hedged = 0;
+        req->slot   = async_http.num_active;
+        async_http.active[async_http.num_active++] = req;
+        clock_gettime(CLOCK_MONOTONIC, &req->started);
+        note_request();
+        curl_multi_add_handle(async_http.multi, easy);
+        async_http.inflight++;
+    }
+
+    long hedge_wait = async_hedge();
+    if (hedge_wait >= 0 && hedge_wait < timeout) timeout = hedge_wait;
+
+    if (async_http.delayed) {
+        long due = ms_until(&async_http.delayed->due);
+        if (due < timeout) timeout = due;
+    }
+    return (int)timeout;
+}
+
+/*
+ * Handle a finished transfer: deliver it, or schedule a retry.
+ */
+static void async_complete(CURL *easy, CURLcode res)
+{
+    AsyncRequest *req = NULL;
+    curl_easy_getinfo(easy, CURLINFO_PRIVATE, (char **)&req);
+    if (req->hedge && !async_settle_hedge(req, easy, res)) {
+        return;
+    }
+    curl_multi_remove_handle(async_http.multi, easy);
+    async_http.inflight--;
+
+    /* Off the multi handle: no longer a hedge candidate */
+    AsyncRequest *last = async_http.active[--async_http.num_active];
+    async_http.active[req->slot] = last;
+    last->slot = req->slot;
+
+    if (res == CURLE_OK) {
+        curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &req->resp->status_code);
+    }
+
+    RateSignal signal = classify(res, req->resp->status_code);
+    ratelimit_release(http_limiter, signal,
+                      signal == RATE_THROTTLED ? retry_after_of(easy) : 0);
+
+    if (signal == RATE_OK) note_latency(easy);
+
+    pthread_mutex_lock(&async_http.mutex);
+    async_http.idle[async_http.num_idle++] = easy;
+    pthread_mutex_unlock(&async_http.mutex);
+    req->easy = NULL;
+
+    /* Throttled: requeue now; the limiter holds dispatch until Retry-After */
+    if (signal == RATE_THROTTLED && req->throttles < MAX_THROTTLES) {
+        req->throttles++;
+        fprintf(stderr, "warning: LRCLIB throttled (HTTP %ld), "
+                "retrying (%d/%d)...\n",
+                req->resp->status_code, req->throttles, MAX_THROTTLES);
+        note_retry(ratelimit_pause_ms(http_limiter));
+        http_response_free(req->resp);
+        req->resp = NULL;
+
+        pthread_mutex_lock(&async_http.mutex);
+        async_enqueue(req);
+        pthread_mutex_unlock(&async_http.mutex);
+        return;
+    }
+
+    int retryable = (res == CURLE_OK) ? signal == RATE_FAILED
+                                      : is_retryable(res);
+
+    if (signal == RATE_OK || (res == CURLE_OK &&
+                              (!retryable || req->attempt >= MAX_RETRIES))) {
+        HttpResponse *resp = req->resp;
+        req->resp = NULL;
+        recv_hand_out(req->rx, resp);
+        req->done(resp, req->user);
+        async_request_free(req);
+        return;
+    }
+
+    http_response_free(req->resp);
+    req->resp = NULL;
+
+    if (req->attempt < MAX_RETRIES && retryable) {
+        int delay = BASE_DELAY_SEC << req->attempt;
+        fprintf(stderr, "warning: %s, retrying in %ds (%d/%d)...\n",
+                res == CURLE_OK ? "server error" : curl_easy_strerror(res),
+                delay, req->attempt + 1, MAX_RETRIES);
+        req->attempt++;
+        note_retry(delay * 1000L);
+        clock_gettime(CLOCK_MONOTONIC, &req->due);
+        req->due.tv_sec += delay;
+
+        pthread_mutex_lock(&async_http.mutex);
+        AsyncRequest **pos = &async_http.delayed;
+        while (*pos && ((*pos)->due.tv_sec < req->due.tv_sec ||
+                        ((*pos)->due.tv_sec == req->due.tv_sec &&
+                         (*pos)->due.tv_nsec <= req->due.tv_nsec))) {
+            pos = &(*pos)->next;
         }
+        req->next = *pos;
+        *pos = req;
+        pthread_mutex_unlock(&async_http.mutex);
+        return;
+    }
 
-        /* Request failed */
-        http_response_free(resp);
+    fprintf(stderr, "error: HTTP request failed: %s\n", curl_easy_strerror(res));
+    print_ca_hint(res, http_ca_file, http_ca_path);
+    req->done(NULL, req->user);
+    async_request_free(req);
+}
 
-        if (attempt < MAX_RETRIES && is_retryable(res)) {
-            int delay = BASE_DELAY_SEC << attempt; /* 1, 2, 4 seconds */
-            fprintf(stderr, "warning: %s, retrying in %ds (%d/%d)...\n",
-                    curl_easy_strerror(res), delay, attempt + 1, MAX_RETRIES);
-            struct timespec ts = { .tv_sec = delay, .tv_nsec = 0 };
-            nanosleep(&ts, NULL);
-        } else {
-            fprintf(stderr, "error: HTTP request failed: %s\n",
-                    curl_easy_strerror(res));
-            print_ca_hint(res, ca_file, ca_path);
-            return NULL;
+static void *async_loop(void *arg)
+{
+    (void)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&async_http.mutex);
+        int timeout = async_dispatch();
+        int finished = async_http.stopping && async_http.inflight == 0 &&
+                       !async_http.queue_head && !async_http.delayed;
+        pthread_mutex_unlock(&async_http.mutex);
+        if (finished) break;
+
+        int still_running = 0;
+        curl_multi_perform(async_http.multi, &still_running);
+
+        CURLMsg *msg;
+        int left = 0;
+        while ((msg = curl_multi_info_read(async_http.multi, &left)) != NULL) {
+            if (msg->msg == CURLMSG_DONE) {
+                async_complete(msg->easy_handle, msg->data.result);
+            }
         }
+
+        curl_multi_poll(async_http.multi, NULL, 0, timeout, NULL);
     }
 
+    /* Completion callbacks may have URL-encoded on this thread */
+    http_thread_cleanup();
     return NULL;
 }
 
+int http_async_start(int max_inflight)
+{
+    if (async_http.running || max_inflight < 1) {
+        return -1;
+    }
+
+    async_http.multi  = curl_multi_init();
+    async_http.idle   = calloc((size_t)max_inflight, sizeof(CURL *));
+    async_http.active = calloc((size_t)max_inflight, sizeof(AsyncRequest *));
+    if (!async_http.multi || !async_http.idle || !async_http.active) {
+        if (async_http.multi) curl_multi_cleanup(async_http.multi);
+        free(async_http.idle);
+        free(async_http.active);
+        async_http.multi  = NULL;
+        async_http.idle   = NULL;
+        async_http.active = NULL;
+        return -1;
+    }
+
+    /* Many requests over few connections: multiplex when HTTP/2 is up */
+    curl_multi_setopt(async_http.multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(async_http.multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+                      (long)ASYNC_MAX_CONNS);
+
+    async_http.max_inflight = max_inflight;
+    async_http.inflight     = 0;
+    async_http.num_idle     = 0;
+    async_http.num_active   = 0;
+    async_http.stopping     = 0;
+
+    if (pthread_create(&async_http.thread, NULL, async_loop, NULL) != 0) {
+        curl_multi_cleanup(async_http.multi);
+        free(async_http.idle);
+        free(async_http.active);
+        async_http.multi  = NULL;
+        async_http.idle   = NULL;
+        async_http.active = NULL;
+        return -1;
+    }
+    async_http.running = 1;
+    return 0;
+}
+
+int http_async_running(void)
+{
+    return async_http.running;
+}
+
+int http_get_async(const char *url, HttpDoneFn done, void *user)
+{
+    if (!url || !done || !async_http.running) {
+        return -1;
+    }
+
+    AsyncRequest *req = calloc(1, sizeof(AsyncRequest));
+    if (!req) {
+        return -1;
+    }
+    req->url      = strdup(url);
+    req->done     = done;
+    req->user     = user;
+    req->rx       = &req->bufs[0];
+    req->hedge_rx = &req->bufs[1];
+    if (!req->url) {
+        free(req);
+        return -1;
+    }
+
+    pthread_mutex_lock(&async_http.mutex);
+    async_enqueue(req);
+    pthread_mutex_unlock(&async_http.mutex);
+
+    curl_multi_wakeup(async_http.multi);
+    return 0;
+}
+
+void http_async_stop(void)
+{
+    if (!async_http.running) {
+        return;
+    }
+
+    pthread_mutex_lock(&async_http.mutex);
+    async_http.stopping = 1;
+    pthread_mutex_unlock(&async_http.mutex);
+    curl_multi_wakeup(async_http.multi);
+
+    pthread_join(async_http.thread, NULL);
+
+    for (int i = 0; i < async_http.num_idle; i++) {
+        curl_easy_cleanup(async_http.idle[i]);
+    }
+    free(async_http.idle);
+    free(async_http.active);
+    curl_multi_cleanup(async_http.multi);
+    async_http.idle    = NULL;
+    async_http.active  = NULL;
+    async_http.multi   = NULL;
+    async_http.running = 0;
+}
+
+/* ── Warm-up ──────────────────────────────────────────────────────────── */
+
+static size_t discard_callback(char *data, size_t size, size_t nmemb,
+                               void *userdata)
+{
+    (void)data;
+    (void)userdata;
+    return size * nmemb;
+}
+
+int http_warmup(const char *url, int connections)
+{
+    if (!url || connections < 1) {
+        return 0;
+    }
+
+    CURLM *multi = curl_multi_init();
+    CURL **handles = calloc((size_t)connections, sizeof(CURL *));
+    if (!multi || !handles) {
+        if (multi) curl_multi_cleanup(multi);
+        free(handles);
+        return 0;
+    }
+
+    /* One connection per handle: no multiplexing onto the first one */
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_NOTHING);
+
+    for (int i = 0; i < connections; i++) {
+        handles[i] = new_handle();
+        if (!handles[i]) break;
+        curl_easy_setopt(handles[i], CURLOPT_URL, url);
+        curl_easy_setopt(handles[i], CURLOPT_NOBODY, 1L);
+        curl_easy_setopt(handles[i], CURLOPT_WRITEFUNCTION, discard_callback);
+        curl_easy_setopt(handles[i], CURLOPT_FRESH_CONNECT, 1L);
+        curl_multi_add_handle(multi, handles[i]);
+    }
+
+    int still_running = 1;
+    while (still_running) {
+        if (curl_multi_perform(multi, &still_running) != CURLM_OK) break;
+        if (still_running) curl_multi_poll(multi, NULL, 0, 1000, NULL);
+    }
+
+    int opened = 0;
+    CURLMsg *msg;
+    int left = 0;
+    while ((msg = curl_multi_info_read(multi, &left)) != NULL) {
+        if (msg->msg == CURLMSG_DONE && msg->data.result == CURLE_OK) {
+            opened++;
+        }
+    }
+
+    /* The DNS answer and TLS sessions stay in the share after the
+       handles and their connections are gone */
+    for (int i = 0; i < connections && handles[i]; i++) {
+        curl_multi_remove_handle(multi, handles[i]);
+        curl_easy_cleanup(handles[i]);
+    }
+    free(handles);
+    curl_multi_cleanup(multi);
+    return opened;
+}
+
+char *http_response_take_body(HttpResponse *resp)
+{
+    if (!resp || !resp->body) {
+        return NULL;
+    }
+
+    char *body = resp->body;
+    if (resp->lent) {
+        body = arena_malloc(resp->size + 1);
+        if (body) {
+            memcpy(body, resp->body, resp->size + 1);
+        }
+    }
+    resp->body = NULL;
+    resp->lent = 0;
+    return body;
+}
+
 void http_response_free(HttpResponse *resp)
 {
     if (!resp) {
         return;
     }
-    free(resp->body);
-    free(resp);
+    if (!resp->lent) {
+        arena_release(resp->body);
+    }
+    arena_release(resp);
 }
 
 void http_cleanup(void)
 {
+    http_async_stop();
     http_thread_cleanup();
+
+    if (http_share) {
+        curl_share_cleanup(http_share);
+        http_share = NULL;
+        for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+            pthread_mutex_destroy(&share_locks[i]);
+        }
+    }
+    ratelimit_free(http_limiter);
+    http_limiter = NULL;
     curl_global_cleanup();
 }
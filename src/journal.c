@@ -0,0 +1,284 @@
+/*
+ * journal.c — Checkpoint journal implementation
+ *
+ * The journal is a text file: a magic line, then one line per finished
+ * track, "<outcome> <path>\n".  Lines are only ever appended, a batch
+ * per write(), so a crash can at worst leave a torn last line; it is
+ * dropped on resume and that track is simply synced again.
+ *
+ * On resume the whole file is read into one buffer, the newlines
+ * become terminators, and the paths are indexed in place by an
+ * open-addressing hash set.
+ */
+
+#include "journal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define JOURNAL_MAGIC      "synclyr2metadata journal 1\n"
+#define JOURNAL_BATCH_SIZE (64 * 1024)   /* write out at this many bytes */
+
+/* ── Internal types ───────────────────────────────────────────────────── */
+
+typedef struct {
+    uint64_t    hash;             /* 0 = empty slot */
+    const char *path;             /* points into `data` */
+} JournalEntry;
+
+struct Journal {
+    char         *path;
+    int           fd;
+    int           failed;         /* a write failed; reported once */
+
+    char         *data;           /* file contents loaded on resume */
+    JournalEntry *slots;
+    size_t        cap;            /* power of two */
+    long          count;
+
+    char         *buf;            /* pending batch */
+    size_t        len, buf_cap;
+};
+
+/* ── Internal helpers ──────────────────────────────────────────────────── */
+
+static uint64_t hash_path(const char *s)
+{
+    uint64_t h = 1469598103934665603ULL;   /* FNV-1a */
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;
+}
+
+static JournalEntry *find_slot(JournalEntry *slots, size_t cap, uint64_t hash,
+                               const char *path)
+{
+    size_t i = (size_t)hash & (cap - 1);
+    for (;;) {
+        JournalEntry *e = &slots[i];
+        if (e->hash == 0) return e;
+        if (e->hash == hash && strcmp(e->path, path) == 0) return e;
+        i = (i + 1) & (cap - 1);
+    }
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p   += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int read_all(int fd, char *buf, size_t len)
+{
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = pread(fd, buf + got, len - got, (off_t)got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        got += (size_t)n;
+    }
+    return 0;
+}
+
+/*
+ * Index the lines of the loaded file.  Returns the length of the
+ * complete lines, which is shorter than `size` after a torn write.
+ */
+static size_t load_entries(Journal *j, size_t size)
+{
+    size_t lines = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (j->data[i] == '\n') lines++;
+    }
+
+    j->cap = 64;
+    while (j->cap < lines * 2) j->cap *= 2;
+    j->slots = calloc(j->cap, sizeof(JournalEntry));
+    if (!j->slots) return 0;
+
+    size_t off = strlen(JOURNAL_MAGIC);
+    for (;;) {
+        char *line = j->data + off;
+        char *nl = memchr(line, '\n', size - off);
+        if (!nl) break;
+        *nl = '\0';
+        off = (size_t)(nl + 1 - j->data);
+
+        /* "<outcome> <path>"; the outcome is informational here */
+        if (line[0] < '0' || line[0] > '9' || line[1] != ' ' || !line[2]) {
+            continue;
+        }
+        const char *path = line + 2;
+        uint64_t hash = hash_path(path);
+        JournalEntry *e = find_slot(j->slots, j->cap, hash, path);
+        if (e->hash == 0) {
+            e->hash = hash;
+            e->path = path;
+            j->count++;
+        }
+    }
+    return off;
+}
+
+/*
+ * Check the header and, with `resume`, load the entries.  An empty
+ * file, or one holding only the start of the magic line (a run killed
+ * while creating it), is a fresh journal.  Returns 0, or -1 if the
+ * file is not a journal (or cannot be read).
+ */
+static int load_journal(Journal *j, int resume)
+{
+    struct stat st;
+    if (fstat(j->fd, &st) != 0) return -1;
+
+    size_t size  = (size_t)st.st_size;
+    size_t magic = strlen(JOURNAL_MAGIC);
+    if (size == 0) return 0;
+
+    char header[sizeof(JOURNAL_MAGIC)];
+    size_t head = size < magic ? size : magic;
+    if (read_all(j->fd, header, head) != 0) return -1;
+    if (memcmp(header, JOURNAL_MAGIC, head) != 0) {
+        fprintf(stderr, "error: '%s' is not a journal\n", j->path);
+        return -1;
+    }
+
+    if (!resume || size < magic) {
+        return ftruncate(j->fd, 0);
+    }
+
+    j->data = malloc(size + 1);
+    if (!j->data || read_all(j->fd, j->data, size) != 0) return -1;
+    j->data[size] = '\0';
+
+    size_t valid = load_entries(j, size);
+    if (!j->slots) return -1;
+    if (valid < size && ftruncate(j->fd, (off_t)valid) != 0) return -1;
+    return 0;
+}
+
+/* ── Public API ────────────────────────────────────────────────────────── */
+
+Journal *journal_open(const char *path, int resume)
+{
+    if (!path) return NULL;
+
+    Journal *j = calloc(1, sizeof(Journal));
+    if (!j) return NULL;
+
+    j->path = strdup(path);
+    j->fd   = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (!j->path || j->fd < 0) {
+        fprintf(stderr, "error: could not open journal '%s': %s\n",
+                path, strerror(errno));
+        free(j->path);
+        free(j);
+        return NULL;
+    }
+
+    if (load_journal(j, resume) != 0) {
+        close(j->fd);
+        j->fd = -1;
+        journal_close(j, 0);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(j->fd, &st) != 0 ||
+        (st.st_size == 0 &&
+         write_all(j->fd, JOURNAL_MAGIC, strlen(JOURNAL_MAGIC)) != 0)) {
+        fprintf(stderr, "error: could not write journal '%s'\n", path);
+        journal_close(j, 0);
+        return NULL;
+    }
+
+    return j;
+}
+
+int journal_is_done(const Journal *j, const char *filepath)
+{
+    if (!j || !j->slots || !filepath) return 0;
+
+    uint64_t hash = hash_path(filepath);
+    return find_slot(j->slots, j->cap, hash, filepath)->hash != 0;
+}
+
+long journal_count(const Journal *j)
+{
+    return j ? j->count : 0;
+}
+
+void journal_add(Journal *j, const char *filepath, StateOutcome outcome)
+{
+    if (!j || !filepath || strchr(filepath, '\n')) return;
+
+    size_t need = strlen(filepath) + 3;
+    if (j->len + need > j->buf_cap) {
+        size_t cap = j->buf_cap ? j->buf_cap : JOURNAL_BATCH_SIZE;
+        while (cap < j->len + need) cap *= 2;
+        char *buf = realloc(j->buf, cap);
+        if (!buf) return;   /* the track is just redone on resume */
+        j->buf     = buf;
+        j->buf_cap = cap;
+    }
+
+    j->buf[j->len++] = (char)('0' + outcome);
+    j->buf[j->len++] = ' ';
+    memcpy(j->buf + j->len, filepath, need - 3);
+    j->len += need - 3;
+    j->buf[j->len++] = '\n';
+
+    if (j->len >= JOURNAL_BATCH_SIZE) journal_flush(j);
+}
+
+int journal_flush(Journal *j)
+{
+    if (!j || j->len == 0) return 0;
+
+    int rc = write_all(j->fd, j->buf, j->len);
+    j->len = 0;
+    if (rc != 0 && !j->failed) {
+        fprintf(stderr, "warning: could not write journal '%s': %s\n",
+                j->path, strerror(errno));
+        j->failed = 1;
+    }
+    return rc;
+}
+
+void journal_close(Journal *j, int finished)
+{
+    if (!j) return;
+
+    if (j->fd >= 0) {
+        journal_flush(j);
+        if (finished) {
+            unlink(j->path);
+        } else {
+            fsync(j->fd);
+        }
+        close(j->fd);
+    }
+
+    free(j->path);
+    free(j->data);
+    free(j->slots);
+    free(j->buf);
+    free(j);
+}
@@ -0,0 +1,309 @@
+/*
+ * json_scan.c — Single-pass JSON field extraction implementation
+ *
+ * A recursive-descent validator that only records positions.  The hot
+ * loop is string scanning: lyrics make up nearly all of a response, so
+ * plain characters are skipped in an unrolled loop with one table
+ * lookup each, and longer runs between escapes are moved with memmove().
+ *
+ * Like cJSON, raw control characters inside strings and anything after
+ * the object are tolerated.
+ */
+
+#include "json_scan.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define MAX_DEPTH 64   /* nesting deeper than this is rejected */
+
+/* ── Scanner ──────────────────────────────────────────────────────────── */
+
+/* Bytes that end a run of plain string characters: '"', '\\', NUL */
+static const unsigned char string_stop[256] = {
+    [0] = 1, ['"'] = 1, ['\\'] = 1
+};
+
+static const char *skip_ws(const char *p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+    return p;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/*
+ * Skip a string whose opening quote is at p[-1].  Returns the position
+ * of the closing quote, or NULL if the string is malformed.
+ */
+static const char *scan_string(const char *p)
+{
+    for (;;) {
+        const unsigned char *u = (const unsigned char *)p;
+        /* Unrolled, but each byte is tested before the next is read,
+           so the scan never looks past the terminating NUL */
+        for (;;) {
+            if (string_stop[u[0]]) break;
+            if (string_stop[u[1]]) { u += 1; break; }
+            if (string_stop[u[2]]) { u += 2; break; }
+            if (string_stop[u[3]]) { u += 3; break; }
+            u += 4;
+        }
+        p = (const char *)u;
+
+        if (*p == '"') return p;
+        if (*p != '\\') return NULL;    /* unterminated */
+
+        switch (p[1]) {
+        case '"': case '\\': case '/': case 'b':
+        case 'f': case 'n':  case 'r': case 't':
+            p += 2;
+            break;
+        case 'u':
+            for (int i = 2; i < 6; i++) {
+                if (hex_value(p[i]) < 0) return NULL;
+            }
+            p += 6;
+            break;
+        default:
+            return NULL;
+        }
+    }
+}
+
+static const char *scan_number(const char *p)
+{
+    if (*p == '-') p++;
+    if (*p == '0') {
+        p++;
+    } else if (*p >= '1' && *p <= '9') {
+        while (*p >= '0' && *p <= '9') p++;
+    } else {
+        return NULL;
+    }
+    if (*p == '.') {
+        p++;
+        if (*p < '0' || *p > '9') return NULL;
+        while (*p >= '0' && *p <= '9') p++;
+    }
+    if (*p == 'e' || *p == 'E') {
+        p++;
+        if (*p == '+' || *p == '-') p++;
+        if (*p < '0' || *p > '9') return NULL;
+        while (*p >= '0' && *p <= '9') p++;
+    }
+    return p;
+}
+
+static const char *scan_value(const char *p, int depth, JsonKind *kind);
+
+/*
+ * Skip an object or array whose opening bracket is at p[-1].  Returns
+ * the position after the closing bracket, or NULL.
+ */
+static const char *scan_container(const char *p, char close, int depth)
+{
+    if (depth >= MAX_DEPTH) return NULL;
+
+    p = skip_ws(p);
+    if (*p == close) return p + 1;
+
+    for (;;) {
+        JsonKind kind;
+        if (close == '}') {
+            if (*p != '"' || !(p = scan_string(p + 1))) return NULL;
+            p = skip_ws(p + 1);
+            if (*p != ':') return NULL;
+            p = skip_ws(p + 1);
+        }
+        if (!(p = scan_value(p, depth + 1, &kind))) return NULL;
+
+        p = skip_ws(p);
+        if (*p == close) return p + 1;
+        if (*p != ',') return NULL;
+        p = skip_ws(p + 1);
+    }
+}
+
+/*
+ * Skip the value at `p` and report its kind.  Returns the position
+ * after it, or NULL if it is malformed.
+ */
+static const char *scan_value(const char *p, int depth, JsonKind *kind)
+{
+    switch (*p) {
+    case '"':
+        *kind = JSON_STRING;
+        p = scan_string(p + 1);
+        return p ? p + 1 : NULL;
+    case '{':
+        *kind = JSON_OTHER;
+        return scan_container(p + 1, '}', depth);
+    case '[':
+        *kind = JSON_OTHER;
+        return scan_container(p + 1, ']', depth);
+    case 't':
+        *kind = JSON_TRUE;
+        return strncmp(p, "true", 4) == 0 ? p + 4 : NULL;
+    case 'f':
+        *kind = JSON_FALSE;
+        return strncmp(p, "false", 5) == 0 ? p + 5 : NULL;
+    case 'n':
+        *kind = JSON_NULL;
+        return strncmp(p, "null", 4) == 0 ? p + 4 : NULL;
+    default:
+        *kind = JSON_NUMBER;
+        return scan_number(p);
+    }
+}
+
+/* ── Public API ────────────────────────────────────────────────────────── */
+
+int json_scan_object(char *json, JsonField *fields, int count)
+{
+    const char *p = skip_ws(json);
+    if (*p != '{') return -1;
+    p = skip_ws(p + 1);
+
+    if (*p != '}') {
+        for (;;) {
+            /* Key: compared raw, member names here need no escapes */
+            if (*p != '"') return -1;
+            const char *key = p + 1;
+            const char *key_end = scan_string(key);
+            if (!key_end) return -1;
+            size_t key_len = (size_t)(key_end - key);
+
+            p = skip_ws(key_end + 1);
+            if (*p != ':') return -1;
+            p = skip_ws(p + 1);
+
+            const char *value = p;
+            JsonKind kind;
+            if (!(p = scan_value(p, 1, &kind))) return -1;
+
+            for (int i = 0; i < count; i++) {
+                JsonField *f = &fields[i];
+                if (f->kind != JSON_ABSENT ||
+                    strncmp(f->key, key, key_len) != 0 ||
+                    f->key[key_len] != '\0') {
+                    continue;
+                }
+                f->kind = kind;
+                if (kind == JSON_STRING) {
+                    f->raw = (char *)value + 1;
+                    f->len = (size_t)(p - value) - 2;
+                } else if (kind == JSON_NUMBER) {
+                    f->raw = (char *)value;
+                    f->len = (size_t)(p - value);
+                }
+                break;
+            }
+
+            p = skip_ws(p);
+            if (*p == '}') break;
+            if (*p != ',') return -1;
+            p = skip_ws(p + 1);
+        }
+    }
+
+    /* Nothing but whitespace may follow the object */
+    return *skip_ws(p + 1) == '\0' ? 0 : -1;
+}
+
+/* ── Decoding ─────────────────────────────────────────────────────────── */
+
+static unsigned read_hex4(const char *p)
+{
+    return (unsigned)(hex_value(p[0]) << 12 | hex_value(p[1]) << 8 |
+                      hex_value(p[2]) << 4 | hex_value(p[3]));
+}
+
+static char *put_utf8(char *out, uint32_t cp)
+{
+    if (cp < 0x80) {
+        *out++ = (char)cp;
+    } else if (cp < 0x800) {
+        *out++ = (char)(0xC0 | (cp >> 6));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *out++ = (char)(0xE0 | (cp >> 12));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    } else {
+        *out++ = (char)(0xF0 | (cp >> 18));
+        *out++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    }
+    return out;
+}
+
+char *json_field_string(JsonField *f)
+{
+    if (f->kind != JSON_STRING) return NULL;
+
+    /* Every escape decodes to fewer bytes than it takes, so the output
+       never overtakes the input */
+    char *in  = f->raw;
+    char *end = f->raw + f->len;
+    char *esc = memchr(in, '\\', f->len);
+    if (!esc) {
+        *end = '\0';
+        return f->raw;
+    }
+
+    char *out = esc;
+    in = esc;
+    while (in < end) {
+        if (*in != '\\') {
+            /* Move the run up to the next escape; short ones bytewise */
+            char *next = memchr(in, '\\', (size_t)(end - in));
+            size_t run = (size_t)((next ? next : end) - in);
+            if (run < 16) {
+                while (run--) *out++ = *in++;
+                continue;
+            }
+            memmove(out, in, run);
+            out += run;
+            in  += run;
+            continue;
+        }
+        char c = in[1];
+        in += 2;
+        switch (c) {
+        case 'b': *out++ = '\b'; break;
+        case 'f': *out++ = '\f'; break;
+        case 'n': *out++ = '\n'; break;
+        case 'r': *out++ = '\r'; break;
+        case 't': *out++ = '\t'; break;
+        case 'u': {
+            uint32_t cp = read_hex4(in);
+            in += 4;
+            if (cp >= 0xD800 && cp <= 0xDBFF && in + 6 <= end &&
+                in[0] == '\\' && in[1] == 'u') {
+                uint32_t lo = read_hex4(in + 2);
+                if (lo >= 0xDC00 && lo <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    in += 6;
+                }
+            }
+            if (cp >= 0xD800 && cp <= 0xDFFF) cp = 0xFFFD;  /* lone half */
+            out = put_utf8(out, cp);
+            break;
+        }
+        default:  /* '"', '\\', '/' */
+            *out++ = c;
+            break;
+        }
+    }
+    *out = '\0';
+    f->len = (size_t)(out - f->raw);
+    return f->raw;
+}
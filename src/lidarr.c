@@ -13,7 +13,9 @@
  */
 
 #include "lidarr.h"
+#include "cache.h"
 #include "http_client.h"
+#include "lrclib.h"
 #include "metadata.h"
 #include "sync.h"
 
@@ -25,10 +27,17 @@
 #include <sys/stat.h>
 #include <time.h>
 
-#define LIDARR_THREADS     4
+#define LIDARR_THREADS     4        /* lookup workers to start with */
 #define MAX_LOG_SIZE       102400   /* 100 KB */
 #define LOG_KEEP_LINES     200
 
+#define LIDARR_CACHE_TTL       (30 * 86400L)
+#define LIDARR_CACHE_MISS_TTL  (7 * 86400L)
+#define LIDARR_CACHE_SIZE      (64LL * 1024 * 1024)
+
+/* One slow lookup holds up the whole import: hedge up to 5% extra */
+#define LIDARR_HEDGE_BUDGET    0.05
+
 /* ── Logging ──────────────────────────────────────────────────────────── */
 
 static FILE *log_fp = NULL;
@@ -210,13 +219,30 @@ static void lidarr_progress(int idx, int total, const char *title,
                              const char *status, void *user)
 {
     (void)user;
-    log_msg("  [%2d/%d] %-40.40s %s", idx + 1, total, title, status);
+    if (total > 0) {
+        log_msg("  [%2d/%d] %-40.40s %s", idx + 1, total, title, status);
+    } else {
+        log_msg("  [%2d/?] %-40.40s %s", idx + 1, title, status);
+    }
+}
+
+/*
+ * Album callback: logs the per-directory summary.  `user` is the
+ * directory path, owned by the engine until now.
+ */
+static void lidarr_album_done(const SyncResult *r, void *user)
+{
+    log_msg("Done: %s: %d synced, %d plain, %d skipped, %d not found "
+            "(%d lookup(s) avoided)", (const char *)user,
+            r->synced, r->plain, r->skipped, r->not_found, r->lookups_saved);
+    free(user);
 }
 
 /*
- * Scan and sync a single directory, logging results.
+ * Scan a single directory and queue it on the shared engine, so worker
+ * threads and their connections are reused across directories.
  */
-static void lidarr_sync_dir(const char *dirpath, const char *plain_log, const char *missing_log)
+static void lidarr_sync_dir(SyncEngine *engine, const char *dirpath)
 {
     TrackMetaList *list = metadata_scan_dir(dirpath);
     if (!list || list->count == 0) {
@@ -227,19 +253,11 @@ static void lidarr_sync_dir(const char *dirpath, const char *plain_log, const ch
 
     log_msg("Syncing %d track(s) in '%s'", list->count, dirpath);
 
-    SyncConfig config = {
-        .force       = 0,
-        .clean_lrc   = 0,  /* Safe default for Lidarr */
-        .num_threads = LIDARR_THREADS,
-        .out_plain   = (char *)plain_log,
-        .out_missing = (char *)missing_log
-    };
-
-    SyncResult r = sync_tracks(list, &config, lidarr_progress, NULL);
-    metadata_list_free(list);
-
-    log_msg("Done: %d synced, %d plain, %d skipped, %d not found",
-            r.synced, r.plain, r.skipped, r.not_found);
+    char *name = strdup(dirpath);
+    if (!name || sync_engine_submit(engine, list, name) != 0) {
+        free(name);
+        metadata_list_free(list);
+    }
 }
 
 /* ── Public API ───────────────────────────────────────────────────────── */
@@ -294,10 +312,48 @@ int lidarr_run(const char *self_path)
 
     /* Sync the album or fall back to the entire artist */
     http_init();
+    /* The pool is auto-tuned, so the limiter must allow its ceiling */
+    int max_threads = sync_thread_ceiling();
+    http_set_limits(0.0, max_threads);
+    http_set_hedging(LIDARR_HEDGE_BUDGET);
+    metadata_scan_init(LIDARR_THREADS);
+
+    /* Lookup cache next to the binary; upgrades re-import known tracks */
+    LookupCache *cache = NULL;
+    char *cache_dir = log_path_suffix(self_path, ".cache");
+    if (cache_dir) {
+        cache = cache_open(cache_dir, LIDARR_CACHE_TTL, LIDARR_CACHE_MISS_TTL,
+                           LIDARR_CACHE_SIZE);
+        lrclib_set_cache(cache);
+        free(cache_dir);
+    }
+
+    SyncConfig config = {
+        .force         = 0,
+        .clean_lrc     = 0,  /* Safe default for Lidarr */
+        .num_threads   = LIDARR_THREADS,
+        .out_plain     = plain_log,
+        .out_missing   = missing_log,
+        .auto_threads  = 1,
+        .max_threads   = max_threads,
+        .write_threads = sync_cpu_count()
+    };
+    SyncEngine *engine = sync_engine_new(&config, lidarr_progress,
+                                         lidarr_album_done);
+    if (!engine) {
+        log_msg("ERROR: could not start sync workers");
+    }
+
+    /* Handshakes happen once, in parallel, before the first lookup */
+    if (engine) {
+        lrclib_warmup(LIDARR_THREADS);
+    }
 
-    if (album_dir && album_dir[0] != '\0') {
+    if (!engine) {
+        /* Nothing to do; error already logged */
+    } else if (album_dir && album_dir[0] != '\0') {
         log_msg("Album: %s", album_dir);
-        lidarr_sync_dir(album_dir, plain_log, missing_log);
+        lidarr_sync_dir(engine, album_dir);
     } else if (artist_path) {
         log_msg("Album dir not found, syncing artist: %s", artist_path);
         /* Iterate artist subdirs */
@@ -313,7 +369,7 @@ int lidarr_run(const char *self_path)
 
                 struct stat st;
                 if (stat(sub, &st) == 0 && S_ISDIR(st.st_mode)) {
-                    lidarr_sync_dir(sub, plain_log, missing_log);
+                    lidarr_sync_dir(engine, sub);
                 }
                 free(sub);
             }
@@ -323,9 +379,19 @@ int lidarr_run(const char *self_path)
         log_msg("ERROR: could not determine album directory");
     }
 
+    if (engine) {
+        SyncResult r = sync_engine_finish(engine);
+        log_msg("Total: %d synced, %d plain, %d skipped, %d not found",
+                r.synced, r.plain, r.skipped, r.not_found);
+    }
+
+    lrclib_set_cache(NULL);
+    cache_close(cache);
+
     free(album_dir);
     free(plain_log);
     free(missing_log);
+    metadata_scan_cleanup();
     http_cleanup();
 
     if (log_fp) fclose(log_fp);
@@ -2,19 +2,50 @@
  * lrclib.c — LRCLIB API client implementation
  *
  * Builds API URLs, performs HTTP requests, and parses JSON responses
- * into LrclibTrack structs.
+ * into LrclibTrack structs.  Names are sent NFC-composed with whitespace
+ * collapsed.  With a cache set, found tracks are cached as the raw
+ * response body and 404s as negative entries, under a canonical key
+ * built from the normalized names, so spellings LRCLIB matches alike
+ * share one entry.
+ *
+ * A lookup without album and duration is the relaxed fallback: it
+ * sends artist and title with credits and edition suffixes stripped
+ * ("feat. X", "(Remastered 2011)").
+ *
+ * With an offline index set, lookups are answered from it alone and
+ * never touch the network.
+ *
+ * Identical lookups running at the same time are collapsed: the first
+ * caller for a key (the "leader") sends the request, later callers
+ * wait for it and receive their own copy of its result.
+ *
+ * Blocking lookups build their URL, receive the response and return
+ * the track in the calling thread's arena, if it has one.  Whatever
+ * can reach another thread (async results, single-flight copies,
+ * album search results) stays on the heap.
  */
 
 #include "lrclib.h"
+#include "arena.h"
 #include "http_client.h"
+#include "json_scan.h"
+#include "normalize.h"
+#include "offline.h"
 #include "cJSON.h"
 
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define LRCLIB_BASE_URL "https://lrclib.net/api"
 #define URL_BUFFER_SIZE 1024
+#define FLIGHT_BUCKETS  256
+#define MATCH_DURATION_TOL 2.0   /* seconds, as the /get endpoint */
+
+static LookupCache  *lrclib_cache;
+static OfflineIndex *lrclib_offline;
 
 /* ── Internal helpers ──────────────────────────────────────────────────── */
 
@@ -28,8 +59,43 @@ static const char *json_get_string(const cJSON *obj, const char *key)
 }
 
 /*
- * Parse a JSON object into a heap-allocated LrclibTrack.
- * Only extracts the lyrics fields we actually use.
+ * Allocate `size` bytes in `arena`, or on the heap if it is NULL.
+ */
+static void *track_alloc(Arena *arena, size_t size)
+{
+    return arena ? arena_alloc(arena, size) : malloc(size);
+}
+
+/*
+ * Build a track in `arena` (NULL = heap) with copies of the given
+ * lyrics stored right after it, in one block.
+ */
+static LrclibTrack *track_new(Arena *arena, const char *synced,
+                              const char *plain, int instrumental)
+{
+    size_t synced_len = synced ? strlen(synced) + 1 : 0;
+    size_t plain_len  = plain  ? strlen(plain)  + 1 : 0;
+
+    LrclibTrack *track = track_alloc(arena, sizeof(LrclibTrack) +
+                                            synced_len + plain_len);
+    if (!track) {
+        return NULL;
+    }
+
+    char *storage = (char *)(track + 1);
+    memset(track, 0, sizeof(*track));
+    if (synced) {
+        track->synced_lyrics = memcpy(storage, synced, synced_len);
+    }
+    if (plain) {
+        track->plain_lyrics = memcpy(storage + synced_len, plain, plain_len);
+    }
+    track->instrumental = instrumental;
+    return track;
+}
+
+/*
+ * Parse a /search result object into a track.
  */
 static LrclibTrack *parse_track(const cJSON *obj)
 {
@@ -37,76 +103,203 @@ static LrclibTrack *parse_track(const cJSON *obj)
         return NULL;
     }
 
-    const char *synced = json_get_string(obj, "syncedLyrics");
-    const char *plain  = json_get_string(obj, "plainLyrics");
-    cJSON *inst_item   = cJSON_GetObjectItemCaseSensitive(obj, "instrumental");
+    cJSON *inst_item = cJSON_GetObjectItemCaseSensitive(obj, "instrumental");
+    return track_new(NULL, json_get_string(obj, "syncedLyrics"),
+                     json_get_string(obj, "plainLyrics"),
+                     cJSON_IsTrue(inst_item));
+}
+
+/* Members of a /get response that a track needs */
+enum { FIELD_SYNCED, FIELD_PLAIN, FIELD_INSTRUMENTAL, TRACK_FIELDS };
+
+/*
+ * Validate a /get response body and locate the track's members in it.
+ * Returns 0 on success, -1 if it is not a JSON object.
+ */
+static int scan_track(char *body, JsonField *f)
+{
+    f[FIELD_SYNCED]       = (JsonField){ .key = "syncedLyrics" };
+    f[FIELD_PLAIN]        = (JsonField){ .key = "plainLyrics" };
+    f[FIELD_INSTRUMENTAL] = (JsonField){ .key = "instrumental" };
 
-    LrclibTrack *track = calloc(1, sizeof(LrclibTrack));
+    if (json_scan_object(body, f, TRACK_FIELDS) != 0) {
+        fprintf(stderr, "error: failed to parse API response as JSON\n");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Turn a body scanned by scan_track() into a track in `arena` (NULL =
+ * heap) without copying: the lyrics are decoded in place and the track
+ * takes over `body`, which is released on failure.
+ */
+static LrclibTrack *take_track(Arena *arena, char *body, JsonField *f)
+{
+    LrclibTrack *track = track_alloc(arena, sizeof(LrclibTrack));
     if (!track) {
+        arena_release(body);
         return NULL;
     }
 
-    track->synced_lyrics = synced ? strdup(synced) : NULL;
-    track->plain_lyrics  = plain  ? strdup(plain)  : NULL;
-    track->instrumental  = cJSON_IsTrue(inst_item) ? 1 : 0;
-
+    track->storage       = body;
+    track->synced_lyrics = json_field_string(&f[FIELD_SYNCED]);
+    track->plain_lyrics  = json_field_string(&f[FIELD_PLAIN]);
+    track->instrumental  = f[FIELD_INSTRUMENTAL].kind == JSON_TRUE;
     return track;
 }
 
+/*
+ * Parse a /get response body into a track in `arena`, consuming
+ * `body`.  Sets *out on LRCLIB_OK.
+ */
+static LrclibStatus parse_body(char *body, Arena *arena, LrclibTrack **out)
+{
+    JsonField f[TRACK_FIELDS];
+    if (scan_track(body, f) != 0) {
+        arena_release(body);
+        return LRCLIB_ERROR;
+    }
+
+    *out = take_track(arena, body, f);
+    return *out ? LRCLIB_OK : LRCLIB_ERROR;
+}
 
 /*
- * Perform a GET request and parse the response as JSON.
- * Returns a cJSON object on success, NULL on failure.
- * Caller must free the result with cJSON_Delete().
+ * Turn an API response for lookup `key` into a track in `arena`,
+ * consuming `resp`.  Sets *out on LRCLIB_OK.  Throttling and server
+ * errors map to LRCLIB_RETRY so they are never mistaken for a missing
+ * track.  Definitive answers are written to the cache.
  */
-static cJSON *api_request(const char *url)
+static LrclibStatus parse_response(const char *key, HttpResponse *resp,
+                                   Arena *arena, LrclibTrack **out)
 {
-    HttpResponse *resp = http_get(url);
+    *out = NULL;
     if (!resp) {
-        return NULL;
+        return LRCLIB_ERROR;
     }
 
-    if (resp->status_code != 200) {
-        if (resp->status_code == 404) {
+    long code = resp->status_code;
+    if (code != 200) {
+        http_response_free(resp);
+        if (code == 404) {
             /* Not found is a valid "no result", not an error */
-        } else {
-            fprintf(stderr, "error: LRCLIB API returned HTTP %ld\n",
-                    resp->status_code);
+            cache_put(lrclib_cache, key, NULL, 0);
+            return LRCLIB_NOT_FOUND;
         }
-        http_response_free(resp);
-        return NULL;
+        fprintf(stderr, "error: LRCLIB API returned HTTP %ld\n", code);
+        return (code == 429 || code >= 500) ? LRCLIB_RETRY : LRCLIB_ERROR;
     }
 
-    cJSON *json = cJSON_Parse(resp->body);
+    /* The track keeps the body; it is cached before its lyrics are
+       decoded in place */
+    size_t size = resp->size;
+    char *body = http_response_take_body(resp);
     http_response_free(resp);
-
-    if (!json) {
-        fprintf(stderr, "error: failed to parse API response as JSON\n");
+    JsonField f[TRACK_FIELDS];
+    if (!body || scan_track(body, f) != 0) {
+        arena_release(body);
+        return LRCLIB_ERROR;
     }
+    cache_put(lrclib_cache, key, body, size);
 
-    return json;
+    *out = take_track(arena, body, f);
+    return *out ? LRCLIB_OK : LRCLIB_ERROR;
 }
 
-/* ── Public API ────────────────────────────────────────────────────────── */
-
-LrclibTrack *lrclib_get(const char *artist, const char *track,
-                         const char *album, double duration)
+/*
+ * Answer a lookup from the offline index.  Sets *out (in `arena`) on
+ * LRCLIB_OK.
+ */
+static LrclibStatus offline_lookup(const char *artist, const char *track,
+                                   const char *album, double duration,
+                                   Arena *arena, LrclibTrack **out)
 {
+    *out = NULL;
     if (!artist || !track) {
         fprintf(stderr, "error: artist and track are required\n");
-        return NULL;
+        return LRCLIB_ERROR;
+    }
+
+    /* The relaxed fallback matches without suffixes, as online */
+    char *s_artist = NULL, *s_track = NULL;
+    if (!album && duration <= 0.0) {
+        s_artist = normalize_stripped(artist);
+        s_track  = normalize_stripped(track);
+        if (!s_artist || !s_track) {
+            free(s_artist);
+            free(s_track);
+            return LRCLIB_ERROR;
+        }
+        artist = s_artist;
+        track  = s_track;
     }
 
+    OfflineMatch m;
+    int found = offline_find(lrclib_offline, artist, track, album,
+                             duration, &m);
+    free(s_artist);
+    free(s_track);
+    if (!found) {
+        return LRCLIB_NOT_FOUND;
+    }
+
+    *out = track_new(arena, m.synced_lyrics, m.plain_lyrics, m.instrumental);
+    return *out ? LRCLIB_OK : LRCLIB_ERROR;
+}
+
+/*
+ * Answer lookup `key` from the cache.  Returns 1 and sets *status
+ * (and *out, in `arena`) on a hit, 0 if the server must be asked.
+ */
+static int cached_lookup(const char *key, Arena *arena,
+                         LrclibStatus *status, LrclibTrack **out)
+{
+    *out = NULL;
+    if (!lrclib_cache) {
+        return 0;
+    }
+
+    char *body;
+    size_t len;
+    switch (cache_get(lrclib_cache, key, &body, &len)) {
+    case CACHE_HIT:
+        *status = parse_body(body, arena, out);
+        return *status == LRCLIB_OK;
+    case CACHE_NEGATIVE:
+        *status = LRCLIB_NOT_FOUND;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * A /get lookup: the URL to request and its canonical key for the
+ * cache and the single-flight table.
+ */
+typedef struct {
+    char url[URL_BUFFER_SIZE];
+    char key[URL_BUFFER_SIZE];
+} GetRequest;
+
+/*
+ * Build the /get URL for the given metadata into `url`.
+ * Returns 0 on success, -1 on failure.
+ */
+static int build_get_url(char *url, size_t size,
+                         const char *artist, const char *track,
+                         const char *album, double duration)
+{
     char *enc_artist = http_url_encode(artist);
     char *enc_track  = http_url_encode(track);
     if (!enc_artist || !enc_track) {
-        free(enc_artist);
-        free(enc_track);
-        return NULL;
+        arena_release(enc_artist);
+        arena_release(enc_track);
+        return -1;
     }
 
-    char url[URL_BUFFER_SIZE];
-    int len = snprintf(url, sizeof(url),
+    int len = snprintf(url, size,
                        "%s/get?artist_name=%s&track_name=%s",
                        LRCLIB_BASE_URL, enc_artist, enc_track);
 
@@ -114,32 +307,649 @@ LrclibTrack *lrclib_get(const char *artist, const char *track,
     if (album) {
         char *enc_album = http_url_encode(album);
         if (enc_album) {
-            snprintf(url + len, sizeof(url) - (size_t)len,
+            snprintf(url + len, size - (size_t)len,
                      "&album_name=%s", enc_album);
-            free(enc_album);
+            arena_release(enc_album);
         }
     }
 
     if (duration > 0.0) {
         size_t current_len = strlen(url);
-        snprintf(url + current_len, sizeof(url) - current_len,
+        snprintf(url + current_len, size - current_len,
                  "&duration=%.0f", duration);
     }
 
-    free(enc_artist);
-    free(enc_track);
+    arena_release(enc_artist);
+    arena_release(enc_track);
+    return 0;
+}
+
+/*
+ * Append the folded form of `name` and a separator to the key being
+ * built in `key` (length *len).  Returns -1 if it does not fit.
+ */
+static int key_append(char *key, size_t size, size_t *len, const char *name)
+{
+    if (*len + strlen(name) + 2 > size) {
+        return -1;
+    }
+    *len += normalize_buf(name, key + *len);
+    key[(*len)++] = '\x1f';
+    key[*len] = '\0';
+    return 0;
+}
+
+/*
+ * Fill `rq` for the given metadata.  Returns 0 on success, -1 on
+ * failure (including names too long for a key).
+ */
+static int prepare_get(GetRequest *rq, const char *artist, const char *track,
+                       const char *album, double duration)
+{
+    if (!artist || !track) {
+        fprintf(stderr, "error: artist and track are required\n");
+        return -1;
+    }
+
+    char *q_artist = arena_malloc(strlen(artist) + 1);
+    char *q_track  = arena_malloc(strlen(track) + 1);
+    char *q_album  = album ? arena_malloc(strlen(album) + 1) : NULL;
+    int rc = -1;
+    if (!q_artist || !q_track || (album && !q_album)) {
+        goto out;
+    }
+    normalize_query_buf(artist, q_artist);
+    normalize_query_buf(track, q_track);
+    if (album) {
+        normalize_query_buf(album, q_album);
+    }
+
+    if (!album && duration <= 0.0) {
+        normalize_strip(q_artist, strlen(q_artist));
+        normalize_strip(q_track, strlen(q_track));
+    }
+
+    /* The key folds case, as LRCLIB's matching does; the query keeps it */
+    size_t len = 0;
+    rq->key[0] = '\0';
+    if (key_append(rq->key, sizeof(rq->key), &len, "get") != 0 ||
+        key_append(rq->key, sizeof(rq->key), &len, q_artist) != 0 ||
+        key_append(rq->key, sizeof(rq->key), &len, q_track) != 0 ||
+        key_append(rq->key, sizeof(rq->key), &len, q_album ? q_album : "") != 0 ||
+        len + 24 > sizeof(rq->key)) {
+        fprintf(stderr, "error: track metadata too long for a lookup\n");
+        goto out;
+    }
+    snprintf(rq->key + len, sizeof(rq->key) - len, "%.0f",
+             duration > 0.0 ? duration : 0.0);
+
+    rc = build_get_url(rq->url, sizeof(rq->url), q_artist, q_track,
+                       q_album, duration);
+
+out:
+    arena_release(q_artist);
+    arena_release(q_track);
+    arena_release(q_album);
+    return rc;
+}
+
+/* ── Single-flight table ──────────────────────────────────────────────── */
+
+/*
+ * An async caller waiting for another caller's request.
+ */
+typedef struct FlightWaiter {
+    LrclibDoneFn         done;
+    void                *user;
+    struct FlightWaiter *next;
+} FlightWaiter;
+
+/*
+ * One request in flight.  It leaves the table when the leader finishes
+ * and is freed once the last blocking follower has taken its result.
+ */
+typedef struct Flight {
+    struct Flight *next;       /* bucket chain */
+    uint64_t       hash;
+    int            finished;
+    int            followers;  /* blocking callers still waiting */
+    LrclibStatus   status;
+    LrclibTrack   *track;
+    long           retry_ms;
+    FlightWaiter  *waiters;
+    char           key[];
+} Flight;
+
+static Flight          *flights[FLIGHT_BUCKETS];
+static long             flights_shared;
+static pthread_mutex_t  flights_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   flights_cond = PTHREAD_COND_INITIALIZER;
 
-    cJSON *json = api_request(url);
-    if (!json) {
+static LrclibTrack *track_dup(Arena *arena, const LrclibTrack *src)
+{
+    if (!src) {
         return NULL;
     }
 
-    LrclibTrack *result = parse_track(json);
-    cJSON_Delete(json);
+    return track_new(arena, src->synced_lyrics, src->plain_lyrics,
+                     src->instrumental);
+}
+
+static uint64_t flight_hash(const char *key)
+{
+    uint64_t h = 1469598103934665603ULL;   /* FNV-1a */
+    for (; *key; key++) {
+        h ^= (unsigned char)*key;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/*
+ * Join the flight for lookup `key`, or start one.  Returns NULL if the caller
+ * is the leader and must send the request (*f receives the new flight,
+ * or NULL if it could not be tracked).  Otherwise returns the flight to
+ * wait on; with `done` set, the caller is registered as an async waiter
+ * instead and must not touch the flight again.
+ */
+static Flight *flight_join(const char *key, LrclibDoneFn done, void *user,
+                           Flight **f)
+{
+    uint64_t h = flight_hash(key);
+    Flight **bucket = &flights[h % FLIGHT_BUCKETS];
+
+    *f = NULL;
+    FlightWaiter *w = done ? malloc(sizeof(FlightWaiter)) : NULL;
+
+    pthread_mutex_lock(&flights_lock);
+    for (Flight *it = *bucket; it; it = it->next) {
+        if (it->hash != h || strcmp(it->key, key) != 0) {
+            continue;
+        }
+        if (done && !w) {
+            break;    /* cannot wait without a waiter record */
+        }
+        flights_shared++;
+        if (done) {
+            w->done = done;
+            w->user = user;
+            w->next = it->waiters;
+            it->waiters = w;
+        } else {
+            it->followers++;
+        }
+        pthread_mutex_unlock(&flights_lock);
+        return it;
+    }
+
+    size_t key_len = strlen(key) + 1;
+    Flight *nf = calloc(1, sizeof(Flight) + key_len);
+    if (nf) {
+        memcpy(nf->key, key, key_len);
+        nf->hash = h;
+        nf->next = *bucket;
+        *bucket  = nf;
+        *f = nf;
+    }
+    pthread_mutex_unlock(&flights_lock);
+    free(w);
+    return NULL;
+}
+
+static void flight_free(Flight *f)
+{
+    lrclib_track_free(f->track);
+    free(f);
+}
+
+/*
+ * Publish the leader's result to every follower and retire the flight.
+ * `track` stays owned by the leader.
+ */
+static void flight_finish(Flight *f, LrclibStatus status,
+                          const LrclibTrack *track, long retry_ms)
+{
+    if (!f) {
+        return;
+    }
+
+    pthread_mutex_lock(&flights_lock);
+    Flight **p = &flights[f->hash % FLIGHT_BUCKETS];
+    while (*p != f) {
+        p = &(*p)->next;
+    }
+    *p = f->next;
+
+    FlightWaiter *waiters = f->waiters;
+    f->waiters  = NULL;
+    f->finished = 1;
+    f->status   = status;
+    f->retry_ms = retry_ms;
+    f->track    = (f->followers > 0 || waiters) ? track_dup(NULL, track)
+                                                : NULL;
+    int orphan  = (f->followers == 0);
+    pthread_cond_broadcast(&flights_cond);
+    pthread_mutex_unlock(&flights_lock);
+
+    /* Async followers run without the lock: they may start new lookups */
+    while (waiters) {
+        FlightWaiter *next = waiters->next;
+        LrclibTrack *copy = track_dup(NULL, f->track);
+        waiters->done((status == LRCLIB_OK && !copy) ? LRCLIB_ERROR : status,
+                      copy, waiters->user);
+        free(waiters);
+        waiters = next;
+    }
 
+    if (orphan) {
+        flight_free(f);
+    }
+}
+
+/*
+ * Wait for the leader of `f` to finish and take a copy of its result.
+ */
+static LrclibStatus flight_wait(Flight *f, LrclibTrack **out, long *retry_ms)
+{
+    pthread_mutex_lock(&flights_lock);
+    while (!f->finished) {
+        pthread_cond_wait(&flights_cond, &flights_lock);
+    }
+    LrclibStatus status = f->status;
+    *out      = track_dup(arena_thread(), f->track);
+    *retry_ms = f->retry_ms;
+    int last  = (--f->followers == 0);
+    pthread_mutex_unlock(&flights_lock);
+
+    if (last) {
+        flight_free(f);
+    }
+    return (status == LRCLIB_OK && !*out) ? LRCLIB_ERROR : status;
+}
+
+/*
+ * Context for an asynchronous lookup.
+ */
+typedef struct {
+    LrclibDoneFn done;
+    void        *user;
+    Flight      *flight;
+    char         key[];
+} AsyncLookup;
+
+static void lookup_done(HttpResponse *resp, void *user)
+{
+    AsyncLookup *lookup = user;
+
+    LrclibTrack *result = NULL;
+    LrclibStatus status = parse_response(lookup->key, resp, NULL, &result);
+    flight_finish(lookup->flight, status, result, 0);
+
+    lookup->done(status, result, lookup->user);
+    free(lookup);
+}
+
+/* ── Album search ─────────────────────────────────────────────────────── */
+
+/*
+ * One /search result, with the fields used for matching normalized.
+ */
+typedef struct {
+    char        *artist;
+    char        *title;
+    char        *album;
+    double       duration;
+    LrclibTrack *track;
+} AlbumCandidate;
+
+struct LrclibAlbum {
+    AlbumCandidate *items;
+    int             count;
+};
+
+/*
+ * Fetch a JSON body for `url`, from the cache when possible.
+ * Returns a string the caller must arena_release(), or NULL.
+ */
+static char *fetch_body(const char *url)
+{
+    char *body;
+    size_t len;
+    if (cache_get(lrclib_cache, url, &body, &len) == CACHE_HIT) {
+        return body;
+    }
+
+    HttpResponse *resp = http_get(url);
+    if (!resp) {
+        return NULL;
+    }
+    if (resp->status_code != 200) {
+        fprintf(stderr, "error: LRCLIB search returned HTTP %ld\n",
+                resp->status_code);
+        http_response_free(resp);
+        return NULL;
+    }
+
+    cache_put(lrclib_cache, url, resp->body, resp->size);
+    body = http_response_take_body(resp);
+    http_response_free(resp);
+    return body;
+}
+
+static int add_candidate(LrclibAlbum *a, const cJSON *obj)
+{
+    const char *artist = json_get_string(obj, "artistName");
+    const char *title  = json_get_string(obj, "trackName");
+    const char *album  = json_get_string(obj, "albumName");
+    const cJSON *dur   = cJSON_GetObjectItemCaseSensitive(obj, "duration");
+    if (!artist || !title || !album) {
+        return 0;
+    }
+
+    AlbumCandidate c = {
+        .artist   = normalize_name(artist),
+        .title    = normalize_name(title),
+        .album    = normalize_name(album),
+        .duration = cJSON_IsNumber(dur) ? dur->valuedouble : 0.0,
+        .track    = parse_track(obj)
+    };
+    if (!c.artist || !c.title || !c.album || !c.track) {
+        free(c.artist);
+        free(c.title);
+        free(c.album);
+        lrclib_track_free(c.track);
+        return -1;
+    }
+
+    a->items[a->count++] = c;
+    return 0;
+}
+
+/* ── Public API ────────────────────────────────────────────────────────── */
+
+LrclibStatus lrclib_lookup(const char *artist, const char *track,
+                           const char *album, double duration,
+                           LrclibTrack **out)
+{
+    *out = NULL;
+    Arena *arena = arena_thread();
+    if (lrclib_offline) {
+        return offline_lookup(artist, track, album, duration, arena, out);
+    }
+
+    GetRequest rq;
+    if (prepare_get(&rq, artist, track, album, duration) != 0) {
+        return LRCLIB_ERROR;
+    }
+
+    LrclibStatus status;
+    if (cached_lookup(rq.key, arena, &status, out)) {
+        return status;
+    }
+
+    Flight *flight;
+    Flight *leader = flight_join(rq.key, NULL, NULL, &flight);
+    if (leader) {
+        long retry_ms;
+        return flight_wait(leader, out, &retry_ms);
+    }
+
+    status = parse_response(rq.key, http_get(rq.url), arena, out);
+    flight_finish(flight, status, *out, 0);
+    return status;
+}
+
+LrclibStatus lrclib_lookup_attempt(const char *artist, const char *track,
+                                   const char *album, double duration,
+                                   HttpRetry *retry, LrclibTrack **out)
+{
+    *out = NULL;
+    retry->retry_ms = 0;
+    Arena *arena = arena_thread();
+    if (lrclib_offline) {
+        return offline_lookup(artist, track, album, duration, arena, out);
+    }
+
+    GetRequest rq;
+    if (prepare_get(&rq, artist, track, album, duration) != 0) {
+        return LRCLIB_ERROR;
+    }
+
+    LrclibStatus status;
+    if (cached_lookup(rq.key, arena, &status, out)) {
+        return status;
+    }
+
+    Flight *flight;
+    Flight *leader = flight_join(rq.key, NULL, NULL, &flight);
+    if (leader) {
+        /* Share the leader's answer, including when to try again */
+        return flight_wait(leader, out, &retry->retry_ms);
+    }
+
+    HttpResponse *resp = http_get_attempt(rq.url, retry);
+    if (retry->retry_ms > 0) {
+        flight_finish(flight, LRCLIB_RETRY, NULL, retry->retry_ms);
+        return LRCLIB_RETRY;
+    }
+    status = parse_response(rq.key, resp, arena, out);
+    flight_finish(flight, status, *out, 0);
+    return status;
+}
+
+LrclibTrack *lrclib_get(const char *artist, const char *track,
+                         const char *album, double duration)
+{
+    LrclibTrack *result = NULL;
+    lrclib_lookup(artist, track, album, duration, &result);
     return result;
 }
 
+int lrclib_get_async(const char *artist, const char *track,
+                     const char *album, double duration,
+                     LrclibDoneFn done, void *user)
+{
+    if (!done) {
+        return -1;
+    }
+
+    /* Results may be handed to another thread, so never in an arena */
+    if (lrclib_offline) {
+        LrclibTrack *result;
+        LrclibStatus status = offline_lookup(artist, track, album,
+                                             duration, NULL, &result);
+        done(status, result, user);
+        return 0;
+    }
+
+    GetRequest rq;
+    if (prepare_get(&rq, artist, track, album, duration) != 0) {
+        return -1;
+    }
+
+    LrclibStatus status;
+    LrclibTrack *result;
+    if (cached_lookup(rq.key, NULL, &status, &result)) {
+        done(status, result, user);
+        return 0;
+    }
+
+    Flight *flight;
+    if (flight_join(rq.key, done, user, &flight)) {
+        return 0;    /* `done` runs when the leader finishes */
+    }
+
+    size_t key_len = strlen(rq.key) + 1;
+    AsyncLookup *lookup = malloc(sizeof(AsyncLookup) + key_len);
+    if (!lookup) {
+        flight_finish(flight, LRCLIB_ERROR, NULL, 0);
+        return -1;
+    }
+    lookup->done   = done;
+    lookup->user   = user;
+    lookup->flight = flight;
+    memcpy(lookup->key, rq.key, key_len);
+
+    if (http_get_async(rq.url, lookup_done, lookup) != 0) {
+        flight_finish(flight, LRCLIB_ERROR, NULL, 0);
+        free(lookup);
+        return -1;
+    }
+    return 0;
+}
+
+LrclibAlbum *lrclib_search_album(const char *artist, const char *album)
+{
+    if (!artist || !album || lrclib_offline) {
+        return NULL;
+    }
+
+    char *enc_artist = http_url_encode(artist);
+    char *enc_album  = http_url_encode(album);
+    size_t q_len = strlen(artist) + strlen(album) + 2;
+    char *q = arena_malloc(q_len);
+    char *enc_q = NULL;
+    if (q) {
+        snprintf(q, q_len, "%s %s", artist, album);
+        enc_q = http_url_encode(q);
+        arena_release(q);
+    }
+
+    char url[URL_BUFFER_SIZE];
+    int len = -1;
+    if (enc_artist && enc_album && enc_q) {
+        len = snprintf(url, sizeof(url),
+                       "%s/search?q=%s&artist_name=%s&album_name=%s",
+                       LRCLIB_BASE_URL, enc_q, enc_artist, enc_album);
+    }
+    arena_release(enc_artist);
+    arena_release(enc_album);
+    arena_release(enc_q);
+    if (len < 0 || (size_t)len >= sizeof(url)) {
+        return NULL;
+    }
+
+    char *body = fetch_body(url);
+    if (!body) {
+        return NULL;
+    }
+
+    cJSON *json = cJSON_Parse(body);
+    arena_release(body);
+    if (!cJSON_IsArray(json)) {
+        cJSON_Delete(json);
+        return NULL;
+    }
+
+    LrclibAlbum *a = calloc(1, sizeof(LrclibAlbum));
+    int n = cJSON_GetArraySize(json);
+    if (a && n > 0) {
+        a->items = calloc((size_t)n, sizeof(AlbumCandidate));
+        if (!a->items) {
+            free(a);
+            a = NULL;
+        }
+    }
+
+    const cJSON *item;
+    cJSON_ArrayForEach(item, json) {
+        if (!a || add_candidate(a, item) < 0) {
+            break;
+        }
+    }
+    cJSON_Delete(json);
+    return a;
+}
+
+LrclibStatus lrclib_album_match(const LrclibAlbum *a,
+                                const char *artist, const char *track,
+                                const char *album, double duration,
+                                LrclibTrack **out)
+{
+    *out = NULL;
+    if (!a || a->count == 0 || !artist || !track || !album) {
+        return LRCLIB_NOT_FOUND;
+    }
+
+    char *n_artist = arena_malloc(strlen(artist) + 1);
+    char *n_title  = arena_malloc(strlen(track) + 1);
+    char *n_album  = arena_malloc(strlen(album) + 1);
+    if (n_artist && n_title && n_album) {
+        normalize_buf(artist, n_artist);
+        normalize_buf(track, n_title);
+        normalize_buf(album, n_album);
+    }
+
+    /* Same rules as an exact /get; synced lyrics beat plain ones */
+    const AlbumCandidate *best = NULL;
+    for (int i = 0; n_artist && n_title && n_album && i < a->count; i++) {
+        const AlbumCandidate *c = &a->items[i];
+        if (strcmp(c->title, n_title) != 0 ||
+            strcmp(c->artist, n_artist) != 0 ||
+            strcmp(c->album, n_album) != 0) {
+            continue;
+        }
+        if (duration > 0.0 && c->duration > 0.0 &&
+            (c->duration < duration - MATCH_DURATION_TOL ||
+             c->duration > duration + MATCH_DURATION_TOL)) {
+            continue;
+        }
+        if (!best || (c->track->synced_lyrics && !best->track->synced_lyrics)) {
+            best = c;
+        }
+    }
+
+    arena_release(n_artist);
+    arena_release(n_title);
+    arena_release(n_album);
+
+    /* Only a result /get could not improve on ends the lookup here */
+    if (!best || (!best->track->synced_lyrics && !best->track->instrumental)) {
+        return LRCLIB_NOT_FOUND;
+    }
+
+    *out = track_dup(arena_thread(), best->track);
+    return *out ? LRCLIB_OK : LRCLIB_ERROR;
+}
+
+void lrclib_album_free(LrclibAlbum *a)
+{
+    if (!a) {
+        return;
+    }
+    for (int i = 0; i < a->count; i++) {
+        free(a->items[i].artist);
+        free(a->items[i].title);
+        free(a->items[i].album);
+        lrclib_track_free(a->items[i].track);
+    }
+    free(a->items);
+    free(a);
+}
+
+long lrclib_shared_lookups(void)
+{
+    pthread_mutex_lock(&flights_lock);
+    long n = flights_shared;
+    pthread_mutex_unlock(&flights_lock);
+    return n;
+}
+
+void lrclib_set_offline(OfflineIndex *index)
+{
+    lrclib_offline = index;
+}
+
+void lrclib_set_cache(LookupCache *cache)
+{
+    lrclib_cache = cache;
+}
+
+int lrclib_warmup(int connections)
+{
+    return http_warmup(LRCLIB_BASE_URL, connections);
+}
+
 /* ── Memory management ─────────────────────────────────────────────────── */
 
 void lrclib_track_free(LrclibTrack *track)
@@ -147,7 +957,6 @@ void lrclib_track_free(LrclibTrack *track)
     if (!track) {
         return;
     }
-    free(track->synced_lyrics);
-    free(track->plain_lyrics);
-    free(track);
+    arena_release(track->storage);
+    arena_release(track);
 }
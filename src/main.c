@@ -7,16 +7,29 @@
  *   synclyr2metadata --library "/path/to/music"
  */
 
+#include "arena.h"
+#include "cache.h"
+#include "cJSON.h"
+#include "crawl.h"
 #include "http_client.h"
+#include "journal.h"
 #include "lidarr.h"
+#include "lrclib.h"
 #include "metadata.h"
+#include "normalize.h"
+#include "offline.h"
+#include "shard.h"
+#include "state.h"
 #include "sync.h"
 
-#include <dirent.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
 
 /* ── Usage ─────────────────────────────────────────────────────────────── */
 
@@ -24,41 +37,175 @@ static void print_usage(const char *progname)
 {
     fprintf(stderr,
         "Usage:\n"
-        "  %s --album   \"/path/to/album\"   [--force] [--threads N]\n"
-        "  %s --artist  \"/path/to/artist\"  [--force] [--threads N]\n"
-        "  %s --library \"/path/to/music\"   [--force] [--threads N]\n"
+        "  %s --album   \"/path/to/album\"   [--force] [--threads N|auto]\n"
+        "  %s --artist  \"/path/to/artist\"  [--force] [--threads N|auto]\n"
+        "  %s --library \"/path/to/music\"   [--force] [--threads N|auto]\n"
         "\n"
         "Options:\n"
         "  --album        Sync lyrics for a single album directory\n"
         "  --artist       Sync lyrics for all albums of an artist\n"
-        "  --library      Sync lyrics for an entire library (artist/album)\n"
+        "  --library      Sync lyrics for an entire library (any depth, repeatable)\n"
         "  --force        Overwrite existing lyrics\n"
         "  --clean-lrc    Delete local .lrc file after successfully embedding it\n"
-        "  --threads      Number of parallel threads (default: 4, max: 16)\n"
+        "  --threads      Number of parallel threads, or auto to tune it while\n"
+        "                 running (default: 4, max: 256)\n"
+        "  --min-threads  Smallest pool for --threads auto (default: 1)\n"
+        "  --max-threads  Largest pool for --threads auto (default: 64 per CPU,\n"
+        "                 cgroup CPU quota included)\n"
+        "  --scan-threads Number of parallel tag readers and crawlers (default: 4)\n"
+        "  --write-threads Number of parallel tag writers (default: same as --threads;\n"
+        "                 with auto, one per CPU)\n"
+        "  --serialize-writes At most one tag write per disk at a time\n"
+        "  --max-inflight Async LRCLIB lookups kept in flight (default: 0 = off)\n"
+        "  --album-search One LRCLIB search per album; per-track lookups only for the rest\n"
+        "  --speculate    Send exact and relaxed lookups together (uses async lookups)\n"
+        "  --strip-suffix Words that start a suffix the relaxed lookup drops\n"
+        "                 (default: feat.,feat,ft.,featuring,remaster*; none = off)\n"
+        "  --warmup       Prime DNS and TLS sessions with N connections to LRCLIB\n"
+        "                 before syncing (default: 0)\n"
+        "  --rate         Max LRCLIB requests per second (default: 0 = adaptive only)\n"
+        "  --hedge        Duplicate slow lookups, up to N%% extra requests (default: 0 = off)\n"
         "  --out-plain    File to log paths of tracks that got plain lyrics\n"
         "  --out-missing  File to log paths of tracks with no lyrics found\n"
+        "  --state        State index file; unchanged files are skipped on re-runs\n"
+        "                 (still listed in --out-plain / --out-missing)\n"
+        "  --state-retry  Days before plain/missing tracks are retried (default: 30)\n"
+        "  --journal      Checkpoint file of finished tracks, kept if the run stops\n"
+        "  --resume       Skip the tracks the --journal lists as finished\n"
+        "  --shard        Sync only albums of shard i of N (i/N), for splitting a\n"
+        "                 library across processes; output files get a per-shard name\n"
+        "  --summary      Write the run's totals as JSON (for --merge-summary)\n"
+        "  --merge-summary Combine --summary files of a sharded run and exit (repeatable)\n"
+        "  --cache-dir    Lookup cache directory (default: ~/.cache/synclyr2metadata)\n"
+        "  --cache-ttl    Days a found result stays cached (default: 30, 0 = forever)\n"
+        "  --cache-miss-ttl Days a not-found result stays cached (default: 7)\n"
+        "  --cache-size   Cache size cap in MB (default: 256, 0 = unlimited)\n"
+        "  --no-cache     Always ask LRCLIB; neither read nor write the cache\n"
+        "  --mem-stats    Report lookup allocations and peak memory in the summary\n"
+        "  --stage-stats  Report lookup/write queue depth and utilization in the summary\n"
+        "  --offline      Answer lookups from a local index instead of LRCLIB\n"
+        "  --build-index  Build the --offline index from a JSON Lines dump and exit\n"
         "  --help         Show this help message\n",
         progname, progname, progname);
 }
 
 
+/*
+ * Album context for --artist / --library runs.  Tracks from different
+ * albums interleave on the shared worker pool, so the progress callback
+ * re-prints the album header whenever the album changes.
+ */
+typedef struct {
+    char *artist;   /* printed as a group header; NULL in --artist mode */
+    char *album;
+} CliAlbum;
+
+/* Lookup cache of this run, for the summary (NULL if disabled) */
+static LookupCache *run_cache = NULL;
+
+/* --mem-stats: add allocation counts and peak RSS to the summary */
+static int mem_stats = 0;
+
+/* --stage-stats: add pipeline queue depths and utilization */
+static int stage_stats = 0;
+
+/* --shard: the albums this process syncs (count 0 = all) */
+static ShardSpec run_shard = {0};
+
+/* Totals of this run, for --summary */
+static ShardSummary run_summary = {0};
+
+/* SIGINT / SIGTERM received: the run is draining (0 = none) */
+static volatile sig_atomic_t stop_signal = 0;
+
+/* Album of the last progress line (callbacks run on one reporter thread) */
+static const CliAlbum *cli_current = NULL;
+
 /*
  * CLI progress callback: prints each track's status to stdout.
+ * `user` is a CliAlbum for pooled runs, NULL for a single album.
+ * `total` is 0 while the album is still being scanned.
  */
 static void cli_progress(int idx, int total, const char *title,
                           const char *status, void *user)
 {
-    (void)user;
-    printf("  [%2d/%d] %-40.40s %s\n", idx + 1, total, title, status);
+    const CliAlbum *album = user;
+
+    if (album && album != cli_current) {
+        if (album->artist &&
+            (!cli_current || !cli_current->artist ||
+             strcmp(cli_current->artist, album->artist) != 0)) {
+            printf("\u2550\u2550\u2550 %s\n", album->artist);
+        }
+        printf("  \u25b6 %s\n", album->album);
+        cli_current = album;
+    }
+
+    if (total > 0) {
+        printf("  [%2d/%d] %-40.40s %s\n", idx + 1, total, title, status);
+    } else {
+        printf("  [%2d/?] %-40.40s %s\n", idx + 1, title, status);
+    }
+}
+
+static CliAlbum *cli_album_new(const char *artist, const char *name)
+{
+    CliAlbum *album = calloc(1, sizeof(CliAlbum));
+    if (!album) return NULL;
+
+    album->artist = artist ? strdup(artist) : NULL;
+    album->album  = strdup(name);
+    return album;
+}
+
+static void cli_album_free(CliAlbum *album)
+{
+    if (!album) return;
+    free(album->artist);
+    free(album->album);
+    free(album);
 }
 
 /*
- * Check if a path is a directory.
+ * CLI album callback: prints a one-line summary and releases the album.
+ * A single --album run (NULL user) only gets the final summary.
  */
-static int is_directory(const char *path)
+static void cli_album_done(const SyncResult *r, void *user)
+{
+    CliAlbum *album = user;
+    if (!album) return;
+
+    printf("  \u25c0 %s: %d synced, %d plain, %d skipped, %d not found\n",
+           album->album, r->synced, r->plain, r->skipped, r->not_found);
+
+    if (cli_current == album) cli_current = NULL;
+    cli_album_free(album);
+}
+
+static void print_stage(const char *name, const SyncStageStats *s)
 {
-    struct stat st;
-    return (stat(path, &st) == 0 && S_ISDIR(st.st_mode));
+    printf("    (%s stage: %d thread(s), %ld track(s), queue avg %.1f "
+           "max %d, %.0f%% busy", name, s->threads, s->items, s->avg_queue,
+           s->max_queue, s->busy * 100.0);
+    if (s->stalled >= 0.005) {
+        printf(", %.0f%% stalled on writes", s->stalled * 100.0);
+    }
+    printf(")\n");
+}
+
+/*
+ * Describe the lookup pool size for headers, e.g. "8" or "auto, 1-64".
+ */
+static const char *threads_label(const SyncConfig *config)
+{
+    static char label[32];
+    if (config->auto_threads) {
+        snprintf(label, sizeof(label), "auto, %d-%d",
+                 config->min_threads, config->max_threads);
+    } else {
+        snprintf(label, sizeof(label), "%d", config->num_threads);
+    }
+    return label;
 }
 
 /*
@@ -72,210 +219,516 @@ static void print_summary(const SyncResult *r)
         printf("  \xe2\x9c\x93 Plain:      %d\n", r->plain);
     }
     printf("  \xe2\x8a\x98 Skipped:    %d\n", r->skipped);
+    if (r->lookups_saved > 0) {
+        printf("    (%d lookup(s) avoided: lyrics already embedded)\n",
+               r->lookups_saved);
+    }
+    if (r->unchanged > 0) {
+        printf("  \xe2\x8a\x98 Unchanged:  %d\n", r->unchanged);
+    }
+    if (r->resumed > 0) {
+        printf("  \xe2\x8a\x98 Resumed:    %d\n", r->resumed);
+    }
     printf("  \xe2\x9c\x97 Not found:  %d\n", r->not_found);
     if (r->errors > 0) {
         printf("  \xe2\x9c\x97 Errors:     %d\n", r->errors);
     }
+    if (stop_signal) {
+        printf("    (stopped early: %d queued track(s) not started; "
+               "run again with --resume)\n", r->interrupted);
+    }
+
+    RateStats rs = http_rate_stats();
+    if (rs.throttled > 0) {
+        printf("    (LRCLIB throttled %ld time(s); concurrency settled at %d/%d)\n",
+               rs.throttled, rs.window, rs.max_window);
+    }
+    if (r->album_searches > 0) {
+        printf("    (%d track(s) matched from %d album search(es))\n",
+               r->album_matches, r->album_searches);
+    }
+    if (r->spec_saved_ms > 0 || r->spec_extra > 0) {
+        printf("    (speculation saved %.1fs of lookup time for %d extra "
+               "request(s))\n", (double)r->spec_saved_ms / 1000.0,
+               r->spec_extra);
+    }
+    CacheStats cs = cache_stats(run_cache);
+    if (cs.hits > 0) {
+        printf("    (%ld lookup(s) answered from cache, %ld sent to LRCLIB)\n",
+               cs.hits, cs.misses);
+    }
+    long shared = lrclib_shared_lookups();
+    if (shared > 0) {
+        printf("    (%ld duplicate lookup(s) shared a request in flight)\n",
+               shared);
+    }
+    HttpHedgeStats hs = http_hedge_stats();
+    if (hs.hedges > 0) {
+        printf("    (%ld slow lookup(s) hedged, %ld answered first by the "
+               "duplicate)\n", hs.hedges, hs.wins);
+    }
+    HttpRetryStats retries = http_retry_stats();
+    if (retries.retries > 0) {
+        printf("    (%ld retr%s scheduled, %.1fs spent waiting)\n",
+               retries.retries, retries.retries == 1 ? "y" : "ies",
+               (double)retries.wait_ms / 1000.0);
+    }
+    if (r->threads_max > 0) {
+        printf("    (auto threads: %d lookup worker(s) at the end, at most "
+               "%d of %d)\n", r->threads_end, r->threads_peak,
+               r->threads_max);
+    }
+    if (stage_stats) {
+        print_stage("lookup", &r->lookup_stage);
+        print_stage("write", &r->write_stage);
+    }
+    if (mem_stats) {
+        ArenaStats as = arena_stats();
+        struct rusage ru;
+        long rss_kb = getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_maxrss : 0;
+        printf("    (lookup allocations: %ld from arenas, %ld from the heap, "
+               "%ld arena block(s); at most %zu KB per track, "
+               "peak RSS %.1f MB)\n", as.arena_allocs, as.heap_allocs,
+               as.blocks, (as.peak_bytes + 1023) / 1024,
+               (double)rss_kb / 1024.0);
+    }
     printf("\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\u2500\n");
 }
 
 /*
- * Accumulate results from one sync run into a total.
+ * Scan filter state: skips files the state index reports as unchanged
+ * and, with --resume, files the journal lists as finished.  Unchanged
+ * plain and missing tracks still go to --out-plain / --out-missing.
+ * After a stop request every file is skipped, so the scan winds down
+ * unread.
  */
-static void result_add(SyncResult *total, const SyncResult *r)
+typedef struct {
+    SyncEngine *engine;    /* logs the unchanged tracks */
+    StateIndex *state;     /* NULL with --force */
+    Journal    *journal;   /* NULL unless resuming */
+    int         unchanged;
+    int         resumed;
+} ScanFilter;
+
+static int skip_finished(const char *filepath, void *user)
 {
-    total->synced    += r->synced;
-    total->plain     += r->plain;
-    total->skipped   += r->skipped;
-    total->not_found += r->not_found;
-    total->errors    += r->errors;
+    ScanFilter *f = user;
+    if (sync_stop_requested()) return 1;
+    if (f->journal && journal_is_done(f->journal, filepath)) {
+        f->resumed++;
+        return 1;
+    }
+    StateOutcome outcome;
+    if (f->state && state_is_current(f->state, filepath, &outcome)) {
+        sync_engine_log_skipped(f->engine, filepath, outcome);
+        f->unchanged++;
+        return 1;
+    }
+    return 0;
+}
+
+static ScanFilter scan_filter(SyncEngine *engine, const SyncConfig *config)
+{
+    ScanFilter f = {
+        .engine  = engine,
+        .state   = config->force ? NULL : config->state,
+        .journal = journal_count(config->journal) > 0 ? config->journal : NULL
+    };
+    return f;
 }
 
-#define SYNC_DEFAULT_THREADS 4
 /*
- * --album: sync a single album directory
+ * Streaming state for one album directory.  The album is only opened
+ * in the engine once its first track has been read, so directories
+ * without audio files never show up in the output.
  */
-static int cmd_album(const char *dirpath, const SyncConfig *config)
+typedef struct {
+    SyncEngine *engine;
+    SyncAlbum  *album;
+    const char *artist;
+    const char *name;     /* NULL: single --album run, no album header */
+    int         tracks;
+} AlbumStream;
+
+static int stream_track(TrackMeta *meta, void *user)
 {
-    TrackMetaList *list = metadata_scan_dir(dirpath);
-    if (!list || list->count == 0) {
-        if (list) metadata_list_free(list);
-        printf("No audio files found in '%s'.\n", dirpath);
-        return 0;
+    AlbumStream *s = user;
+
+    if (!s->album) {
+        CliAlbum *ca = s->name ? cli_album_new(s->artist, s->name) : NULL;
+        if (s->name && !ca) {
+            metadata_free(meta);
+            return 1;
+        }
+        s->album = sync_engine_begin_album(s->engine, ca);
+        if (!s->album) {
+            cli_album_free(ca);
+            metadata_free(meta);
+            return 1;
+        }
     }
 
-    printf("Syncing lyrics for %d track(s) in '%s' [%d threads]...\n\n",
-           list->count, dirpath, config->num_threads);
+    if (sync_album_add(s->album, meta) != 0) {
+        metadata_free(meta);
+        return 1;
+    }
+    s->tracks++;
+    return 0;
+}
 
-    SyncResult r = sync_tracks(list, config, cli_progress, NULL);
-    metadata_list_free(list);
-    print_summary(&r);
+/*
+ * Stream an album directory into the engine: each track is queued as
+ * soon as its tags are read.  Unchanged and already finished files are
+ * skipped and counted in *f.  Returns the number of tracks queued.
+ */
+static int stream_album(SyncEngine *engine, const char *dirpath,
+                        const char *artist, const char *name,
+                        const SyncConfig *config, ScanFilter *f)
+{
+    AlbumStream s = { engine, NULL, artist, name, 0 };
+    *f = scan_filter(engine, config);
 
-    return (r.errors > 0) ? 1 : 0;
+    metadata_scan_dir_each(dirpath, skip_finished, f, stream_track, &s);
+    if (s.album) sync_album_end(s.album);
+
+    return s.tracks;
 }
 
 /*
- * --artist: sync all album subdirectories under an artist
+ * Shared state for --artist / --library crawls.  The crawler calls
+ * crawl_album() from several threads at once.
+ */
+typedef struct {
+    SyncEngine       *engine;
+    const SyncConfig *config;
+    int               group_by_parent;  /* --library: parent path is the artist */
+    pthread_mutex_t   lock;
+    int               unchanged;
+    int               resumed;
+    long              foreign;          /* albums left to other shards */
+} CrawlRun;
+
+/*
+ * Crawler callback: stream one album directory into the engine, using
+ * the file names the crawler already listed.  Stops the crawl once a
+ * stop is requested.
  */
-static int cmd_artist(const char *artist_path, const SyncConfig *config)
+static int crawl_album(const CrawlDir *dir, void *user)
 {
-    DIR *dir = opendir(artist_path);
-    if (!dir) {
-        fprintf(stderr, "error: could not open '%s'\n", artist_path);
-        return 1;
+    CrawlRun *run = user;
+
+    if (!shard_owns(&run_shard, dir->rel)) {
+        pthread_mutex_lock(&run->lock);
+        run->foreign++;
+        pthread_mutex_unlock(&run->lock);
+        return sync_stop_requested();
     }
 
-    const char *artist_name = strrchr(artist_path, '/');
-    artist_name = artist_name ? artist_name + 1 : artist_path;
+    /* Label albums by their path below the root, e.g. "Artist" / "Album" */
+    char *artist = NULL;
+    const char *name = dir->rel[0] ? dir->rel : dir->name;
+    const char *slash = strrchr(dir->rel, '/');
+    if (run->group_by_parent && slash) {
+        artist = strndup(dir->rel, (size_t)(slash - dir->rel));
+        name   = slash + 1;
+    }
+
+    AlbumStream s = { run->engine, NULL, artist, name, 0 };
+    ScanFilter f = scan_filter(run->engine, run->config);
 
-    printf("\u2550\u2550\u2550 %s \u2550\u2550\u2550\n\n", artist_name);
+    metadata_scan_files(dir->path, dir->files, dir->num_files,
+                        skip_finished, &f, stream_track, &s);
+    if (s.album) sync_album_end(s.album);
+    free(artist);
+
+    pthread_mutex_lock(&run->lock);
+    run->unchanged += f.unchanged;
+    run->resumed   += f.resumed;
+    pthread_mutex_unlock(&run->lock);
+    return sync_stop_requested();
+}
 
+/*
+ * Crawl `roots` and sync every album found (of this shard, with
+ * --shard).  Returns the aggregate result; crawl totals go to *stats,
+ * where `albums` only counts this shard's.
+ */
+static SyncResult crawl_sync(const char *const *roots, int num_roots,
+                             int group_by_parent, int crawl_threads,
+                             const SyncConfig *config, CrawlStats *stats)
+{
     SyncResult total = {0};
-    int album_count = 0;
+    CrawlRun run = {
+        .engine          = sync_engine_new(config, cli_progress, cli_album_done),
+        .config          = config,
+        .group_by_parent = group_by_parent
+    };
+    if (!run.engine) {
+        total.errors = 1;
+        return total;
+    }
+    pthread_mutex_init(&run.lock, NULL);
 
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL) {
-        if (entry->d_name[0] == '.') continue;
+    if (crawl_tree(roots, num_roots, crawl_threads, crawl_album, &run,
+                   stats) != 0) {
+        total.errors = 1;
+    }
 
-        size_t len = strlen(artist_path) + strlen(entry->d_name) + 2;
-        char *sub = malloc(len);
-        if (!sub) continue;
-        snprintf(sub, len, "%s/%s", artist_path, entry->d_name);
+    SyncResult r = sync_engine_finish(run.engine);
+    r.errors   += total.errors;
+    r.unchanged = run.unchanged;
+    r.resumed   = run.resumed;
+    stats->albums -= run.foreign;
+    pthread_mutex_destroy(&run.lock);
 
-        if (!is_directory(sub)) {
-            free(sub);
-            continue;
-        }
+    run_summary.albums = stats->albums;
+    run_summary.result = r;
+    return r;
+}
 
-        /* Check if this subdir has audio files */
-        TrackMetaList *list = metadata_scan_dir(sub);
-        if (!list || list->count == 0) {
-            if (list) metadata_list_free(list);
-            free(sub);
-            continue;
+#define SYNC_DEFAULT_THREADS     4
+#define SCAN_DEFAULT_THREADS     4
+#define STATE_DEFAULT_RETRY_DAYS 30
+#define CACHE_DEFAULT_TTL_DAYS   30
+#define CACHE_DEFAULT_MISS_DAYS  7
+#define CACHE_DEFAULT_SIZE_MB    256
+
+/*
+ * Default cache location: $XDG_CACHE_HOME/synclyr2metadata, else
+ * ~/.cache/synclyr2metadata.  Returns a heap string, or NULL if
+ * neither variable is set.
+ */
+static char *default_cache_dir(void)
+{
+    const char *base = getenv("XDG_CACHE_HOME");
+    const char *sub  = "/synclyr2metadata";
+    if (!base || !base[0]) {
+        base = getenv("HOME");
+        sub  = "/.cache/synclyr2metadata";
+    }
+    if (!base || !base[0]) return NULL;
+
+    size_t len = strlen(base) + strlen(sub) + 1;
+    char *dir = malloc(len);
+    if (dir) snprintf(dir, len, "%s%s", base, sub);
+    return dir;
+}
+/*
+ * --album: sync a single album directory
+ */
+static int cmd_album(const char *dirpath, const SyncConfig *config)
+{
+    SyncEngine *engine = sync_engine_new(config, cli_progress, cli_album_done);
+    if (!engine) return 1;
+
+    printf("Syncing lyrics in '%s' [%s threads]...\n\n",
+           dirpath, threads_label(config));
+
+    ScanFilter f;
+    int tracks = stream_album(engine, dirpath, NULL, NULL, config, &f);
+
+    SyncResult r = sync_engine_finish(engine);
+    r.unchanged = f.unchanged;
+    r.resumed   = f.resumed;
+
+    run_summary.albums = tracks > 0;
+    run_summary.result = r;
+
+    if (tracks == 0 && !stop_signal) {
+        if (f.resumed > 0) {
+            printf("Nothing left to sync in '%s' (%d unchanged, %d finished "
+                   "before the resume).\n", dirpath, f.unchanged, f.resumed);
+        } else if (f.unchanged > 0) {
+            printf("All %d track(s) in '%s' unchanged since last run.\n",
+                   f.unchanged, dirpath);
+        } else {
+            printf("No audio files found in '%s'.\n", dirpath);
         }
+        return 0;
+    }
 
-        album_count++;
-        printf("\u25b6 %s (%d tracks)\n", entry->d_name, list->count);
+    print_summary(&r);
+
+    return (r.errors > 0) ? 1 : 0;
+}
 
-        SyncResult r = sync_tracks(list, config, cli_progress, NULL);
-        result_add(&total, &r);
-        metadata_list_free(list);
-        printf("\n");
-        free(sub);
+/*
+ * --artist: sync all album directories below an artist
+ */
+static int cmd_artist(const char *artist_path, int crawl_threads,
+                      const SyncConfig *config)
+{
+    const char *artist_name = strrchr(artist_path, '/');
+    artist_name = artist_name ? artist_name + 1 : artist_path;
+
+    if (run_shard.count > 1) {
+        printf("\u2550\u2550\u2550 %s (shard %d of %d) \u2550\u2550\u2550\n\n",
+               artist_name, run_shard.index, run_shard.count);
+    } else {
+        printf("\u2550\u2550\u2550 %s \u2550\u2550\u2550\n\n", artist_name);
     }
 
-    closedir(dir);
+    CrawlStats stats = {0};
+    SyncResult total = crawl_sync(&artist_path, 1, 0, crawl_threads,
+                                  config, &stats);
+    printf("\n");
 
-    if (album_count == 0) {
+    if (stats.albums == 0) {
         printf("No albums found.\n");
-        return 0;
+        return (total.errors > 0) ? 1 : 0;
     }
 
-    printf("%d album(s) processed", album_count);
+    printf("%ld album(s) processed", stats.albums);
     print_summary(&total);
 
     return (total.errors > 0) ? 1 : 0;
 }
 
 /*
- * --library: scan artist/album structure and sync everything
+ * --library: crawl one or more library roots to any depth and sync
+ * every directory that contains audio files
  */
-static int cmd_library(const char *library_path, const SyncConfig *config)
+static int cmd_library(const char *const *roots, int num_roots,
+                       int crawl_threads, const SyncConfig *config)
 {
-    DIR *dir = opendir(library_path);
-    if (!dir) {
-        fprintf(stderr, "error: could not open '%s'\n", library_path);
-        return 1;
-    }
-
     printf("\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\n");
     printf("  synclyr2metadata \u2014 Library Sync\n");
-    printf("  Path:     %s\n", library_path);
-    printf("  Threads:  %d\n", config->num_threads);
+    for (int i = 0; i < num_roots; i++) {
+        printf("  Path:     %s\n", roots[i]);
+    }
+    printf("  Threads:  %s\n", threads_label(config));
+    if (run_shard.count > 1) {
+        printf("  Shard:    %d of %d\n", run_shard.index, run_shard.count);
+    }
     printf("\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\n\n");
 
-    SyncResult total = {0};
-    int artist_count = 0, album_count = 0;
+    CrawlStats stats = {0};
+    SyncResult total = crawl_sync(roots, num_roots, 1, crawl_threads,
+                                  config, &stats);
+    printf("\n");
 
-    /* Iterate artists */
-    struct dirent *artist_entry;
-    while ((artist_entry = readdir(dir)) != NULL) {
-        if (artist_entry->d_name[0] == '.') continue;
+    printf("\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\n");
+    printf("  Library Sync Complete\n");
+    printf("  Artists:  %ld\n", stats.artists);
+    printf("  Albums:   %ld\n", stats.albums);
+    print_summary(&total);
 
-        size_t alen = strlen(library_path) + strlen(artist_entry->d_name) + 2;
-        char *artist_dir = malloc(alen);
-        if (!artist_dir) continue;
-        snprintf(artist_dir, alen, "%s/%s", library_path, artist_entry->d_name);
+    return (total.errors > 0) ? 1 : 0;
+}
 
-        if (!is_directory(artist_dir)) {
-            free(artist_dir);
-            continue;
-        }
+/*
+ * --merge-summary: add up the --summary files of a sharded run and
+ * check that every shard is there exactly once
+ */
+static int cmd_merge(const char *const *paths, int num_paths)
+{
+    ShardSummary total = {0};
+    unsigned char *seen = NULL;
+    double slowest = 0, fastest = 0;
+    int ok = 1;
 
-        /* Iterate albums under this artist */
-        DIR *adir = opendir(artist_dir);
-        if (!adir) {
-            free(artist_dir);
+    for (int i = 0; i < num_paths; i++) {
+        ShardSummary sum;
+        if (shard_read_summary(paths[i], &sum) != 0) {
+            ok = 0;
             continue;
         }
 
-        int artist_albums = 0;
-
-        struct dirent *album_entry;
-        while ((album_entry = readdir(adir)) != NULL) {
-            if (album_entry->d_name[0] == '.') continue;
-
-            size_t blen = strlen(artist_dir) + strlen(album_entry->d_name) + 2;
-            char *album_dir = malloc(blen);
-            if (!album_dir) continue;
-            snprintf(album_dir, blen, "%s/%s", artist_dir, album_entry->d_name);
-
-            if (!is_directory(album_dir)) {
-                free(album_dir);
-                continue;
-            }
-
-            TrackMetaList *list = metadata_scan_dir(album_dir);
-            if (!list || list->count == 0) {
-                if (list) metadata_list_free(list);
-                free(album_dir);
-                continue;
-            }
-
-            if (artist_albums == 0) {
-                printf("\u2550\u2550\u2550 %s\n", artist_entry->d_name);
+        if (!seen) {
+            total.shard.count = sum.shard.count;
+            seen = calloc((size_t)sum.shard.count + 1, 1);
+            if (!seen) {
+                fprintf(stderr, "error: out of memory\n");
+                return 1;
             }
-
-            artist_albums++;
-            album_count++;
-            printf("  \u25b6 %s (%d tracks)\n", album_entry->d_name, list->count);
-
-            SyncResult r = sync_tracks(list, config, cli_progress, NULL);
-            result_add(&total, &r);
-            metadata_list_free(list);
-            free(album_dir);
+        }
+        if (sum.shard.count != total.shard.count ||
+            sum.shard.index < 1 || sum.shard.index > total.shard.count) {
+            fprintf(stderr, "error: '%s' is shard %d of %d, expected one "
+                    "of %d\n", paths[i], sum.shard.index, sum.shard.count,
+                    total.shard.count);
+            ok = 0;
+            continue;
+        }
+        if (seen[sum.shard.index]++) {
+            fprintf(stderr, "error: shard %d given twice ('%s')\n",
+                    sum.shard.index, paths[i]);
+            ok = 0;
+            continue;
         }
 
-        closedir(adir);
+        SyncResult *t = &total.result;
+        const SyncResult *r = &sum.result;
+        t->synced         += r->synced;
+        t->plain          += r->plain;
+        t->skipped        += r->skipped;
+        t->not_found      += r->not_found;
+        t->errors         += r->errors;
+        t->lookups_saved  += r->lookups_saved;
+        t->unchanged      += r->unchanged;
+        t->resumed        += r->resumed;
+        t->interrupted    += r->interrupted;
+        t->album_searches += r->album_searches;
+        t->album_matches  += r->album_matches;
+        total.albums      += sum.albums;
+
+        if (sum.seconds > slowest) slowest = sum.seconds;
+        if (fastest == 0 || sum.seconds < fastest) fastest = sum.seconds;
+    }
 
-        if (artist_albums > 0) {
-            artist_count++;
-            printf("\n");
+    int found = 0;
+    for (int i = 1; seen && i <= total.shard.count; i++) {
+        if (seen[i]) {
+            found++;
+        } else {
+            fprintf(stderr, "warning: no summary for shard %d of %d\n",
+                    i, total.shard.count);
+            ok = 0;
         }
+    }
+    free(seen);
+    if (found == 0) return 1;
 
-        free(artist_dir);
+    printf("Merged %d of %d shard summar%s\n", found, total.shard.count,
+           found == 1 ? "y" : "ies");
+    printf("  Albums:   %ld\n", total.albums);
+    printf("  Time:     %.1fs slowest shard, %.1fs fastest\n",
+           slowest, fastest);
+    if (total.result.interrupted > 0) {
+        printf("    (%d track(s) left unstarted by interrupted shards)\n",
+               total.result.interrupted);
     }
+    print_summary(&total.result);
 
-    closedir(dir);
+    return (ok && total.result.errors == 0) ? 0 : 1;
+}
 
-    printf("\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\u2550\n");
-    printf("  Library Sync Complete\n");
-    printf("  Artists:  %d\n", artist_count);
-    printf("  Albums:   %d\n", album_count);
-    print_summary(&total);
+/* ── Signals ───────────────────────────────────────────────────────────── */
 
-    return (total.errors > 0) ? 1 : 0;
+/*
+ * SIGINT / SIGTERM: start no new tracks and let the run drain, so every
+ * finished track is recorded.  A second signal ends the process.
+ */
+static void on_stop_signal(int sig)
+{
+    static const char msg[] = "\nStopping: finishing tracks in progress "
+                              "(signal again to quit now)...\n";
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    stop_signal = sig;
+    sync_request_stop();
+    ssize_t n = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+    (void)n;
+}
+
+static void install_stop_handlers(void)
+{
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
 }
 
 /* ── Argument parsing ──────────────────────────────────────────────────── */
@@ -290,6 +743,36 @@ static const char *find_arg(int argc, char **argv, const char *flag)
     return NULL;
 }
 
+/*
+ * Collect every value given for a repeatable flag.  *out receives a
+ * heap array of them, NULL if there are none; caller frees.  Returns
+ * the number found, or -1 if out of memory.
+ */
+static int find_args(int argc, char **argv, const char *flag,
+                     const char ***out)
+{
+    *out = NULL;
+    int n = 0;
+    for (int i = 1; i < argc - 1; i++) {
+        if (strcmp(argv[i], flag) == 0) {
+            n++;
+            i++;
+        }
+    }
+    if (n == 0) return 0;
+
+    const char **values = malloc((size_t)n * sizeof(*values));
+    if (!values) return -1;
+    n = 0;
+    for (int i = 1; i < argc - 1; i++) {
+        if (strcmp(argv[i], flag) == 0) {
+            values[n++] = argv[++i];
+        }
+    }
+    *out = values;
+    return n;
+}
+
 static int has_flag(int argc, char **argv, const char *flag)
 {
     for (int i = 1; i < argc; i++) {
@@ -317,41 +800,275 @@ int main(int argc, char **argv)
     int exit_code = 0;
     int force = has_flag(argc, argv, "--force");
     int clean_lrc = has_flag(argc, argv, "--clean-lrc");
+    int speculate = has_flag(argc, argv, "--speculate");
+    int album_search = has_flag(argc, argv, "--album-search");
+    mem_stats = has_flag(argc, argv, "--mem-stats");
+    stage_stats = has_flag(argc, argv, "--stage-stats");
+    int serialize_writes = has_flag(argc, argv, "--serialize-writes");
 
     const char *threads_str = find_arg(argc, argv, "--threads");
-    int num_threads = threads_str ? atoi(threads_str) : SYNC_DEFAULT_THREADS;
+    int auto_threads = threads_str && strcmp(threads_str, "auto") == 0;
+    int num_threads = threads_str && !auto_threads ? atoi(threads_str)
+                                                   : SYNC_DEFAULT_THREADS;
     if (num_threads < 1) num_threads = 1;
-    if (num_threads > 16) num_threads = 16;
+    if (num_threads > SYNC_MAX_THREADS) num_threads = SYNC_MAX_THREADS;
+
+    /* --threads auto: start at the default, tune within the bounds */
+    const char *min_str = find_arg(argc, argv, "--min-threads");
+    const char *max_str = find_arg(argc, argv, "--max-threads");
+    int min_threads = min_str ? atoi(min_str) : 1;
+    int max_threads = max_str ? atoi(max_str) : sync_thread_ceiling();
+    if (min_threads < 1) min_threads = 1;
+    if (max_threads > SYNC_MAX_THREADS) max_threads = SYNC_MAX_THREADS;
+    if (max_threads < min_threads) max_threads = min_threads;
+    if (auto_threads) {
+        if (num_threads < min_threads) num_threads = min_threads;
+        if (num_threads > max_threads) num_threads = max_threads;
+    }
+
+    /* Tag writes are CPU and disk work, so auto sizes them by CPU */
+    const char *write_str = find_arg(argc, argv, "--write-threads");
+    int write_threads = write_str ? atoi(write_str)
+                      : auto_threads ? sync_cpu_count() : num_threads;
+    if (write_threads < 1) write_threads = 1;
+    if (write_threads > SYNC_MAX_THREADS) write_threads = SYNC_MAX_THREADS;
+
+    const char *scan_str = find_arg(argc, argv, "--scan-threads");
+    int scan_threads = scan_str ? atoi(scan_str) : SCAN_DEFAULT_THREADS;
+    if (scan_threads < 1) scan_threads = 1;
+
+    const char *inflight_str = find_arg(argc, argv, "--max-inflight");
+    int max_inflight = inflight_str ? atoi(inflight_str) : 0;
+    if (max_inflight < 0) max_inflight = 0;
+
+    /* Speculation pairs async requests; default to one track per thread */
+    if (speculate && max_inflight == 0) max_inflight = num_threads;
+
+    const char *rate_str = find_arg(argc, argv, "--rate");
+    double rate = rate_str ? atof(rate_str) : 0.0;
+
+    const char *hedge_str = find_arg(argc, argv, "--hedge");
+    double hedge_pct = hedge_str ? atof(hedge_str) : 0.0;
+
+    const char *warmup_str = find_arg(argc, argv, "--warmup");
+    int warmup = warmup_str ? atoi(warmup_str) : 0;
 
     const char *album_dir   = find_arg(argc, argv, "--album");
     const char *artist_dir  = find_arg(argc, argv, "--artist");
-    const char *library_dir = find_arg(argc, argv, "--library");
+    const char **library_dirs = NULL;
+    int num_libraries = find_args(argc, argv, "--library", &library_dirs);
     const char *out_plain   = find_arg(argc, argv, "--out-plain");
     const char *out_missing = find_arg(argc, argv, "--out-missing");
+    const char *state_path  = find_arg(argc, argv, "--state");
+    const char *retry_str   = find_arg(argc, argv, "--state-retry");
+    long retry_days = retry_str ? atol(retry_str) : STATE_DEFAULT_RETRY_DAYS;
+    const char *journal_path = find_arg(argc, argv, "--journal");
+    int resume = has_flag(argc, argv, "--resume");
+    const char *shard_str    = find_arg(argc, argv, "--shard");
+    const char *summary_path = find_arg(argc, argv, "--summary");
+    const char **merge_paths = NULL;
+    int num_merges = find_args(argc, argv, "--merge-summary", &merge_paths);
+    if (num_libraries < 0 || num_merges < 0) {
+        fprintf(stderr, "error: out of memory\n");
+        return 1;
+    }
+
+    int no_cache = has_flag(argc, argv, "--no-cache");
+    const char *cache_dir = find_arg(argc, argv, "--cache-dir");
+    const char *ttl_str   = find_arg(argc, argv, "--cache-ttl");
+    long cache_ttl_days = ttl_str ? atol(ttl_str) : CACHE_DEFAULT_TTL_DAYS;
+    const char *miss_str  = find_arg(argc, argv, "--cache-miss-ttl");
+    long cache_miss_days = miss_str ? atol(miss_str) : CACHE_DEFAULT_MISS_DAYS;
+    const char *csize_str = find_arg(argc, argv, "--cache-size");
+    long long cache_mb = csize_str ? atoll(csize_str) : CACHE_DEFAULT_SIZE_MB;
+
+    const char *suffix_str = find_arg(argc, argv, "--strip-suffix");
+    if (suffix_str &&
+        normalize_set_suffixes(strcmp(suffix_str, "none") == 0
+                               ? NULL : suffix_str) != 0) {
+        fprintf(stderr, "error: out of memory\n");
+        return 1;
+    }
+
+    const char *offline_path = find_arg(argc, argv, "--offline");
+    const char *dump_path    = find_arg(argc, argv, "--build-index");
+
+    if (dump_path) {
+        /* ── Index build: no sync, no network ───────────────────── */
+        if (!offline_path) {
+            fprintf(stderr, "error: --build-index needs --offline FILE "
+                            "for the index to write\n");
+            return 1;
+        }
+        long n = offline_build(dump_path, offline_path);
+        if (n < 0) return 1;
+        printf("Indexed %ld track(s) into %s\n", n, offline_path);
+        return 0;
+    }
+
+    if (num_merges > 0) {
+        /* ── Summary merge: no sync, no network ─────────────────── */
+        exit_code = cmd_merge(merge_paths, num_merges);
+        free(merge_paths);
+        free(library_dirs);
+        return exit_code;
+    }
+
+    if (shard_str) {
+        if (shard_parse(shard_str, &run_shard) != 0) {
+            fprintf(stderr, "error: --shard takes i/N with 1 <= i <= N, "
+                            "e.g. 1/4\n");
+            return 1;
+        }
+        if (album_dir && !artist_dir && num_libraries == 0) {
+            fprintf(stderr, "error: --shard splits albums; use it with "
+                            "--artist or --library\n");
+            return 1;
+        }
+    }
+
+    /* Every shard keeps its own files, so shards can share a directory */
+    char *plain_file   = shard_path(out_plain, &run_shard);
+    char *missing_file = shard_path(out_missing, &run_shard);
+    char *state_file   = shard_path(state_path, &run_shard);
+    char *journal_file = shard_path(journal_path, &run_shard);
+    char *summary_file = shard_path(summary_path, &run_shard);
+    if ((out_plain && !plain_file) || (out_missing && !missing_file) ||
+        (state_path && !state_file) || (journal_path && !journal_file) ||
+        (summary_path && !summary_file)) {
+        fprintf(stderr, "error: out of memory\n");
+        return 1;
+    }
+
+    if (resume && !journal_path) {
+        fprintf(stderr, "error: --resume needs --journal FILE "
+                        "to resume from\n");
+        return 1;
+    }
 
     SyncConfig config = {
-        .force       = force,
-        .clean_lrc   = clean_lrc,
-        .num_threads = num_threads,
-        .out_plain   = (char *)out_plain,
-        .out_missing = (char *)out_missing
+        .force            = force,
+        .clean_lrc        = clean_lrc,
+        .num_threads      = num_threads,
+        .out_plain        = plain_file,
+        .out_missing      = missing_file,
+        .max_inflight     = max_inflight,
+        .speculative      = speculate,
+        .album_search     = album_search,
+        .write_threads    = write_threads,
+        .serialize_writes = serialize_writes,
+        .auto_threads     = auto_threads,
+        .min_threads      = min_threads,
+        .max_threads      = max_threads
     };
 
-    if (album_dir || artist_dir || library_dir) {
+    if (album_dir || artist_dir || num_libraries > 0) {
         /* ── All sync modes require HTTP ─────────────────────────── */
         if (http_init() != 0) {
             fprintf(stderr, "error: failed to initialize HTTP client\n");
             return 1;
         }
 
-        if (library_dir) {
-            exit_code = cmd_library(library_dir, &config);
+        /* Concurrency adapts up to the configured ceiling */
+        int window = max_inflight > 0 ? max_inflight
+                   : auto_threads ? max_threads : num_threads;
+        http_set_limits(rate, speculate ? window * 2 : window);
+        http_set_hedging(hedge_pct / 100.0);
+
+        /* /search results are parsed with cJSON, in the worker arenas */
+        cJSON_Hooks hooks = { arena_malloc, arena_release };
+        cJSON_InitHooks(&hooks);
+
+        if (max_inflight > 0 &&
+            http_async_start(speculate ? max_inflight * 2 : max_inflight) != 0) {
+            fprintf(stderr, "warning: async HTTP unavailable, "
+                            "using blocking lookups\n");
+        }
+
+        OfflineIndex *offline = NULL;
+        if (offline_path) {
+            offline = offline_open(offline_path);
+            if (!offline) {
+                http_cleanup();
+                return 1;
+            }
+            lrclib_set_offline(offline);
+        } else if (warmup > 0) {
+            lrclib_warmup(warmup);
+        }
+
+        metadata_scan_init(scan_threads);
+
+        if (state_file) {
+            config.state = state_open(state_file, retry_days * 86400L);
+            if (!config.state) {
+                lrclib_set_offline(NULL);
+                offline_close(offline);
+                metadata_scan_cleanup();
+                http_cleanup();
+                return 1;
+            }
+        }
+
+        if (journal_file) {
+            config.journal = journal_open(journal_file, resume);
+            if (!config.journal) {
+                state_close(config.state);
+                lrclib_set_offline(NULL);
+                offline_close(offline);
+                metadata_scan_cleanup();
+                http_cleanup();
+                return 1;
+            }
+        }
+
+        if (!no_cache && !offline) {
+            char *dir = cache_dir ? strdup(cache_dir) : default_cache_dir();
+            if (dir) {
+                /* A cache that cannot be opened only costs speed */
+                run_cache = cache_open(dir, cache_ttl_days * 86400L,
+                                       cache_miss_days * 86400L,
+                                       cache_mb * 1024 * 1024);
+                lrclib_set_cache(run_cache);
+                free(dir);
+            }
+        }
+
+        install_stop_handlers();
+
+        struct timespec started, ended;
+        clock_gettime(CLOCK_MONOTONIC, &started);
+
+        if (num_libraries > 0) {
+            exit_code = cmd_library(library_dirs, num_libraries,
+                                    scan_threads, &config);
         } else if (artist_dir) {
-            exit_code = cmd_artist(artist_dir, &config);
+            exit_code = cmd_artist(artist_dir, scan_threads, &config);
         } else {
             exit_code = cmd_album(album_dir, &config);
         }
 
+        if (summary_file) {
+            clock_gettime(CLOCK_MONOTONIC, &ended);
+            run_summary.shard   = run_shard;
+            run_summary.seconds = (double)(ended.tv_sec - started.tv_sec) +
+                                  (double)(ended.tv_nsec - started.tv_nsec) / 1e9;
+            if (shard_write_summary(summary_file, &run_summary) != 0 &&
+                exit_code == 0) {
+                exit_code = 1;
+            }
+        }
+
+        /* An interrupted or failed run keeps its journal for --resume */
+        if (stop_signal) exit_code = 128 + stop_signal;
+        journal_close(config.journal, exit_code == 0);
+
+        lrclib_set_cache(NULL);
+        cache_close(run_cache);
+        lrclib_set_offline(NULL);
+        offline_close(offline);
+        state_close(config.state);
+        metadata_scan_cleanup();
         http_cleanup();
 
     } else {
@@ -360,5 +1077,12 @@ int main(int argc, char **argv)
         exit_code = 1;
     }
 
+    free(plain_file);
+    free(missing_file);
+    free(state_file);
+    free(journal_file);
+    free(summary_file);
+    free(library_dirs);
+    free(merge_paths);
     return exit_code;
 }
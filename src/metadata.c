@@ -2,7 +2,9 @@
  * metadata.c — Audio file metadata reader implementation
  *
  * Uses TagLib C bindings to extract metadata from audio files
- * and provides directory scanning for batch processing.
+ * and provides directory scanning for batch processing.  Tag reads
+ * within a directory can be spread over a small pool of scan threads
+ * (see metadata_scan_init()); results are still delivered in order.
  */
 
 #include "metadata.h"
@@ -10,6 +12,7 @@
 #include <taglib/tag_c.h>
 
 #include <dirent.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,10 +25,7 @@ static const char *AUDIO_EXTENSIONS[] = {
     NULL
 };
 
-/*
- * Check if a filename has a supported audio extension (case-insensitive).
- */
-static int is_audio_file(const char *filename)
+int metadata_is_audio_file(const char *filename)
 {
     const char *dot = strrchr(filename, '.');
     if (!dot) {
@@ -53,6 +53,29 @@ static char *safe_strdup(const char *src)
     return strdup(src);
 }
 
+/*
+ * Copy a string returned by TagLib and release the original.  String
+ * management is disabled (see disable_string_management()), so each
+ * returned string is owned by the caller.
+ */
+static char *take_taglib_string(char *src)
+{
+    char *copy = safe_strdup(src);
+    taglib_free(src);
+    return copy;
+}
+
+/*
+ * TagLib's managed-string list is a process-wide global, so it cannot
+ * be shared by concurrent readers.  Turn it off once, before any read.
+ */
+static pthread_once_t string_mgmt_once = PTHREAD_ONCE_INIT;
+
+static void disable_string_management(void)
+{
+    taglib_set_string_management_enabled(0);
+}
+
 /*
  * Comparison function for qsort: sort TrackMeta by track_number.
  */
@@ -63,6 +86,17 @@ static int compare_track_number(const void *a, const void *b)
     return ta->track_number - tb->track_number;
 }
 
+/*
+ * Check whether an open TagLib file already has a non-empty LYRICS tag.
+ */
+static int file_has_lyrics(TagLib_File *file)
+{
+    char **values = taglib_property_get(file, "LYRICS");
+    int has = (values && values[0] && values[0][0] != '\0');
+    taglib_property_free(values);
+    return has;
+}
+
 /* ── Public API ────────────────────────────────────────────────────────── */
 
 TrackMeta *metadata_read(const char *filepath)
@@ -71,6 +105,8 @@ TrackMeta *metadata_read(const char *filepath)
         return NULL;
     }
 
+    pthread_once(&string_mgmt_once, disable_string_management);
+
     TagLib_File *file = taglib_file_new(filepath);
     if (!file || !taglib_file_is_valid(file)) {
         if (file) {
@@ -91,9 +127,9 @@ TrackMeta *metadata_read(const char *filepath)
 
     /* Extract tag fields */
     if (tag) {
-        meta->title        = safe_strdup(taglib_tag_title(tag));
-        meta->artist       = safe_strdup(taglib_tag_artist(tag));
-        meta->album        = safe_strdup(taglib_tag_album(tag));
+        meta->title        = take_taglib_string(taglib_tag_title(tag));
+        meta->artist       = take_taglib_string(taglib_tag_artist(tag));
+        meta->album        = take_taglib_string(taglib_tag_album(tag));
         meta->track_number = (int)taglib_tag_track(tag);
     }
 
@@ -102,10 +138,10 @@ TrackMeta *metadata_read(const char *filepath)
         meta->duration = taglib_audioproperties_length(props);
     }
 
+    meta->has_lyrics = file_has_lyrics(file);
+
     meta->filepath = strdup(filepath);
 
-    /* Clean up TagLib allocated strings */
-    taglib_tag_free_strings();
     taglib_file_free(file);
 
     return meta;
@@ -113,80 +149,350 @@ TrackMeta *metadata_read(const char *filepath)
 
 TrackMetaList *metadata_scan_dir(const char *dirpath)
 {
-    if (!dirpath) {
-        return NULL;
-    }
+    return metadata_scan_dir_filtered(dirpath, NULL, NULL);
+}
 
-    DIR *dir = opendir(dirpath);
-    if (!dir) {
-        fprintf(stderr, "error: could not open directory '%s'\n", dirpath);
-        return NULL;
+/* ── Parallel tag reading ─────────────────────────────────────────────── */
+
+/*
+ * The audio files of one directory.  Paths are claimed in order by the
+ * scan threads and by the scanning caller itself; results land in the
+ * slot of their path, so delivery order is independent of read order.
+ */
+typedef struct ScanBatch {
+    char             **paths;
+    TrackMeta        **results;
+    unsigned char     *ready;
+    int                count;
+    int                next;       /* next path to claim */
+    int                finished;   /* claimed paths whose read is done */
+    struct ScanBatch  *next_batch;
+} ScanBatch;
+
+static struct {
+    pthread_t       *threads;
+    int              num_threads;
+    int              stopping;
+    ScanBatch       *head;        /* batches with unclaimed paths */
+    ScanBatch       *tail;
+    pthread_mutex_t  mutex;
+    pthread_cond_t   work_cond;   /* signalled when a batch is queued */
+    pthread_cond_t   done_cond;   /* signalled when a read completes */
+} scan_pool = {
+    .mutex     = PTHREAD_MUTEX_INITIALIZER,
+    .work_cond = PTHREAD_COND_INITIALIZER,
+    .done_cond = PTHREAD_COND_INITIALIZER
+};
+
+/* Caller holds scan_pool.mutex. */
+static void batch_unlink(ScanBatch *b)
+{
+    ScanBatch *prev = NULL;
+    for (ScanBatch *cur = scan_pool.head; cur; prev = cur, cur = cur->next_batch) {
+        if (cur != b) continue;
+        if (prev) prev->next_batch = cur->next_batch;
+        else scan_pool.head = cur->next_batch;
+        if (scan_pool.tail == cur) scan_pool.tail = prev;
+        break;
     }
+    b->next_batch = NULL;
+}
 
-    /* First pass: count audio files */
-    int capacity = 32;
-    TrackMetaList *list = calloc(1, sizeof(TrackMetaList));
-    if (!list) {
-        closedir(dir);
-        return NULL;
+/*
+ * Claim the next path of `b`, or -1 if all are claimed.
+ * Caller holds scan_pool.mutex.
+ */
+static int batch_claim(ScanBatch *b)
+{
+    if (b->next >= b->count) return -1;
+    int idx = b->next++;
+    if (b->next >= b->count) batch_unlink(b);
+    return idx;
+}
+
+/*
+ * Read one claimed path with the mutex dropped, then publish the result.
+ * Caller holds scan_pool.mutex.
+ */
+static void batch_read(ScanBatch *b, int idx)
+{
+    pthread_mutex_unlock(&scan_pool.mutex);
+    TrackMeta *meta = metadata_read(b->paths[idx]);
+    pthread_mutex_lock(&scan_pool.mutex);
+
+    b->results[idx] = meta;
+    b->ready[idx]   = 1;
+    b->finished++;
+    pthread_cond_broadcast(&scan_pool.done_cond);
+}
+
+static void *scan_worker(void *arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&scan_pool.mutex);
+    for (;;) {
+        while (!scan_pool.head && !scan_pool.stopping) {
+            pthread_cond_wait(&scan_pool.work_cond, &scan_pool.mutex);
+        }
+        if (scan_pool.stopping) break;
+
+        ScanBatch *b = scan_pool.head;
+        batch_read(b, batch_claim(b));
     }
+    pthread_mutex_unlock(&scan_pool.mutex);
+    return NULL;
+}
 
-    list->items = calloc((size_t)capacity, sizeof(TrackMeta *));
-    if (!list->items) {
-        free(list);
-        closedir(dir);
-        return NULL;
+/*
+ * Read every path of `b` (helped by the scan pool, if any) and hand the
+ * results to `sink` in path order.  Returns the number delivered.
+ */
+static int batch_deliver(ScanBatch *b, MetaSinkFn sink, void *sink_user)
+{
+    int delivered = 0;
+
+    pthread_mutex_lock(&scan_pool.mutex);
+    if (scan_pool.num_threads > 0 && b->count > 1) {
+        if (scan_pool.tail) scan_pool.tail->next_batch = b;
+        else scan_pool.head = b;
+        scan_pool.tail = b;
+        pthread_cond_broadcast(&scan_pool.work_cond);
     }
 
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL) {
-        if (entry->d_name[0] == '.') {
-            continue; /* Skip hidden files and . / .. */
+    int stop = 0;
+    for (int i = 0; i < b->count && !stop; i++) {
+        while (!b->ready[i]) {
+            /* Help out rather than wait while paths remain unclaimed */
+            int idx = batch_claim(b);
+            if (idx >= 0) {
+                batch_read(b, idx);
+            } else {
+                pthread_cond_wait(&scan_pool.done_cond, &scan_pool.mutex);
+            }
         }
 
-        if (!is_audio_file(entry->d_name)) {
-            continue;
-        }
+        TrackMeta *meta = b->results[i];
+        b->results[i] = NULL;
+        if (!meta) continue;
+
+        pthread_mutex_unlock(&scan_pool.mutex);
+        delivered++;
+        stop = (sink(meta, sink_user) != 0);
+        pthread_mutex_lock(&scan_pool.mutex);
+    }
+
+    /* Early stop: withdraw unclaimed paths and wait for in-flight reads */
+    if (b->next < b->count) {
+        batch_unlink(b);
+        b->count = b->next;
+    }
+    while (b->finished < b->next) {
+        pthread_cond_wait(&scan_pool.done_cond, &scan_pool.mutex);
+    }
+    pthread_mutex_unlock(&scan_pool.mutex);
 
+    for (int i = 0; i < b->count; i++) metadata_free(b->results[i]);
+    return delivered;
+}
+
+int metadata_scan_files(const char *dirpath, char *const *names, int count,
+                        MetaFilterFn filter, void *filter_user,
+                        MetaSinkFn sink, void *sink_user)
+{
+    if (!dirpath || !sink || count < 0) {
+        return -1;
+    }
+
+    ScanBatch b = {0};
+    b.paths = calloc((size_t)(count ? count : 1), sizeof(char *));
+    if (!b.paths) {
+        return -1;
+    }
+
+    size_t dir_len = strlen(dirpath);
+    for (int i = 0; i < count; i++) {
         /* Build full path */
-        size_t path_len = strlen(dirpath) + strlen(entry->d_name) + 2;
+        size_t path_len = dir_len + strlen(names[i]) + 2;
         char *fullpath = malloc(path_len);
         if (!fullpath) {
             continue;
         }
-        snprintf(fullpath, path_len, "%s/%s", dirpath, entry->d_name);
+        snprintf(fullpath, path_len, "%s/%s", dirpath, names[i]);
+
+        if (filter && filter(fullpath, filter_user)) {
+            free(fullpath);
+            continue;
+        }
+        b.paths[b.count++] = fullpath;
+    }
 
-        TrackMeta *meta = metadata_read(fullpath);
-        free(fullpath);
+    int delivered = 0;
+    if (b.count > 0) {
+        b.results = calloc((size_t)b.count, sizeof(TrackMeta *));
+        b.ready   = calloc((size_t)b.count, 1);
+        if (b.results && b.ready) {
+            int total = b.count;
+            delivered = batch_deliver(&b, sink, sink_user);
+            b.count = total;
+        }
+    }
+
+    for (int i = 0; i < b.count; i++) free(b.paths[i]);
+    free(b.paths);
+    free(b.results);
+    free(b.ready);
+    return delivered;
+}
 
-        if (!meta) {
+int metadata_scan_dir_each(const char *dirpath,
+                           MetaFilterFn filter, void *filter_user,
+                           MetaSinkFn sink, void *sink_user)
+{
+    if (!dirpath || !sink) {
+        return -1;
+    }
+
+    DIR *dir = opendir(dirpath);
+    if (!dir) {
+        fprintf(stderr, "error: could not open directory '%s'\n", dirpath);
+        return -1;
+    }
+
+    /* Collect the audio names first; listing is cheap next to TagLib */
+    char **names = NULL;
+    int count = 0, capacity = 0;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue; /* Skip hidden files and . / .. */
+        }
+
+        if (!metadata_is_audio_file(entry->d_name)) {
             continue;
         }
 
-        /* Grow array if needed */
-        if (list->count >= capacity) {
-            capacity *= 2;
-            TrackMeta **new_items = realloc(list->items,
-                                            (size_t)capacity * sizeof(TrackMeta *));
-            if (!new_items) {
-                metadata_free(meta);
+        if (count >= capacity) {
+            int new_cap = capacity ? capacity * 2 : 32;
+            char **grown = realloc(names, (size_t)new_cap * sizeof(char *));
+            if (!grown) {
                 break;
             }
-            list->items = new_items;
+            names    = grown;
+            capacity = new_cap;
         }
-
-        list->items[list->count++] = meta;
+        names[count] = strdup(entry->d_name);
+        if (names[count]) count++;
     }
 
     closedir(dir);
 
+    int delivered = metadata_scan_files(dirpath, names, count,
+                                        filter, filter_user, sink, sink_user);
+
+    for (int i = 0; i < count; i++) free(names[i]);
+    free(names);
+    return delivered < 0 ? 0 : delivered;
+}
+
+/*
+ * Sink state for metadata_scan_dir_filtered(): a growing TrackMetaList.
+ */
+typedef struct {
+    TrackMetaList *list;
+    int            capacity;
+} ListBuilder;
+
+static int list_append(TrackMeta *meta, void *user)
+{
+    ListBuilder *b = user;
+    TrackMetaList *list = b->list;
+
+    /* Grow array if needed */
+    if (list->count >= b->capacity) {
+        int capacity = b->capacity * 2;
+        TrackMeta **new_items = realloc(list->items,
+                                        (size_t)capacity * sizeof(TrackMeta *));
+        if (!new_items) {
+            metadata_free(meta);
+            return 1;
+        }
+        list->items = new_items;
+        b->capacity = capacity;
+    }
+
+    list->items[list->count++] = meta;
+    return 0;
+}
+
+TrackMetaList *metadata_scan_dir_filtered(const char *dirpath,
+                                          MetaFilterFn filter, void *user)
+{
+    if (!dirpath) {
+        return NULL;
+    }
+
+    ListBuilder b = { calloc(1, sizeof(TrackMetaList)), 32 };
+    if (!b.list) {
+        return NULL;
+    }
+
+    b.list->items = calloc((size_t)b.capacity, sizeof(TrackMeta *));
+    if (!b.list->items) {
+        free(b.list);
+        return NULL;
+    }
+
+    if (metadata_scan_dir_each(dirpath, filter, user, list_append, &b) < 0) {
+        metadata_list_free(b.list);
+        return NULL;
+    }
+
     /* Sort by track number */
-    if (list->count > 1) {
-        qsort(list->items, (size_t)list->count, sizeof(TrackMeta *),
+    if (b.list->count > 1) {
+        qsort(b.list->items, (size_t)b.list->count, sizeof(TrackMeta *),
               compare_track_number);
     }
 
-    return list;
+    return b.list;
+}
+
+int metadata_scan_init(int num_threads)
+{
+    pthread_once(&string_mgmt_once, disable_string_management);
+
+    /* The scanning caller reads too, so N readers need N-1 helpers */
+    int helpers = num_threads - 1;
+    if (helpers <= 0 || scan_pool.threads) return 0;
+
+    scan_pool.threads = calloc((size_t)helpers, sizeof(pthread_t));
+    if (!scan_pool.threads) return -1;
+
+    for (int i = 0; i < helpers; i++) {
+        if (pthread_create(&scan_pool.threads[i], NULL, scan_worker, NULL) != 0) {
+            break;
+        }
+        scan_pool.num_threads++;
+    }
+    return 0;
+}
+
+void metadata_scan_cleanup(void)
+{
+    pthread_mutex_lock(&scan_pool.mutex);
+    scan_pool.stopping = 1;
+    pthread_cond_broadcast(&scan_pool.work_cond);
+    pthread_mutex_unlock(&scan_pool.mutex);
+
+    for (int i = 0; i < scan_pool.num_threads; i++) {
+        pthread_join(scan_pool.threads[i], NULL);
+    }
+
+    free(scan_pool.threads);
+    scan_pool.threads     = NULL;
+    scan_pool.num_threads = 0;
+    scan_pool.stopping    = 0;
 }
 
 int metadata_sync_lyrics(const char *filepath, const char *lyrics, int force)
@@ -202,14 +508,9 @@ int metadata_sync_lyrics(const char *filepath, const char *lyrics, int force)
     }
 
     /* Check existing lyrics if not forcing */
-    if (!force) {
-        char **values = taglib_property_get(file, "LYRICS");
-        int has = (values && values[0] && values[0][0] != '\0');
-        taglib_property_free(values);
-        if (has) {
-            taglib_file_free(file);
-            return 0;  /* already has lyrics */
-        }
+    if (!force && file_has_lyrics(file)) {
+        taglib_file_free(file);
+        return 0;  /* already has lyrics */
     }
 
     /* Write lyrics */
@@ -0,0 +1,763 @@
+/*
+ * normalize.c — Name normalization implementation
+ *
+ * Names are decoded as UTF-8 one code point at a time.  A combining
+ * mark is composed with the character before it (NFC for the Latin,
+ * Greek and Cyrillic scripts tag strings are written in), then the
+ * result is case folded.  Neither step makes the UTF-8 longer, so the
+ * output always fits in the input's length.  Invalid UTF-8 is copied
+ * through byte by byte.
+ *
+ * The tables below are generated from Unicode 14.0 data: simple case
+ * foldings (CaseFolding.txt, status C and S) that do not grow the
+ * encoding, and canonical pairs of a base letter and one combining
+ * diacritical mark (U+0300-U+036F).
+ */
+
+#include "normalize.h"
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define MAX_SUFFIXES    32
+#define DEFAULT_SUFFIXES "feat.,feat,ft.,featuring,remaster*"
+
+/* ── Unicode tables ───────────────────────────────────────────────────── */
+
+/*
+ * Code points `first`..`last` (every `stride`-th) fold to cp + delta.
+ */
+typedef struct {
+    uint16_t first;
+    uint16_t last;
+    int32_t  delta;
+    uint8_t  stride;
+} FoldRange;
+
+typedef struct {
+    uint16_t base;
+    uint16_t mark;
+    uint16_t composed;
+} Composition;
+
+static const FoldRange fold_ranges[] = {
+    { 0x00B5, 0x00B5,    775, 1 }, { 0x00C0, 0x00D6,     32, 1 },
+    { 0x00D8, 0x00DE,     32, 1 }, { 0x0100, 0x012E,      1, 2 },
+    { 0x0132, 0x0136,      1, 2 }, { 0x0139, 0x0147,      1, 2 },
+    { 0x014A, 0x0176,      1, 2 }, { 0x0178, 0x0178,   -121, 1 },
+    { 0x0179, 0x017D,      1, 2 }, { 0x017F, 0x017F,   -268, 1 },
+    { 0x0181, 0x0181,    210, 1 }, { 0x0182, 0x0184,      1, 2 },
+    { 0x0186, 0x0186,    206, 1 }, { 0x0187, 0x0187,      1, 1 },
+    { 0x0189, 0x018A,    205, 1 }, { 0x018B, 0x018B,      1, 1 },
+    { 0x018E, 0x018E,     79, 1 }, { 0x018F, 0x018F,    202, 1 },
+    { 0x0190, 0x0190,    203, 1 }, { 0x0191, 0x0191,      1, 1 },
+    { 0x0193, 0x0193,    205, 1 }, { 0x0194, 0x0194,    207, 1 },
+    { 0x0196, 0x0196,    211, 1 }, { 0x0197, 0x0197,    209, 1 },
+    { 0x0198, 0x0198,      1, 1 }, { 0x019C, 0x019C,    211, 1 },
+    { 0x019D, 0x019D,    213, 1 }, { 0x019F, 0x019F,    214, 1 },
+    { 0x01A0, 0x01A4,      1, 2 }, { 0x01A6, 0x01A6,    218, 1 },
+    { 0x01A7, 0x01A7,      1, 1 }, { 0x01A9, 0x01A9,    218, 1 },
+    { 0x01AC, 0x01AC,      1, 1 }, { 0x01AE, 0x01AE,    218, 1 },
+    { 0x01AF, 0x01AF,      1, 1 }, { 0x01B1, 0x01B2,    217, 1 },
+    { 0x01B3, 0x01B5,      1, 2 }, { 0x01B7, 0x01B7,    219, 1 },
+    { 0x01B8, 0x01B8,      1, 1 }, { 0x01BC, 0x01BC,      1, 1 },
+    { 0x01C4, 0x01C4,      2, 1 }, { 0x01C5, 0x01C5,      1, 1 },
+    { 0x01C7, 0x01C7,      2, 1 }, { 0x01C8, 0x01C8,      1, 1 },
+    { 0x01CA, 0x01CA,      2, 1 }, { 0x01CB, 0x01DB,      1, 2 },
+    { 0x01DE, 0x01EE,      1, 2 }, { 0x01F1, 0x01F1,      2, 1 },
+    { 0x01F2, 0x01F4,      1, 2 }, { 0x01F6, 0x01F6,    -97, 1 },
+    { 0x01F7, 0x01F7,    -56, 1 }, { 0x01F8, 0x021E,      1, 2 },
+    { 0x0220, 0x0220,   -130, 1 }, { 0x0222, 0x0232,      1, 2 },
+    { 0x023B, 0x023B,      1, 1 }, { 0x023D, 0x023D,   -163, 1 },
+    { 0x0241, 0x0241,      1, 1 }, { 0x0243, 0x0243,   -195, 1 },
+    { 0x0244, 0x0244,     69, 1 }, { 0x0245, 0x0245,     71, 1 },
+    { 0x0246, 0x024E,      1, 2 }, { 0x0345, 0x0345,    116, 1 },
+    { 0x0370, 0x0372,      1, 2 }, { 0x0376, 0x0376,      1, 1 },
+    { 0x037F, 0x037F,    116, 1 }, { 0x0386, 0x0386,     38, 1 },
+    { 0x0388, 0x038A,     37, 1 }, { 0x038C, 0x038C,     64, 1 },
+    { 0x038E, 0x038F,     63, 1 }, { 0x0391, 0x03A1,     32, 1 },
+    { 0x03A3, 0x03AB,     32, 1 }, { 0x03C2, 0x03C2,      1, 1 },
+    { 0x03CF, 0x03CF,      8, 1 }, { 0x03D0, 0x03D0,    -30, 1 },
+    { 0x03D1, 0x03D1,    -25, 1 }, { 0x03D5, 0x03D5,    -15, 1 },
+    { 0x03D6, 0x03D6,    -22, 1 }, { 0x03D8, 0x03EE,      1, 2 },
+    { 0x03F0, 0x03F0,    -54, 1 }, { 0x03F1, 0x03F1,    -48, 1 },
+    { 0x03F4, 0x03F4,    -60, 1 }, { 0x03F5, 0x03F5,    -64, 1 },
+    { 0x03F7, 0x03F7,      1, 1 }, { 0x03F9, 0x03F9,     -7, 1 },
+    { 0x03FA, 0x03FA,      1, 1 }, { 0x03FD, 0x03FF,   -130, 1 },
+    { 0x0400, 0x040F,     80, 1 }, { 0x0410, 0x042F,     32, 1 },
+    { 0x0460, 0x0480,      1, 2 }, { 0x048A, 0x04BE,      1, 2 },
+    { 0x04C0, 0x04C0,     15, 1 }, { 0x04C1, 0x04CD,      1, 2 },
+    { 0x04D0, 0x052E,      1, 2 }, { 0x0531, 0x0556,     48, 1 },
+    { 0x10A0, 0x10C5,   7264, 1 }, { 0x10C7, 0x10C7,   7264, 1 },
+    { 0x10CD, 0x10CD,   7264, 1 }, { 0x13F8, 0x13FD,     -8, 1 },
+    { 0x1C80, 0x1C80,  -6222, 1 }, { 0x1C81, 0x1C81,  -6221, 1 },
+    { 0x1C82, 0x1C82,  -6212, 1 }, { 0x1C83, 0x1C84,  -6210, 1 },
+    { 0x1C85, 0x1C85,  -6211, 1 }, { 0x1C86, 0x1C86,  -6204, 1 },
+    { 0x1C87, 0x1C87,  -6180, 1 }, { 0x1C88, 0x1C88,  35267, 1 },
+    { 0x1C90, 0x1CBA,  -3008, 1 }, { 0x1CBD, 0x1CBF,  -3008, 1 },
+    { 0x1E00, 0x1E94,      1, 2 }, { 0x1E9B, 0x1E9B,    -58, 1 },
+    { 0x1EA0, 0x1EFE,      1, 2 }, { 0x1F08, 0x1F0F,     -8, 1 },
+    { 0x1F18, 0x1F1D,     -8, 1 }, { 0x1F28, 0x1F2F,     -8, 1 },
+    { 0x1F38, 0x1F3F,     -8, 1 }, { 0x1F48, 0x1F4D,     -8, 1 },
+    { 0x1F59, 0x1F5F,     -8, 2 }, { 0x1F68, 0x1F6F,     -8, 1 },
+    { 0x1FB8, 0x1FB9,     -8, 1 }, { 0x1FBA, 0x1FBB,    -74, 1 },
+    { 0x1FBE, 0x1FBE,  -7173, 1 }, { 0x1FC8, 0x1FCB,    -86, 1 },
+    { 0x1FD8, 0x1FD9,     -8, 1 }, { 0x1FDA, 0x1FDB,   -100, 1 },
+    { 0x1FE8, 0x1FE9,     -8, 1 }, { 0x1FEA, 0x1FEB,   -112, 1 },
+    { 0x1FEC, 0x1FEC,     -7, 1 }, { 0x1FF8, 0x1FF9,   -128, 1 },
+    { 0x1FFA, 0x1FFB,   -126, 1 }, { 0x2126, 0x2126,  -7517, 1 },
+    { 0x212A, 0x212A,  -8383, 1 }, { 0x212B, 0x212B,  -8262, 1 },
+    { 0x2132, 0x2132,     28, 1 }, { 0x2160, 0x216F,     16, 1 },
+    { 0x2183, 0x2183,      1, 1 }, { 0x24B6, 0x24CF,     26, 1 },
+    { 0x2C00, 0x2C2F,     48, 1 }, { 0x2C60, 0x2C60,      1, 1 },
+    { 0x2C62, 0x2C62, -10743, 1 }, { 0x2C63, 0x2C63,  -3814, 1 },
+    { 0x2C64, 0x2C64, -10727, 1 }, { 0x2C67, 0x2C6B,      1, 2 },
+    { 0x2C6D, 0x2C6D, -10780, 1 }, { 0x2C6E, 0x2C6E, -10749, 1 },
+    { 0x2C6F, 0x2C6F, -10783, 1 }, { 0x2C70, 0x2C70, -10782, 1 },
+    { 0x2C72, 0x2C72,      1, 1 }, { 0x2C75, 0x2C75,      1, 1 },
+    { 0x2C7E, 0x2C7F, -10815, 1 }, { 0x2C80, 0x2CE2,      1, 2 },
+    { 0x2CEB, 0x2CED,      1, 2 }, { 0x2CF2, 0x2CF2,      1, 1 },
+    { 0xA640, 0xA66C,      1, 2 }, { 0xA680, 0xA69A,      1, 2 },
+    { 0xA722, 0xA72E,      1, 2 }, { 0xA732, 0xA76E,      1, 2 },
+    { 0xA779, 0xA77B,      1, 2 }, { 0xA77D, 0xA77D, -35332, 1 },
+    { 0xA77E, 0xA786,      1, 2 }, { 0xA78B, 0xA78B,      1, 1 },
+    { 0xA78D, 0xA78D, -42280, 1 }, { 0xA790, 0xA792,      1, 2 },
+    { 0xA796, 0xA7A8,      1, 2 }, { 0xA7AA, 0xA7AA, -42308, 1 },
+    { 0xA7AB, 0xA7AB, -42319, 1 }, { 0xA7AC, 0xA7AC, -42315, 1 },
+    { 0xA7AD, 0xA7AD, -42305, 1 }, { 0xA7AE, 0xA7AE, -42308, 1 },
+    { 0xA7B0, 0xA7B0, -42258, 1 }, { 0xA7B1, 0xA7B1, -42282, 1 },
+    { 0xA7B2, 0xA7B2, -42261, 1 }, { 0xA7B3, 0xA7B3,    928, 1 },
+    { 0xA7B4, 0xA7C2,      1, 2 }, { 0xA7C4, 0xA7C4,    -48, 1 },
+    { 0xA7C5, 0xA7C5, -42307, 1 }, { 0xA7C6, 0xA7C6, -35384, 1 },
+    { 0xA7C7, 0xA7C9,      1, 2 }, { 0xA7D0, 0xA7D0,      1, 1 },
+    { 0xA7D6, 0xA7D8,      1, 2 }, { 0xA7F5, 0xA7F5,      1, 1 },
+    { 0xAB70, 0xABBF, -38864, 1 }, { 0xFF21, 0xFF3A,     32, 1 },
+};
+
+static const Composition compositions[] = {
+    { 0x003C, 0x0338, 0x226E }, { 0x003D, 0x0338, 0x2260 }, { 0x003E, 0x0338, 0x226F },
+    { 0x0041, 0x0300, 0x00C0 }, { 0x0041, 0x0301, 0x00C1 }, { 0x0041, 0x0302, 0x00C2 },
+    { 0x0041, 0x0303, 0x00C3 }, { 0x0041, 0x0304, 0x0100 }, { 0x0041, 0x0306, 0x0102 },
+    { 0x0041, 0x0307, 0x0226 }, { 0x0041, 0x0308, 0x00C4 }, { 0x0041, 0x0309, 0x1EA2 },
+    { 0x0041, 0x030A, 0x00C5 }, { 0x0041, 0x030C, 0x01CD }, { 0x0041, 0x030F, 0x0200 },
+    { 0x0041, 0x0311, 0x0202 }, { 0x0041, 0x0323, 0x1EA0 }, { 0x0041, 0x0325, 0x1E00 },
+    { 0x0041, 0x0328, 0x0104 }, { 0x0042, 0x0307, 0x1E02 }, { 0x0042, 0x0323, 0x1E04 },
+    { 0x0042, 0x0331, 0x1E06 }, { 0x0043, 0x0301, 0x0106 }, { 0x0043, 0x0302, 0x0108 },
+    { 0x0043, 0x0307, 0x010A }, { 0x0043, 0x030C, 0x010C }, { 0x0043, 0x0327, 0x00C7 },
+    { 0x0044, 0x0307, 0x1E0A }, { 0x0044, 0x030C, 0x010E }, { 0x0044, 0x0323, 0x1E0C },
+    { 0x0044, 0x0327, 0x1E10 }, { 0x0044, 0x032D, 0x1E12 }, { 0x0044, 0x0331, 0x1E0E },
+    { 0x0045, 0x0300, 0x00C8 }, { 0x0045, 0x0301, 0x00C9 }, { 0x0045, 0x0302, 0x00CA },
+    { 0x0045, 0x0303, 0x1EBC }, { 0x0045, 0x0304, 0x0112 }, { 0x0045, 0x0306, 0x0114 },
+    { 0x0045, 0x0307, 0x0116 }, { 0x0045, 0x0308, 0x00CB }, { 0x0045, 0x0309, 0x1EBA },
+    { 0x0045, 0x030C, 0x011A }, { 0x0045, 0x030F, 0x0204 }, { 0x0045, 0x0311, 0x0206 },
+    { 0x0045, 0x0323, 0x1EB8 }, { 0x0045, 0x0327, 0x0228 }, { 0x0045, 0x0328, 0x0118 },
+    { 0x0045, 0x032D, 0x1E18 }, { 0x0045, 0x0330, 0x1E1A }, { 0x0046, 0x0307, 0x1E1E },
+    { 0x0047, 0x0301, 0x01F4 }, { 0x0047, 0x0302, 0x011C }, { 0x0047, 0x0304, 0x1E20 },
+    { 0x0047, 0x0306, 0x011E }, { 0x0047, 0x0307, 0x0120 }, { 0x0047, 0x030C, 0x01E6 },
+    { 0x0047, 0x0327, 0x0122 }, { 0x0048, 0x0302, 0x0124 }, { 0x0048, 0x0307, 0x1E22 },
+    { 0x0048, 0x0308, 0x1E26 }, { 0x0048, 0x030C, 0x021E }, { 0x0048, 0x0323, 0x1E24 },
+    { 0x0048, 0x0327, 0x1E28 }, { 0x0048, 0x032E, 0x1E2A }, { 0x0049, 0x0300, 0x00CC },
+    { 0x0049, 0x0301, 0x00CD }, { 0x0049, 0x0302, 0x00CE }, { 0x0049, 0x0303, 0x0128 },
+    { 0x0049, 0x0304, 0x012A }, { 0x0049, 0x0306, 0x012C }, { 0x0049, 0x0307, 0x0130 },
+    { 0x0049, 0x0308, 0x00CF }, { 0x0049, 0x0309, 0x1EC8 }, { 0x0049, 0x030C, 0x01CF },
+    { 0x0049, 0x030F, 0x0208 }, { 0x0049, 0x0311, 0x020A }, { 0x0049, 0x0323, 0x1ECA },
+    { 0x0049, 0x0328, 0x012E }, { 0x0049, 0x0330, 0x1E2C }, { 0x004A, 0x0302, 0x0134 },
+    { 0x004B, 0x0301, 0x1E30 }, { 0x004B, 0x030C, 0x01E8 }, { 0x004B, 0x0323, 0x1E32 },
+    { 0x004B, 0x0327, 0x0136 }, { 0x004B, 0x0331, 0x1E34 }, { 0x004C, 0x0301, 0x0139 },
+    { 0x004C, 0x030C, 0x013D }, { 0x004C, 0x0323, 0x1E36 }, { 0x004C, 0x0327, 0x013B },
+    { 0x004C, 0x032D, 0x1E3C }, { 0x004C, 0x0331, 0x1E3A }, { 0x004D, 0x0301, 0x1E3E },
+    { 0x004D, 0x0307, 0x1E40 }, { 0x004D, 0x0323, 0x1E42 }, { 0x004E, 0x0300, 0x01F8 },
+    { 0x004E, 0x0301, 0x0143 }, { 0x004E, 0x0303, 0x00D1 }, { 0x004E, 0x0307, 0x1E44 },
+    { 0x004E, 0x030C, 0x0147 }, { 0x004E, 0x0323, 0x1E46 }, { 0x004E, 0x0327, 0x0145 },
+    { 0x004E, 0x032D, 0x1E4A }, { 0x004E, 0x0331, 0x1E48 }, { 0x004F, 0x0300, 0x00D2 },
+    { 0x004F, 0x0301, 0x00D3 }, { 0x004F, 0x0302, 0x00D4 }, { 0x004F, 0x0303, 0x00D5 },
+    { 0x004F, 0x0304, 0x014C }, { 0x004F, 0x0306, 0x014E }, { 0x004F, 0x0307, 0x022E },
+    { 0x004F, 0x0308, 0x00D6 }, { 0x004F, 0x0309, 0x1ECE }, { 0x004F, 0x030B, 0x0150 },
+    { 0x004F, 0x030C, 0x01D1 }, { 0x004F, 0x030F, 0x020C }, { 0x004F, 0x0311, 0x020E },
+    { 0x004F, 0x031B, 0x01A0 }, { 0x004F, 0x0323, 0x1ECC }, { 0x004F, 0x0328, 0x01EA },
+    { 0x0050, 0x0301, 0x1E54 }, { 0x0050, 0x0307, 0x1E56 }, { 0x0052, 0x0301, 0x0154 },
+    { 0x0052, 0x0307, 0x1E58 }, { 0x0052, 0x030C, 0x0158 }, { 0x0052, 0x030F, 0x0210 },
+    { 0x0052, 0x0311, 0x0212 }, { 0x0052, 0x0323, 0x1E5A }, { 0x0052, 0x0327, 0x0156 },
+    { 0x0052, 0x0331, 0x1E5E }, { 0x0053, 0x0301, 0x015A }, { 0x0053, 0x0302, 0x015C },
+    { 0x0053, 0x0307, 0x1E60 }, { 0x0053, 0x030C, 0x0160 }, { 0x0053, 0x0323, 0x1E62 },
+    { 0x0053, 0x0326, 0x0218 }, { 0x0053, 0x0327, 0x015E }, { 0x0054, 0x0307, 0x1E6A },
+    { 0x0054, 0x030C, 0x0164 }, { 0x0054, 0x0323, 0x1E6C }, { 0x0054, 0x0326, 0x021A },
+    { 0x0054, 0x0327, 0x0162 }, { 0x0054, 0x032D, 0x1E70 }, { 0x0054, 0x0331, 0x1E6E },
+    { 0x0055, 0x0300, 0x00D9 }, { 0x0055, 0x0301, 0x00DA }, { 0x0055, 0x0302, 0x00DB },
+    { 0x0055, 0x0303, 0x0168 }, { 0x0055, 0x0304, 0x016A }, { 0x0055, 0x0306, 0x016C },
+    { 0x0055, 0x0308, 0x00DC }, { 0x0055, 0x0309, 0x1EE6 }, { 0x0055, 0x030A, 0x016E },
+    { 0x0055, 0x030B, 0x0170 }, { 0x0055, 0x030C, 0x01D3 }, { 0x0055, 0x030F, 0x0214 },
+    { 0x0055, 0x0311, 0x0216 }, { 0x0055, 0x031B, 0x01AF }, { 0x0055, 0x0323, 0x1EE4 },
+    { 0x0055, 0x0324, 0x1E72 }, { 0x0055, 0x0328, 0x0172 }, { 0x0055, 0x032D, 0x1E76 },
+    { 0x0055, 0x0330, 0x1E74 }, { 0x0056, 0x0303, 0x1E7C }, { 0x0056, 0x0323, 0x1E7E },
+    { 0x0057, 0x0300, 0x1E80 }, { 0x0057, 0x0301, 0x1E82 }, { 0x0057, 0x0302, 0x0174 },
+    { 0x0057, 0x0307, 0x1E86 }, { 0x0057, 0x0308, 0x1E84 }, { 0x0057, 0x0323, 0x1E88 },
+    { 0x0058, 0x0307, 0x1E8A }, { 0x0058, 0x0308, 0x1E8C }, { 0x0059, 0x0300, 0x1EF2 },
+    { 0x0059, 0x0301, 0x00DD }, { 0x0059, 0x0302, 0x0176 }, { 0x0059, 0x0303, 0x1EF8 },
+    { 0x0059, 0x0304, 0x0232 }, { 0x0059, 0x0307, 0x1E8E }, { 0x0059, 0x0308, 0x0178 },
+    { 0x0059, 0x0309, 0x1EF6 }, { 0x0059, 0x0323, 0x1EF4 }, { 0x005A, 0x0301, 0x0179 },
+    { 0x005A, 0x0302, 0x1E90 }, { 0x005A, 0x0307, 0x017B }, { 0x005A, 0x030C, 0x017D },
+    { 0x005A, 0x0323, 0x1E92 }, { 0x005A, 0x0331, 0x1E94 }, { 0x0061, 0x0300, 0x00E0 },
+    { 0x0061, 0x0301, 0x00E1 }, { 0x0061, 0x0302, 0x00E2 }, { 0x0061, 0x0303, 0x00E3 },
+    { 0x0061, 0x0304, 0x0101 }, { 0x0061, 0x0306, 0x0103 }, { 0x0061, 0x0307, 0x0227 },
+    { 0x0061, 0x0308, 0x00E4 }, { 0x0061, 0x0309, 0x1EA3 }, { 0x0061, 0x030A, 0x00E5 },
+    { 0x0061, 0x030C, 0x01CE }, { 0x0061, 0x030F, 0x0201 }, { 0x0061, 0x0311, 0x0203 },
+    { 0x0061, 0x0323, 0x1EA1 }, { 0x0061, 0x0325, 0x1E01 }, { 0x0061, 0x0328, 0x0105 },
+    { 0x0062, 0x0307, 0x1E03 }, { 0x0062, 0x0323, 0x1E05 }, { 0x0062, 0x0331, 0x1E07 },
+    { 0x0063, 0x0301, 0x0107 }, { 0x0063, 0x0302, 0x0109 }, { 0x0063, 0x0307, 0x010B },
+    { 0x0063, 0x030C, 0x010D }, { 0x0063, 0x0327, 0x00E7 }, { 0x0064, 0x0307, 0x1E0B },
+    { 0x0064, 0x030C, 0x010F }, { 0x0064, 0x0323, 0x1E0D }, { 0x0064, 0x0327, 0x1E11 },
+    { 0x0064, 0x032D, 0x1E13 }, { 0x0064, 0x0331, 0x1E0F }, { 0x0065, 0x0300, 0x00E8 },
+    { 0x0065, 0x0301, 0x00E9 }, { 0x0065, 0x0302, 0x00EA }, { 0x0065, 0x0303, 0x1EBD },
+    { 0x0065, 0x0304, 0x0113 }, { 0x0065, 0x0306, 0x0115 }, { 0x0065, 0x0307, 0x0117 },
+    { 0x0065, 0x0308, 0x00EB }, { 0x0065, 0x0309, 0x1EBB }, { 0x0065, 0x030C, 0x011B },
+    { 0x0065, 0x030F, 0x0205 }, { 0x0065, 0x0311, 0x0207 }, { 0x0065, 0x0323, 0x1EB9 },
+    { 0x0065, 0x0327, 0x0229 }, { 0x0065, 0x0328, 0x0119 }, { 0x0065, 0x032D, 0x1E19 },
+    { 0x0065, 0x0330, 0x1E1B }, { 0x0066, 0x0307, 0x1E1F }, { 0x0067, 0x0301, 0x01F5 },
+    { 0x0067, 0x0302, 0x011D }, { 0x0067, 0x0304, 0x1E21 }, { 0x0067, 0x0306, 0x011F },
+    { 0x0067, 0x0307, 0x0121 }, { 0x0067, 0x030C, 0x01E7 }, { 0x0067, 0x0327, 0x0123 },
+    { 0x0068, 0x0302, 0x0125 }, { 0x0068, 0x0307, 0x1E23 }, { 0x0068, 0x0308, 0x1E27 },
+    { 0x0068, 0x030C, 0x021F }, { 0x0068, 0x0323, 0x1E25 }, { 0x0068, 0x0327, 0x1E29 },
+    { 0x0068, 0x032E, 0x1E2B }, { 0x0068, 0x0331, 0x1E96 }, { 0x0069, 0x0300, 0x00EC },
+    { 0x0069, 0x0301, 0x00ED }, { 0x0069, 0x0302, 0x00EE }, { 0x0069, 0x0303, 0x0129 },
+    { 0x0069, 0x0304, 0x012B }, { 0x0069, 0x0306, 0x012D }, { 0x0069, 0x0308, 0x00EF },
+    { 0x0069, 0x0309, 0x1EC9 }, { 0x0069, 0x030C, 0x01D0 }, { 0x0069, 0x030F, 0x0209 },
+    { 0x0069, 0x0311, 0x020B }, { 0x0069, 0x0323, 0x1ECB }, { 0x0069, 0x0328, 0x012F },
+    { 0x0069, 0x0330, 0x1E2D }, { 0x006A, 0x0302, 0x0135 }, { 0x006A, 0x030C, 0x01F0 },
+    { 0x006B, 0x0301, 0x1E31 }, { 0x006B, 0x030C, 0x01E9 }, { 0x006B, 0x0323, 0x1E33 },
+    { 0x006B, 0x0327, 0x0137 }, { 0x006B, 0x0331, 0x1E35 }, { 0x006C, 0x0301, 0x013A },
+    { 0x006C, 0x030C, 0x013E }, { 0x006C, 0x0323, 0x1E37 }, { 0x006C, 0x0327, 0x013C },
+    { 0x006C, 0x032D, 0x1E3D }, { 0x006C, 0x0331, 0x1E3B }, { 0x006D, 0x0301, 0x1E3F },
+    { 0x006D, 0x0307, 0x1E41 }, { 0x006D, 0x0323, 0x1E43 }, { 0x006E, 0x0300, 0x01F9 },
+    { 0x006E, 0x0301, 0x0144 }, { 0x006E, 0x0303, 0x00F1 }, { 0x006E, 0x0307, 0x1E45 },
+    { 0x006E, 0x030C, 0x0148 }, { 0x006E, 0x0323, 0x1E47 }, { 0x006E, 0x0327, 0x0146 },
+    { 0x006E, 0x032D, 0x1E4B }, { 0x006E, 0x0331, 0x1E49 }, { 0x006F, 0x0300, 0x00F2 },
+    { 0x006F, 0x0301, 0x00F3 }, { 0x006F, 0x0302, 0x00F4 }, { 0x006F, 0x0303, 0x00F5 },
+    { 0x006F, 0x0304, 0x014D }, { 0x006F, 0x0306, 0x014F }, { 0x006F, 0x0307, 0x022F },
+    { 0x006F, 0x0308, 0x00F6 }, { 0x006F, 0x0309, 0x1ECF }, { 0x006F, 0x030B, 0x0151 },
+    { 0x006F, 0x030C, 0x01D2 }, { 0x006F, 0x030F, 0x020D }, { 0x006F, 0x0311, 0x020F },
+    { 0x006F, 0x031B, 0x01A1 }, { 0x006F, 0x0323, 0x1ECD }, { 0x006F, 0x0328, 0x01EB },
+    { 0x0070, 0x0301, 0x1E55 }, { 0x0070, 0x0307, 0x1E57 }, { 0x0072, 0x0301, 0x0155 },
+    { 0x0072, 0x0307, 0x1E59 }, { 0x0072, 0x030C, 0x0159 }, { 0x0072, 0x030F, 0x0211 },
+    { 0x0072, 0x0311, 0x0213 }, { 0x0072, 0x0323, 0x1E5B }, { 0x0072, 0x0327, 0x0157 },
+    { 0x0072, 0x0331, 0x1E5F }, { 0x0073, 0x0301, 0x015B }, { 0x0073, 0x0302, 0x015D },
+    { 0x0073, 0x0307, 0x1E61 }, { 0x0073, 0x030C, 0x0161 }, { 0x0073, 0x0323, 0x1E63 },
+    { 0x0073, 0x0326, 0x0219 }, { 0x0073, 0x0327, 0x015F }, { 0x0074, 0x0307, 0x1E6B },
+    { 0x0074, 0x0308, 0x1E97 }, { 0x0074, 0x030C, 0x0165 }, { 0x0074, 0x0323, 0x1E6D },
+    { 0x0074, 0x0326, 0x021B }, { 0x0074, 0x0327, 0x0163 }, { 0x0074, 0x032D, 0x1E71 },
+    { 0x0074, 0x0331, 0x1E6F }, { 0x0075, 0x0300, 0x00F9 }, { 0x0075, 0x0301, 0x00FA },
+    { 0x0075, 0x0302, 0x00FB }, { 0x0075, 0x0303, 0x0169 }, { 0x0075, 0x0304, 0x016B },
+    { 0x0075, 0x0306, 0x016D }, { 0x0075, 0x0308, 0x00FC }, { 0x0075, 0x0309, 0x1EE7 },
+    { 0x0075, 0x030A, 0x016F }, { 0x0075, 0x030B, 0x0171 }, { 0x0075, 0x030C, 0x01D4 },
+    { 0x0075, 0x030F, 0x0215 }, { 0x0075, 0x0311, 0x0217 }, { 0x0075, 0x031B, 0x01B0 },
+    { 0x0075, 0x0323, 0x1EE5 }, { 0x0075, 0x0324, 0x1E73 }, { 0x0075, 0x0328, 0x0173 },
+    { 0x0075, 0x032D, 0x1E77 }, { 0x0075, 0x0330, 0x1E75 }, { 0x0076, 0x0303, 0x1E7D },
+    { 0x0076, 0x0323, 0x1E7F }, { 0x0077, 0x0300, 0x1E81 }, { 0x0077, 0x0301, 0x1E83 },
+    { 0x0077, 0x0302, 0x0175 }, { 0x0077, 0x0307, 0x1E87 }, { 0x0077, 0x0308, 0x1E85 },
+    { 0x0077, 0x030A, 0x1E98 }, { 0x0077, 0x0323, 0x1E89 }, { 0x0078, 0x0307, 0x1E8B },
+    { 0x0078, 0x0308, 0x1E8D }, { 0x0079, 0x0300, 0x1EF3 }, { 0x0079, 0x0301, 0x00FD },
+    { 0x0079, 0x0302, 0x0177 }, { 0x0079, 0x0303, 0x1EF9 }, { 0x0079, 0x0304, 0x0233 },
+    { 0x0079, 0x0307, 0x1E8F }, { 0x0079, 0x0308, 0x00FF }, { 0x0079, 0x0309, 0x1EF7 },
+    { 0x0079, 0x030A, 0x1E99 }, { 0x0079, 0x0323, 0x1EF5 }, { 0x007A, 0x0301, 0x017A },
+    { 0x007A, 0x0302, 0x1E91 }, { 0x007A, 0x0307, 0x017C }, { 0x007A, 0x030C, 0x017E },
+    { 0x007A, 0x0323, 0x1E93 }, { 0x007A, 0x0331, 0x1E95 }, { 0x00A8, 0x0300, 0x1FED },
+    { 0x00A8, 0x0301, 0x0385 }, { 0x00A8, 0x0342, 0x1FC1 }, { 0x00C2, 0x0300, 0x1EA6 },
+    { 0x00C2, 0x0301, 0x1EA4 }, { 0x00C2, 0x0303, 0x1EAA }, { 0x00C2, 0x0309, 0x1EA8 },
+    { 0x00C4, 0x0304, 0x01DE }, { 0x00C5, 0x0301, 0x01FA }, { 0x00C6, 0x0301, 0x01FC },
+    { 0x00C6, 0x0304, 0x01E2 }, { 0x00C7, 0x0301, 0x1E08 }, { 0x00CA, 0x0300, 0x1EC0 },
+    { 0x00CA, 0x0301, 0x1EBE }, { 0x00CA, 0x0303, 0x1EC4 }, { 0x00CA, 0x0309, 0x1EC2 },
+    { 0x00CF, 0x0301, 0x1E2E }, { 0x00D4, 0x0300, 0x1ED2 }, { 0x00D4, 0x0301, 0x1ED0 },
+    { 0x00D4, 0x0303, 0x1ED6 }, { 0x00D4, 0x0309, 0x1ED4 }, { 0x00D5, 0x0301, 0x1E4C },
+    { 0x00D5, 0x0304, 0x022C }, { 0x00D5, 0x0308, 0x1E4E }, { 0x00D6, 0x0304, 0x022A },
+    { 0x00D8, 0x0301, 0x01FE }, { 0x00DC, 0x0300, 0x01DB }, { 0x00DC, 0x0301, 0x01D7 },
+    { 0x00DC, 0x0304, 0x01D5 }, { 0x00DC, 0x030C, 0x01D9 }, { 0x00E2, 0x0300, 0x1EA7 },
+    { 0x00E2, 0x0301, 0x1EA5 }, { 0x00E2, 0x0303, 0x1EAB }, { 0x00E2, 0x0309, 0x1EA9 },
+    { 0x00E4, 0x0304, 0x01DF }, { 0x00E5, 0x0301, 0x01FB }, { 0x00E6, 0x0301, 0x01FD },
+    { 0x00E6, 0x0304, 0x01E3 }, { 0x00E7, 0x0301, 0x1E09 }, { 0x00EA, 0x0300, 0x1EC1 },
+    { 0x00EA, 0x0301, 0x1EBF }, { 0x00EA, 0x0303, 0x1EC5 }, { 0x00EA, 0x0309, 0x1EC3 },
+    { 0x00EF, 0x0301, 0x1E2F }, { 0x00F4, 0x0300, 0x1ED3 }, { 0x00F4, 0x0301, 0x1ED1 },
+    { 0x00F4, 0x0303, 0x1ED7 }, { 0x00F4, 0x0309, 0x1ED5 }, { 0x00F5, 0x0301, 0x1E4D },
+    { 0x00F5, 0x0304, 0x022D }, { 0x00F5, 0x0308, 0x1E4F }, { 0x00F6, 0x0304, 0x022B },
+    { 0x00F8, 0x0301, 0x01FF }, { 0x00FC, 0x0300, 0x01DC }, { 0x00FC, 0x0301, 0x01D8 },
+    { 0x00FC, 0x0304, 0x01D6 }, { 0x00FC, 0x030C, 0x01DA }, { 0x0102, 0x0300, 0x1EB0 },
+    { 0x0102, 0x0301, 0x1EAE }, { 0x0102, 0x0303, 0x1EB4 }, { 0x0102, 0x0309, 0x1EB2 },
+    { 0x0103, 0x0300, 0x1EB1 }, { 0x0103, 0x0301, 0x1EAF }, { 0x0103, 0x0303, 0x1EB5 },
+    { 0x0103, 0x0309, 0x1EB3 }, { 0x0112, 0x0300, 0x1E14 }, { 0x0112, 0x0301, 0x1E16 },
+    { 0x0113, 0x0300, 0x1E15 }, { 0x0113, 0x0301, 0x1E17 }, { 0x014C, 0x0300, 0x1E50 },
+    { 0x014C, 0x0301, 0x1E52 }, { 0x014D, 0x0300, 0x1E51 }, { 0x014D, 0x0301, 0x1E53 },
+    { 0x015A, 0x0307, 0x1E64 }, { 0x015B, 0x0307, 0x1E65 }, { 0x0160, 0x0307, 0x1E66 },
+    { 0x0161, 0x0307, 0x1E67 }, { 0x0168, 0x0301, 0x1E78 }, { 0x0169, 0x0301, 0x1E79 },
+    { 0x016A, 0x0308, 0x1E7A }, { 0x016B, 0x0308, 0x1E7B }, { 0x017F, 0x0307, 0x1E9B },
+    { 0x01A0, 0x0300, 0x1EDC }, { 0x01A0, 0x0301, 0x1EDA }, { 0x01A0, 0x0303, 0x1EE0 },
+    { 0x01A0, 0x0309, 0x1EDE }, { 0x01A0, 0x0323, 0x1EE2 }, { 0x01A1, 0x0300, 0x1EDD },
+    { 0x01A1, 0x0301, 0x1EDB }, { 0x01A1, 0x0303, 0x1EE1 }, { 0x01A1, 0x0309, 0x1EDF },
+    { 0x01A1, 0x0323, 0x1EE3 }, { 0x01AF, 0x0300, 0x1EEA }, { 0x01AF, 0x0301, 0x1EE8 },
+    { 0x01AF, 0x0303, 0x1EEE }, { 0x01AF, 0x0309, 0x1EEC }, { 0x01AF, 0x0323, 0x1EF0 },
+    { 0x01B0, 0x0300, 0x1EEB }, { 0x01B0, 0x0301, 0x1EE9 }, { 0x01B0, 0x0303, 0x1EEF },
+    { 0x01B0, 0x0309, 0x1EED }, { 0x01B0, 0x0323, 0x1EF1 }, { 0x01B7, 0x030C, 0x01EE },
+    { 0x01EA, 0x0304, 0x01EC }, { 0x01EB, 0x0304, 0x01ED }, { 0x0226, 0x0304, 0x01E0 },
+    { 0x0227, 0x0304, 0x01E1 }, { 0x0228, 0x0306, 0x1E1C }, { 0x0229, 0x0306, 0x1E1D },
+    { 0x022E, 0x0304, 0x0230 }, { 0x022F, 0x0304, 0x0231 }, { 0x0391, 0x0300, 0x1FBA },
+    { 0x0391, 0x0301, 0x0386 }, { 0x0391, 0x0304, 0x1FB9 }, { 0x0391, 0x0306, 0x1FB8 },
+    { 0x0391, 0x0313, 0x1F08 }, { 0x0391, 0x0314, 0x1F09 }, { 0x0391, 0x0345, 0x1FBC },
+    { 0x0395, 0x0300, 0x1FC8 }, { 0x0395, 0x0301, 0x0388 }, { 0x0395, 0x0313, 0x1F18 },
+    { 0x0395, 0x0314, 0x1F19 }, { 0x0397, 0x0300, 0x1FCA }, { 0x0397, 0x0301, 0x0389 },
+    { 0x0397, 0x0313, 0x1F28 }, { 0x0397, 0x0314, 0x1F29 }, { 0x0397, 0x0345, 0x1FCC },
+    { 0x0399, 0x0300, 0x1FDA }, { 0x0399, 0x0301, 0x038A }, { 0x0399, 0x0304, 0x1FD9 },
+    { 0x0399, 0x0306, 0x1FD8 }, { 0x0399, 0x0308, 0x03AA }, { 0x0399, 0x0313, 0x1F38 },
+    { 0x0399, 0x0314, 0x1F39 }, { 0x039F, 0x0300, 0x1FF8 }, { 0x039F, 0x0301, 0x038C },
+    { 0x039F, 0x0313, 0x1F48 }, { 0x039F, 0x0314, 0x1F49 }, { 0x03A1, 0x0314, 0x1FEC },
+    { 0x03A5, 0x0300, 0x1FEA }, { 0x03A5, 0x0301, 0x038E }, { 0x03A5, 0x0304, 0x1FE9 },
+    { 0x03A5, 0x0306, 0x1FE8 }, { 0x03A5, 0x0308, 0x03AB }, { 0x03A5, 0x0314, 0x1F59 },
+    { 0x03A9, 0x0300, 0x1FFA }, { 0x03A9, 0x0301, 0x038F }, { 0x03A9, 0x0313, 0x1F68 },
+    { 0x03A9, 0x0314, 0x1F69 }, { 0x03A9, 0x0345, 0x1FFC }, { 0x03AC, 0x0345, 0x1FB4 },
+    { 0x03AE, 0x0345, 0x1FC4 }, { 0x03B1, 0x0300, 0x1F70 }, { 0x03B1, 0x0301, 0x03AC },
+    { 0x03B1, 0x0304, 0x1FB1 }, { 0x03B1, 0x0306, 0x1FB0 }, { 0x03B1, 0x0313, 0x1F00 },
+    { 0x03B1, 0x0314, 0x1F01 }, { 0x03B1, 0x0342, 0x1FB6 }, { 0x03B1, 0x0345, 0x1FB3 },
+    { 0x03B5, 0x0300, 0x1F72 }, { 0x03B5, 0x0301, 0x03AD }, { 0x03B5, 0x0313, 0x1F10 },
+    { 0x03B5, 0x0314, 0x1F11 }, { 0x03B7, 0x0300, 0x1F74 }, { 0x03B7, 0x0301, 0x03AE },
+    { 0x03B7, 0x0313, 0x1F20 }, { 0x03B7, 0x0314, 0x1F21 }, { 0x03B7, 0x0342, 0x1FC6 },
+    { 0x03B7, 0x0345, 0x1FC3 }, { 0x03B9, 0x0300, 0x1F76 }, { 0x03B9, 0x0301, 0x03AF },
+    { 0x03B9, 0x0304, 0x1FD1 }, { 0x03B9, 0x0306, 0x1FD0 }, { 0x03B9, 0x0308, 0x03CA },
+    { 0x03B9, 0x0313, 0x1F30 }, { 0x03B9, 0x0314, 0x1F31 }, { 0x03B9, 0x0342, 0x1FD6 },
+    { 0x03BF, 0x0300, 0x1F78 }, { 0x03BF, 0x0301, 0x03CC }, { 0x03BF, 0x0313, 0x1F40 },
+    { 0x03BF, 0x0314, 0x1F41 }, { 0x03C1, 0x0313, 0x1FE4 }, { 0x03C1, 0x0314, 0x1FE5 },
+    { 0x03C5, 0x0300, 0x1F7A }, { 0x03C5, 0x0301, 0x03CD }, { 0x03C5, 0x0304, 0x1FE1 },
+    { 0x03C5, 0x0306, 0x1FE0 }, { 0x03C5, 0x0308, 0x03CB }, { 0x03C5, 0x0313, 0x1F50 },
+    { 0x03C5, 0x0314, 0x1F51 }, { 0x03C5, 0x0342, 0x1FE6 }, { 0x03C9, 0x0300, 0x1F7C },
+    { 0x03C9, 0x0301, 0x03CE }, { 0x03C9, 0x0313, 0x1F60 }, { 0x03C9, 0x0314, 0x1F61 },
+    { 0x03C9, 0x0342, 0x1FF6 }, { 0x03C9, 0x0345, 0x1FF3 }, { 0x03CA, 0x0300, 0x1FD2 },
+    { 0x03CA, 0x0301, 0x0390 }, { 0x03CA, 0x0342, 0x1FD7 }, { 0x03CB, 0x0300, 0x1FE2 },
+    { 0x03CB, 0x0301, 0x03B0 }, { 0x03CB, 0x0342, 0x1FE7 }, { 0x03CE, 0x0345, 0x1FF4 },
+    { 0x03D2, 0x0301, 0x03D3 }, { 0x03D2, 0x0308, 0x03D4 }, { 0x0406, 0x0308, 0x0407 },
+    { 0x0410, 0x0306, 0x04D0 }, { 0x0410, 0x0308, 0x04D2 }, { 0x0413, 0x0301, 0x0403 },
+    { 0x0415, 0x0300, 0x0400 }, { 0x0415, 0x0306, 0x04D6 }, { 0x0415, 0x0308, 0x0401 },
+    { 0x0416, 0x0306, 0x04C1 }, { 0x0416, 0x0308, 0x04DC }, { 0x0417, 0x0308, 0x04DE },
+    { 0x0418, 0x0300, 0x040D }, { 0x0418, 0x0304, 0x04E2 }, { 0x0418, 0x0306, 0x0419 },
+    { 0x0418, 0x0308, 0x04E4 }, { 0x041A, 0x0301, 0x040C }, { 0x041E, 0x0308, 0x04E6 },
+    { 0x0423, 0x0304, 0x04EE }, { 0x0423, 0x0306, 0x040E }, { 0x0423, 0x0308, 0x04F0 },
+    { 0x0423, 0x030B, 0x04F2 }, { 0x0427, 0x0308, 0x04F4 }, { 0x042B, 0x0308, 0x04F8 },
+    { 0x042D, 0x0308, 0x04EC }, { 0x0430, 0x0306, 0x04D1 }, { 0x0430, 0x0308, 0x04D3 },
+    { 0x0433, 0x0301, 0x0453 }, { 0x0435, 0x0300, 0x0450 }, { 0x0435, 0x0306, 0x04D7 },
+    { 0x0435, 0x0308, 0x0451 }, { 0x0436, 0x0306, 0x04C2 }, { 0x0436, 0x0308, 0x04DD },
+    { 0x0437, 0x0308, 0x04DF }, { 0x0438, 0x0300, 0x045D }, { 0x0438, 0x0304, 0x04E3 },
+    { 0x0438, 0x0306, 0x0439 }, { 0x0438, 0x0308, 0x04E5 }, { 0x043A, 0x0301, 0x045C },
+    { 0x043E, 0x0308, 0x04E7 }, { 0x0443, 0x0304, 0x04EF }, { 0x0443, 0x0306, 0x045E },
+    { 0x0443, 0x0308, 0x04F1 }, { 0x0443, 0x030B, 0x04F3 }, { 0x0447, 0x0308, 0x04F5 },
+    { 0x044B, 0x0308, 0x04F9 }, { 0x044D, 0x0308, 0x04ED }, { 0x0456, 0x0308, 0x0457 },
+    { 0x0474, 0x030F, 0x0476 }, { 0x0475, 0x030F, 0x0477 }, { 0x04D8, 0x0308, 0x04DA },
+    { 0x04D9, 0x0308, 0x04DB }, { 0x04E8, 0x0308, 0x04EA }, { 0x04E9, 0x0308, 0x04EB },
+    { 0x1E36, 0x0304, 0x1E38 }, { 0x1E37, 0x0304, 0x1E39 }, { 0x1E5A, 0x0304, 0x1E5C },
+    { 0x1E5B, 0x0304, 0x1E5D }, { 0x1E62, 0x0307, 0x1E68 }, { 0x1E63, 0x0307, 0x1E69 },
+    { 0x1EA0, 0x0302, 0x1EAC }, { 0x1EA0, 0x0306, 0x1EB6 }, { 0x1EA1, 0x0302, 0x1EAD },
+    { 0x1EA1, 0x0306, 0x1EB7 }, { 0x1EB8, 0x0302, 0x1EC6 }, { 0x1EB9, 0x0302, 0x1EC7 },
+    { 0x1ECC, 0x0302, 0x1ED8 }, { 0x1ECD, 0x0302, 0x1ED9 }, { 0x1F00, 0x0300, 0x1F02 },
+    { 0x1F00, 0x0301, 0x1F04 }, { 0x1F00, 0x0342, 0x1F06 }, { 0x1F00, 0x0345, 0x1F80 },
+    { 0x1F01, 0x0300, 0x1F03 }, { 0x1F01, 0x0301, 0x1F05 }, { 0x1F01, 0x0342, 0x1F07 },
+    { 0x1F01, 0x0345, 0x1F81 }, { 0x1F02, 0x0345, 0x1F82 }, { 0x1F03, 0x0345, 0x1F83 },
+    { 0x1F04, 0x0345, 0x1F84 }, { 0x1F05, 0x0345, 0x1F85 }, { 0x1F06, 0x0345, 0x1F86 },
+    { 0x1F07, 0x0345, 0x1F87 }, { 0x1F08, 0x0300, 0x1F0A }, { 0x1F08, 0x0301, 0x1F0C },
+    { 0x1F08, 0x0342, 0x1F0E }, { 0x1F08, 0x0345, 0x1F88 }, { 0x1F09, 0x0300, 0x1F0B },
+    { 0x1F09, 0x0301, 0x1F0D }, { 0x1F09, 0x0342, 0x1F0F }, { 0x1F09, 0x0345, 0x1F89 },
+    { 0x1F0A, 0x0345, 0x1F8A }, { 0x1F0B, 0x0345, 0x1F8B }, { 0x1F0C, 0x0345, 0x1F8C },
+    { 0x1F0D, 0x0345, 0x1F8D }, { 0x1F0E, 0x0345, 0x1F8E }, { 0x1F0F, 0x0345, 0x1F8F },
+    { 0x1F10, 0x0300, 0x1F12 }, { 0x1F10, 0x0301, 0x1F14 }, { 0x1F11, 0x0300, 0x1F13 },
+    { 0x1F11, 0x0301, 0x1F15 }, { 0x1F18, 0x0300, 0x1F1A }, { 0x1F18, 0x0301, 0x1F1C },
+    { 0x1F19, 0x0300, 0x1F1B }, { 0x1F19, 0x0301, 0x1F1D }, { 0x1F20, 0x0300, 0x1F22 },
+    { 0x1F20, 0x0301, 0x1F24 }, { 0x1F20, 0x0342, 0x1F26 }, { 0x1F20, 0x0345, 0x1F90 },
+    { 0x1F21, 0x0300, 0x1F23 }, { 0x1F21, 0x0301, 0x1F25 }, { 0x1F21, 0x0342, 0x1F27 },
+    { 0x1F21, 0x0345, 0x1F91 }, { 0x1F22, 0x0345, 0x1F92 }, { 0x1F23, 0x0345, 0x1F93 },
+    { 0x1F24, 0x0345, 0x1F94 }, { 0x1F25, 0x0345, 0x1F95 }, { 0x1F26, 0x0345, 0x1F96 },
+    { 0x1F27, 0x0345, 0x1F97 }, { 0x1F28, 0x0300, 0x1F2A }, { 0x1F28, 0x0301, 0x1F2C },
+    { 0x1F28, 0x0342, 0x1F2E }, { 0x1F28, 0x0345, 0x1F98 }, { 0x1F29, 0x0300, 0x1F2B },
+    { 0x1F29, 0x0301, 0x1F2D }, { 0x1F29, 0x0342, 0x1F2F }, { 0x1F29, 0x0345, 0x1F99 },
+    { 0x1F2A, 0x0345, 0x1F9A }, { 0x1F2B, 0x0345, 0x1F9B }, { 0x1F2C, 0x0345, 0x1F9C },
+    { 0x1F2D, 0x0345, 0x1F9D }, { 0x1F2E, 0x0345, 0x1F9E }, { 0x1F2F, 0x0345, 0x1F9F },
+    { 0x1F30, 0x0300, 0x1F32 }, { 0x1F30, 0x0301, 0x1F34 }, { 0x1F30, 0x0342, 0x1F36 },
+    { 0x1F31, 0x0300, 0x1F33 }, { 0x1F31, 0x0301, 0x1F35 }, { 0x1F31, 0x0342, 0x1F37 },
+    { 0x1F38, 0x0300, 0x1F3A }, { 0x1F38, 0x0301, 0x1F3C }, { 0x1F38, 0x0342, 0x1F3E },
+    { 0x1F39, 0x0300, 0x1F3B }, { 0x1F39, 0x0301, 0x1F3D }, { 0x1F39, 0x0342, 0x1F3F },
+    { 0x1F40, 0x0300, 0x1F42 }, { 0x1F40, 0x0301, 0x1F44 }, { 0x1F41, 0x0300, 0x1F43 },
+    { 0x1F41, 0x0301, 0x1F45 }, { 0x1F48, 0x0300, 0x1F4A }, { 0x1F48, 0x0301, 0x1F4C },
+    { 0x1F49, 0x0300, 0x1F4B }, { 0x1F49, 0x0301, 0x1F4D }, { 0x1F50, 0x0300, 0x1F52 },
+    { 0x1F50, 0x0301, 0x1F54 }, { 0x1F50, 0x0342, 0x1F56 }, { 0x1F51, 0x0300, 0x1F53 },
+    { 0x1F51, 0x0301, 0x1F55 }, { 0x1F51, 0x0342, 0x1F57 }, { 0x1F59, 0x0300, 0x1F5B },
+    { 0x1F59, 0x0301, 0x1F5D }, { 0x1F59, 0x0342, 0x1F5F }, { 0x1F60, 0x0300, 0x1F62 },
+    { 0x1F60, 0x0301, 0x1F64 }, { 0x1F60, 0x0342, 0x1F66 }, { 0x1F60, 0x0345, 0x1FA0 },
+    { 0x1F61, 0x0300, 0x1F63 }, { 0x1F61, 0x0301, 0x1F65 }, { 0x1F61, 0x0342, 0x1F67 },
+    { 0x1F61, 0x0345, 0x1FA1 }, { 0x1F62, 0x0345, 0x1FA2 }, { 0x1F63, 0x0345, 0x1FA3 },
+    { 0x1F64, 0x0345, 0x1FA4 }, { 0x1F65, 0x0345, 0x1FA5 }, { 0x1F66, 0x0345, 0x1FA6 },
+    { 0x1F67, 0x0345, 0x1FA7 }, { 0x1F68, 0x0300, 0x1F6A }, { 0x1F68, 0x0301, 0x1F6C },
+    { 0x1F68, 0x0342, 0x1F6E }, { 0x1F68, 0x0345, 0x1FA8 }, { 0x1F69, 0x0300, 0x1F6B },
+    { 0x1F69, 0x0301, 0x1F6D }, { 0x1F69, 0x0342, 0x1F6F }, { 0x1F69, 0x0345, 0x1FA9 },
+    { 0x1F6A, 0x0345, 0x1FAA }, { 0x1F6B, 0x0345, 0x1FAB }, { 0x1F6C, 0x0345, 0x1FAC },
+    { 0x1F6D, 0x0345, 0x1FAD }, { 0x1F6E, 0x0345, 0x1FAE }, { 0x1F6F, 0x0345, 0x1FAF },
+    { 0x1F70, 0x0345, 0x1FB2 }, { 0x1F74, 0x0345, 0x1FC2 }, { 0x1F7C, 0x0345, 0x1FF2 },
+    { 0x1FB6, 0x0345, 0x1FB7 }, { 0x1FBF, 0x0300, 0x1FCD }, { 0x1FBF, 0x0301, 0x1FCE },
+    { 0x1FBF, 0x0342, 0x1FCF }, { 0x1FC6, 0x0345, 0x1FC7 }, { 0x1FF6, 0x0345, 0x1FF7 },
+    { 0x1FFE, 0x0300, 0x1FDD }, { 0x1FFE, 0x0301, 0x1FDE }, { 0x1FFE, 0x0342, 0x1FDF },
+};
+
+/* ── Suffixes ─────────────────────────────────────────────────────────── */
+
+/*
+ * Words that start a strippable suffix, normalized.  A trailing '*'
+ * makes the word a prefix ("remaster*" also matches "remastered").
+ */
+static char  *suffix_words[MAX_SUFFIXES];
+static size_t suffix_lens[MAX_SUFFIXES];
+static int    suffix_prefix[MAX_SUFFIXES];
+static unsigned char suffix_first[256];  /* first bytes of the words */
+static int    num_suffixes = -1;    /* -1: defaults not loaded yet */
+static pthread_once_t suffix_once = PTHREAD_ONCE_INIT;
+
+/* ── Code points ──────────────────────────────────────────────────────── */
+
+/*
+ * Decode one UTF-8 sequence at `s`.  Returns its length, or 0 if it
+ * is not valid UTF-8 (the byte is then copied as is).
+ */
+static int utf8_decode(const unsigned char *s, uint32_t *cp)
+{
+    if (s[0] < 0xC2 || s[0] > 0xF4) return 0;
+    if (s[0] < 0xE0) {
+        if ((s[1] & 0xC0) != 0x80) return 0;
+        *cp = ((uint32_t)(s[0] & 0x1F) << 6) | (s[1] & 0x3F);
+        return 2;
+    }
+    if ((s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80) return 0;
+    if (s[0] < 0xF0) {
+        *cp = ((uint32_t)(s[0] & 0x0F) << 12) |
+              ((uint32_t)(s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+        return *cp >= 0x800 ? 3 : 0;
+    }
+    if ((s[3] & 0xC0) != 0x80) return 0;
+    *cp = ((uint32_t)(s[0] & 0x07) << 18) | ((uint32_t)(s[1] & 0x3F) << 12) |
+          ((uint32_t)(s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+    return (*cp >= 0x10000 && *cp <= 0x10FFFF) ? 4 : 0;
+}
+
+static size_t utf8_encode(uint32_t cp, char *out)
+{
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+static int is_space(uint32_t cp)
+{
+    return cp == 0x20 || (cp >= 0x09 && cp <= 0x0D) || cp == 0xA0 ||
+           cp == 0x1680 || (cp >= 0x2000 && cp <= 0x200A) ||
+           cp == 0x2028 || cp == 0x2029 || cp == 0x202F ||
+           cp == 0x205F || cp == 0x3000;
+}
+
+/* Zero-width characters that only affect rendering */
+static int is_ignorable(uint32_t cp)
+{
+    return (cp >= 0x200B && cp <= 0x200D) || cp == 0x2060 || cp == 0xFEFF;
+}
+
+static uint32_t fold(uint32_t cp)
+{
+    if (cp < 0x80) {
+        return (cp >= 'A' && cp <= 'Z') ? cp + 32 : cp;
+    }
+    if (cp > 0xFFFF) return cp;
+
+    size_t lo = 0, hi = sizeof(fold_ranges) / sizeof(fold_ranges[0]);
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        const FoldRange *r = &fold_ranges[mid];
+        if (cp < r->first) {
+            hi = mid;
+        } else if (cp > r->last) {
+            lo = mid + 1;
+        } else {
+            return (cp - r->first) % r->stride == 0
+                ? (uint32_t)((int32_t)cp + r->delta) : cp;
+        }
+    }
+    return cp;
+}
+
+static uint32_t compose(uint32_t base, uint32_t mark)
+{
+    if (base > 0xFFFF) return 0;
+
+    size_t lo = 0, hi = sizeof(compositions) / sizeof(compositions[0]);
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        const Composition *c = &compositions[mid];
+        if (base < c->base || (base == c->base && mark < c->mark)) {
+            hi = mid;
+        } else if (base > c->base || mark > c->mark) {
+            lo = mid + 1;
+        } else {
+            return c->composed;
+        }
+    }
+    return 0;
+}
+
+/*
+ * The normalization pass; `fold` selects case folding.
+ */
+static size_t normalize_into(const char *s, char *out, int fold_case)
+{
+    const unsigned char *p = (const unsigned char *)s;
+    size_t n = 0;
+    size_t last_pos = 0;      /* where the last code point was written */
+    uint32_t last = 0;        /* that code point, 0 if none to compose */
+    int space = 0;
+
+    while (*p) {
+        /* ASCII fast path */
+        if (*p < 0x80) {
+            unsigned char c = *p++;
+            if (c == ' ' || (c >= '\t' && c <= '\r')) {
+                space = 1;
+                continue;
+            }
+            if (space && n > 0) out[n++] = ' ';
+            space = 0;
+            last_pos = n;
+            last = (fold_case && c >= 'A' && c <= 'Z') ? (uint32_t)c + 32 : c;
+            out[n++] = (char)last;
+            continue;
+        }
+
+        uint32_t cp;
+        int len = utf8_decode(p, &cp);
+        if (len == 0) {
+            if (space && n > 0) out[n++] = ' ';
+            space = 0;
+            out[n++] = (char)*p++;
+            last = 0;
+            continue;
+        }
+        p += len;
+
+        if (is_ignorable(cp)) continue;
+        if (is_space(cp)) {
+            space = 1;
+            continue;
+        }
+
+        /* A mark right after its base letter merges into it */
+        if (cp >= 0x300 && cp <= 0x36F && last && !space) {
+            uint32_t c = compose(last, cp);
+            if (c) {
+                last = fold_case ? fold(c) : c;
+                n = last_pos + utf8_encode(last, out + last_pos);
+                continue;
+            }
+        }
+
+        if (space && n > 0) out[n++] = ' ';
+        space = 0;
+        last_pos = n;
+
+        /* Foldings that change length: sharp s, dotted capital I */
+        if (!fold_case) {
+            last = cp;
+            n += utf8_encode(cp, out + n);
+            continue;
+        }
+        if (cp == 0xDF || cp == 0x1E9E) {
+            out[n++] = 's';
+            out[n++] = 's';
+            last = 0;
+            continue;
+        }
+        if (cp == 0x130) {
+            out[n++] = 'i';
+            last = 'i';
+            continue;
+        }
+
+        last = fold(cp);
+        n += utf8_encode(last, out + n);
+    }
+    out[n] = '\0';
+    return n;
+}
+
+/* ── Public API ────────────────────────────────────────────────────────── */
+
+size_t normalize_buf(const char *s, char *out)
+{
+    return normalize_into(s, out, 1);
+}
+
+char *normalize_name(const char *s)
+{
+    char *out = malloc(strlen(s) + 1);
+    if (!out) return NULL;
+
+    normalize_into(s, out, 1);
+    return out;
+}
+
+size_t normalize_query_buf(const char *s, char *out)
+{
+    return normalize_into(s, out, 0);
+}
+
+int normalize_set_suffixes(const char *list)
+{
+    for (int i = 0; i < num_suffixes; i++) {
+        free(suffix_words[i]);
+    }
+    num_suffixes = 0;
+    memset(suffix_first, 0, sizeof(suffix_first));
+    if (!list) return 0;
+
+    const char *p = list;
+    while (*p && num_suffixes < MAX_SUFFIXES) {
+        size_t len = strcspn(p, ",");
+        char *word = malloc(len + 1);
+        if (!word) return -1;
+
+        memcpy(word, p, len);
+        word[len] = '\0';
+        size_t wlen = normalize_buf(word, word);
+        int prefix = wlen > 0 && word[wlen - 1] == '*';
+        if (prefix) word[--wlen] = '\0';
+
+        if (wlen > 0) {
+            suffix_words[num_suffixes]  = word;
+            suffix_lens[num_suffixes]   = wlen;
+            suffix_prefix[num_suffixes] = prefix;
+            suffix_first[(unsigned char)word[0]] = 1;
+            suffix_first[(unsigned char)toupper((unsigned char)word[0])] = 1;
+            num_suffixes++;
+        } else {
+            free(word);
+        }
+        p += len;
+        if (*p == ',') p++;
+    }
+    return 0;
+}
+
+static void load_default_suffixes(void)
+{
+    if (num_suffixes < 0) normalize_set_suffixes(DEFAULT_SUFFIXES);
+}
+
+/*
+ * Whether a suffix word starts at s[i].
+ */
+static int suffix_at(const char *s, size_t i)
+{
+    for (int k = 0; k < num_suffixes; k++) {
+        size_t len = suffix_lens[k];
+        if (strncasecmp(s + i, suffix_words[k], len) != 0) continue;
+
+        char next = s[i + len];
+        if (suffix_prefix[k] || next == '\0' || next == ' ' ||
+            next == ')' || next == ']') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * End of the bracketed group opening at s[open]: just past its
+ * matching ')' or ']', or `len` if it is never closed.
+ */
+static size_t group_end(const char *s, size_t open, size_t len)
+{
+    int depth = 0;
+    for (size_t j = open; j < len; j++) {
+        if (s[j] == '(' || s[j] == '[') {
+            depth++;
+        } else if ((s[j] == ')' || s[j] == ']') && --depth == 0) {
+            return j + 1;
+        }
+    }
+    return len;
+}
+
+size_t normalize_strip(char *s, size_t len)
+{
+    pthread_once(&suffix_once, load_default_suffixes);
+
+    /* The first word is never a suffix: "Featuring Nobody" stays */
+    for (size_t i = 1; i < len; i++) {
+        if (!suffix_first[(unsigned char)s[i]]) continue;
+        char prev = s[i - 1];
+        if (prev != ' ' && prev != '(' && prev != '[') continue;
+        if (!suffix_at(s, i)) continue;
+
+        /* Cut at the bracket or " - " the suffix is part of */
+        size_t cut = i, end = len;
+        for (size_t j = i; j > 0; j--) {
+            if (s[j - 1] == '(' || s[j - 1] == '[') {
+                cut = j - 1;
+                end = group_end(s, cut, len);
+                break;
+            }
+            if (s[j - 1] == ')' || s[j - 1] == ']') break;
+            if (j >= 3 && s[j - 1] == ' ' && s[j - 2] == '-' &&
+                s[j - 3] == ' ') {
+                cut = j - 3;
+                break;
+            }
+        }
+
+        /* A bracketed group goes alone when text follows it */
+        while (end < len && s[end] == ' ') end++;
+        if (end < len) {
+            while (cut > 0 && s[cut - 1] == ' ') cut--;
+            if (cut == 0) {
+                i = end - 1;   /* a leading group stays */
+                continue;
+            }
+            s[cut] = ' ';
+            memmove(s + cut + 1, s + end, len - end + 1);
+            len -= end - cut - 1;
+            i = cut;
+            continue;
+        }
+
+        while (cut > 0 && (s[cut - 1] == ' ' || s[cut - 1] == '-' ||
+                           s[cut - 1] == ',' || s[cut - 1] == '&')) {
+            cut--;
+        }
+        if (cut == 0) return len;
+        s[cut] = '\0';
+        return cut;
+    }
+    return len;
+}
+
+char *normalize_stripped(const char *s)
+{
+    char *out = normalize_name(s);
+    if (out) normalize_strip(out, strlen(out));
+    return out;
+}
@@ -0,0 +1,409 @@
+/*
+ * offline.c — Offline LRCLIB index: builder and mmap lookups
+ *
+ * File layout:
+ *
+ *   header    magic, entry count, table offset
+ *   data      NUL-terminated strings: normalized keys and albums,
+ *             lyrics, appended in dump order
+ *   table     fixed-size entries sorted by (key hash, lyrics quality)
+ *
+ * The builder streams the dump straight into the data section and only
+ * keeps the fixed-size entries in memory, so the whole dump never has
+ * to fit in RAM.  A lookup binary-searches the table for the key hash
+ * and walks the run of equal hashes, verifying the key string.
+ */
+
+#include "offline.h"
+#include "normalize.h"
+#include "cJSON.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define OFFLINE_MAGIC         "S2MOFFL2"   /* 2: Unicode-aware keys */
+#define OFFLINE_DURATION_TOL  2        /* seconds, as the /get endpoint */
+#define OFFLINE_NONE          UINT64_MAX
+
+/* ── On-disk format ───────────────────────────────────────────────────── */
+
+typedef struct {
+    char     magic[8];
+    uint64_t count;
+    uint64_t table_off;
+    uint64_t reserved;
+} OfflineHeader;
+
+typedef struct {
+    uint64_t hash;          /* FNV-1a of the normalized "artist\ntitle" */
+    uint64_t key_off;       /* normalized "artist\ntitle" */
+    uint64_t album_off;     /* normalized album ("" if none) */
+    uint64_t synced_off;    /* OFFLINE_NONE if absent */
+    uint64_t plain_off;     /* OFFLINE_NONE if absent */
+    uint32_t duration;      /* seconds, 0 if unknown */
+    uint8_t  instrumental;
+    uint8_t  quality;       /* 2 = synced, 1 = plain, 0 = neither */
+    uint8_t  reserved[2];
+} OfflineEntry;
+
+struct OfflineIndex {
+    const char         *map;
+    size_t              map_size;
+    const OfflineEntry *table;
+    size_t              count;
+};
+
+/* ── Keys ─────────────────────────────────────────────────────────────── */
+
+/*
+ * Build the normalized "artist\ntitle" key.  Returns a heap string.
+ */
+static char *make_key(const char *artist, const char *title)
+{
+    char *a = normalize_name(artist);
+    char *t = normalize_name(title);
+    char *key = NULL;
+
+    if (a && t) {
+        size_t len = strlen(a) + strlen(t) + 2;
+        key = malloc(len);
+        if (key) snprintf(key, len, "%s\n%s", a, t);
+    }
+    free(a);
+    free(t);
+    return key;
+}
+
+static uint64_t hash_key(const char *s)
+{
+    uint64_t h = 1469598103934665603ULL;   /* FNV-1a */
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/* ── Builder ──────────────────────────────────────────────────────────── */
+
+typedef struct {
+    FILE     *fp;
+    uint64_t  off;
+    int       failed;
+} DataWriter;
+
+/*
+ * Append a NUL-terminated string to the data section and return its
+ * offset.
+ */
+static uint64_t put_string(DataWriter *w, const char *s)
+{
+    size_t len = strlen(s) + 1;
+    uint64_t off = w->off;
+    if (fwrite(s, 1, len, w->fp) != len) w->failed = 1;
+    w->off += len;
+    return off;
+}
+
+/*
+ * Get a string field by its API name or, failing that, its dump
+ * column name.
+ */
+static const char *field_string(const cJSON *obj, const char *api,
+                                const char *column)
+{
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(obj, api);
+    if (!cJSON_IsString(item)) {
+        item = cJSON_GetObjectItemCaseSensitive(obj, column);
+    }
+    return cJSON_IsString(item) ? item->valuestring : NULL;
+}
+
+static int by_hash_quality(const void *a, const void *b)
+{
+    const OfflineEntry *x = a, *y = b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return (int)y->quality - (int)x->quality;
+}
+
+/*
+ * Parse one dump line and append its strings.  Returns 1 if an entry
+ * was produced, 0 if the line was skipped.
+ */
+static int index_line(DataWriter *w, const char *line, OfflineEntry *e)
+{
+    cJSON *obj = cJSON_Parse(line);
+    if (!cJSON_IsObject(obj)) {
+        cJSON_Delete(obj);
+        return 0;
+    }
+
+    const char *title  = field_string(obj, "trackName", "name");
+    const char *artist = field_string(obj, "artistName", "artist_name");
+    const char *album  = field_string(obj, "albumName", "album_name");
+    const char *synced = field_string(obj, "syncedLyrics", "synced_lyrics");
+    const char *plain  = field_string(obj, "plainLyrics", "plain_lyrics");
+    const cJSON *dur   = cJSON_GetObjectItemCaseSensitive(obj, "duration");
+    const cJSON *inst  = cJSON_GetObjectItemCaseSensitive(obj, "instrumental");
+
+    int ok = 0;
+    char *key = (title && artist) ? make_key(artist, title) : NULL;
+    char *alb = normalize_name(album ? album : "");
+
+    if (key && alb) {
+        memset(e, 0, sizeof(*e));
+        e->hash         = hash_key(key);
+        e->key_off      = put_string(w, key);
+        e->album_off    = put_string(w, alb);
+        e->synced_off   = (synced && synced[0]) ? put_string(w, synced)
+                                                : OFFLINE_NONE;
+        e->plain_off    = (plain && plain[0]) ? put_string(w, plain)
+                                              : OFFLINE_NONE;
+        e->duration     = cJSON_IsNumber(dur) && dur->valuedouble > 0
+                        ? (uint32_t)(dur->valuedouble + 0.5) : 0;
+        /* The dump stores booleans as 0/1 integers */
+        e->instrumental = cJSON_IsTrue(inst) ||
+                          (cJSON_IsNumber(inst) && inst->valueint != 0);
+        e->quality      = e->synced_off != OFFLINE_NONE ? 2
+                        : e->plain_off  != OFFLINE_NONE ? 1 : 0;
+        ok = 1;
+    }
+
+    free(key);
+    free(alb);
+    cJSON_Delete(obj);
+    return ok;
+}
+
+long offline_build(const char *dump_path, const char *index_path)
+{
+    if (!dump_path || !index_path) return -1;
+
+    FILE *in = strcmp(dump_path, "-") == 0 ? stdin : fopen(dump_path, "r");
+    if (!in) {
+        fprintf(stderr, "error: cannot open dump '%s'\n", dump_path);
+        return -1;
+    }
+
+    size_t tmp_len = strlen(index_path) + 5;
+    char *tmp = malloc(tmp_len);
+    if (!tmp) {
+        if (in != stdin) fclose(in);
+        return -1;
+    }
+    snprintf(tmp, tmp_len, "%s.tmp", index_path);
+
+    DataWriter w = { fopen(tmp, "wb"), sizeof(OfflineHeader), 0 };
+    if (!w.fp) {
+        fprintf(stderr, "error: cannot create index '%s'\n", tmp);
+        if (in != stdin) fclose(in);
+        free(tmp);
+        return -1;
+    }
+
+    /* Header is rewritten once the table offset is known */
+    OfflineHeader header;
+    memset(&header, 0, sizeof(header));
+    if (fwrite(&header, sizeof(header), 1, w.fp) != 1) w.failed = 1;
+
+    OfflineEntry *entries = NULL;
+    size_t count = 0, cap = 0, skipped = 0;
+    char *line = NULL;
+    size_t line_cap = 0;
+
+    while (!w.failed && getline(&line, &line_cap, in) != -1) {
+        if (count == cap) {
+            size_t new_cap = cap ? cap * 2 : 4096;
+            OfflineEntry *grown = realloc(entries,
+                                          new_cap * sizeof(OfflineEntry));
+            if (!grown) {
+                w.failed = 1;
+                break;
+            }
+            entries = grown;
+            cap = new_cap;
+        }
+        if (index_line(&w, line, &entries[count])) {
+            count++;
+        } else if (line[0] != '\n' && line[0] != '\0') {
+            skipped++;
+        }
+    }
+    free(line);
+    if (in != stdin) fclose(in);
+
+    if (count > 0) {
+        qsort(entries, count, sizeof(OfflineEntry), by_hash_quality);
+    }
+
+    /* Table starts 8-byte aligned after the data */
+    static const char pad[8];
+    size_t pad_len = (size_t)((8 - w.off % 8) % 8);
+    if (fwrite(pad, 1, pad_len, w.fp) != pad_len) w.failed = 1;
+
+    memcpy(header.magic, OFFLINE_MAGIC, 8);
+    header.count     = count;
+    header.table_off = w.off + pad_len;
+
+    if (count > 0 &&
+        fwrite(entries, sizeof(OfflineEntry), count, w.fp) != count) {
+        w.failed = 1;
+    }
+    if (fseek(w.fp, 0, SEEK_SET) != 0 ||
+        fwrite(&header, sizeof(header), 1, w.fp) != 1) {
+        w.failed = 1;
+    }
+    free(entries);
+
+    int ok = !w.failed && fflush(w.fp) == 0 && fsync(fileno(w.fp)) == 0;
+    ok = (fclose(w.fp) == 0) && ok;
+    if (!ok || rename(tmp, index_path) != 0) {
+        fprintf(stderr, "error: failed to write index '%s'\n", index_path);
+        unlink(tmp);
+        free(tmp);
+        return -1;
+    }
+    free(tmp);
+
+    if (skipped > 0) {
+        fprintf(stderr, "warning: skipped %zu malformed dump line(s)\n",
+                skipped);
+    }
+    return (long)count;
+}
+
+/* ── Lookups ──────────────────────────────────────────────────────────── */
+
+OfflineIndex *offline_open(const char *path)
+{
+    if (!path) return NULL;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "error: cannot open offline index '%s'\n", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(OfflineHeader)) {
+        fprintf(stderr, "error: '%s' is not an offline index of this "
+                        "version (rebuild it with --build-index)\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "error: cannot map offline index '%s'\n", path);
+        return NULL;
+    }
+
+    OfflineHeader header;
+    memcpy(&header, map, sizeof(header));
+    if (memcmp(header.magic, OFFLINE_MAGIC, 8) != 0 ||
+        header.table_off < sizeof(header) || header.table_off % 8 != 0 ||
+        header.table_off > size ||
+        header.count > (size - header.table_off) / sizeof(OfflineEntry)) {
+        fprintf(stderr, "error: '%s' is not an offline index of this "
+                        "version (rebuild it with --build-index)\n", path);
+        munmap(map, size);
+        return NULL;
+    }
+
+    /* Lookups hit random pages; don't let readahead waste I/O */
+    posix_madvise(map, size, POSIX_MADV_RANDOM);
+
+    OfflineIndex *idx = calloc(1, sizeof(OfflineIndex));
+    if (!idx) {
+        munmap(map, size);
+        return NULL;
+    }
+    idx->map      = map;
+    idx->map_size = size;
+    idx->table    = (const OfflineEntry *)((const char *)map + header.table_off);
+    idx->count    = (size_t)header.count;
+    return idx;
+}
+
+/*
+ * String at `off` in the data section, or NULL if absent or out of
+ * bounds.  Strings are NUL-terminated before the table starts.
+ */
+static const char *data_string(const OfflineIndex *idx, uint64_t off)
+{
+    size_t limit = (size_t)((const char *)idx->table - idx->map);
+    if (off == OFFLINE_NONE || off < sizeof(OfflineHeader) || off >= limit) {
+        return NULL;
+    }
+    const char *s = idx->map + off;
+    return memchr(s, '\0', limit - (size_t)off) ? s : NULL;
+}
+
+int offline_find(const OfflineIndex *idx, const char *artist,
+                 const char *title, const char *album, double duration,
+                 OfflineMatch *out)
+{
+    if (!idx || !artist || !title) return 0;
+
+    char *key = make_key(artist, title);
+    char *alb = album ? normalize_name(album) : NULL;
+    if (!key || (album && !alb)) {
+        free(key);
+        free(alb);
+        return 0;
+    }
+    uint64_t h = hash_key(key);
+
+    /* Lower bound of the run of entries with this hash */
+    size_t lo = 0, hi = idx->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (idx->table[mid].hash < h) lo = mid + 1; else hi = mid;
+    }
+
+    /* Entries in a run are ordered best lyrics first */
+    int found = 0;
+    for (size_t i = lo; i < idx->count && idx->table[i].hash == h; i++) {
+        const OfflineEntry *e = &idx->table[i];
+
+        const char *k = data_string(idx, e->key_off);
+        if (!k || strcmp(k, key) != 0) continue;
+
+        if (alb) {
+            const char *a = data_string(idx, e->album_off);
+            if (!a || strcmp(a, alb) != 0) continue;
+        }
+        if (duration > 0.0 && e->duration > 0) {
+            double diff = duration - (double)e->duration;
+            if (diff < -OFFLINE_DURATION_TOL || diff > OFFLINE_DURATION_TOL) {
+                continue;
+            }
+        }
+
+        out->synced_lyrics = data_string(idx, e->synced_off);
+        out->plain_lyrics  = data_string(idx, e->plain_off);
+        out->instrumental  = e->instrumental;
+        found = 1;
+        break;
+    }
+
+    free(key);
+    free(alb);
+    return found;
+}
+
+void offline_close(OfflineIndex *idx)
+{
+    if (!idx) return;
+    munmap((void *)idx->map, idx->map_size);
+    free(idx);
+}
@@ -0,0 +1,224 @@
+/*
+ * ratelimit.c — Token bucket + AIMD concurrency limiter implementation
+ *
+ * The bucket holds up to one second's worth of tokens and refills
+ * continuously.  The concurrency window is a fractional value: each
+ * success adds 1/window (about +1 per window's worth of requests),
+ * each throttle halves it.  A throttle also pauses all new requests
+ * until Retry-After (or a short default) has passed.  The average gap
+ * between releases tells a caller facing a full window how long to
+ * wait for the next free slot.
+ */
+
+#include "ratelimit.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define RATE_INITIAL_WINDOW  4.0
+#define RATE_MIN_WINDOW      1.0
+#define RATE_DEFAULT_PAUSE   2     /* seconds, when Retry-After is absent */
+#define RATE_MAX_PAUSE       300   /* cap on Retry-After */
+#define RATE_SLOT_WAIT_MS    50    /* slot wait before any release is seen */
+#define RATE_MAX_SLOT_WAIT   1000  /* ms */
+
+struct RateLimiter {
+    pthread_mutex_t  lock;
+
+    double           rate;          /* tokens per second, 0 = unlimited */
+    double           tokens;
+    struct timespec  last_refill;
+
+    double           window;
+    double           max_window;
+    int              active;
+
+    struct timespec  paused_until;
+    long             throttled;
+
+    struct timespec  last_release;
+    double           release_gap_ms; /* moving average, 0 = no history */
+};
+
+/* ── Time helpers ─────────────────────────────────────────────────────── */
+
+static double elapsed_sec(const struct timespec *from, const struct timespec *to)
+{
+    return (double)(to->tv_sec - from->tv_sec) +
+           (double)(to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+static long ms_between(const struct timespec *from, const struct timespec *to)
+{
+    long ms = (long)(to->tv_sec - from->tv_sec) * 1000 +
+              (to->tv_nsec - from->tv_nsec) / 1000000;
+    return ms > 0 ? ms : 0;
+}
+
+/* Caller holds the lock. */
+static void refill(RateLimiter *rl, const struct timespec *now)
+{
+    if (rl->rate <= 0.0) return;
+
+    rl->tokens += elapsed_sec(&rl->last_refill, now) * rl->rate;
+    double burst = rl->rate < 1.0 ? 1.0 : rl->rate;
+    if (rl->tokens > burst) rl->tokens = burst;
+    rl->last_refill = *now;
+}
+
+/* ── Public API ───────────────────────────────────────────────────────── */
+
+RateLimiter *ratelimit_new(double rate, int max_window)
+{
+    RateLimiter *rl = calloc(1, sizeof(RateLimiter));
+    if (!rl) return NULL;
+
+    pthread_mutex_init(&rl->lock, NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &rl->last_refill);
+    rl->paused_until = rl->last_refill;
+    ratelimit_configure(rl, rate, max_window);
+    rl->tokens = rl->rate > 1.0 ? rl->rate : 1.0;
+    return rl;
+}
+
+void ratelimit_configure(RateLimiter *rl, double rate, int max_window)
+{
+    if (!rl) return;
+
+    pthread_mutex_lock(&rl->lock);
+    rl->rate       = rate > 0.0 ? rate : 0.0;
+    rl->max_window = max_window > 1 ? (double)max_window : RATE_MIN_WINDOW;
+    rl->window     = RATE_INITIAL_WINDOW < rl->max_window
+                   ? RATE_INITIAL_WINDOW : rl->max_window;
+    pthread_mutex_unlock(&rl->lock);
+}
+
+long ratelimit_try_acquire(RateLimiter *rl)
+{
+    if (!rl) return 0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&rl->lock);
+    long wait = 0;
+
+    if (elapsed_sec(&now, &rl->paused_until) > 0.0) {
+        wait = ms_between(&now, &rl->paused_until);
+        if (wait == 0) wait = 1;
+    } else if (rl->active >= (int)rl->window) {
+        wait = -1;
+    } else {
+        refill(rl, &now);
+        if (rl->rate > 0.0 && rl->tokens < 1.0) {
+            wait = (long)((1.0 - rl->tokens) / rl->rate * 1000.0) + 1;
+        } else {
+            if (rl->rate > 0.0) rl->tokens -= 1.0;
+            rl->active++;
+        }
+    }
+
+    pthread_mutex_unlock(&rl->lock);
+    return wait;
+}
+
+void ratelimit_release(RateLimiter *rl, RateSignal signal, long retry_after)
+{
+    if (!rl) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&rl->lock);
+    if (rl->active > 0) rl->active--;
+
+    /* Smooth the gap between releases (weight 1/8 for the newest) */
+    if (rl->last_release.tv_sec || rl->last_release.tv_nsec) {
+        double gap = elapsed_sec(&rl->last_release, &now) * 1000.0;
+        rl->release_gap_ms += rl->release_gap_ms > 0.0
+                            ? (gap - rl->release_gap_ms) / 8.0 : gap;
+    }
+    rl->last_release = now;
+
+    if (signal == RATE_OK) {
+        rl->window += 1.0 / rl->window;
+        if (rl->window > rl->max_window) rl->window = rl->max_window;
+    } else if (signal == RATE_THROTTLED) {
+        rl->throttled++;
+        rl->window /= 2.0;
+        if (rl->window < RATE_MIN_WINDOW) rl->window = RATE_MIN_WINDOW;
+
+        /* Drain the bucket and pause everyone until the server is ready */
+        rl->tokens = 0.0;
+        long pause = retry_after > 0 ? retry_after : RATE_DEFAULT_PAUSE;
+        if (pause > RATE_MAX_PAUSE) pause = RATE_MAX_PAUSE;
+
+        struct timespec until = now;
+        until.tv_sec += pause;
+        if (elapsed_sec(&rl->paused_until, &until) > 0.0) {
+            rl->paused_until = until;
+        }
+    }
+
+    pthread_mutex_unlock(&rl->lock);
+}
+
+long ratelimit_pause_ms(RateLimiter *rl)
+{
+    if (!rl) return 0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&rl->lock);
+    long ms = ms_between(&now, &rl->paused_until);
+    pthread_mutex_unlock(&rl->lock);
+    return ms;
+}
+
+long ratelimit_slot_wait_ms(RateLimiter *rl)
+{
+    if (!rl) return 0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&rl->lock);
+    long ms = RATE_SLOT_WAIT_MS;
+    if (rl->release_gap_ms > 0.0) {
+        /*
+         * The next release is due one average gap after the last one;
+         * once that is overdue, check again after another gap
+         */
+        double left = rl->release_gap_ms -
+                      elapsed_sec(&rl->last_release, &now) * 1000.0;
+        ms = (long)(left > 0.0 ? left : rl->release_gap_ms);
+    }
+    pthread_mutex_unlock(&rl->lock);
+
+    if (ms < 1) ms = 1;
+    if (ms > RATE_MAX_SLOT_WAIT) ms = RATE_MAX_SLOT_WAIT;
+    return ms;
+}
+
+RateStats ratelimit_stats(RateLimiter *rl)
+{
+    RateStats stats = {0};
+    if (!rl) return stats;
+
+    pthread_mutex_lock(&rl->lock);
+    stats.throttled  = rl->throttled;
+    stats.window     = (int)rl->window;
+    stats.max_window = (int)rl->max_window;
+    pthread_mutex_unlock(&rl->lock);
+    return stats;
+}
+
+void ratelimit_free(RateLimiter *rl)
+{
+    if (!rl) return;
+    pthread_mutex_destroy(&rl->lock);
+    free(rl);
+}
@@ -0,0 +1,193 @@
+/*
+ * shard.c — Library sharding implementation
+ *
+ * Albums are assigned by a 64-bit FNV-1a hash of their root-relative
+ * path, mixed with the splitmix64 finalizer so that paths differing
+ * only in their last characters still spread evenly, reduced modulo
+ * the shard count.  Summaries are small JSON objects.
+ */
+
+#include "shard.h"
+#include "cJSON.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SUMMARY_MAX_SIZE (64 * 1024)
+
+/* Counters stored in a summary, by their JSON name */
+static const struct {
+    const char *name;
+    size_t      offset;
+} summary_fields[] = {
+    { "synced",         offsetof(SyncResult, synced)         },
+    { "plain",          offsetof(SyncResult, plain)          },
+    { "skipped",        offsetof(SyncResult, skipped)        },
+    { "not_found",      offsetof(SyncResult, not_found)      },
+    { "errors",         offsetof(SyncResult, errors)         },
+    { "lookups_saved",  offsetof(SyncResult, lookups_saved)  },
+    { "unchanged",      offsetof(SyncResult, unchanged)      },
+    { "resumed",        offsetof(SyncResult, resumed)        },
+    { "interrupted",    offsetof(SyncResult, interrupted)    },
+    { "album_searches", offsetof(SyncResult, album_searches) },
+    { "album_matches",  offsetof(SyncResult, album_matches)  },
+};
+
+#define NUM_SUMMARY_FIELDS \
+    (sizeof(summary_fields) / sizeof(summary_fields[0]))
+
+/* ── Internal helpers ──────────────────────────────────────────────────── */
+
+static uint64_t hash_rel(const char *s)
+{
+    uint64_t h = 1469598103934665603ULL;   /* FNV-1a */
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ULL;
+    }
+
+    /* splitmix64 finalizer */
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+static int *field_ptr(SyncResult *r, size_t i)
+{
+    return (int *)((char *)r + summary_fields[i].offset);
+}
+
+static double number_field(const cJSON *obj, const char *key)
+{
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(obj, key);
+    return cJSON_IsNumber(item) ? item->valuedouble : 0.0;
+}
+
+/* ── Public API ────────────────────────────────────────────────────────── */
+
+int shard_parse(const char *spec, ShardSpec *out)
+{
+    if (!spec) return -1;
+
+    char *end;
+    long index = strtol(spec, &end, 10);
+    if (end == spec || *end != '/') return -1;
+
+    const char *count_str = end + 1;
+    long count = strtol(count_str, &end, 10);
+    if (end == count_str || *end != '\0') return -1;
+
+    if (count < 1 || count > 65536 || index < 1 || index > count) return -1;
+
+    out->index = (int)index;
+    out->count = (int)count;
+    return 0;
+}
+
+int shard_owns(const ShardSpec *s, const char *rel)
+{
+    if (!s || s->count <= 1) return 1;
+    return (int)(hash_rel(rel ? rel : "") % (uint64_t)s->count) ==
+           s->index - 1;
+}
+
+char *shard_path(const char *path, const ShardSpec *s)
+{
+    if (!path) return NULL;
+    if (!s || s->count <= 1) return strdup(path);
+
+    /* Insert before the extension, if the file name has one */
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    const char *ext = strrchr(base, '.');
+    if (!ext || ext == base) ext = path + strlen(path);
+
+    size_t len = strlen(path) + 48;
+    char *out = malloc(len);
+    if (!out) return NULL;
+    snprintf(out, len, "%.*s.shard-%d-of-%d%s", (int)(ext - path), path,
+             s->index, s->count, ext);
+    return out;
+}
+
+int shard_write_summary(const char *path, const ShardSummary *sum)
+{
+    size_t tmp_len = strlen(path) + 5;
+    char *tmp = malloc(tmp_len);
+    if (!tmp) return -1;
+    snprintf(tmp, tmp_len, "%s.tmp", path);
+
+    FILE *fp = fopen(tmp, "w");
+    if (!fp) {
+        fprintf(stderr, "error: cannot create summary '%s'\n", tmp);
+        free(tmp);
+        return -1;
+    }
+
+    SyncResult r = sum->result;
+    fprintf(fp, "{\n  \"shard\": %d,\n  \"shards\": %d,\n"
+                "  \"albums\": %ld,\n  \"seconds\": %.3f",
+            sum->shard.count > 1 ? sum->shard.index : 1,
+            sum->shard.count > 1 ? sum->shard.count : 1,
+            sum->albums, sum->seconds);
+    for (size_t i = 0; i < NUM_SUMMARY_FIELDS; i++) {
+        fprintf(fp, ",\n  \"%s\": %d", summary_fields[i].name,
+                *field_ptr(&r, i));
+    }
+    fprintf(fp, "\n}\n");
+
+    int ok = !ferror(fp);
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        fprintf(stderr, "error: cannot write summary '%s'\n", path);
+        unlink(tmp);
+        free(tmp);
+        return -1;
+    }
+    free(tmp);
+    return 0;
+}
+
+int shard_read_summary(const char *path, ShardSummary *out)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "error: cannot open summary '%s'\n", path);
+        return -1;
+    }
+
+    char *text = malloc(SUMMARY_MAX_SIZE + 1);
+    size_t len = text ? fread(text, 1, SUMMARY_MAX_SIZE, fp) : 0;
+    fclose(fp);
+    if (!text) return -1;
+    text[len] = '\0';
+
+    cJSON *obj = cJSON_Parse(text);
+    free(text);
+    if (!cJSON_IsObject(obj) ||
+        !cJSON_IsNumber(cJSON_GetObjectItemCaseSensitive(obj, "shards"))) {
+        fprintf(stderr, "error: '%s' is not a summary\n", path);
+        cJSON_Delete(obj);
+        return -1;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->shard.index = (int)number_field(obj, "shard");
+    out->shard.count = (int)number_field(obj, "shards");
+    out->albums      = (long)number_field(obj, "albums");
+    out->seconds     = number_field(obj, "seconds");
+    for (size_t i = 0; i < NUM_SUMMARY_FIELDS; i++) {
+        *field_ptr(&out->result, i) =
+            (int)number_field(obj, summary_fields[i].name);
+    }
+
+    cJSON_Delete(obj);
+    return 0;
+}
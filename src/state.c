@@ -0,0 +1,481 @@
+/*
+ * state.c — Persistent per-file state index implementation
+ *
+ * On-disk format: a 16-byte header followed by an append-only stream
+ * of variable-length records (fixed header + path, padded to 8 bytes).
+ * Each record carries a CRC-32, so a torn write from a crash is
+ * detected on the next open and the tail is truncated away.  A later
+ * record for the same path supersedes earlier ones; the file is
+ * compacted on close once superseded records dominate.
+ *
+ * The file is memory-mapped on open and indexed in an open-addressing
+ * hash table whose paths point straight into the mapping.
+ */
+
+#include "state.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define STATE_MAGIC        "S2MSTAT1"
+#define STATE_HEADER_SIZE  16
+#define STATE_MIN_SLOTS    1024
+#define STATE_COMPACT_MIN  1024
+
+/* ── On-disk record ───────────────────────────────────────────────────── */
+
+typedef struct {
+    uint32_t crc;        /* CRC-32 of the rest of the record incl. path */
+    uint16_t path_len;
+    uint8_t  outcome;
+    uint8_t  reserved;
+    uint64_t ino;
+    uint64_t size;
+    int64_t  mtime_ns;
+    int64_t  stamp;      /* seconds since epoch when recorded */
+} StateRecord;
+
+#define RECORD_PAD(n) (((n) + 7u) & ~(size_t)7u)
+
+/* ── In-memory index ──────────────────────────────────────────────────── */
+
+typedef struct {
+    uint64_t    hash;    /* 0 = empty slot */
+    const char *path;    /* into the mapping, or heap if `owned` */
+    uint16_t    path_len;
+    uint8_t     outcome;
+    uint8_t     owned;
+    uint64_t    ino;
+    uint64_t    size;
+    int64_t     mtime_ns;
+    int64_t     stamp;
+} StateEntry;
+
+struct StateIndex {
+    char            *path;
+    int              fd;
+    long             retry_secs;
+    void            *map;
+    size_t           map_size;
+    StateEntry      *slots;
+    size_t           cap;       /* power of two */
+    size_t           live;      /* distinct paths */
+    size_t           records;   /* records in the file */
+    pthread_mutex_t  mutex;
+};
+
+/* ── Internal helpers ─────────────────────────────────────────────────── */
+
+static uint64_t hash_path(const char *s, size_t len)
+{
+    uint64_t h = 1469598103934665603ULL;   /* FNV-1a */
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;
+}
+
+static int64_t stat_mtime_ns(const struct stat *st)
+{
+    return (int64_t)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+static uint32_t record_crc(const StateRecord *rec, const char *path)
+{
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef *)rec + sizeof(rec->crc),
+                (uInt)(sizeof(*rec) - sizeof(rec->crc)));
+    crc = crc32(crc, (const Bytef *)path, rec->path_len);
+    return (uint32_t)crc;
+}
+
+static StateEntry *find_slot(StateEntry *slots, size_t cap, uint64_t hash,
+                             const char *path, size_t len)
+{
+    size_t i = (size_t)hash & (cap - 1);
+    for (;;) {
+        StateEntry *e = &slots[i];
+        if (e->hash == 0) return e;
+        if (e->hash == hash && e->path_len == len &&
+            memcmp(e->path, path, len) == 0) {
+            return e;
+        }
+        i = (i + 1) & (cap - 1);
+    }
+}
+
+static int grow_table(StateIndex *idx)
+{
+    size_t new_cap = idx->cap ? idx->cap * 2 : STATE_MIN_SLOTS;
+    StateEntry *slots = calloc(new_cap, sizeof(StateEntry));
+    if (!slots) return -1;
+
+    for (size_t i = 0; i < idx->cap; i++) {
+        StateEntry *e = &idx->slots[i];
+        if (e->hash == 0) continue;
+        *find_slot(slots, new_cap, e->hash, e->path, e->path_len) = *e;
+    }
+
+    free(idx->slots);
+    idx->slots = slots;
+    idx->cap   = new_cap;
+    return 0;
+}
+
+/*
+ * Insert or replace the entry for `rec`.  `path` must outlive the entry
+ * unless `owned` is set, in which case the index takes ownership.
+ */
+static int upsert(StateIndex *idx, const StateRecord *rec,
+                  const char *path, int owned)
+{
+    if ((idx->live + 1) * 4 > idx->cap * 3 && grow_table(idx) != 0) {
+        return -1;
+    }
+
+    uint64_t h = hash_path(path, rec->path_len);
+    StateEntry *e = find_slot(idx->slots, idx->cap, h, path, rec->path_len);
+
+    if (e->hash == 0) {
+        idx->live++;
+    } else if (e->owned) {
+        free((char *)e->path);
+    }
+
+    e->hash     = h;
+    e->path     = path;
+    e->path_len = rec->path_len;
+    e->outcome  = rec->outcome;
+    e->owned    = (uint8_t)owned;
+    e->ino      = rec->ino;
+    e->size     = rec->size;
+    e->mtime_ns = rec->mtime_ns;
+    e->stamp    = rec->stamp;
+    return 0;
+}
+
+/*
+ * Walk the mapped file and index every valid record.  Returns the
+ * offset just past the last valid record.
+ */
+static size_t load_records(StateIndex *idx)
+{
+    const char *base = idx->map;
+    size_t off = STATE_HEADER_SIZE;
+
+    while (off + sizeof(StateRecord) <= idx->map_size) {
+        StateRecord rec;
+        memcpy(&rec, base + off, sizeof(rec));
+
+        size_t rec_len = RECORD_PAD(sizeof(rec) + rec.path_len);
+        if (rec.path_len == 0 || off + rec_len > idx->map_size) break;
+
+        const char *path = base + off + sizeof(rec);
+        if (record_crc(&rec, path) != rec.crc) break;
+
+        if (upsert(idx, &rec, path, 0) != 0) break;
+        idx->records++;
+        off += rec_len;
+    }
+    return off;
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p   += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/*
+ * Serialize one record (header + padded path) into `buf`.
+ * Returns the record length; `buf` must hold RECORD_PAD(40 + len) bytes.
+ */
+static size_t encode_record(char *buf, const StateEntry *e)
+{
+    StateRecord rec = {
+        .path_len = e->path_len,
+        .outcome  = e->outcome,
+        .ino      = e->ino,
+        .size     = e->size,
+        .mtime_ns = e->mtime_ns,
+        .stamp    = e->stamp
+    };
+    rec.crc = record_crc(&rec, e->path);
+
+    size_t rec_len = RECORD_PAD(sizeof(rec) + e->path_len);
+    memset(buf, 0, rec_len);
+    memcpy(buf, &rec, sizeof(rec));
+    memcpy(buf + sizeof(rec), e->path, e->path_len);
+    return rec_len;
+}
+
+static void write_header(char *buf)
+{
+    memset(buf, 0, STATE_HEADER_SIZE);
+    memcpy(buf, STATE_MAGIC, 8);
+}
+
+/*
+ * Rewrite the index with one record per live path, then atomically
+ * replace the old file.
+ */
+static void compact(StateIndex *idx)
+{
+    size_t tmp_len = strlen(idx->path) + 5;
+    char *tmp = malloc(tmp_len);
+    if (!tmp) return;
+    snprintf(tmp, tmp_len, "%s.tmp", idx->path);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        free(tmp);
+        return;
+    }
+
+    char header[STATE_HEADER_SIZE];
+    write_header(header);
+    int ok = (write_all(fd, header, sizeof(header)) == 0);
+
+    char *buf = malloc(RECORD_PAD(sizeof(StateRecord) + UINT16_MAX));
+    ok = ok && buf;
+    for (size_t i = 0; ok && i < idx->cap; i++) {
+        if (idx->slots[i].hash == 0) continue;
+        size_t n = encode_record(buf, &idx->slots[i]);
+        ok = (write_all(fd, buf, n) == 0);
+    }
+    free(buf);
+
+    ok = ok && fsync(fd) == 0;
+    close(fd);
+
+    if (!ok || rename(tmp, idx->path) != 0) {
+        unlink(tmp);
+    }
+    free(tmp);
+}
+
+/* ── Public API ───────────────────────────────────────────────────────── */
+
+StateIndex *state_open(const char *path, long retry_secs)
+{
+    if (!path) return NULL;
+
+    StateIndex *idx = calloc(1, sizeof(StateIndex));
+    if (!idx) return NULL;
+
+    pthread_mutex_init(&idx->mutex, NULL);
+    idx->path       = strdup(path);
+    idx->retry_secs = retry_secs;
+    idx->fd         = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (!idx->path || idx->fd < 0 || grow_table(idx) != 0) {
+        fprintf(stderr, "error: could not open state index '%s'\n", path);
+        state_close(idx);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(idx->fd, &st) != 0) {
+        state_close(idx);
+        return NULL;
+    }
+
+    if (st.st_size < STATE_HEADER_SIZE) {
+        /* New (or hopelessly truncated) index: start fresh */
+        char header[STATE_HEADER_SIZE];
+        write_header(header);
+        if (ftruncate(idx->fd, 0) != 0 ||
+            write_all(idx->fd, header, sizeof(header)) != 0) {
+            state_close(idx);
+            return NULL;
+        }
+        return idx;
+    }
+
+    idx->map_size = (size_t)st.st_size;
+    idx->map = mmap(NULL, idx->map_size, PROT_READ, MAP_PRIVATE, idx->fd, 0);
+    if (idx->map == MAP_FAILED) {
+        idx->map = NULL;
+        state_close(idx);
+        return NULL;
+    }
+
+    if (memcmp(idx->map, STATE_MAGIC, 8) != 0) {
+        fprintf(stderr, "error: '%s' is not a state index\n", path);
+        state_close(idx);
+        return NULL;
+    }
+
+    size_t valid = load_records(idx);
+    if (valid < idx->map_size) {
+        fprintf(stderr, "warning: state index '%s' has a torn tail, "
+                "truncating %zu byte(s)\n", path, idx->map_size - valid);
+        if (ftruncate(idx->fd, (off_t)valid) != 0) {
+            state_close(idx);
+            return NULL;
+        }
+    }
+
+    return idx;
+}
+
+/*
+ * Find the entry for `filepath` if the file, as `st` describes it, is
+ * unchanged since it was recorded.  Caller holds the mutex.  Returns
+ * NULL otherwise.
+ */
+static const StateEntry *unchanged_entry(StateIndex *idx,
+                                         const char *filepath,
+                                         const struct stat *st)
+{
+    size_t len = strlen(filepath);
+    if (len > UINT16_MAX) return NULL;
+
+    const StateEntry *e = find_slot(idx->slots, idx->cap,
+                                    hash_path(filepath, len), filepath, len);
+    if (e->hash != 0 &&
+        e->ino == (uint64_t)st->st_ino &&
+        e->size == (uint64_t)st->st_size &&
+        e->mtime_ns == stat_mtime_ns(st)) {
+        return e;
+    }
+    return NULL;
+}
+
+int state_is_current(StateIndex *idx, const char *filepath,
+                     StateOutcome *outcome)
+{
+    if (!idx || !filepath) return 0;
+
+    struct stat st;
+    if (stat(filepath, &st) != 0) return 0;
+
+    int current = 0;
+    pthread_mutex_lock(&idx->mutex);
+
+    const StateEntry *e = unchanged_entry(idx, filepath, &st);
+    if (e) {
+        switch (e->outcome) {
+        case STATE_SYNCED:
+        case STATE_INSTRUMENTAL:
+        case STATE_TAGGED:
+            current = 1;
+            break;
+        case STATE_PLAIN:
+        case STATE_MISSING:
+            current = (idx->retry_secs <= 0 ||
+                       (int64_t)time(NULL) - e->stamp < idx->retry_secs);
+            break;
+        default:
+            break;
+        }
+        if (current && outcome) *outcome = (StateOutcome)e->outcome;
+    }
+
+    pthread_mutex_unlock(&idx->mutex);
+    return current;
+}
+
+StateOutcome state_recorded(StateIndex *idx, const char *filepath)
+{
+    if (!idx || !filepath) return STATE_NONE;
+
+    struct stat st;
+    if (stat(filepath, &st) != 0) return STATE_NONE;
+
+    pthread_mutex_lock(&idx->mutex);
+    const StateEntry *e = unchanged_entry(idx, filepath, &st);
+    StateOutcome outcome = e ? (StateOutcome)e->outcome : STATE_NONE;
+    pthread_mutex_unlock(&idx->mutex);
+    return outcome;
+}
+
+int state_record(StateIndex *idx, const char *filepath, StateOutcome outcome)
+{
+    if (!idx || !filepath || outcome == STATE_NONE) return -1;
+
+    struct stat st;
+    if (stat(filepath, &st) != 0) return -1;
+
+    size_t len = strlen(filepath);
+    if (len == 0 || len > UINT16_MAX) return -1;
+
+    char *path = malloc(len + 1);
+    if (!path) return -1;
+    memcpy(path, filepath, len + 1);
+
+    StateRecord rec = {
+        .path_len = (uint16_t)len,
+        .outcome  = (uint8_t)outcome,
+        .ino      = (uint64_t)st.st_ino,
+        .size     = (uint64_t)st.st_size,
+        .mtime_ns = stat_mtime_ns(&st),
+        .stamp    = (int64_t)time(NULL)
+    };
+    StateEntry tmp = {
+        .path = path, .path_len = rec.path_len, .outcome = rec.outcome,
+        .ino = rec.ino, .size = rec.size, .mtime_ns = rec.mtime_ns,
+        .stamp = rec.stamp
+    };
+
+    char *buf = malloc(RECORD_PAD(sizeof(StateRecord) + len));
+    if (!buf) {
+        free(path);
+        return -1;
+    }
+    size_t n = encode_record(buf, &tmp);
+
+    pthread_mutex_lock(&idx->mutex);
+    int rc = write_all(idx->fd, buf, n);
+    if (rc == 0) {
+        idx->records++;
+        rc = upsert(idx, &rec, path, 1);
+    }
+    pthread_mutex_unlock(&idx->mutex);
+
+    free(buf);
+    if (rc != 0) free(path);
+    return rc;
+}
+
+void state_close(StateIndex *idx)
+{
+    if (!idx) return;
+
+    if (idx->fd >= 0) {
+        if (idx->records > STATE_COMPACT_MIN && idx->records > idx->live * 2) {
+            compact(idx);
+        } else {
+            fdatasync(idx->fd);
+        }
+        close(idx->fd);
+    }
+    pthread_mutex_destroy(&idx->mutex);
+
+    for (size_t i = 0; i < idx->cap; i++) {
+        if (idx->slots[i].owned) free((char *)idx->slots[i].path);
+    }
+    free(idx->slots);
+    if (idx->map) munmap(idx->map, idx->map_size);
+    free(idx->path);
+    free(idx);
+}
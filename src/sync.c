@@ -2,261 +2,1908 @@
  * sync.c — Shared lyrics sync engine
  *
  * Core pipeline: LRCLIB lookup → lyrics selection → metadata write.
- * Runs in parallel using worker threads with a shared work queue.
+ * Lookups run in parallel on a long-lived pool of worker threads that
+ * pull tracks from a single queue of albums, so workers stay busy
+ * across album boundaries.  The lyrics they select go through a bounded
+ * write queue to a separate pool of tag writers, so a slow disk and a
+ * slow network do not hold each other up and each side is sized on its
+ * own.  Writes can be limited to one per device at a time.
+ *
+ * With the HTTP async engine running, workers only start lookups; the
+ * completions come back through a ready queue and the workers do the
+ * selection, so the number of requests in flight no longer depends on
+ * the number of threads.
+ *
+ * With --threads auto the lookup pool is resized during the run: it
+ * grows while more workers buy more lookups per second, and backs off
+ * when LRCLIB throttles, lookups fail or latency climbs.  Workers above
+ * the current size park rather than exit.
+ *
+ * Finished tracks are pushed onto a lock-free queue and a single
+ * reporter thread does the counting, log writes and callbacks, so no
+ * worker ever waits on stdout or a log file, and the engine mutex only
+ * guards the queues.
+ *
+ * Each worker has an arena for its blocking lookups, reset whenever it
+ * moves on to the next piece of work.
+ *
+ * After sync_request_stop() workers start nothing new: unclaimed tracks
+ * and waiting retries are reported as interrupted, while lookups under
+ * way, queued writes and the reporter drain as usual, so every finished
+ * track reaches the state index and the journal.
  */
 
 #include "sync.h"
+#include "arena.h"
 #include "http_client.h"
 #include "lrclib.h"
 #include "metadata.h"
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 
 /* ── Internal context ─────────────────────────────────────────────────── */
 
+/* Max unclaimed tracks queued before producers block */
+#define SYNC_QUEUE_PER_THREAD 64
+
+/* Max selected tracks waiting for a writer before lookups block */
+#define WRITE_QUEUE_PER_THREAD 16
+
+/* Longest a worker sleeps on a retry before checking for a stop */
+#define STOP_POLL_MS 1000
+
+/* --threads auto */
+#define TUNE_INTERVAL_MS   1000   /* shortest interval between decisions */
+#define TUNE_MAX_WAIT_MS   10000  /* drop an interval with too few samples */
+#define TUNE_MIN_SAMPLES   8      /* lookups needed to judge an interval */
+#define TUNE_MAX_FAILURES  0.05   /* failure share that forces a back-off */
+#define TUNE_LATENCY_SLACK 2.0    /* latency over the best that means queueing */
+#define TUNE_GAIN          1.05   /* throughput gain a growth step must buy */
+#define TUNE_BASE_DRIFT    1.02   /* per interval, so the best can age out */
+#define TUNE_HOLD          3      /* intervals without growth after a back-off */
+
+/*
+ * One album in the queue.  Tracks are appended while the album is being
+ * scanned and claimed in order by the workers; `closed` is set once the
+ * scan is over and the track count is final.
+ */
+struct SyncAlbum {
+    SyncEngine       *engine;
+    TrackMeta       **items;
+    int               count;
+    int               capacity;
+    int               owns_items;   /* 0 for sync_tracks()' borrowed list */
+    int               next_index;   /* next track to claim */
+    int               closed;
+    int               queued;       /* linked into the engine queue */
+    int               searched;     /* album search: 0 no, 1 running, 2 done */
+    LrclibAlbum      *search;
+    void             *user;
+    struct SyncAlbum *next;
+
+    /* Reporter thread only */
+    SyncResult        result;
+    int               done;         /* tracks reported */
+    int               ended;        /* reporter has seen the album close */
+    int               final_count;  /* track count, once ended */
+};
+
+/*
+ * A lookup that outlives the worker that started it: in flight on the
+ * async engine, completed and waiting for a write, or waiting in the
+ * retry heap until `due`.
+ */
+typedef struct PendingLookup {
+    SyncEngine           *engine;
+    SyncAlbum            *album;
+    int                   idx;
+    const TrackMeta      *track;
+    int                   relaxed;     /* second, relaxed lookup issued */
+    LrclibStatus          status;
+    LrclibTrack          *lrc;
+    HttpRetry             retry;
+    struct timespec       due;
+    struct PendingLookup *next;
+
+    /* Async bookkeeping, under the engine mutex */
+    int                   outstanding; /* requests not yet answered */
+    int                   decided;     /* result chosen and queued */
+    int                   written;     /* result handed to finish_track */
+
+    /* Speculative mode: both lookups in flight at once */
+    int                   exact_done;
+    int                   relaxed_done;
+    LrclibStatus          relaxed_status;
+    LrclibTrack          *relaxed_lrc;
+    struct timespec       started;
+    long                  exact_ms;
+    long                  relaxed_ms;
+} PendingLookup;
+
+/*
+ * Queue depth and thread time of one pipeline stage, under the engine
+ * mutex.  Times are in milliseconds.
+ */
+typedef struct {
+    long             items;        /* taken off the input queue */
+    int              depth;        /* input queue depth right now */
+    int              max_depth;
+    double           depth_area;   /* depth integrated over time */
+    double           changed_ms;   /* when `depth` last changed */
+    double           thread_ms;    /* summed lifetimes of the threads */
+    double           idle_ms;      /* waiting for input */
+    double           stalled_ms;   /* waiting for room downstream */
+} StageMeter;
+
+/*
+ * Lookup samples and state of the thread tuner, under the engine mutex.
+ */
 typedef struct {
-    const TrackMetaList *list;
-    const SyncConfig    *config;
-    int                  next_index;
-    SyncResult           result;
-    SyncProgressFn       progress;
-    void                *user;
-    FILE                *plain_file;
-    FILE                *missing_file;
-    pthread_mutex_t      mutex;
-} SyncContext;
+    double           started_ms;   /* start of the current interval */
+    long             samples;      /* lookup requests answered */
+    long             failures;     /* ... failed or throttled */
+    double           latency_ms;   /* summed over the samples */
+    long             throttled;    /* limiter count at the interval start */
+    double           last_rate;    /* lookups per second, last interval */
+    double           base_latency; /* best interval mean so far, drifting */
+    int              grew;         /* workers the last step added */
+    int              hold;         /* intervals before growing again */
+    int              settled;      /* left slow start: grow by steps */
+    int              peak;
+} AutoTune;
+
+typedef struct WriteJob WriteJob;
+typedef struct SyncEvent SyncEvent;
+
+/* Set by sync_request_stop(), possibly from a signal handler */
+static atomic_int stop_requested;
+
+struct SyncEngine {
+    SyncConfig       config;
+    SyncProgressFn   progress;
+    SyncAlbumDoneFn  album_done;
+    SyncResult       result;      /* track counters: reporter thread only */
+    FILE            *plain_file;
+    FILE            *missing_file;
+
+    _Atomic(SyncEvent *) events;  /* unreported events, newest first */
+    pthread_t        reporter;
+    int              has_reporter;
+    int              reporter_stop;
+    pthread_mutex_t  report_mutex; /* reporter sleep and wakeup */
+    pthread_cond_t   report_cond;
+    pthread_mutex_t  emit_mutex;   /* held while reporting a batch */
+
+    SyncAlbum       *head;        /* albums that may still get work */
+    SyncAlbum       *tail;
+    int              pending;     /* unclaimed tracks across all albums */
+    int              max_pending;
+    int              closing;
+
+    int              async;        /* lookups via lrclib_get_async() */
+    int              inflight;     /* async lookups not yet completed */
+    int              max_inflight;
+    PendingLookup   *ready_head;   /* completed lookups awaiting a write */
+    PendingLookup   *ready_tail;
+
+    PendingLookup  **retry_heap;   /* min-heap on `due` */
+    int              num_retries;
+    int              retry_cap;
+
+    WriteJob        *write_head;   /* selected lyrics awaiting a writer */
+    WriteJob        *write_tail;
+    int              write_count;
+    int              max_writes;
+    int              writers_closing;
+    dev_t           *busy_devs;    /* devices being written to */
+    int              num_busy_devs;
+
+    StageMeter       lookup_meter;
+    StageMeter       write_meter;
+    double           started_ms;
+
+    int              tuning;       /* --threads auto */
+    int              min_threads;
+    int              max_threads;
+    int              active_threads; /* workers allowed to take work */
+    int              next_worker_id;
+    AutoTune         tune;
+
+    pthread_t       *threads;
+    int              num_threads;  /* started so far */
+    pthread_t       *writers;
+    int              num_writers;
+    pthread_mutex_t  mutex;
+    pthread_cond_t   work_cond;   /* signalled when tracks are queued */
+    pthread_cond_t   space_cond;  /* signalled when tracks are claimed */
+    pthread_cond_t   write_cond;  /* write queued or device released */
+    pthread_cond_t   write_space_cond; /* write taken off the queue */
+};
+
+/* ── Stage meters ─────────────────────────────────────────────────────── */
+
+static double mono_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_nsec / 1e6;
+}
+
+/* Record a new input queue depth.  Caller holds the engine mutex. */
+static void meter_depth(StageMeter *m, int depth)
+{
+    double now = mono_ms();
+    m->depth_area += (double)m->depth * (now - m->changed_ms);
+    m->changed_ms = now;
+    m->depth = depth;
+    if (depth > m->max_depth) m->max_depth = depth;
+}
+
+/*
+ * Wait on `cond`, charging the time to `*waited`.  Caller holds the
+ * engine mutex.
+ */
+static void meter_wait(SyncEngine *e, pthread_cond_t *cond, double *waited)
+{
+    double start = mono_ms();
+    pthread_cond_wait(cond, &e->mutex);
+    *waited += mono_ms() - start;
+}
+
+static SyncStageStats stage_stats(StageMeter *m, int threads, double run_ms)
+{
+    SyncStageStats s = { .threads = threads, .items = m->items,
+                         .max_queue = m->max_depth };
+
+    meter_depth(m, m->depth);
+    if (run_ms > 0) s.avg_queue = m->depth_area / run_ms;
+    if (m->thread_ms > 0) {
+        double busy = m->thread_ms - m->idle_ms - m->stalled_ms;
+        s.busy    = busy > 0 ? busy / m->thread_ms : 0;
+        s.stalled = m->stalled_ms / m->thread_ms;
+    }
+    return s;
+}
+
+/* ── Thread tuning ────────────────────────────────────────────────────── */
+
+static void *sync_worker(void *arg);
+
+/*
+ * Count answered lookup requests for the tuner.  Caller holds the
+ * engine mutex.
+ */
+static void tune_note(SyncEngine *e, int requests, double ms, int failures)
+{
+    if (!e->tuning) return;
+    e->tune.samples    += requests;
+    e->tune.latency_ms += ms;
+    e->tune.failures   += failures;
+}
+
+/*
+ * Resize the lookup pool to `n` workers, starting threads as needed.
+ * Caller holds the engine mutex.
+ */
+static void tune_set(SyncEngine *e, int n)
+{
+    if (n < e->min_threads) n = e->min_threads;
+    if (n > e->max_threads) n = e->max_threads;
+
+    while (e->num_threads < n) {
+        if (pthread_create(&e->threads[e->num_threads], NULL,
+                           sync_worker, e) != 0) {
+            n = e->num_threads;
+            break;
+        }
+        e->num_threads++;
+    }
+
+    e->active_threads = n;
+    if (n > e->tune.peak) e->tune.peak = n;
+    /* Unpark workers that are allowed back in */
+    pthread_cond_broadcast(&e->work_cond);
+}
+
+/*
+ * Decide on the pool size once an interval has enough samples.  Like
+ * TCP slow start, the pool doubles until a step stops paying off, then
+ * grows by an eighth.  A growth step has to raise throughput or it is
+ * undone; throttling and failures cut the pool by a quarter, and
+ * latency well above the best seen (requests queueing somewhere) trims
+ * it by a step.  The pool only grows while there is a backlog to grow
+ * into.
+ * Caller holds the engine mutex.
+ */
+static void tune_step(SyncEngine *e)
+{
+    AutoTune *t = &e->tune;
+    double now = mono_ms();
+    double elapsed = now - t->started_ms;
+    int n = e->active_threads;
+
+    if (elapsed < TUNE_INTERVAL_MS) return;
+    long needed = n > TUNE_MIN_SAMPLES ? n : TUNE_MIN_SAMPLES;
+    if (t->samples < needed && elapsed < TUNE_MAX_WAIT_MS) return;
+
+    RateStats rs = http_rate_stats();
+    if (t->samples >= needed) {
+        double rate    = (double)t->samples * 1000.0 / elapsed;
+        double latency = t->latency_ms / (double)t->samples;
+        double failed  = (double)t->failures / (double)t->samples;
+        int step = n / 8 > 1 ? n / 8 : 1;
+        int next = n;
+
+        if (t->base_latency <= 0 || latency < t->base_latency) {
+            t->base_latency = latency;
+        } else {
+            t->base_latency *= TUNE_BASE_DRIFT;
+        }
+
+        if (rs.throttled > t->throttled || failed > TUNE_MAX_FAILURES) {
+            next = n - (n / 4 > 1 ? n / 4 : 1);
+            t->hold    = TUNE_HOLD;
+            t->settled = 1;
+        } else if (latency > t->base_latency * TUNE_LATENCY_SLACK) {
+            next = n - step;
+            t->settled = 1;
+        } else if (t->grew && rate < t->last_rate * TUNE_GAIN) {
+            /* The last step bought nothing */
+            next = n - t->grew;
+            t->hold    = TUNE_HOLD;
+            t->settled = 1;
+        } else if (t->hold > 0) {
+            t->hold--;
+        } else if (e->pending > n) {
+            next = n + (t->settled ? step : n);
+        }
+
+        t->last_rate = rate;
+        tune_set(e, next);
+        t->grew = e->active_threads > n ? e->active_threads - n : 0;
+    }
+
+    t->started_ms = now;
+    t->samples    = 0;
+    t->failures   = 0;
+    t->latency_ms = 0;
+    t->throttled  = rs.throttled;
+}
+
+static int cgroup_cpu_quota(double *cpus)
+{
+    /* cgroup v2: "<quota> <period>", or "max <period>" for none */
+    FILE *f = fopen("/sys/fs/cgroup/cpu.max", "r");
+    if (f) {
+        char quota[32];
+        long period = 0;
+        int ok = fscanf(f, "%31s %ld", quota, &period) == 2 &&
+                 strcmp(quota, "max") != 0 && period > 0;
+        fclose(f);
+        if (ok) *cpus = atof(quota) / (double)period;
+        return ok;
+    }
+
+    /* cgroup v1: quota is -1 for none */
+    long quota = -1, period = 0;
+    f = fopen("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "r");
+    if (f) {
+        if (fscanf(f, "%ld", &quota) != 1) quota = -1;
+        fclose(f);
+    }
+    f = fopen("/sys/fs/cgroup/cpu/cpu.cfs_period_us", "r");
+    if (f) {
+        if (fscanf(f, "%ld", &period) != 1) period = 0;
+        fclose(f);
+    }
+    if (quota <= 0 || period <= 0) return 0;
+    *cpus = (double)quota / (double)period;
+    return 1;
+}
 
 /* ── Track processing ─────────────────────────────────────────────────── */
 
-static int try_local_lrc(const TrackMeta *t, const SyncConfig *cfg,
-                         int *out_synced, int *out_skipped,
-                         int *out_error, const char **out_status)
+/*
+ * Outcome of processing a single track.  Exactly one of the counters
+ * is set once the track is done; `saved` and `instrumental` qualify
+ * skipped / synced.  Until then `lyrics` or `local_lrc` says what the
+ * write stage still has to embed.
+ */
+typedef struct {
+    int         synced;
+    int         plain;
+    int         skipped;
+    int         not_found;
+    int         error;
+    int         saved;          /* skipped without any LRCLIB request */
+    int         instrumental;   /* synced counter came from an instrumental */
+    const char *status;
+    char       *lyrics;         /* selected lyrics to write (heap) */
+    int         is_synced;      /* `lyrics` are synced */
+    int         local_lrc;      /* embed the track's .lrc file instead */
+    int         replace;        /* overwrite the track's plain lyrics */
+    int         interrupted;    /* not started before a stop request */
+} TrackResult;
+
+/*
+ * A finished track, or a closed album (`track` NULL, `idx` holds its
+ * final track count), on its way to the reporter.
+ */
+struct SyncEvent {
+    SyncAlbum       *album;
+    int              idx;
+    const TrackMeta *track;
+    TrackResult      result;
+    SyncEvent       *next;
+};
+
+/*
+ * A track whose lyrics are selected, waiting for a writer.
+ */
+struct WriteJob {
+    SyncAlbum       *album;
+    int              idx;
+    const TrackMeta *track;
+    dev_t            dev;       /* device of the file, when serializing */
+    TrackResult      result;
+    WriteJob        *next;
+};
+
+static void local_lrc_path(const TrackMeta *t, char *out, size_t size)
 {
-    char lrc_path[4096];
-    snprintf(lrc_path, sizeof(lrc_path), "%s", t->filepath);
-    char *dot = strrchr(lrc_path, '.');
+    snprintf(out, size, "%s", t->filepath);
+    char *dot = strrchr(out, '.');
     if (dot != NULL) {
         strcpy(dot, ".lrc");
     } else {
-        strncat(lrc_path, ".lrc", sizeof(lrc_path) - strlen(lrc_path) - 1);
+        strncat(out, ".lrc", size - strlen(out) - 1);
     }
+}
 
-    FILE *f_lrc = fopen(lrc_path, "rb");
-    if (!f_lrc) return 0;
+/*
+ * Whether the track has a non-empty .lrc file next to it, to be
+ * embedded by the write stage instead of looking it up.
+ */
+static int has_local_lrc(const TrackMeta *t)
+{
+    char lrc_path[4096];
+    local_lrc_path(t, lrc_path, sizeof(lrc_path));
 
-    fseek(f_lrc, 0, SEEK_END);
-    long length = ftell(f_lrc);
-    fseek(f_lrc, 0, SEEK_SET);
+    struct stat st;
+    return stat(lrc_path, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0;
+}
 
-    if (length <= 0) {
-        fclose(f_lrc);
-        return 0;
+static void write_outcome(int rc, TrackResult *r)
+{
+    if (rc == 1) {
+        if (r->is_synced) r->synced = 1; else r->plain = 1;
+    } else if (rc == 0) {
+        r->skipped = 1;
+        r->status = "\xe2\x8a\x98 already has lyrics";
+    } else {
+        r->error = 1;
+        r->status = "\xe2\x9c\x97 write error";
     }
+}
+
+/*
+ * Embed the track's local .lrc file (write stage).
+ */
+static void write_local_lrc(const TrackMeta *t, const SyncConfig *cfg,
+                            TrackResult *r)
+{
+    char lrc_path[4096];
+    local_lrc_path(t, lrc_path, sizeof(lrc_path));
 
-    char *buf = malloc((size_t)length + 1);
-    if (!buf) {
+    char *buf = NULL;
+    FILE *f_lrc = fopen(lrc_path, "rb");
+    if (f_lrc) {
+        fseek(f_lrc, 0, SEEK_END);
+        long length = ftell(f_lrc);
+        fseek(f_lrc, 0, SEEK_SET);
+
+        if (length > 0 && (buf = malloc((size_t)length + 1)) != NULL) {
+            size_t read_bytes = fread(buf, 1, (size_t)length, f_lrc);
+            buf[read_bytes] = '\0';
+        }
         fclose(f_lrc);
-        return 0;
     }
 
-    size_t read_bytes = fread(buf, 1, (size_t)length, f_lrc);
-    buf[read_bytes] = '\0';
-    fclose(f_lrc);
-
-    int rc = metadata_sync_lyrics(t->filepath, buf, cfg->force);
+    int rc = buf ? metadata_sync_lyrics(t->filepath, buf,
+                                        cfg->force || r->replace) : -1;
     free(buf);
 
-    if (rc == 1) {
-        *out_synced = 1;
-        *out_status = "\xe2\x9c\x93 local lrc";
-        if (cfg->clean_lrc) {
-            unlink(lrc_path);
-        }
-    } else if (rc == 0) {
-        *out_skipped = 1;
-        *out_status = "\xe2\x8a\x98 already has lyrics";
-    } else {
-        *out_error = 1;
-        *out_status = "\xe2\x9c\x97 write error";
+    write_outcome(rc, r);
+    if (rc == 1 && cfg->clean_lrc) {
+        unlink(lrc_path);
     }
-    return 1;
 }
 
-static int try_api_lrc(const TrackMeta *t, const SyncConfig *cfg,
-                       int *out_synced, int *out_plain, int *out_skipped,
-                       int *out_not_found, int *out_error, const char **out_status)
+/*
+ * Whether an exact-match result is worth a relaxed second lookup.
+ * Throttling and errors are not: the track is retried on a later run.
+ */
+static int needs_relaxed(LrclibStatus status, const LrclibTrack *lrc)
 {
-    /* Refined LRCLIB lookup: exact match first */
-    LrclibTrack *lrc = lrclib_get(t->artist, t->title, t->album, (double)t->duration);
+    if (status != LRCLIB_OK && status != LRCLIB_NOT_FOUND) return 0;
+    return !lrc || (!lrc->synced_lyrics && !lrc->instrumental);
+}
 
-    /* Fallback: relax constraints if lyrics or track not found */
-    if (!lrc || (!lrc->synced_lyrics && !lrc->instrumental)) {
+/*
+ * Select the best lyrics from a lookup result.  Lyrics to write are
+ * copied into r->lyrics for the write stage, since `lrc` may live in
+ * this thread's arena.  Takes ownership of `lrc` (which may be NULL).
+ */
+static void select_lyrics(LrclibStatus status, LrclibTrack *lrc,
+                          TrackResult *r)
+{
+    /* Failed lookups are errors, so they stay out of the missing log */
+    if (status == LRCLIB_RETRY || status == LRCLIB_ERROR) {
         lrclib_track_free(lrc);
-        lrc = lrclib_get(t->artist, t->title, NULL, 0);
+        r->error = 1;
+        r->status = status == LRCLIB_RETRY ? "\xe2\x9c\x97 throttled"
+                                           : "\xe2\x9c\x97 lookup failed";
+        return;
     }
 
     if (!lrc) {
-        *out_not_found = 1;
-        *out_status = "\xe2\x9c\x97 not found";
-        return 1;
+        r->not_found = 1;
+        r->status = "\xe2\x9c\x97 not found";
+        return;
     }
 
     /* Pick best available lyrics: synced first, then plain, then instrumental */
     const char *lyrics = NULL;
-    int is_synced = 0;
-    int is_inst = 0;
 
     if (lrc->instrumental) {
-        *out_status = "\xe2\x9c\x93 instrumental";
-        is_inst = 1;
+        r->status = "\xe2\x9c\x93 instrumental";
+        r->instrumental = 1;
     } else if (lrc->synced_lyrics && lrc->synced_lyrics[0] != '\0') {
         lyrics = lrc->synced_lyrics;
-        *out_status = "\xe2\x9c\x93 synced";
-        is_synced = 1;
+        r->status = "\xe2\x9c\x93 synced";
+        r->is_synced = 1;
     } else if (lrc->plain_lyrics && lrc->plain_lyrics[0] != '\0') {
         lyrics = lrc->plain_lyrics;
-        *out_status = "\xe2\x9c\x93 plain";
+        r->status = "\xe2\x9c\x93 plain";
     }
 
-    if (!lyrics && !is_inst) {
-        *out_not_found = 1;
-        *out_status = "\xe2\x9c\x97 not found";
+    if (!lyrics && !r->instrumental) {
+        r->not_found = 1;
+        r->status = "\xe2\x9c\x97 not found";
         lrclib_track_free(lrc);
-        return 1;
+        return;
     }
 
-    if (is_inst) {
+    if (r->instrumental) {
         /* User requested NOT to write [Instrumental] tags */
-        *out_synced = 1; /* Count as success */
+        r->synced = 1; /* Count as success */
         lrclib_track_free(lrc);
-        return 1;
+        return;
     }
 
-    /* Single TagLib open: check existing + write if needed */
-    int rc = metadata_sync_lyrics(t->filepath, lyrics, cfg->force);
+    r->lyrics = strdup(lyrics);
     lrclib_track_free(lrc);
+    if (!r->lyrics) write_outcome(-1, r);
+}
 
-    if (rc == 1) {
-        if (is_synced) *out_synced = 1; else *out_plain = 1;
-    } else if (rc == 0) {
-        *out_skipped = 1;
-        *out_status = "\xe2\x8a\x98 already has lyrics";
-    } else {
-        *out_error = 1;
-        *out_status = "\xe2\x9c\x97 write error";
+static void try_api_lrc(const TrackMeta *t, TrackResult *r)
+{
+    /* Refined LRCLIB lookup: exact match first */
+    LrclibTrack *lrc = NULL;
+    LrclibStatus status = lrclib_lookup(t->artist, t->title, t->album,
+                                        (double)t->duration, &lrc);
+
+    /* Fallback: relax constraints if lyrics or track not found */
+    if (needs_relaxed(status, lrc)) {
+        lrclib_track_free(lrc);
+        status = lrclib_lookup(t->artist, t->title, NULL, 0, &lrc);
     }
-    return 1;
+
+    select_lyrics(status, lrc, r);
 }
 
-static void process_track(const TrackMeta *t, const SyncConfig *cfg,
-                          int *out_synced, int *out_plain,
-                          int *out_skipped, int *out_not_found,
-                          int *out_error, const char **out_status)
+/*
+ * Handle everything that needs no LRCLIB request.  Returns 1 if the
+ * track still needs an API lookup, 0 if `r` is final.
+ */
+static int prepare_track(const TrackMeta *t, const SyncConfig *cfg,
+                         TrackResult *r)
 {
-    *out_synced = *out_plain = *out_skipped = *out_not_found = *out_error = 0;
+    memset(r, 0, sizeof(*r));
+    r->status = "";
+
+    /* Already tagged at scan time: no network, no second file open.
+       Plain lyrics this tool wrote are looked up again once the state
+       index has them due for a retry (see retry_plain). */
+    if (t->has_lyrics && !cfg->force &&
+        state_recorded(cfg->state, t->filepath) != STATE_PLAIN) {
+        r->skipped = 1;
+        r->saved = 1;
+        r->status = "\xe2\x8a\x98 already has lyrics";
+        return 0;
+    }
 
     if (!t->artist || !t->title) {
-        *out_not_found = 1;
-        *out_status = "\xe2\x9c\x97 missing metadata";
-        return;
+        r->not_found = 1;
+        r->status = "\xe2\x9c\x97 missing metadata";
+        return 0;
     }
 
-    if (try_local_lrc(t, cfg, out_synced, out_skipped, out_error, out_status)) {
+    if (has_local_lrc(t)) {
+        r->local_lrc = 1;
+        r->is_synced = 1;
+        r->status = "\xe2\x9c\x93 local lrc";
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Settle the retry of a track whose plain lyrics this tool wrote on
+ * an earlier run: synced lyrics (from LRCLIB or a local .lrc file)
+ * replace them, anything else keeps them and the track stays plain.
+ * Errors stay errors, so the next run retries again.
+ */
+static void retry_plain(TrackResult *r)
+{
+    if (r->error) return;
+    if ((r->lyrics && r->is_synced) || r->local_lrc) {
+        r->replace = 1;
         return;
     }
 
-    try_api_lrc(t, cfg, out_synced, out_plain, out_skipped, out_not_found, out_error, out_status);
+    free(r->lyrics);
+    r->lyrics       = NULL;
+    r->is_synced    = 0;
+    r->synced       = 0;
+    r->instrumental = 0;
+    r->not_found    = 0;
+    r->plain        = 1;
+    r->status       = "\xe2\x8a\x98 kept plain lyrics";
+}
+
+/*
+ * Map a track result onto the outcome stored in the state index.
+ * Errors are not recorded, so the file is retried next run.
+ */
+static StateOutcome state_outcome(const TrackResult *r)
+{
+    if (r->instrumental) return STATE_INSTRUMENTAL;
+    if (r->synced)       return STATE_SYNCED;
+    if (r->plain)        return STATE_PLAIN;
+    if (r->skipped)      return STATE_TAGGED;
+    if (r->not_found)    return STATE_MISSING;
+    return STATE_NONE;
 }
 
 /* ── Worker thread ────────────────────────────────────────────────────── */
 
-static void *sync_worker(void *arg)
+static void result_add(SyncResult *total, const TrackResult *r)
+{
+    total->synced    += r->synced;
+    total->plain     += r->plain;
+    total->skipped   += r->skipped;
+    total->not_found += r->not_found;
+    total->errors    += r->error;
+    total->lookups_saved += r->saved;
+    total->interrupted   += r->interrupted;
+}
+
+static void album_free(SyncAlbum *a)
 {
-    SyncContext *ctx = (SyncContext *)arg;
+    lrclib_album_free(a->search);
+    if (a->owns_items) {
+        for (int i = 0; i < a->count; i++) metadata_free(a->items[i]);
+        free(a->items);
+    }
+    free(a);
+}
 
-    for (;;) {
-        pthread_mutex_lock(&ctx->mutex);
-        int idx = ctx->next_index++;
-        pthread_mutex_unlock(&ctx->mutex);
+/* Caller holds the engine mutex. */
+static void album_unlink(SyncEngine *e, SyncAlbum *a)
+{
+    SyncAlbum *prev = NULL;
+    for (SyncAlbum *cur = e->head; cur; prev = cur, cur = cur->next) {
+        if (cur != a) continue;
+        if (prev) prev->next = cur->next; else e->head = cur->next;
+        if (e->tail == cur) e->tail = prev;
+        break;
+    }
+    a->queued = 0;
+    a->next = NULL;
+}
 
-        if (idx >= ctx->list->count) break;
+/*
+ * Claim the next unprocessed track from the first album that has one.
+ * Caller holds the engine mutex.  Returns NULL if nothing is claimable.
+ */
+static SyncAlbum *claim_track(SyncEngine *e, int *out_idx,
+                              const TrackMeta **out_track)
+{
+    for (SyncAlbum *a = e->head; a; a = a->next) {
+        if (a->next_index >= a->count) continue;
+
+        *out_idx   = a->next_index++;
+        *out_track = a->items[*out_idx];
+        e->pending--;
+        e->lookup_meter.items++;
+        meter_depth(&e->lookup_meter, e->pending);
+
+        /* Fully claimed and closed: nothing more will come from it */
+        if (a->closed && a->next_index >= a->count) album_unlink(e, a);
+        return a;
+    }
+    return NULL;
+}
 
-        const TrackMeta *t = ctx->list->items[idx];
+/* ── Reporter ─────────────────────────────────────────────────────────── */
 
-        int s = 0, p = 0, sk = 0, nf = 0, e = 0;
-        const char *status = "";
-        process_track(t, ctx->config, &s, &p, &sk, &nf, &e, &status);
+/*
+ * Apply one event: counters, logs and callbacks, then release the
+ * album once it is closed and every track is reported.  Runs on the
+ * reporter thread, or with emit_mutex held when an event cannot be
+ * queued.
+ */
+static void report_event(SyncEngine *e, const SyncEvent *ev)
+{
+    SyncAlbum *a = ev->album;
 
-        pthread_mutex_lock(&ctx->mutex);
+    if (ev->track) {
+        const TrackMeta *t = ev->track;
+        const TrackResult *r = &ev->result;
 
-        ctx->result.synced    += s;
-        ctx->result.plain     += p;
-        ctx->result.skipped   += sk;
-        ctx->result.not_found += nf;
-        ctx->result.errors    += e;
+        result_add(&a->result, r);
+        result_add(&e->result, r);
 
-        if (p && ctx->plain_file) {
-            fprintf(ctx->plain_file, "%s\n", t->filepath);
-            fflush(ctx->plain_file);
+        if (r->plain && e->plain_file) {
+            fprintf(e->plain_file, "%s\n", t->filepath);
+        }
+        if (r->not_found && e->missing_file) {
+            fprintf(e->missing_file, "%s\n", t->filepath);
         }
-        if (nf && ctx->missing_file) {
-            fprintf(ctx->missing_file, "%s\n", t->filepath);
-            fflush(ctx->missing_file);
+        if (e->config.journal && !r->error && !r->interrupted) {
+            journal_add(e->config.journal, t->filepath, state_outcome(r));
         }
 
-        if (ctx->progress) {
-            ctx->progress(idx, ctx->list->count,
-                          t->title ? t->title : "(unknown)",
-                          status, ctx->user);
+        if (e->progress && !r->interrupted) {
+            e->progress(ev->idx, a->ended ? a->final_count : 0,
+                        t->title ? t->title : "(unknown)",
+                        r->status, a->user);
         }
+        a->done++;
+    } else {
+        a->ended       = 1;
+        a->final_count = ev->idx;
+    }
 
-        pthread_mutex_unlock(&ctx->mutex);
+    if (a->ended && a->done >= a->final_count) {
+        if (e->album_done) e->album_done(&a->result, a->user);
+        album_free(a);
     }
+}
 
-    http_thread_cleanup();
+/* Logs and the journal are flushed once per batch, not once per line. */
+static void report_flush(SyncEngine *e)
+{
+    if (e->plain_file) fflush(e->plain_file);
+    if (e->missing_file) fflush(e->missing_file);
+    journal_flush(e->config.journal);
+}
+
+/*
+ * Hand an event to the reporter.  The push is a lock-free CAS; only
+ * the push that finds the queue empty wakes the reporter.
+ */
+static void report(SyncEngine *e, const SyncEvent *src)
+{
+    SyncEvent *ev = e->has_reporter ? malloc(sizeof(SyncEvent)) : NULL;
+    if (!ev) {
+        /* No reporter thread, or no memory: report from here */
+        pthread_mutex_lock(&e->emit_mutex);
+        report_event(e, src);
+        report_flush(e);
+        pthread_mutex_unlock(&e->emit_mutex);
+        return;
+    }
+    *ev = *src;
+
+    SyncEvent *head = atomic_load_explicit(&e->events, memory_order_relaxed);
+    do {
+        ev->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&e->events, &head, ev,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+    if (!head) {
+        pthread_mutex_lock(&e->report_mutex);
+        pthread_cond_signal(&e->report_cond);
+        pthread_mutex_unlock(&e->report_mutex);
+    }
+}
+
+static void *sync_reporter(void *arg)
+{
+    SyncEngine *e = (SyncEngine *)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&e->report_mutex);
+        while (!atomic_load_explicit(&e->events, memory_order_relaxed) &&
+               !e->reporter_stop) {
+            pthread_cond_wait(&e->report_cond, &e->report_mutex);
+        }
+        int stop = e->reporter_stop;
+        pthread_mutex_unlock(&e->report_mutex);
+
+        /* Take everything queued so far; it comes newest first */
+        SyncEvent *list = atomic_exchange_explicit(&e->events, NULL,
+                                                   memory_order_acquire);
+        if (!list) {
+            if (stop) break;
+            continue;
+        }
+        SyncEvent *fifo = NULL;
+        while (list) {
+            SyncEvent *next = list->next;
+            list->next = fifo;
+            fifo = list;
+            list = next;
+        }
+
+        pthread_mutex_lock(&e->emit_mutex);
+        while (fifo) {
+            SyncEvent *next = fifo->next;
+            report_event(e, fifo);
+            free(fifo);
+            fifo = next;
+        }
+        report_flush(e);
+        pthread_mutex_unlock(&e->emit_mutex);
+    }
     return NULL;
 }
 
-/* ── Public API ───────────────────────────────────────────────────────── */
+/*
+ * Record a processed track: state index, then the reporter for
+ * counters, logs and callbacks.
+ * Called without the engine mutex; returns with it held.
+ */
+static void finish_track(SyncEngine *e, SyncAlbum *a, int idx,
+                         const TrackMeta *t, const TrackResult *r)
+{
+    if (e->config.state && !r->error && !r->interrupted) {
+        state_record(e->config.state, t->filepath, state_outcome(r));
+    }
 
-SyncResult sync_tracks(const TrackMetaList *list, const SyncConfig *config,
-                         SyncProgressFn progress, void *user)
+    SyncEvent ev = { .album = a, .idx = idx, .track = t, .result = *r };
+    report(e, &ev);
+
+    pthread_mutex_lock(&e->mutex);
+}
+
+/*
+ * Drop a track after a stop request.  It is still reported so its
+ * album completes, but it is not counted, recorded or journaled, and a
+ * resumed run picks it up again.
+ * Called without the engine mutex; returns with it held.
+ */
+static void interrupt_track(SyncEngine *e, SyncAlbum *a, int idx,
+                            const TrackMeta *t)
 {
-    SyncResult empty = {0};
-    if (!list || list->count == 0 || !config) return empty;
+    TrackResult r = { .status = "", .interrupted = 1 };
+    finish_track(e, a, idx, t, &r);
+}
 
-    int t = config->num_threads > list->count ? list->count : config->num_threads;
+/* ── Write stage ──────────────────────────────────────────────────────── */
 
-    SyncContext ctx = {
-        .list         = list,
-        .config       = config,
-        .next_index   = 0,
-        .result       = {0},
-        .progress     = progress,
-        .user         = user,
-        .plain_file   = config->out_plain ? fopen(config->out_plain, "a") : NULL,
-        .missing_file = config->out_missing ? fopen(config->out_missing, "a") : NULL
-    };
-    pthread_mutex_init(&ctx.mutex, NULL);
+/*
+ * Embed a job's lyrics and record the track.  Frees the job.
+ * Called without the engine mutex; returns with it held.
+ */
+static void write_track(SyncEngine *e, WriteJob *job)
+{
+    TrackResult *r = &job->result;
 
-    pthread_t *threads = calloc((size_t)t, sizeof(pthread_t));
-    for (int i = 0; i < t; i++) {
-        pthread_create(&threads[i], NULL, sync_worker, &ctx);
+    if (r->local_lrc) {
+        write_local_lrc(job->track, &e->config, r);
+    } else {
+        /* Single TagLib open: check existing + write if needed */
+        write_outcome(metadata_sync_lyrics(job->track->filepath, r->lyrics,
+                                           e->config.force || r->replace), r);
+        free(r->lyrics);
+        r->lyrics = NULL;
     }
-    for (int i = 0; i < t; i++) {
-        pthread_join(threads[i], NULL);
+
+    finish_track(e, job->album, job->idx, job->track, r);
+    free(job);
+}
+
+/* Caller holds the engine mutex. */
+static int dev_busy(const SyncEngine *e, dev_t dev)
+{
+    for (int i = 0; i < e->num_busy_devs; i++) {
+        if (e->busy_devs[i] == dev) return 1;
     }
+    return 0;
+}
+
+/*
+ * Take the first queued job a writer may start now: with writes
+ * serialized, one whose device nobody is writing to.
+ * Caller holds the engine mutex.  Returns NULL if there is none.
+ */
+static WriteJob *write_pop(SyncEngine *e)
+{
+    int serialize = e->config.serialize_writes;
+    WriteJob *prev = NULL;
 
-    free(threads);
-    pthread_mutex_destroy(&ctx.mutex);
+    for (WriteJob *job = e->write_head; job; prev = job, job = job->next) {
+        if (serialize && dev_busy(e, job->dev)) continue;
 
-    if (ctx.plain_file) fclose(ctx.plain_file);
-    if (ctx.missing_file) fclose(ctx.missing_file);
+        if (prev) prev->next = job->next; else e->write_head = job->next;
+        if (e->write_tail == job) e->write_tail = prev;
+        if (serialize) e->busy_devs[e->num_busy_devs++] = job->dev;
+
+        e->write_count--;
+        e->write_meter.items++;
+        meter_depth(&e->write_meter, e->write_count);
+        pthread_cond_signal(&e->write_space_cond);
+        return job;
+    }
+    return NULL;
+}
 
-    return ctx.result;
+/* Caller holds the engine mutex. */
+static void dev_release(SyncEngine *e, dev_t dev)
+{
+    for (int i = 0; i < e->num_busy_devs; i++) {
+        if (e->busy_devs[i] != dev) continue;
+        e->busy_devs[i] = e->busy_devs[--e->num_busy_devs];
+        break;
+    }
+    /* Jobs for this device may be waiting behind it */
+    pthread_cond_broadcast(&e->write_cond);
+}
+
+static void *sync_writer(void *arg)
+{
+    SyncEngine *e = (SyncEngine *)arg;
+    double started = mono_ms();
+
+    pthread_mutex_lock(&e->mutex);
+    for (;;) {
+        WriteJob *job = write_pop(e);
+        if (!job) {
+            if (e->writers_closing && !e->write_head) break;
+            meter_wait(e, &e->write_cond, &e->write_meter.idle_ms);
+            continue;
+        }
+        pthread_mutex_unlock(&e->mutex);
+
+        dev_t dev = job->dev;
+        write_track(e, job);
+        if (e->config.serialize_writes) dev_release(e, dev);
+    }
+    e->write_meter.thread_ms += mono_ms() - started;
+    pthread_mutex_unlock(&e->mutex);
+    return NULL;
+}
+
+/*
+ * Finish a track whose lookup stage is over: hand it to the writers if
+ * it has lyrics to embed, otherwise record it right away.  Blocks while
+ * the write queue is full.
+ * Called without the engine mutex; returns with it held.
+ */
+static void complete_track(SyncEngine *e, SyncAlbum *a, int idx,
+                           const TrackMeta *t, TrackResult *r)
+{
+    /* Tagged tracks only get this far when their plain lyrics are due
+       for a retry (see prepare_track) */
+    if (t->has_lyrics && !e->config.force && !r->skipped) retry_plain(r);
+
+    if (!r->lyrics && !r->local_lrc) {
+        finish_track(e, a, idx, t, r);
+        return;
+    }
+
+    WriteJob *job = calloc(1, sizeof(WriteJob));
+    if (!job) {
+        free(r->lyrics);
+        r->lyrics = NULL;
+        write_outcome(-1, r);
+        finish_track(e, a, idx, t, r);
+        return;
+    }
+    job->album  = a;
+    job->idx    = idx;
+    job->track  = t;
+    job->result = *r;
+
+    struct stat st;
+    if (e->config.serialize_writes && stat(t->filepath, &st) == 0) {
+        job->dev = st.st_dev;
+    }
+
+    /* No writer threads: write inline */
+    if (e->num_writers == 0) {
+        write_track(e, job);
+        return;
+    }
+
+    pthread_mutex_lock(&e->mutex);
+    while (e->write_count >= e->max_writes) {
+        meter_wait(e, &e->write_space_cond, &e->lookup_meter.stalled_ms);
+    }
+    if (e->write_tail) e->write_tail->next = job; else e->write_head = job;
+    e->write_tail = job;
+    e->write_count++;
+    meter_depth(&e->write_meter, e->write_count);
+    pthread_cond_signal(&e->write_cond);
+}
+
+static void pending_free(PendingLookup *p)
+{
+    lrclib_track_free(p->lrc);
+    lrclib_track_free(p->relaxed_lrc);
+    free(p);
+}
+
+/*
+ * Queue a decided lookup for a worker to write.
+ * Caller holds the engine mutex.
+ */
+static void ready_push(SyncEngine *e, PendingLookup *p)
+{
+    p->decided = 1;
+    p->next = NULL;
+    if (e->ready_tail) e->ready_tail->next = p; else e->ready_head = p;
+    e->ready_tail = p;
+    pthread_cond_broadcast(&e->work_cond);
+}
+
+/*
+ * Account for one answered request.  The lookup stops counting as in
+ * flight once all its requests are answered, and is freed once it has
+ * also been written.  Caller holds the engine mutex.
+ */
+static void lookup_release(SyncEngine *e, PendingLookup *p)
+{
+    if (--p->outstanding > 0) return;
+
+    e->inflight--;
+    pthread_cond_broadcast(&e->work_cond);
+    if (p->written) pending_free(p);
+}
+
+static long ms_since(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long)(now.tv_sec - start->tv_sec) * 1000 +
+           (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+/*
+ * Async completion (event-loop thread): issue the relaxed fallback if
+ * needed, otherwise hand the result to the workers.
+ */
+static void lookup_done(LrclibStatus status, LrclibTrack *lrc, void *user)
+{
+    PendingLookup *p = user;
+    SyncEngine *e = p->engine;
+    const TrackMeta *t = p->track;
+
+    if (!p->relaxed && needs_relaxed(status, lrc)) {
+        lrclib_track_free(lrc);
+        p->relaxed = 1;
+        if (lrclib_get_async(t->artist, t->title, NULL, 0,
+                             lookup_done, p) == 0) {
+            return;
+        }
+        status = LRCLIB_ERROR;
+        lrc = NULL;
+    }
+
+    pthread_mutex_lock(&e->mutex);
+    p->status = status;
+    p->lrc    = lrc;
+    ready_push(e, p);
+    lookup_release(e, p);
+    pthread_mutex_unlock(&e->mutex);
+}
+
+/*
+ * Pick a speculative lookup's result as soon as it is known: the exact
+ * answer if it is good enough on its own, otherwise the relaxed one
+ * once both are in, which is what the sequential path would return.
+ * Caller holds the engine mutex.
+ */
+static void spec_resolve(SyncEngine *e, PendingLookup *p)
+{
+    if (p->decided || !p->exact_done) return;
+
+    if (!needs_relaxed(p->status, p->lrc)) {
+        /* The relaxed request was wasted (or is still in flight) */
+        if (p->relaxed) e->result.spec_extra++;
+        ready_push(e, p);
+    } else if (p->relaxed_done) {
+        lrclib_track_free(p->lrc);
+        p->status      = p->relaxed_status;
+        p->lrc         = p->relaxed_lrc;
+        p->relaxed_lrc = NULL;
+
+        /* Sequentially, the relaxed request would have started only
+           after the exact one returned */
+        e->result.spec_saved_ms += p->exact_ms < p->relaxed_ms
+                                 ? p->exact_ms : p->relaxed_ms;
+        ready_push(e, p);
+    }
+}
+
+static void spec_exact_done(LrclibStatus status, LrclibTrack *lrc, void *user)
+{
+    PendingLookup *p = user;
+    SyncEngine *e = p->engine;
+    long ms = ms_since(&p->started);
+
+    pthread_mutex_lock(&e->mutex);
+    p->exact_done = 1;
+    p->exact_ms   = ms;
+    p->status     = status;
+    p->lrc        = lrc;
+    spec_resolve(e, p);
+    lookup_release(e, p);
+    pthread_mutex_unlock(&e->mutex);
+}
+
+static void spec_relaxed_done(LrclibStatus status, LrclibTrack *lrc,
+                              void *user)
+{
+    PendingLookup *p = user;
+    SyncEngine *e = p->engine;
+    long ms = ms_since(&p->started);
+
+    pthread_mutex_lock(&e->mutex);
+    p->relaxed_done   = 1;
+    p->relaxed_ms     = ms;
+    p->relaxed_status = status;
+    p->relaxed_lrc    = lrc;
+    spec_resolve(e, p);
+    lookup_release(e, p);
+    pthread_mutex_unlock(&e->mutex);
+}
+
+/*
+ * Start an async lookup for a claimed track.  Returns 0 if the lookup
+ * is in flight, -1 if the caller must fall back to a blocking one.
+ * In speculative mode the relaxed query goes out right behind the
+ * exact one instead of waiting for it to come back empty.
+ */
+static int start_lookup(SyncEngine *e, SyncAlbum *a, int idx,
+                        const TrackMeta *t)
+{
+    PendingLookup *p = calloc(1, sizeof(PendingLookup));
+    if (!p) return -1;
+
+    int spec = e->config.speculative;
+    p->engine      = e;
+    p->album       = a;
+    p->idx         = idx;
+    p->track       = t;
+    p->outstanding = spec ? 2 : 1;
+    clock_gettime(CLOCK_MONOTONIC, &p->started);
+
+    pthread_mutex_lock(&e->mutex);
+    e->inflight++;
+    pthread_mutex_unlock(&e->mutex);
+
+    if (lrclib_get_async(t->artist, t->title, t->album, (double)t->duration,
+                         spec ? spec_exact_done : lookup_done, p) != 0) {
+        pthread_mutex_lock(&e->mutex);
+        e->inflight--;
+        pthread_mutex_unlock(&e->mutex);
+        free(p);
+        return -1;
+    }
+    if (!spec) return 0;
+
+    /* A cached exact answer may already have settled the track; only
+       a relaxed request that is actually sent can be counted as extra */
+    pthread_mutex_lock(&e->mutex);
+    int decided = p->decided;
+    if (decided) {
+        lookup_release(e, p);
+    } else {
+        p->relaxed = 1;
+    }
+    pthread_mutex_unlock(&e->mutex);
+    if (decided) return 0;
+
+    if (lrclib_get_async(t->artist, t->title, NULL, 0,
+                         spec_relaxed_done, p) != 0) {
+        pthread_mutex_lock(&e->mutex);
+        if (p->decided) e->result.spec_extra--;   /* counted, never sent */
+        p->relaxed        = 0;
+        p->relaxed_done   = 1;
+        p->relaxed_status = LRCLIB_ERROR;
+        spec_resolve(e, p);
+        lookup_release(e, p);
+        pthread_mutex_unlock(&e->mutex);
+    }
+    return 0;
+}
+
+/*
+ * Answer `t` from its album's /search results, running the search when
+ * the first track of the album gets here.  Other workers reaching the
+ * same album meanwhile wait for it rather than send their own /get.
+ * Returns 1 with `r` filled if the track is done.
+ */
+static int try_album_search(SyncEngine *e, SyncAlbum *a, const TrackMeta *t,
+                            TrackResult *r)
+{
+    if (!t->album) return 0;
+
+    pthread_mutex_lock(&e->mutex);
+    while (a->searched == 1) {
+        pthread_cond_wait(&e->work_cond, &e->mutex);
+    }
+    if (a->searched == 0) {
+        a->searched = 1;
+        pthread_mutex_unlock(&e->mutex);
+
+        LrclibAlbum *search = lrclib_search_album(t->artist, t->album);
+
+        pthread_mutex_lock(&e->mutex);
+        a->search   = search;
+        a->searched = 2;
+        if (search) e->result.album_searches++;
+        pthread_cond_broadcast(&e->work_cond);
+    }
+    pthread_mutex_unlock(&e->mutex);
+
+    LrclibTrack *lrc = NULL;
+    if (lrclib_album_match(a->search, t->artist, t->title, t->album,
+                           (double)t->duration, &lrc) != LRCLIB_OK) {
+        return 0;
+    }
+
+    select_lyrics(LRCLIB_OK, lrc, r);
+    pthread_mutex_lock(&e->mutex);
+    e->result.album_matches++;
+    pthread_mutex_unlock(&e->mutex);
+    return 1;
+}
+
+/* ── Retry heap ───────────────────────────────────────────────────────── */
+
+static int due_before(const PendingLookup *a, const PendingLookup *b)
+{
+    if (a->due.tv_sec != b->due.tv_sec) return a->due.tv_sec < b->due.tv_sec;
+    return a->due.tv_nsec < b->due.tv_nsec;
+}
+
+/* Caller holds the engine mutex. */
+static int retry_push(SyncEngine *e, PendingLookup *p)
+{
+    if (e->num_retries >= e->retry_cap) {
+        int cap = e->retry_cap ? e->retry_cap * 2 : 64;
+        PendingLookup **heap = realloc(e->retry_heap,
+                                       (size_t)cap * sizeof(PendingLookup *));
+        if (!heap) return -1;
+        e->retry_heap = heap;
+        e->retry_cap  = cap;
+    }
+
+    int i = e->num_retries++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!due_before(p, e->retry_heap[parent])) break;
+        e->retry_heap[i] = e->retry_heap[parent];
+        i = parent;
+    }
+    e->retry_heap[i] = p;
+    return 0;
+}
+
+/*
+ * Pop the earliest retry, due or not; NULL if the heap is empty.
+ * Caller holds the engine mutex.
+ */
+static PendingLookup *retry_pop(SyncEngine *e)
+{
+    if (e->num_retries == 0) return NULL;
+
+    PendingLookup *top  = e->retry_heap[0];
+    PendingLookup *last = e->retry_heap[--e->num_retries];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= e->num_retries) break;
+        if (child + 1 < e->num_retries &&
+            due_before(e->retry_heap[child + 1], e->retry_heap[child])) {
+            child++;
+        }
+        if (!due_before(e->retry_heap[child], last)) break;
+        e->retry_heap[i] = e->retry_heap[child];
+        i = child;
+    }
+    if (e->num_retries > 0) e->retry_heap[i] = last;
+    return top;
+}
+
+/*
+ * Pop the earliest retry if it is due.  Otherwise return NULL and set
+ * *wait_ms to the time until it is (-1 if the heap is empty).
+ * Caller holds the engine mutex.
+ */
+static PendingLookup *retry_pop_due(SyncEngine *e, long *wait_ms)
+{
+    *wait_ms = -1;
+    if (e->num_retries == 0) return NULL;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    PendingLookup *top = e->retry_heap[0];
+    long ms = (long)(top->due.tv_sec - now.tv_sec) * 1000 +
+              (top->due.tv_nsec - now.tv_nsec) / 1000000;
+    if (ms > 0) {
+        *wait_ms = ms;
+        return NULL;
+    }
+    return retry_pop(e);
+}
+
+/*
+ * Run lookup attempts for `p` until it either finishes or has to wait;
+ * a waiting lookup goes on the retry heap so the worker can move on.
+ * Called without the engine mutex; returns with it held.
+ */
+static void run_lookup(SyncEngine *e, PendingLookup *p)
+{
+    const TrackMeta *t = p->track;
+    int requests = 0;
+    double lookup_ms = 0;
+
+    for (;;) {
+        LrclibTrack *lrc = NULL;
+        double started = mono_ms();
+        LrclibStatus status = p->relaxed
+            ? lrclib_lookup_attempt(t->artist, t->title, NULL, 0,
+                                    &p->retry, &lrc)
+            : lrclib_lookup_attempt(t->artist, t->title, t->album,
+                                    (double)t->duration, &p->retry, &lrc);
+        lookup_ms += mono_ms() - started;
+        requests++;
+
+        if (p->retry.retry_ms > 0) {
+            clock_gettime(CLOCK_MONOTONIC, &p->due);
+            p->due.tv_sec  += p->retry.retry_ms / 1000;
+            p->due.tv_nsec += (p->retry.retry_ms % 1000) * 1000000L;
+            if (p->due.tv_nsec >= 1000000000L) {
+                p->due.tv_sec++;
+                p->due.tv_nsec -= 1000000000L;
+            }
+
+            pthread_mutex_lock(&e->mutex);
+            tune_note(e, requests, lookup_ms, 1);
+            requests  = 0;
+            lookup_ms = 0;
+            if (retry_push(e, p) == 0) {
+                /* Sleeping workers may need a shorter timeout now */
+                pthread_cond_broadcast(&e->work_cond);
+                return;
+            }
+            pthread_mutex_unlock(&e->mutex);
+            status = LRCLIB_ERROR;
+        }
+
+        /* Fallback: relax constraints if lyrics or track not found */
+        if (!p->relaxed && needs_relaxed(status, lrc)) {
+            lrclib_track_free(lrc);
+            p->relaxed = 1;
+            memset(&p->retry, 0, sizeof(p->retry));
+            continue;
+        }
+
+        TrackResult r = { .status = "" };
+        select_lyrics(status, lrc, &r);
+        complete_track(e, p->album, p->idx, t, &r);
+        tune_note(e, requests, lookup_ms, r.error);
+        free(p);
+        return;
+    }
+}
+
+static void *sync_worker(void *arg)
+{
+    SyncEngine *e = (SyncEngine *)arg;
+
+    /* Without an arena lookups simply use the heap */
+    Arena *arena = arena_new();
+    arena_set_thread(arena);
+    double started = mono_ms();
+
+    pthread_mutex_lock(&e->mutex);
+    int id = e->next_worker_id++;
+    for (;;) {
+        if (e->tuning) tune_step(e);
+
+        /* Parked by the tuner: take no work until let back in */
+        if (id >= e->active_threads) {
+            if (e->closing && !e->head && e->inflight == 0 &&
+                e->num_retries == 0) {
+                break;
+            }
+            meter_wait(e, &e->work_cond, &e->lookup_meter.idle_ms);
+            continue;
+        }
+
+        /* Completed lookups first: they free in-flight slots */
+        PendingLookup *p = e->ready_head;
+        if (p) {
+            e->ready_head = p->next;
+            if (!e->ready_head) e->ready_tail = NULL;
+            pthread_mutex_unlock(&e->mutex);
+            arena_reset(arena);
+
+            TrackResult r = { .status = "" };
+            LrclibTrack *lrc = p->lrc;
+            p->lrc = NULL;
+            select_lyrics(p->status, lrc, &r);
+            complete_track(e, p->album, p->idx, p->track, &r);
+
+            /* A speculative request may still be in flight */
+            p->written = 1;
+            if (p->outstanding == 0) pending_free(p);
+            continue;
+        }
+
+        /* Then retries whose time has come; after a stop, all of them
+           are dropped at once */
+        int stopping = atomic_load(&stop_requested);
+        long wait_ms = -1;
+        p = stopping ? retry_pop(e) : retry_pop_due(e, &wait_ms);
+        if (p) {
+            pthread_mutex_unlock(&e->mutex);
+            arena_reset(arena);
+            if (stopping) {
+                interrupt_track(e, p->album, p->idx, p->track);
+                free(p);
+            } else {
+                run_lookup(e, p);
+            }
+            continue;
+        }
+
+        int idx = 0;
+        const TrackMeta *t = NULL;
+        SyncAlbum *a = NULL;
+        if (!e->async || e->inflight < e->max_inflight) {
+            a = claim_track(e, &idx, &t);
+        }
+        if (!a) {
+            if (e->closing && !e->head && e->inflight == 0 &&
+                e->num_retries == 0) {
+                /* Parked workers wait for this too */
+                pthread_cond_broadcast(&e->work_cond);
+                break;
+            }
+            if (wait_ms >= 0) {
+                /* A stop request cannot wake us; look again soon */
+                if (wait_ms > STOP_POLL_MS) wait_ms = STOP_POLL_MS;
+                struct timespec until;
+                clock_gettime(CLOCK_MONOTONIC, &until);
+                until.tv_sec  += wait_ms / 1000;
+                until.tv_nsec += (wait_ms % 1000) * 1000000L;
+                if (until.tv_nsec >= 1000000000L) {
+                    until.tv_sec++;
+                    until.tv_nsec -= 1000000000L;
+                }
+                double idle = mono_ms();
+                pthread_cond_timedwait(&e->work_cond, &e->mutex, &until);
+                e->lookup_meter.idle_ms += mono_ms() - idle;
+            } else {
+                meter_wait(e, &e->work_cond, &e->lookup_meter.idle_ms);
+            }
+            continue;
+        }
+        pthread_cond_signal(&e->space_cond);
+        pthread_mutex_unlock(&e->mutex);
+        arena_reset(arena);
+
+        if (stopping) {
+            interrupt_track(e, a, idx, t);
+            continue;
+        }
+
+        TrackResult r;
+        if (prepare_track(t, &e->config, &r) &&
+            !(e->config.album_search && try_album_search(e, a, t, &r))) {
+            if (e->async && start_lookup(e, a, idx, t) == 0) {
+                pthread_mutex_lock(&e->mutex);
+                continue;
+            }
+
+            PendingLookup *lookup = calloc(1, sizeof(PendingLookup));
+            if (lookup) {
+                lookup->engine = e;
+                lookup->album  = a;
+                lookup->idx    = idx;
+                lookup->track  = t;
+                run_lookup(e, lookup);
+                continue;
+            }
+            try_api_lrc(t, &r);
+        }
+
+        complete_track(e, a, idx, t, &r);
+    }
+    e->lookup_meter.thread_ms += mono_ms() - started;
+    pthread_mutex_unlock(&e->mutex);
+
+    arena_set_thread(NULL);
+    arena_free(arena);
+    http_thread_cleanup();
+    return NULL;
+}
+
+/*
+ * Create an album and link it into the queue.
+ */
+static SyncAlbum *album_new(SyncEngine *e, void *user)
+{
+    SyncAlbum *a = calloc(1, sizeof(SyncAlbum));
+    if (!a) return NULL;
+
+    a->engine     = e;
+    a->owns_items = 1;
+    a->user       = user;
+
+    pthread_mutex_lock(&e->mutex);
+    if (e->tail) e->tail->next = a; else e->head = a;
+    e->tail = a;
+    a->queued = 1;
+    pthread_mutex_unlock(&e->mutex);
+    return a;
+}
+
+/*
+ * Hand `n` tracks to an album in one step, blocking while the queue is
+ * full.  A batch larger than the whole queue is still admitted once the
+ * queue has drained, so big albums cannot deadlock.
+ */
+static void album_push(SyncAlbum *a, TrackMeta **items, int n)
+{
+    SyncEngine *e = a->engine;
+
+    pthread_mutex_lock(&e->mutex);
+    while (e->pending > 0 && e->pending + n > e->max_pending) {
+        pthread_cond_wait(&e->space_cond, &e->mutex);
+    }
+
+    if (items != a->items) {
+        for (int i = 0; i < n; i++) a->items[a->count + i] = items[i];
+    }
+    a->count   += n;
+    e->pending += n;
+    meter_depth(&e->lookup_meter, e->pending);
+
+    pthread_cond_broadcast(&e->work_cond);
+    pthread_mutex_unlock(&e->mutex);
+}
+
+/* ── Public API ───────────────────────────────────────────────────────── */
+
+void sync_request_stop(void)
+{
+    atomic_store(&stop_requested, 1);
+}
+
+int sync_stop_requested(void)
+{
+    return atomic_load(&stop_requested);
+}
+
+int sync_cpu_count(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+
+    /* A container's CPU quota caps what the visible CPUs can deliver */
+    double quota;
+    if (cgroup_cpu_quota(&quota)) {
+        long q = (long)quota;
+        if ((double)q < quota) q++;
+        if (q < 1) q = 1;
+        if (q < n) n = q;
+    }
+    return (int)n;
+}
+
+int sync_thread_ceiling(void)
+{
+    long n = (long)sync_cpu_count() * SYNC_THREADS_PER_CPU;
+    return n < SYNC_MAX_THREADS ? (int)n : SYNC_MAX_THREADS;
+}
+
+SyncEngine *sync_engine_new(const SyncConfig *config, SyncProgressFn progress,
+                            SyncAlbumDoneFn album_done)
+{
+    if (!config) return NULL;
+
+    SyncEngine *e = calloc(1, sizeof(SyncEngine));
+    if (!e) return NULL;
+
+    e->config       = *config;
+    e->progress     = progress;
+    e->album_done   = album_done;
+    e->num_threads  = config->num_threads > 0 ? config->num_threads : 1;
+    e->num_writers  = config->write_threads > 0 ? config->write_threads
+                                                : e->num_threads;
+
+    /* The in-flight cap, not the pool, sets async lookup concurrency */
+    e->async        = config->max_inflight > 0 && http_async_running();
+    e->tuning       = config->auto_threads && !e->async;
+    e->min_threads  = config->min_threads > 0 ? config->min_threads : 1;
+    e->max_threads  = config->max_threads > 0 ? config->max_threads
+                                              : sync_thread_ceiling();
+    if (e->max_threads < e->min_threads) e->max_threads = e->min_threads;
+    if (e->tuning) {
+        if (e->num_threads < e->min_threads) e->num_threads = e->min_threads;
+        if (e->num_threads > e->max_threads) e->num_threads = e->max_threads;
+    } else {
+        e->max_threads = e->num_threads;
+    }
+    e->active_threads = e->num_threads;
+    e->tune.peak      = e->num_threads;
+
+    /* Sized for the largest pool, so growing does not block the scan */
+    e->max_pending  = e->max_threads * SYNC_QUEUE_PER_THREAD;
+    e->max_writes   = e->num_writers * WRITE_QUEUE_PER_THREAD;
+    e->max_inflight = config->max_inflight;
+    e->plain_file   = config->out_plain ? fopen(config->out_plain, "a") : NULL;
+    e->missing_file = config->out_missing ? fopen(config->out_missing, "a") : NULL;
+
+    atomic_init(&e->events, NULL);
+    e->started_ms = mono_ms();
+    e->tune.started_ms = e->started_ms;
+    e->lookup_meter.changed_ms = e->started_ms;
+    e->write_meter.changed_ms  = e->started_ms;
+
+    pthread_mutex_init(&e->mutex, NULL);
+    pthread_mutex_init(&e->report_mutex, NULL);
+    pthread_mutex_init(&e->emit_mutex, NULL);
+    pthread_cond_init(&e->report_cond, NULL);
+    pthread_cond_init(&e->space_cond, NULL);
+    pthread_cond_init(&e->write_cond, NULL);
+    pthread_cond_init(&e->write_space_cond, NULL);
+
+    /* Retry deadlines are monotonic */
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&e->work_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    e->threads   = calloc((size_t)e->max_threads, sizeof(pthread_t));
+    e->writers   = calloc((size_t)e->num_writers, sizeof(pthread_t));
+    e->busy_devs = calloc((size_t)e->num_writers, sizeof(dev_t));
+    if (!e->threads || !e->writers || !e->busy_devs) {
+        e->num_threads = 0;
+        e->num_writers = 0;
+        sync_engine_finish(e);
+        return NULL;
+    }
+
+    /* Without a reporter thread, workers report inline */
+    e->has_reporter = pthread_create(&e->reporter, NULL, sync_reporter,
+                                     e) == 0;
+
+    /* Without writers the lookup workers write inline */
+    for (int i = 0; i < e->num_writers; i++) {
+        if (pthread_create(&e->writers[i], NULL, sync_writer, e) != 0) {
+            e->num_writers = i;
+            break;
+        }
+    }
+
+    /* The tuner may start more workers, so count them under the lock */
+    pthread_mutex_lock(&e->mutex);
+    for (int i = 0; i < e->num_threads; i++) {
+        if (pthread_create(&e->threads[i], NULL, sync_worker, e) != 0) {
+            e->num_threads = i;
+            break;
+        }
+    }
+    e->active_threads = e->num_threads;
+    pthread_mutex_unlock(&e->mutex);
+    if (e->num_threads == 0) {
+        sync_engine_finish(e);
+        return NULL;
+    }
+
+    return e;
+}
+
+SyncAlbum *sync_engine_begin_album(SyncEngine *e, void *user)
+{
+    if (!e) return NULL;
+    return album_new(e, user);
+}
+
+int sync_album_add(SyncAlbum *a, TrackMeta *meta)
+{
+    if (!a || !meta) return -1;
+    SyncEngine *e = a->engine;
+
+    /* Workers read items[] under the mutex, so growing it needs it too */
+    if (a->count >= a->capacity) {
+        int cap = a->capacity ? a->capacity * 2 : 16;
+        pthread_mutex_lock(&e->mutex);
+        TrackMeta **items = realloc(a->items, (size_t)cap * sizeof(TrackMeta *));
+        if (items) {
+            a->items    = items;
+            a->capacity = cap;
+        }
+        pthread_mutex_unlock(&e->mutex);
+        if (!items) return -1;
+    }
+
+    album_push(a, &meta, 1);
+    return 0;
+}
+
+void sync_album_end(SyncAlbum *a)
+{
+    if (!a) return;
+    SyncEngine *e = a->engine;
+
+    pthread_mutex_lock(&e->mutex);
+    a->closed = 1;
+    if (a->queued && a->next_index >= a->count) album_unlink(e, a);
+    int count = a->count;
+    /* Workers may be waiting for this album to drain before exiting */
+    pthread_cond_broadcast(&e->work_cond);
+    pthread_mutex_unlock(&e->mutex);
+
+    /* The reporter releases the album once its tracks are all in */
+    SyncEvent ev = { .album = a, .idx = count };
+    report(e, &ev);
+}
+
+int sync_engine_submit(SyncEngine *e, TrackMetaList *list, void *user)
+{
+    if (!e || !list) return -1;
+
+    SyncAlbum *a = album_new(e, user);
+    if (!a) return -1;
+
+    /* Adopt the list's array; the tracks become visible in one batch */
+    a->items    = list->items;
+    a->capacity = list->count;
+    album_push(a, a->items, list->count);
+    free(list);
+
+    sync_album_end(a);
+    return 0;
+}
+
+void sync_engine_log_skipped(SyncEngine *e, const char *filepath,
+                             StateOutcome outcome)
+{
+    /* stdio locks the stream, so this can interleave with the reporter */
+    if (outcome == STATE_PLAIN && e->plain_file) {
+        fprintf(e->plain_file, "%s\n", filepath);
+    } else if (outcome == STATE_MISSING && e->missing_file) {
+        fprintf(e->missing_file, "%s\n", filepath);
+    }
+}
+
+SyncResult sync_engine_finish(SyncEngine *e)
+{
+    SyncResult empty = {0};
+    if (!e) return empty;
+
+    pthread_mutex_lock(&e->mutex);
+    e->closing = 1;
+    pthread_cond_broadcast(&e->work_cond);
+    pthread_mutex_unlock(&e->mutex);
+
+    /* Workers may still be starting others while the backlog drains */
+    for (int i = 0;; i++) {
+        pthread_mutex_lock(&e->mutex);
+        int started = e->num_threads;
+        pthread_mutex_unlock(&e->mutex);
+        if (i >= started) break;
+        pthread_join(e->threads[i], NULL);
+    }
+
+    /* Lookups are over; let the writers drain the queue and exit */
+    pthread_mutex_lock(&e->mutex);
+    e->writers_closing = 1;
+    pthread_cond_broadcast(&e->write_cond);
+    pthread_mutex_unlock(&e->mutex);
+
+    for (int i = 0; i < e->num_writers; i++) {
+        pthread_join(e->writers[i], NULL);
+    }
+
+    if (e->has_reporter) {
+        pthread_mutex_lock(&e->report_mutex);
+        e->reporter_stop = 1;
+        pthread_cond_signal(&e->report_cond);
+        pthread_mutex_unlock(&e->report_mutex);
+        pthread_join(e->reporter, NULL);
+    }
+
+    SyncResult result = e->result;
+    double run_ms = mono_ms() - e->started_ms;
+    result.lookup_stage = stage_stats(&e->lookup_meter, e->num_threads,
+                                      run_ms);
+    result.write_stage  = stage_stats(&e->write_meter, e->num_writers,
+                                      run_ms);
+    if (e->tuning) {
+        result.threads_end  = e->active_threads;
+        result.threads_peak = e->tune.peak;
+        result.threads_max  = e->max_threads;
+    }
+
+    free(e->threads);
+    free(e->writers);
+    free(e->busy_devs);
+    free(e->retry_heap);
+    pthread_cond_destroy(&e->space_cond);
+    pthread_cond_destroy(&e->work_cond);
+    pthread_cond_destroy(&e->write_cond);
+    pthread_cond_destroy(&e->write_space_cond);
+    pthread_cond_destroy(&e->report_cond);
+    pthread_mutex_destroy(&e->emit_mutex);
+    pthread_mutex_destroy(&e->report_mutex);
+    pthread_mutex_destroy(&e->mutex);
+
+    if (e->plain_file) fclose(e->plain_file);
+    if (e->missing_file) fclose(e->missing_file);
+
+    free(e);
+    return result;
+}
+
+SyncResult sync_tracks(const TrackMetaList *list, const SyncConfig *config,
+                         SyncProgressFn progress, void *user)
+{
+    SyncResult empty = {0};
+    if (!list || list->count == 0 || !config) return empty;
+
+    /* No point spawning more workers than there are tracks */
+    SyncConfig cfg = *config;
+    if (cfg.num_threads > list->count) cfg.num_threads = list->count;
+    if (cfg.auto_threads && (cfg.max_threads <= 0 ||
+                             cfg.max_threads > list->count)) {
+        cfg.max_threads = list->count;
+    }
+    if (cfg.write_threads > list->count) cfg.write_threads = list->count;
+
+    SyncEngine *e = sync_engine_new(&cfg, progress, NULL);
+    if (!e) return empty;
+
+    SyncAlbum *a = album_new(e, user);
+    if (a) {
+        /* Borrow the caller's tracks; the caller still frees the list */
+        a->items      = list->items;
+        a->capacity   = list->count;
+        a->owns_items = 0;
+        album_push(a, a->items, list->count);
+        sync_album_end(a);
+    }
+    return sync_engine_finish(e);
 }
@@ -0,0 +1,152 @@
+/*
+ * crawl_check.c — Checks of the library crawler against a fixture tree
+ *
+ * Crawls tests/fixtures/library (albums at two depths, a multi-disc
+ * album, hidden entries, non-audio files) together with
+ * tests/fixtures/library2 (audio files in the root itself), and checks
+ * every reported directory, its audio files and the totals.  Also
+ * checks an early stop and roots that cannot be opened.
+ *
+ *   make check      (or: build/crawl_check <fixtures dir>)
+ */
+
+#include "crawl.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CRAWL_THREADS 4
+#define MAX_SEEN      32
+
+static int checks, failures;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        checks++;                                                       \
+        if (!(cond)) {                                                  \
+            failures++;                                                 \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                         \
+        }                                                               \
+    } while (0)
+
+/*
+ * Every album directory the crawler reported, as "rel|name|files..."
+ * with the files in the order given.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    char           *seen[MAX_SEEN];
+    int             count;
+    int             stop_after;   /* > 0: stop the crawl after that many */
+} Seen;
+
+/* Albums of the fixtures, sorted */
+static const char *const expected[] = {
+    "Artist A/Album 1|Album 1|01 Intro.flac|02 Song.MP3",
+    "Artist A/Album 2/CD1|CD1|01.flac",
+    "Artist A/Album 2/CD2|CD2|01.ogg",
+    "Artist B/Single|Single|01.m4a",
+    "|library2|01 Loose.opus",
+};
+
+#define NUM_EXPECTED ((int)(sizeof(expected) / sizeof(expected[0])))
+
+/* ── Internal helpers ──────────────────────────────────────────────────── */
+
+static int on_album(const CrawlDir *dir, void *user)
+{
+    Seen *s = user;
+
+    char buf[1024];
+    int n = snprintf(buf, sizeof(buf), "%s|%s", dir->rel, dir->name);
+    for (int i = 0; i < dir->num_files && n < (int)sizeof(buf); i++) {
+        n += snprintf(buf + n, sizeof(buf) - (size_t)n, "|%s",
+                      dir->files[i]);
+    }
+
+    size_t plen = strlen(dir->path), rlen = strlen(dir->rel);
+
+    pthread_mutex_lock(&s->lock);
+    /* The full path is the root joined with the relative path */
+    CHECK(rlen == 0 || (plen > rlen && dir->path[plen - rlen - 1] == '/' &&
+                        strcmp(dir->path + plen - rlen, dir->rel) == 0));
+    if (s->count < MAX_SEEN) s->seen[s->count++] = strdup(buf);
+    int stop = s->stop_after > 0 && s->count >= s->stop_after;
+    pthread_mutex_unlock(&s->lock);
+    return stop;
+}
+
+static int compare_strings(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void seen_reset(Seen *s)
+{
+    for (int i = 0; i < s->count; i++) free(s->seen[i]);
+    s->count = 0;
+}
+
+/* ── Main ─────────────────────────────────────────────────────────────── */
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <fixtures dir>\n", argv[0]);
+        return 2;
+    }
+
+    char library[1024], library2[1024], missing[1024];
+    snprintf(library, sizeof(library), "%s/library", argv[1]);
+    snprintf(library2, sizeof(library2), "%s/library2/", argv[1]);
+    snprintf(missing, sizeof(missing), "%s/no-such-dir", argv[1]);
+
+    Seen s = { .lock = PTHREAD_MUTEX_INITIALIZER };
+    CrawlStats stats;
+
+    /* Two roots, one with a trailing slash, crawled in parallel */
+    const char *roots[] = { library, library2 };
+    CHECK(crawl_tree(roots, 2, CRAWL_THREADS, on_album, &s, &stats) == 0);
+
+    qsort(s.seen, (size_t)s.count, sizeof(char *), compare_strings);
+    CHECK(s.count == NUM_EXPECTED);
+    for (int i = 0; i < s.count && i < NUM_EXPECTED; i++) {
+        if (strcmp(s.seen[i], expected[i]) != 0) {
+            fprintf(stderr, "crawl: got \"%s\", expected \"%s\"\n",
+                    s.seen[i], expected[i]);
+        }
+        CHECK(strcmp(s.seen[i], expected[i]) == 0);
+    }
+
+    /* Hidden directories are not read; Album 2 counts as an artist */
+    CHECK(stats.dirs == 9);
+    CHECK(stats.files == 6);
+    CHECK(stats.albums == NUM_EXPECTED);
+    CHECK(stats.artists == 3);
+    seen_reset(&s);
+
+    /* A stop from the callback ends the crawl */
+    s.stop_after = 1;
+    CHECK(crawl_tree(roots, 1, 1, on_album, &s, &stats) == 0);
+    CHECK(s.count == 1);
+    seen_reset(&s);
+    s.stop_after = 0;
+
+    /* A root that cannot be opened is skipped, and fails on its own */
+    const char *mixed[] = { missing, library2 };
+    CHECK(crawl_tree(mixed, 2, CRAWL_THREADS, on_album, &s, &stats) == 0);
+    CHECK(s.count == 1 && stats.albums == 1);
+    seen_reset(&s);
+    CHECK(crawl_tree(mixed, 1, CRAWL_THREADS, on_album, &s, &stats) == -1);
+    CHECK(s.count == 0);
+
+    if (failures > 0) {
+        fprintf(stderr, "crawl: %d of %d checks failed\n", failures, checks);
+        return 1;
+    }
+    printf("crawl: %d checks passed\n", checks);
+    return 0;
+}
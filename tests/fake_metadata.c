@@ -0,0 +1,74 @@
+/*
+ * fake_metadata.c — Stand-in for metadata.c in the checks
+ *
+ * Implements the parts of metadata.h the crawler and the sync engine
+ * call, without TagLib: audio files are recognized by extension as in
+ * metadata.c, and "embedding" lyrics appends a LYRICS= line to what is
+ * a plain text file in the fixtures.
+ */
+
+#include "metadata.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *AUDIO_EXTENSIONS[] = {
+    ".flac", ".mp3", ".ogg", ".m4a", ".opus", ".wma", ".wav", ".aac",
+    NULL
+};
+
+int metadata_is_audio_file(const char *filename)
+{
+    const char *dot = strrchr(filename, '.');
+    if (!dot) return 0;
+
+    for (int i = 0; AUDIO_EXTENSIONS[i]; i++) {
+        if (strcasecmp(dot, AUDIO_EXTENSIONS[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+int metadata_sync_lyrics(const char *filepath, const char *lyrics, int force)
+{
+    if (!filepath || !lyrics) return -1;
+
+    FILE *f = fopen(filepath, "r+");
+    if (!f) return -1;
+
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+        if (!force && strncmp(line, "LYRICS=", 7) == 0) {
+            fclose(f);
+            return 0;
+        }
+    }
+
+    /* One line per write; newlines in the lyrics become '|' */
+    fseek(f, 0, SEEK_END);
+    fputs("LYRICS=", f);
+    for (const char *p = lyrics; *p; p++) {
+        fputc(*p == '\n' ? '|' : *p, f);
+    }
+    fputc('\n', f);
+    return fclose(f) == 0 ? 1 : -1;
+}
+
+void metadata_free(TrackMeta *meta)
+{
+    if (!meta) return;
+    free(meta->title);
+    free(meta->artist);
+    free(meta->album);
+    free(meta->filepath);
+    free(meta);
+}
+
+void metadata_list_free(TrackMetaList *list)
+{
+    if (!list) return;
+    for (int i = 0; i < list->count; i++) metadata_free(list->items[i]);
+    free(list->items);
+    free(list);
+}
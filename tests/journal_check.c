@@ -0,0 +1,131 @@
+/*
+ * journal_check.c — Checks of opening and resuming the checkpoint journal
+ *
+ * Opens journals over an empty file, a file cut off inside the magic
+ * line, a file that is not a journal and a journal with a torn last
+ * line, and checks what is loaded and what is left on disk.
+ *
+ *   make check      (or: build/journal_check <work dir>)
+ */
+
+#include "journal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAGIC "synclyr2metadata journal 1\n"
+
+static int checks, failures;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        checks++;                                                       \
+        if (!(cond)) {                                                  \
+            failures++;                                                 \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                         \
+        }                                                               \
+    } while (0)
+
+/* ── Internal helpers ──────────────────────────────────────────────────── */
+
+static void write_file(const char *path, const char *text)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        exit(2);
+    }
+    fputs(text, f);
+    fclose(f);
+}
+
+/* Whether the file at `path` holds exactly `text` */
+static int file_is(const char *path, const char *text)
+{
+    char buf[256];
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+    return strcmp(buf, text) == 0;
+}
+
+/* ── Main ─────────────────────────────────────────────────────────────── */
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <work dir>\n", argv[0]);
+        return 2;
+    }
+    if (mkdir(argv[1], 0755) != 0) {
+        perror(argv[1]);
+        return 2;
+    }
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/journal", argv[1]);
+    Journal *j;
+
+    /* An empty file is a fresh journal, resumed or not */
+    for (int resume = 0; resume <= 1; resume++) {
+        write_file(path, "");
+        j = journal_open(path, resume);
+        CHECK(j && journal_count(j) == 0);
+        journal_close(j, 0);
+        CHECK(file_is(path, MAGIC));
+    }
+
+    /* So is one cut off inside the magic line */
+    for (int resume = 0; resume <= 1; resume++) {
+        write_file(path, "synclyr2meta");
+        j = journal_open(path, resume);
+        CHECK(j && journal_count(j) == 0);
+        if (j) journal_add(j, "/music/a.flac", STATE_SYNCED);
+        journal_close(j, 0);
+        CHECK(file_is(path, MAGIC "1 /music/a.flac\n"));
+    }
+
+    /* Anything else is left alone */
+    write_file(path, "synclyr2metadata journal 2\n");
+    CHECK(journal_open(path, 1) == NULL);
+    CHECK(file_is(path, "synclyr2metadata journal 2\n"));
+    write_file(path, "not a journal");
+    CHECK(journal_open(path, 0) == NULL);
+    CHECK(file_is(path, "not a journal"));
+
+    /* Resume loads the complete lines and drops a torn last one */
+    write_file(path, MAGIC "1 /music/a.flac\n2 /music/b.flac\n1 /mus");
+    j = journal_open(path, 1);
+    CHECK(j && journal_count(j) == 2);
+    if (j) {
+        CHECK(journal_is_done(j, "/music/a.flac"));
+        CHECK(journal_is_done(j, "/music/b.flac"));
+        CHECK(!journal_is_done(j, "/mus"));
+        journal_add(j, "/music/c.flac", STATE_MISSING);
+    }
+    journal_close(j, 0);
+    CHECK(file_is(path, MAGIC "1 /music/a.flac\n2 /music/b.flac\n"
+                        "3 /music/c.flac\n"));
+
+    /* Without resume the journal starts over; a finished run removes it */
+    j = journal_open(path, 0);
+    CHECK(j && journal_count(j) == 0 && !journal_is_done(j, "/music/a.flac"));
+    journal_close(j, 1);
+    struct stat st;
+    CHECK(stat(path, &st) != 0);
+    rmdir(argv[1]);
+
+    if (failures > 0) {
+        fprintf(stderr, "journal: %d of %d checks failed\n", failures,
+                checks);
+        return 1;
+    }
+    printf("journal: %d checks passed\n", checks);
+    return 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * json_scan_check.c — Checks of the single-pass JSON field scanner
+ *
+ * Scans objects for the members an LRCLIB /get response is read for,
+ * decodes their strings (escapes, surrogate pairs, lone halves), and
+ * checks that malformed documents are rejected.
+ *
+ *   make check      (or: build/json_scan_check)
+ */
+
+#include "json_scan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int checks, failures;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        checks++;                                                       \
+        if (!(cond)) {                                                  \
+            failures++;                                                 \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                         \
+        }                                                               \
+    } while (0)
+
+/* ── Internal helpers ──────────────────────────────────────────────────── */
+
+/*
+ * Scan a copy of `json` for the single member `key`.  Returns the scan
+ * result; the field and the copy (to free) are left in `f` and `*buf`.
+ */
+static int scan_one(const char *json, const char *key, JsonField *f,
+                    char **buf)
+{
+    *buf = strdup(json);
+    if (!*buf) {
+        perror("strdup");
+        exit(2);
+    }
+    *f = (JsonField){ .key = key };
+    return json_scan_object(*buf, f, 1);
+}
+
+/* Whether member `key` of `json` is the string `want` once decoded */
+static int decodes_to(const char *json, const char *key, const char *want)
+{
+    JsonField f;
+    char *buf;
+    int ok = scan_one(json, key, &f, &buf) == 0;
+    const char *got = ok ? json_field_string(&f) : NULL;
+    ok = got && strcmp(got, want) == 0 && f.len == strlen(want);
+    free(buf);
+    return ok;
+}
+
+static int is_rejected(const char *json)
+{
+    JsonField f;
+    char *buf;
+    int rc = scan_one(json, "a", &f, &buf);
+    free(buf);
+    return rc == -1;
+}
+
+/* ── Main ─────────────────────────────────────────────────────────────── */
+
+int main(void)
+{
+    /* The members of a /get response, among nested and unknown ones */
+    char get[] =
+        " {\"id\":7,\"plainLyricsX\":1,\"trackName\":\"}\\\"{\","
+        "\"extra\":{\"plainLyrics\":\"nested\",\"list\":[1,-2.5e+3,{}]},"
+        "\"instrumental\":false,\"plainLyrics\":\"Line 1\\nLine 2\","
+        "\"syncedLyrics\":null,\"duration\":-1.5E-2,"
+        "\"plainLyrics\":\"second\"}\n";
+    JsonField fields[] = {
+        { .key = "plainLyrics" },
+        { .key = "syncedLyrics" },
+        { .key = "instrumental" },
+        { .key = "duration" },
+        { .key = "albumName" },
+    };
+    CHECK(json_scan_object(get, fields, 5) == 0);
+    CHECK(fields[0].kind == JSON_STRING);
+    CHECK(fields[1].kind == JSON_NULL);
+    CHECK(fields[2].kind == JSON_FALSE);
+    CHECK(fields[3].kind == JSON_NUMBER && fields[3].len == 7 &&
+          strncmp(fields[3].raw, "-1.5E-2", 7) == 0);
+    CHECK(fields[4].kind == JSON_ABSENT);
+
+    /* The first top-level occurrence wins; nested ones do not count */
+    char *plain = json_field_string(&fields[0]);
+    CHECK(plain && strcmp(plain, "Line 1\nLine 2") == 0);
+    CHECK(json_field_string(&fields[1]) == NULL);
+
+    /* Empty objects, kinds of other values */
+    JsonField f;
+    char *buf;
+    CHECK(scan_one(" { } ", "a", &f, &buf) == 0 && f.kind == JSON_ABSENT);
+    free(buf);
+    CHECK(scan_one("{\"a\":[true]}", "a", &f, &buf) == 0 &&
+          f.kind == JSON_OTHER);
+    free(buf);
+    CHECK(scan_one("{\"a\":true}", "a", &f, &buf) == 0 && f.kind == JSON_TRUE);
+    free(buf);
+
+    /* Decoding: escapes, \u to UTF-8, pairs and lone halves */
+    CHECK(decodes_to("{\"a\":\"\"}", "a", ""));
+    CHECK(decodes_to("{\"a\":\"no escapes\"}", "a", "no escapes"));
+    CHECK(decodes_to("{\"a\":\"\\\"q\\\" \\\\ \\/ \\b\\f\\n\\r\\t\"}", "a",
+                     "\"q\" \\ / \b\f\n\r\t"));
+    CHECK(decodes_to("{\"a\":\"caf\\u00e9 \\u00E9t\\u00e9 \\u20ac\"}", "a",
+                     "caf\xc3\xa9 \xc3\xa9t\xc3\xa9 \xe2\x82\xac"));
+    CHECK(decodes_to("{\"a\":\"\\ud83c\\udfb5 note\"}", "a",
+                     "\xf0\x9f\x8e\xb5 note"));
+    CHECK(decodes_to("{\"a\":\"\\ud83c x \\udfb5\"}", "a",
+                     "\xef\xbf\xbd x \xef\xbf\xbd"));
+    CHECK(decodes_to("{\"a\":\"[00:01.00] a line longer than a run\\n"
+                     "[00:02.00] and the next one\"}", "a",
+                     "[00:01.00] a line longer than a run\n"
+                     "[00:02.00] and the next one"));
+    CHECK(decodes_to("{\"a\":\"caf\xc3\xa9 raw UTF-8\"}", "a",
+                     "caf\xc3\xa9 raw UTF-8"));
+
+    /* Malformed documents */
+    CHECK(is_rejected(""));
+    CHECK(is_rejected("[]"));
+    CHECK(is_rejected("{"));
+    CHECK(is_rejected("{\"a\"}"));
+    CHECK(is_rejected("{\"a\":}"));
+    CHECK(is_rejected("{\"a\":1,}"));
+    CHECK(is_rejected("{\"a\":1 \"b\":2}"));
+    CHECK(is_rejected("{a:1}"));
+    CHECK(is_rejected("{\"a\":tru}"));
+    CHECK(is_rejected("{\"a\":\"open}"));
+    CHECK(is_rejected("{\"a\":\"\\x\"}"));
+    CHECK(is_rejected("{\"a\":\"\\u12g4\"}"));
+    CHECK(is_rejected("{\"a\":01}"));
+    CHECK(is_rejected("{\"a\":1.}"));
+    CHECK(is_rejected("{\"a\":-}"));
+    CHECK(is_rejected("{\"a\":[1,2}"));
+    CHECK(is_rejected("{\"a\":1} trailing"));
+    CHECK(is_rejected("{\"a\":1}{\"a\":2}"));
+
+    /* Nesting is capped */
+    char deep[200];
+    int n = snprintf(deep, sizeof(deep), "{\"a\":");
+    for (int i = 0; i < 70; i++) deep[n++] = '[';
+    for (int i = 0; i < 70; i++) deep[n++] = ']';
+    strcpy(deep + n, "}");
+    CHECK(is_rejected(deep));
+
+    if (failures > 0) {
+        fprintf(stderr, "json_scan: %d of %d checks failed\n", failures,
+                checks);
+        return 1;
+    }
+    printf("json_scan: %d checks passed\n", checks);
+    return 0;
+}
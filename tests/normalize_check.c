@@ -0,0 +1,71 @@
+/*
+ * normalize_check.c — Checks of name normalization and suffix stripping
+ *
+ * Runs normalize_stripped() over names with trailing, bracketed and
+ * mid-title suffixes, and names that must come through unstripped.
+ *
+ *   make check      (or: build/normalize_check)
+ */
+
+#include "normalize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int checks, failures;
+
+/* ── Internal helpers ──────────────────────────────────────────────────── */
+
+static void check_stripped(const char *file, int line, const char *name,
+                           const char *want)
+{
+    char *got = normalize_stripped(name);
+    checks++;
+    if (!got || strcmp(got, want) != 0) {
+        failures++;
+        fprintf(stderr, "%s:%d: check failed: \"%s\" stripped to \"%s\", "
+                "expected \"%s\"\n", file, line, name,
+                got ? got : "(null)", want);
+    }
+    free(got);
+}
+
+#define CHECK_STRIPPED(name, want) \
+    check_stripped(__FILE__, __LINE__, name, want)
+
+/* ── Main ─────────────────────────────────────────────────────────────── */
+
+int main(void)
+{
+    /* Trailing suffixes go to the end */
+    CHECK_STRIPPED("Artist feat. Somebody", "artist");
+    CHECK_STRIPPED("Beyonc\xc3\xa9 ft. JAY Z", "beyonc\xc3\xa9");
+    CHECK_STRIPPED("Song (Remastered 2011)", "song");
+    CHECK_STRIPPED("Here Comes the Sun - Remastered 2009",
+                   "here comes the sun");
+    CHECK_STRIPPED("Artist, feat. Other & Another", "artist");
+
+    /* A bracketed suffix takes only its group; the rest stays */
+    CHECK_STRIPPED("Hit (feat. X) Remix", "hit remix");
+    CHECK_STRIPPED("Hit [feat. X] (Live)", "hit (live)");
+    CHECK_STRIPPED("Get Lucky (feat. Pharrell Williams) [Radio Edit]",
+                   "get lucky [radio edit]");
+    CHECK_STRIPPED("Song (feat. A (B)) Part 2", "song part 2");
+    CHECK_STRIPPED("Song (feat. X) - Remastered", "song");
+    CHECK_STRIPPED("Song (feat. X", "song");
+
+    /* Nothing to strip */
+    CHECK_STRIPPED("Featuring Nobody", "featuring nobody");
+    CHECK_STRIPPED("Paranoid Android", "paranoid android");
+    CHECK_STRIPPED("Song (Live) Part 2", "song (live) part 2");
+    CHECK_STRIPPED("Defeat the Giant", "defeat the giant");
+
+    if (failures > 0) {
+        fprintf(stderr, "normalize: %d of %d checks failed\n", failures,
+                checks);
+        return 1;
+    }
+    printf("normalize: %d checks passed\n", checks);
+    return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * offline_check.c — Checks of the offline index against a fixed dump
+ *
+ * Builds an index from tests/fixtures/offline_dump.jsonl and looks up
+ * tracks that must hit (with API and dump column names, different
+ * spellings, album and duration filters) and ones that must miss,
+ * including those of the dump's malformed lines.  Also checks that
+ * truncated indexes are refused and that an empty dump indexes nothing.
+ *
+ *   make check      (or: build/offline_check <dump> <index>)
+ */
+
+#include "offline.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Tracks the fixture yields; its truncated and artist-less lines are
+   skipped */
+#define FIXTURE_TRACKS 5
+
+static int checks, failures;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        checks++;                                                       \
+        if (!(cond)) {                                                  \
+            failures++;                                                 \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                         \
+        }                                                               \
+    } while (0)
+
+/* ── Internal helpers ──────────────────────────────────────────────────── */
+
+static int same(const char *a, const char *b)
+{
+    return (!a && !b) || (a && b && strcmp(a, b) == 0);
+}
+
+static int hit(const OfflineIndex *idx, const char *artist, const char *title,
+               const char *album, double duration, OfflineMatch *m)
+{
+    memset(m, 0, sizeof(*m));
+    return offline_find(idx, artist, title, album, duration, m);
+}
+
+/* ── Main ─────────────────────────────────────────────────────────────── */
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <dump> <index>\n", argv[0]);
+        return 2;
+    }
+    const char *dump = argv[1], *index = argv[2];
+
+    CHECK(offline_build(dump, index) == FIXTURE_TRACKS);
+    CHECK(offline_open(dump) == NULL);   /* a dump is not an index */
+
+    OfflineIndex *idx = offline_open(index);
+    CHECK(idx != NULL);
+    if (!idx) return 1;
+
+    OfflineMatch m;
+
+    /* API field names; the synced entry wins over the plain duplicate */
+    CHECK(hit(idx, "Radiohead", "Paranoid Android", "OK Computer", 387, &m));
+    CHECK(same(m.synced_lyrics, "[00:34.10] Please could you stop the noise"));
+    CHECK(same(m.plain_lyrics, "Please could you stop the noise"));
+    CHECK(!m.instrumental);
+
+    /* Case, spacing and a missing album do not matter */
+    CHECK(hit(idx, "  RADIOHEAD", "paranoid   android ", NULL, 0, &m));
+    CHECK(m.synced_lyrics != NULL);
+
+    /* Dump column names; decomposed accents match precomposed ones */
+    CHECK(hit(idx, "Bj\xc3\xb6rk", "J\xc3\xb3ga", "Homogenic", 305, &m));
+    CHECK(m.synced_lyrics == NULL);
+    CHECK(same(m.plain_lyrics, "All these accidents"));
+    CHECK(hit(idx, "BJO\xcc\x88RK", "jo\xcc\x81ga", NULL, 0, &m));
+
+    /* 0/1 integers as booleans */
+    CHECK(hit(idx, "Aphex Twin", "Flim", "Come to Daddy", 177, &m));
+    CHECK(m.instrumental);
+    CHECK(m.synced_lyrics == NULL && m.plain_lyrics == NULL);
+
+    /* The last line, after the malformed ones, is still indexed */
+    CHECK(hit(idx, "Daft Punk", "Get Lucky", "Random Access Memories", 370,
+              &m));
+
+    /* Wrong album or duration beyond the tolerance */
+    CHECK(!hit(idx, "Radiohead", "Paranoid Android", "The Bends", 0, &m));
+    CHECK(!hit(idx, "Radiohead", "Paranoid Android", NULL, 395, &m));
+
+    /* Unknown tracks, and those of the skipped lines */
+    CHECK(!hit(idx, "Radiohead", "Karma Police", NULL, 0, &m));
+    CHECK(!hit(idx, "Daft Punk", "Paranoid Android", NULL, 0, &m));
+    CHECK(!hit(idx, "Truncated", "Broken Line", NULL, 0, &m));
+    CHECK(!hit(idx, "", "No Artist", NULL, 0, &m));
+
+    offline_close(idx);
+
+    /* An index cut short, or emptied, is refused rather than read */
+    FILE *f = fopen(index, "r+");
+    CHECK(f != NULL);
+    if (f) {
+        CHECK(fseek(f, 0, SEEK_END) == 0);
+        long size = ftell(f);
+        fclose(f);
+        CHECK(truncate(index, size / 2) == 0);
+        CHECK(offline_open(index) == NULL);
+        CHECK(truncate(index, 0) == 0);
+        CHECK(offline_open(index) == NULL);
+    }
+
+    /* An empty dump builds an index that finds nothing; no dump fails */
+    CHECK(offline_build("/dev/null", index) == 0);
+    idx = offline_open(index);
+    CHECK(idx != NULL);
+    if (idx) {
+        CHECK(!hit(idx, "Radiohead", "Paranoid Android", NULL, 0, &m));
+        offline_close(idx);
+    }
+    unlink(index);
+    CHECK(offline_build("/nonexistent/dump.jsonl", index) == -1);
+
+    if (failures > 0) {
+        fprintf(stderr, "offline: %d of %d checks failed\n", failures, checks);
+        return 1;
+    }
+    printf("offline: %d checks passed\n", checks);
+    return 0;
+}
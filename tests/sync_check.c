@@ -0,0 +1,374 @@
+/*
+ * sync_check.c — Checks of the sync pipeline against the offline fixture
+ *
+ * Runs a SyncEngine over generated albums whose tracks cover every
+ * outcome (synced, plain, instrumental, not found, already tagged,
+ * missing metadata, local .lrc), answering lookups from an index of
+ * tests/fixtures/offline_dump.jsonl, so nothing touches the network.
+ * Tracks are text files written through tests/fake_metadata.c.  Checks
+ * the totals, what each file ends up holding, the state index and the
+ * load reported for each stage, then what the reporter delivered: the
+ * callbacks (one at a time, on one thread), the plain / missing logs
+ * and the journal.
+ *
+ *   make check      (or: build/sync_check <fixtures dir> <work dir>)
+ */
+
+#include "sync.h"
+#include "lrclib.h"
+#include "offline.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define ALBUMS         6
+#define LOOKUP_THREADS 4
+#define WRITE_THREADS  2
+
+static int checks, failures;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        checks++;                                                       \
+        if (!(cond)) {                                                  \
+            failures++;                                                 \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                         \
+        }                                                               \
+    } while (0)
+
+/*
+ * One track of every album: its tags, and what the run must leave in
+ * its file and in the state index.
+ */
+typedef struct {
+    const char   *file;
+    const char   *artist;
+    const char   *title;
+    const char   *album;
+    int           duration;
+    const char   *existing;   /* lyrics already in the file, or NULL */
+    const char   *lrc;        /* sidecar .lrc contents, or NULL */
+    const char   *lyrics;     /* LYRICS= line expected after the run */
+    StateOutcome  outcome;
+} TrackSpec;
+
+static const TrackSpec tracks[] = {
+    { "01.flac", "Radiohead", "Paranoid Android", "OK Computer", 387,
+      NULL, NULL, "[00:34.10] Please could you stop the noise",
+      STATE_SYNCED },
+    { "02.flac", "Bj\xc3\xb6rk", "J\xc3\xb3ga", "Homogenic", 305,
+      NULL, NULL, "All these accidents", STATE_PLAIN },
+    { "03.flac", "Aphex Twin", "Flim", "Come to Daddy", 177,
+      NULL, NULL, NULL, STATE_INSTRUMENTAL },
+    { "04.flac", "Radiohead", "Karma Police", "OK Computer", 264,
+      NULL, NULL, NULL, STATE_MISSING },
+    { "05.flac", "Daft Punk", "Get Lucky", "Random Access Memories", 369,
+      "already here", NULL, "already here", STATE_TAGGED },
+    { "06.flac", NULL, "No Artist", NULL, 0,
+      NULL, NULL, NULL, STATE_MISSING },
+    { "07.flac", "Nobody", "Home Recording", NULL, 120,
+      NULL, "[00:01.00] la la", "[00:01.00] la la", STATE_SYNCED },
+    { "08.flac", "Daft Punk", "Get Lucky", NULL, 0,
+      NULL, NULL, "[00:00.50] Like the legend of the phoenix",
+      STATE_SYNCED },
+};
+
+#define NUM_TRACKS ((int)(sizeof(tracks) / sizeof(tracks[0])))
+
+/* Tracks whose lyrics the write stage embeds */
+#define WRITES_PER_ALBUM 4
+
+/*
+ * What the reporter delivered.  Written by the callbacks only, and
+ * read once sync_engine_finish() has stopped the reporter.
+ */
+typedef struct {
+    atomic_int  inside;            /* callbacks running right now */
+    int         overlaps;          /* ... found another one running */
+    pthread_t   thread;
+    int         threads;           /* distinct callback threads seen */
+    int         bad_args;
+    int         progress[ALBUMS];
+    int         done[ALBUMS];
+    SyncResult  album[ALBUMS];
+} Reported;
+
+static Reported reported;
+static int album_ids[ALBUMS];
+
+/* ── Internal helpers ──────────────────────────────────────────────────── */
+
+static void track_path(char *out, size_t size, const char *work, int album,
+                       const char *file)
+{
+    snprintf(out, size, "%s/album%d/%s", work, album, file);
+}
+
+static int write_file(const char *path, const char *text)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    fputs(text, f);
+    return fclose(f);
+}
+
+/* The value of the file's LYRICS= line, in `out`; 0 if it has none */
+static int read_lyrics(const char *path, char *out, size_t size)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+
+    char line[4096];
+    int found = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "LYRICS=", 7) != 0) continue;
+        line[strcspn(line, "\n")] = '\0';
+        snprintf(out, size, "%s", line + 7);
+        found = 1;
+    }
+    fclose(f);
+    return found;
+}
+
+static char *dup_or_null(const char *s)
+{
+    return s ? strdup(s) : NULL;
+}
+
+/* Lines of a log file, and how many of them end in `suffix` */
+static int count_lines(const char *path, const char *suffix, int *matching)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    char line[4096];
+    int lines = 0;
+    *matching = 0;
+    size_t slen = strlen(suffix);
+    while (fgets(line, sizeof(line), f)) {
+        size_t len = strcspn(line, "\n");
+        lines++;
+        if (len >= slen && memcmp(line + len - slen, suffix, slen) == 0) {
+            (*matching)++;
+        }
+    }
+    fclose(f);
+    return lines;
+}
+
+static void callback_enter(void)
+{
+    if (atomic_fetch_add(&reported.inside, 1) != 0) reported.overlaps++;
+    if (reported.threads == 0) {
+        reported.thread  = pthread_self();
+        reported.threads = 1;
+    } else if (!pthread_equal(reported.thread, pthread_self())) {
+        reported.threads++;
+    }
+}
+
+static void callback_leave(void)
+{
+    atomic_fetch_sub(&reported.inside, 1);
+}
+
+static void on_progress(int idx, int total, const char *title,
+                        const char *status, void *user)
+{
+    callback_enter();
+    int a = *(const int *)user;
+    reported.progress[a]++;
+    if (idx < 0 || idx >= NUM_TRACKS || (total != 0 && total != NUM_TRACKS) ||
+        !title || !status || status[0] == '\0') {
+        reported.bad_args++;
+    }
+    callback_leave();
+}
+
+static void on_album_done(const SyncResult *result, void *user)
+{
+    callback_enter();
+    int a = *(const int *)user;
+    reported.done[a]++;
+    reported.album[a] = *result;
+    callback_leave();
+}
+
+/*
+ * Write the files of album `album` and stream its tracks into `e`.
+ */
+static int submit_album(SyncEngine *e, const char *work, int album)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/album%d", work, album);
+    mkdir(path, 0755);
+
+    album_ids[album] = album;
+    SyncAlbum *a = sync_engine_begin_album(e, &album_ids[album]);
+    if (!a) return -1;
+
+    for (int i = 0; i < NUM_TRACKS; i++) {
+        const TrackSpec *t = &tracks[i];
+        track_path(path, sizeof(path), work, album, t->file);
+
+        char text[512];
+        snprintf(text, sizeof(text), "TITLE=%s\n%s%s%s", t->title,
+                 t->existing ? "LYRICS=" : "",
+                 t->existing ? t->existing : "", t->existing ? "\n" : "");
+        if (write_file(path, text) != 0) return -1;
+
+        if (t->lrc) {
+            char lrc[4096];
+            snprintf(lrc, sizeof(lrc), "%.*s.lrc",
+                     (int)(strrchr(path, '.') - path), path);
+            if (write_file(lrc, t->lrc) != 0) return -1;
+        }
+
+        TrackMeta *m = calloc(1, sizeof(TrackMeta));
+        if (!m) return -1;
+        m->artist       = dup_or_null(t->artist);
+        m->title        = dup_or_null(t->title);
+        m->album        = dup_or_null(t->album);
+        m->duration     = t->duration;
+        m->track_number = i + 1;
+        m->has_lyrics   = t->existing != NULL;
+        m->filepath     = strdup(path);
+        if (sync_album_add(a, m) != 0) {
+            metadata_free(m);
+            return -1;
+        }
+    }
+    sync_album_end(a);
+    return 0;
+}
+
+/* ── Main ─────────────────────────────────────────────────────────────── */
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <fixtures dir> <work dir>\n", argv[0]);
+        return 2;
+    }
+    const char *fixtures = argv[1], *work = argv[2];
+    mkdir(work, 0755);
+
+    char dump[4096], index[4096], state_path[4096], journal_path[4096];
+    char plain_log[4096], missing_log[4096];
+    snprintf(dump, sizeof(dump), "%s/offline_dump.jsonl", fixtures);
+    snprintf(index, sizeof(index), "%s/offline.idx", work);
+    snprintf(state_path, sizeof(state_path), "%s/state.idx", work);
+    snprintf(journal_path, sizeof(journal_path), "%s/journal", work);
+    snprintf(plain_log, sizeof(plain_log), "%s/plain.txt", work);
+    snprintf(missing_log, sizeof(missing_log), "%s/missing.txt", work);
+    remove(state_path);
+
+    CHECK(offline_build(dump, index) > 0);
+    OfflineIndex *idx = offline_open(index);
+    CHECK(idx != NULL);
+    if (!idx) return 1;
+    lrclib_set_offline(idx);
+
+    SyncConfig config = {
+        .num_threads   = LOOKUP_THREADS,
+        .write_threads = WRITE_THREADS,
+        .out_plain     = plain_log,
+        .out_missing   = missing_log,
+        .state         = state_open(state_path, 0),
+        .journal       = journal_open(journal_path, 0)
+    };
+    CHECK(config.state != NULL);
+    CHECK(config.journal != NULL);
+
+    SyncEngine *e = sync_engine_new(&config, on_progress, on_album_done);
+    CHECK(e != NULL);
+    if (!e) return 1;
+    for (int a = 0; a < ALBUMS; a++) {
+        CHECK(submit_album(e, work, a) == 0);
+    }
+    /* Unchanged tracks the scan skipped are logged too */
+    sync_engine_log_skipped(e, "/unchanged/plain.flac", STATE_PLAIN);
+    sync_engine_log_skipped(e, "/unchanged/missing.flac", STATE_MISSING);
+    sync_engine_log_skipped(e, "/unchanged/synced.flac", STATE_SYNCED);
+    SyncResult r = sync_engine_finish(e);
+
+    /* Instrumentals and local .lrc files count as synced */
+    CHECK(r.synced == 4 * ALBUMS);
+    CHECK(r.plain == 1 * ALBUMS);
+    CHECK(r.not_found == 2 * ALBUMS);
+    CHECK(r.skipped == 1 * ALBUMS);
+    CHECK(r.lookups_saved == 1 * ALBUMS);
+    CHECK(r.errors == 0);
+
+    /* Every track went through the lookup stage, only lyrics through
+       the write stage */
+    CHECK(r.lookup_stage.threads == LOOKUP_THREADS);
+    CHECK(r.write_stage.threads == WRITE_THREADS);
+    CHECK(r.lookup_stage.items == (long)NUM_TRACKS * ALBUMS);
+    CHECK(r.write_stage.items == (long)WRITES_PER_ALBUM * ALBUMS);
+
+    for (int a = 0; a < ALBUMS; a++) {
+        for (int i = 0; i < NUM_TRACKS; i++) {
+            const TrackSpec *t = &tracks[i];
+            char path[4096], lyrics[4096];
+            track_path(path, sizeof(path), work, a, t->file);
+
+            int has = read_lyrics(path, lyrics, sizeof(lyrics));
+            if (t->lyrics) {
+                CHECK(has && strcmp(lyrics, t->lyrics) == 0);
+            } else {
+                CHECK(!has);
+            }
+            CHECK(state_recorded(config.state, path) == t->outcome);
+        }
+    }
+
+    /* Reporter: every track and album reported once, serially */
+    CHECK(reported.overlaps == 0);
+    CHECK(reported.threads == 1);
+    CHECK(reported.bad_args == 0);
+    for (int a = 0; a < ALBUMS; a++) {
+        CHECK(reported.progress[a] == NUM_TRACKS);
+        CHECK(reported.done[a] == 1);
+        CHECK(reported.album[a].synced == 4 && reported.album[a].plain == 1 &&
+              reported.album[a].not_found == 2 &&
+              reported.album[a].skipped == 1);
+    }
+
+    int matching;
+    CHECK(count_lines(plain_log, "/02.flac", &matching) == ALBUMS + 1);
+    CHECK(matching == ALBUMS);
+    CHECK(count_lines(missing_log, "/04.flac", &matching) ==
+          2 * ALBUMS + 1);
+    CHECK(matching == ALBUMS);
+
+    /* The journal lists every finished track for a resume */
+    journal_close(config.journal, 0);
+    Journal *j = journal_open(journal_path, 1);
+    CHECK(j != NULL);
+    CHECK(journal_count(j) == (long)NUM_TRACKS * ALBUMS);
+    for (int a = 0; a < ALBUMS; a++) {
+        for (int i = 0; i < NUM_TRACKS; i++) {
+            char path[4096];
+            track_path(path, sizeof(path), work, a, tracks[i].file);
+            CHECK(journal_is_done(j, path));
+        }
+    }
+    journal_close(j, 1);
+
+    state_close(config.state);
+    lrclib_set_offline(NULL);
+    offline_close(idx);
+
+    if (failures > 0) {
+        fprintf(stderr, "sync: %d of %d checks failed\n", failures, checks);
+        return 1;
+    }
+    printf("sync: %d checks passed\n", checks);
+    return 0;
+}